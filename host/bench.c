@@ -0,0 +1,397 @@
+// Microbenchmarks for the sysmodule's hot paths, built by `make host-bench`
+// against the host shim. Each benchmark is warmed up, calibrated so one sample
+// takes about SAMPLE_TARGET_NS, then sampled RUNS times; the median, min, max
+// and median absolute deviation of ns/op are printed one line per benchmark in
+// a fixed order, so two runs can be diffed or compared with -c:
+//
+//   richnx-bench > before.txt
+//   ... change, rebuild ...
+//   richnx-bench -c before.txt
+
+#include "host_shim.h"
+#include "http_server.h"
+#include "json_writer.h"
+#include "telemetry.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RUNS_DEFAULT 15
+#define RUNS_MAX 101
+#define WARMUP_NS 50000000ULL
+#define SAMPLE_TARGET_NS 10000000ULL
+#define BASELINE_MAX 64
+
+typedef void (*BenchFn)(u64 iterations);
+
+typedef struct {
+    const char* name;
+    BenchFn fn;
+} Bench;
+
+typedef struct {
+    char name[64];
+    double median_ns;
+} BaselineEntry;
+
+static TelemetryState g_state;
+static HttpServer g_server;
+static char g_out[4096];
+static volatile size_t g_sink; // keeps results observable so calls are not elided
+
+static BaselineEntry g_baseline[BASELINE_MAX];
+static int g_baseline_count;
+
+// A long, mostly non-ASCII title with a few characters that need escaping.
+static const char g_utf8_title[] =
+    "\xE3\x82\xBC\xE3\x83\xAB\xE3\x83\x80\xE3\x81\xAE\xE4\xBC\x9D\xE8\xAA\xAC "
+    "\xE3\x83\x86\xE3\x82\xA3\xE3\x82\xA2\xE3\x83\xBC\xE3\x82\xBA \xE3\x82\xAA\xE3\x83\x96 "
+    "\xE3\x82\xB6 \xE3\x82\xAD\xE3\x83\xB3\xE3\x82\xB0\xE3\x83\x80\xE3\x83\xA0 \xE2\x80\x94 "
+    "\xC3\x89" "dition \"Collector\xE2\x80\x99s\" \\ Pok\xC3\xA9mon\xE2\x84\xA2 "
+    "\xE3\x82\xB9\xE3\x83\x97\xE3\x83\xA9\xE3\x83\x88\xE3\x82\xA5\xE3\x83\xBC\xE3\x83\xB3 3\t"
+    "\xF0\x9F\x8E\xAE \xE5\xA4\xA7\xE4\xB9\xB1\xE9\x97\x98\xE3\x82\xB9\xE3\x83\x9E\xE3\x83\x83"
+    "\xE3\x82\xB7\xE3\x83\xA5\xE3\x83\x96\xE3\x83\xA9\xE3\x82\xB6\xE3\x83\xBC\xE3\x82\xBA "
+    "SPECIAL \xE2\x80\x94 Deluxe Edition";
+
+static const char g_ascii_title[] =
+    "The Legend of Zelda: Tears of the Kingdom - Collector's Edition - Super Smash Bros. Ultimate";
+
+static const char* const g_request_lines[] = {
+    "GET /state HTTP/1.1\r\nHost: 192.168.1.20:6029\r\n\r\n",
+    "GET /debug HTTP/1.1\r\nHost: 192.168.1.20:6029\r\n\r\n",
+    "GET /debug/timings HTTP/1.1\r\nHost: 192.168.1.20:6029\r\n\r\n",
+    "GET /log?since=120 HTTP/1.1\r\nHost: 192.168.1.20:6029\r\n\r\n",
+    "GET /favicon.ico HTTP/1.1\r\nHost: 192.168.1.20:6029\r\n\r\n",
+};
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+// benchmarks -----------------------------------------------------------------------
+
+static void bench_telemetry_build_json(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) g_sink += telemetry_build_json(&g_state, g_out, sizeof(g_out));
+}
+
+// The /state renderer as it was before JsonWriter (escape helper included),
+// kept only as the comparison point for telemetry_build_json.
+static void snprintf_json_escape(const char* in, char* out, size_t out_size) {
+    size_t oi = 0;
+    size_t i;
+
+    for (i = 0; in[i] != '\0' && oi + 2 < out_size; i++) {
+        const char c = in[i];
+        if (c == '\\' || c == '"') {
+            out[oi++] = '\\';
+            out[oi++] = c;
+        } else if ((unsigned char)c < 0x20) {
+            out[oi++] = ' ';
+        } else {
+            out[oi++] = c;
+        }
+    }
+    out[oi] = '\0';
+}
+
+static size_t telemetry_build_json_snprintf(TelemetryState* state, char* out, size_t out_size) {
+    TelemetryState s;
+    char escaped_game[512];
+    char escaped_firmware[64];
+    char battery_percent_json[16];
+    char is_charging_json[8];
+    char is_docked_json[8];
+    int n;
+
+    rmutexLock(&state->lock);
+    memcpy(&s, state, sizeof(s));
+    rmutexUnlock(&state->lock);
+
+    snprintf_json_escape(s.active_game, escaped_game, sizeof(escaped_game));
+    snprintf_json_escape(s.firmware, escaped_firmware, sizeof(escaped_firmware));
+    if (s.battery_percent_valid) {
+        snprintf(battery_percent_json, sizeof(battery_percent_json), "%u", (unsigned int)s.battery_percent);
+    } else {
+        snprintf(battery_percent_json, sizeof(battery_percent_json), "null");
+    }
+    if (s.is_charging_valid) {
+        snprintf(is_charging_json, sizeof(is_charging_json), "%s", s.is_charging ? "true" : "false");
+    } else {
+        snprintf(is_charging_json, sizeof(is_charging_json), "null");
+    }
+    if (s.is_docked_valid) {
+        snprintf(is_docked_json, sizeof(is_docked_json), "%s", s.is_docked ? "true" : "false");
+    } else {
+        snprintf(is_docked_json, sizeof(is_docked_json), "null");
+    }
+
+    n = snprintf(
+        out,
+        out_size,
+        "{"
+        "\"service\":\"RichNX\","
+        "\"firmware\":\"%s\","
+        "\"active_program_id\":\"0x%016llX\","
+        "\"active_game\":\"%s\","
+        "\"started_sec\":%llu,"
+        "\"last_update_sec\":%llu,"
+        "\"sample_count\":%llu,"
+        "\"last_pm_result\":\"0x%08lX\","
+        "\"last_pminfo_result\":\"0x%08lX\","
+        "\"last_ns_result\":\"0x%08lX\","
+        "\"last_svc_result\":\"0x%08lX\","
+        "\"last_process_id\":\"0x%016llX\","
+        "\"detection_source\":%u,"
+        "\"detection_mode\":%s,"
+        "\"detection_attempt_count\":%llu,"
+        "\"detection_success_count\":%llu,"
+        "\"detection_fail_count\":%llu,"
+        "\"detection_fail_streak\":%u,"
+        "\"detection_last_query_sec\":%llu,"
+        "\"detection_last_success_sec\":%llu,"
+        "\"battery_percent\":%s,"
+        "\"is_charging\":%s,"
+        "\"is_docked\":%s,"
+        "\"dock_detection_source\":%u"
+        "}",
+        escaped_firmware,
+        (unsigned long long)s.active_program_id,
+        escaped_game,
+        (unsigned long long)s.started_sec,
+        (unsigned long long)s.last_update_sec,
+        (unsigned long long)s.sample_count,
+        (unsigned long)s.last_pm_result,
+        (unsigned long)s.last_pminfo_result,
+        (unsigned long)s.last_ns_result,
+        (unsigned long)s.last_svc_result,
+        (unsigned long long)s.last_process_id,
+        (unsigned int)s.detection_source,
+        s.detection_source != 0 ? "true" : "false",
+        (unsigned long long)s.detection_attempt_count,
+        (unsigned long long)s.detection_success_count,
+        (unsigned long long)s.detection_fail_count,
+        (unsigned int)s.detection_fail_streak,
+        (unsigned long long)s.detection_last_query_sec,
+        (unsigned long long)s.detection_last_success_sec,
+        battery_percent_json,
+        is_charging_json,
+        is_docked_json,
+        (unsigned int)s.dock_detection_source
+    );
+    return n > 0 ? (size_t)n : 0;
+}
+
+static void bench_telemetry_build_json_snprintf(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) g_sink += telemetry_build_json_snprintf(&g_state, g_out, sizeof(g_out));
+}
+
+static void bench_json_escape_utf8(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) {
+        JsonWriter w;
+        json_writer_init(&w, g_out, sizeof(g_out));
+        json_string_n(&w, g_utf8_title, sizeof(g_utf8_title) - 1);
+        g_sink += json_writer_finish(&w);
+    }
+}
+
+static void bench_json_escape_ascii(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) {
+        JsonWriter w;
+        json_writer_init(&w, g_out, sizeof(g_out));
+        json_string_n(&w, g_ascii_title, sizeof(g_ascii_title) - 1);
+        g_sink += json_writer_finish(&w);
+    }
+}
+
+static void bench_debug_json(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) g_sink += http_server_build_debug_json(&g_server, g_out, sizeof(g_out));
+}
+
+static void bench_route_match(u64 n) {
+    const size_t count = sizeof(g_request_lines) / sizeof(g_request_lines[0]);
+    u64 i;
+    for (i = 0; i < n; i++) g_sink += (size_t)http_server_match_route(g_request_lines[i % count]);
+}
+
+static void bench_telemetry_lock(u64 n) {
+    u64 i;
+    for (i = 0; i < n; i++) {
+        rmutexLock(&g_state.lock);
+        g_sink++;
+        rmutexUnlock(&g_state.lock);
+    }
+}
+
+static const Bench g_benches[] = {
+    { "telemetry_build_json", bench_telemetry_build_json },
+    { "telemetry_build_json_snprintf", bench_telemetry_build_json_snprintf },
+    { "json_escape_utf8_title", bench_json_escape_utf8 },
+    { "json_escape_ascii_title", bench_json_escape_ascii },
+    { "http_server_build_debug_json", bench_debug_json },
+    { "http_server_match_route", bench_route_match },
+    { "telemetry_lock_cycle", bench_telemetry_lock },
+};
+
+// harness --------------------------------------------------------------------------
+
+static void setup_state(void) {
+    static const char* const script[][2] = {
+        { "psm.battery", "87" },
+        { "psm.charger", "1" },
+        { "applet.mode", "1" },
+        { "pmshell.pid", "0x81" },
+        { "pminfo.program_id", "0x0100F2C0115B6000" },
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(script) / sizeof(script[0]); i++) host_shim_set(script[i][0], script[i][1]);
+    telemetry_init(&g_state);
+    telemetry_set_firmware(&g_state, "18.1.0");
+    telemetry_update(&g_state, 0xFFFFFFFFu);
+    snprintf(g_state.active_game, sizeof(g_state.active_game), "%s", g_utf8_title);
+
+    memset(&g_server, 0, sizeof(g_server));
+    g_server.telemetry = &g_state;
+    g_server.listen_fd = -1;
+    g_server.client_fd = -1;
+    g_server.accepted_count = 1234;
+    g_server.request_count = 1240;
+}
+
+static int compare_double(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double* v, int n) {
+    qsort(v, (size_t)n, sizeof(*v), compare_double);
+    return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2.0;
+}
+
+static u64 calibrate(BenchFn fn) {
+    const u64 warm_end = now_ns() + WARMUP_NS;
+    u64 iterations = 1;
+
+    // Warm up caches and branch predictors, growing the batch as we go.
+    while (now_ns() < warm_end) {
+        const u64 start = now_ns();
+        u64 elapsed;
+
+        fn(iterations);
+        elapsed = now_ns() - start;
+        if (elapsed < SAMPLE_TARGET_NS / 2 && iterations < (1ULL << 40)) {
+            iterations *= 2;
+        } else if (elapsed > 0) {
+            iterations = iterations * SAMPLE_TARGET_NS / elapsed;
+            if (iterations == 0) iterations = 1;
+        }
+    }
+    return iterations;
+}
+
+static const BaselineEntry* find_baseline(const char* name) {
+    int i;
+    for (i = 0; i < g_baseline_count; i++) {
+        if (strcmp(g_baseline[i].name, name) == 0) return &g_baseline[i];
+    }
+    return NULL;
+}
+
+static bool load_baseline(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[256];
+
+    if (!f) {
+        fprintf(stderr, "bench: cannot open %s\n", path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f) && g_baseline_count < BASELINE_MAX) {
+        BaselineEntry* e = &g_baseline[g_baseline_count];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s median_ns=%lf", e->name, &e->median_ns) == 2) g_baseline_count++;
+    }
+    fclose(f);
+    return true;
+}
+
+static void run_bench(const Bench* b, int runs) {
+    double samples[RUNS_MAX];
+    double deviations[RUNS_MAX];
+    const u64 iterations = calibrate(b->fn);
+    const BaselineEntry* base = find_baseline(b->name);
+    double median, mad, lo, hi;
+    int i;
+
+    for (i = 0; i < runs; i++) {
+        const u64 start = now_ns();
+        b->fn(iterations);
+        samples[i] = (double)(now_ns() - start) / (double)iterations;
+    }
+    median = median_of(samples, runs);
+    lo = samples[0];
+    hi = samples[runs - 1];
+    for (i = 0; i < runs; i++) deviations[i] = samples[i] > median ? samples[i] - median : median - samples[i];
+    mad = median_of(deviations, runs);
+
+    printf(
+        "%-30s median_ns=%10.1f min_ns=%10.1f max_ns=%10.1f mad_pct=%5.1f iters=%llu",
+        b->name,
+        median,
+        lo,
+        hi,
+        median > 0 ? 100.0 * mad / median : 0.0,
+        (unsigned long long)iterations
+    );
+    if (base && base->median_ns > 0) {
+        printf(" vs_baseline=%+.1f%%", 100.0 * (median - base->median_ns) / base->median_ns);
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [-r runs] [-f name-substring] [-c baseline.txt]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* filter = NULL;
+    int runs = RUNS_DEFAULT;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:f:c:")) != -1) {
+        switch (opt) {
+            case 'r': runs = atoi(optarg); break;
+            case 'f': filter = optarg; break;
+            case 'c':
+                if (!load_baseline(optarg)) return 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (runs < 3 || runs > RUNS_MAX) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    setup_state();
+    printf("# richnx-bench runs=%d sample_target_ms=%llu\n", runs, (unsigned long long)(SAMPLE_TARGET_NS / 1000000ULL));
+    for (i = 0; i < sizeof(g_benches) / sizeof(g_benches[0]); i++) {
+        if (filter && !strstr(g_benches[i].name, filter)) continue;
+        run_bench(&g_benches[i], runs);
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+#---------------------------------------------------------------------------------
+# Host (Linux) build of the sysmodule. Included by the top-level Makefile for
+# `make host` / `host-bench` / `host-replay` / `host-clean`; compiles every
+# file in source/ with the system compiler against host/include/switch.h and
+# links host/shim.c. The bench and replay tools link the same objects minus
+# main.c with host/bench.c and host/replay.c.
+#
+# Every binary's socket calls go through host/netfault.c (linker --wrap);
+# RICHNX_NETFAULT=<file> injects scripted errors there, driven by
+# tools/faultrun.
+#
+# Run it from a scratch directory: "sdmc:/..." paths land in ./sdmc:/, and
+# RICHNX_SHIM_SCRIPT=<file> scripts the psm/applet/pm/nifm results (see
+# host/include/host_shim.h).
+#---------------------------------------------------------------------------------
+HOST_TARGET	:=	richnx-host
+HOST_BENCH	:=	richnx-bench
+HOST_REPLAY	:=	richnx-replay
+HOST_BUILD	:=	build-host
+
+HOST_CC		?=	cc
+HOST_CFLAGS	?=	-O2 -g -Wall
+HOST_CFLAGS	+=	-std=gnu11 -MMD -MP -Iinclude -Ihost/include \
+			-DLOG_COMPILE_MIN_LEVEL=$(or $(LOG_COMPILE_MIN_LEVEL),0)
+HOST_LDLIBS	:=	-lpthread
+HOST_LDFLAGS	:=	-Wl,--wrap=socket,--wrap=bind,--wrap=listen,--wrap=accept \
+			-Wl,--wrap=select,--wrap=recv,--wrap=send
+
+HOST_SOURCES	:=	$(wildcard source/*.c) host/shim.c host/netfault.c
+HOST_OBJS	:=	$(patsubst %.c,$(HOST_BUILD)/%.o,$(HOST_SOURCES))
+HOST_LIB_OBJS	:=	$(filter-out $(HOST_BUILD)/source/main.o,$(HOST_OBJS))
+
+.PHONY: host host-bench host-replay host-clean
+
+host: $(HOST_TARGET)
+
+host-bench: $(HOST_BENCH)
+
+host-replay: $(HOST_REPLAY)
+
+$(HOST_TARGET): $(HOST_OBJS)
+	$(HOST_CC) $(HOST_CFLAGS) $(HOST_LDFLAGS) -o $@ $^ $(HOST_LDLIBS)
+
+$(HOST_BENCH): $(HOST_LIB_OBJS) $(HOST_BUILD)/host/bench.o
+	$(HOST_CC) $(HOST_CFLAGS) $(HOST_LDFLAGS) -o $@ $^ $(HOST_LDLIBS)
+
+$(HOST_REPLAY): $(HOST_LIB_OBJS) $(HOST_BUILD)/host/replay.o
+	$(HOST_CC) $(HOST_CFLAGS) $(HOST_LDFLAGS) -o $@ $^ $(HOST_LDLIBS)
+
+$(HOST_BUILD)/%.o: %.c
+	@mkdir -p $(dir $@)
+	$(HOST_CC) $(HOST_CFLAGS) -c -o $@ $<
+
+host-clean:
+	@echo clean host ...
+	@rm -fr $(HOST_BUILD) $(HOST_TARGET) $(HOST_BENCH) $(HOST_REPLAY)
+
+-include $(HOST_OBJS:.o=.d) $(HOST_BUILD)/host/bench.d $(HOST_BUILD)/host/replay.d
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+
+// Scripted return values for the host libnx shim. Every key holds a sequence
+// that is consumed one value per call; once exhausted the last value repeats.
+//
+// Script files hold one "key = value, value, ..." line per key; "#" and ";"
+// start comments and "value*N" repeats a value N times. Values are decimal or
+// 0x-prefixed hex, except setsys.firmware which is dotted ("18.1.0").
+//
+//   psm.battery = 100*30, 99*30, 98
+//   psm.charger = 1                 ; PsmChargerType
+//   applet.mode = 1                 ; 1 = docked
+//   applet.rc   = 0
+//   pmshell.pid = 0x81
+//   pminfo.program_id = 0x01006F8002326000
+//   nifm.status = 4, 4, 0*5, 4      ; link drop for five polls
+//   fs.init.rc  = 0x1234, 0         ; first attempt fails
+//   time.now    = 1700000000        ; fixed wall clock (0 = host clock)
+//
+// Every libnx call in switch.h with a scripted result has a matching key; see
+// g_host_shim_keys in host/shim.c for the list and defaults. The environment
+// variable RICHNX_SHIM_SCRIPT names a script loaded before __appInit runs.
+
+// Replaces key's sequence from a comma separated value list.
+bool host_shim_set(const char* key, const char* values);
+// Loads a script file; returns false on I/O or parse errors (logged to stderr).
+bool host_shim_load(const char* path);
+// Number of times key's value has been consumed.
+u64 host_shim_calls(const char* key);
+// Restores every key to its default and clears call counts.
+void host_shim_reset(void);
+
+// Telemetry calls a hook can answer instead of the script (see host/replay.c).
+typedef enum {
+    HostShimCall_PsmBattery = 0,
+    HostShimCall_PsmCharger,
+    HostShimCall_AppletSystemInfo, // rc only
+    HostShimCall_AppletMode,       // value only
+    HostShimCall_PmshellPid,
+    HostShimCall_PminfoProgramId,  // arg = pid
+    HostShimCall_ProcessList,      // value = pid count, pids = the list
+    HostShimCall_Count,
+} HostShimCall;
+
+typedef struct {
+    Result rc;
+    u64 value;
+    const u64* pids;
+} HostShimReply;
+
+// Consulted before the scripted sequences; returning true answers the call.
+typedef bool (*HostShimHook)(HostShimCall call, u64 arg, HostShimReply* reply);
+void host_shim_set_hook(HostShimHook hook);
+
+// Exits through __appExit if SIGINT/SIGTERM arrived and the caller is the
+// main thread. svcSleepThread checks it, and so does select (host/netfault.c),
+// where the main loop waits in reactor_mode.
+void host_shim_exit_if_requested(void);
+
+// Freezes armGetSystemTick at ns so callers can be driven faster than real
+// time; host_shim_use_real_time() switches back to CLOCK_MONOTONIC.
+void host_shim_set_time_ns(u64 ns);
+void host_shim_use_real_time(void);
@@ -0,0 +1,202 @@
+#pragma once
+
+// Host (Linux) stand-in for the subset of libnx the sysmodule uses. Types keep
+// libnx's names and the fields the sources touch; service calls return values
+// scripted through host_shim.h.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef u32 Result;
+typedef u32 Handle;
+
+#define INVALID_HANDLE ((Handle)0)
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res) ((res) != 0)
+#define R_MODULE(res) ((res) & 0x1FF)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1FFF)
+#define MAKERESULT(module, description) \
+    ((((module) & 0x1FF)) | ((description) & 0x1FFF) << 9)
+
+#define Module_Kernel 1
+#define KernelError_TimedOut 117
+#define KERNELRESULT(description) MAKERESULT(Module_Kernel, KernelError_##description)
+
+// sync / threads -------------------------------------------------------------
+
+// Recursive like libnx's; zero-initialised storage is a valid unlocked mutex.
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_t owner;
+    u32 counter;
+} RMutex;
+
+void rmutexInit(RMutex* m);
+void rmutexLock(RMutex* m);
+bool rmutexTryLock(RMutex* m);
+void rmutexUnlock(RMutex* m);
+
+typedef void (*ThreadFunc)(void*);
+
+typedef struct {
+    Handle handle;
+    void* stack_mem;
+    size_t stack_sz;
+} Thread;
+
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread* t);
+Result threadWaitForExit(Thread* t);
+Result threadClose(Thread* t);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool signaled;
+    bool auto_clear;
+} UEvent;
+
+typedef struct {
+    UEvent* event;
+} Waiter;
+
+void ueventCreate(UEvent* e, bool auto_clear);
+void ueventClear(UEvent* e);
+void ueventSignal(UEvent* e);
+Waiter waiterForUEvent(UEvent* e);
+Result waitSingle(Waiter w, u64 timeout_ns);
+// Only thread handles can be waited on; signalled when the thread has exited.
+Result waitSingleHandle(Handle h, u64 timeout_ns);
+
+void svcSleepThread(s64 ns);
+Result svcGetProcessList(s32* out_count, u64* out_pids, u32 max);
+
+// 19.2 MHz like the console, derived from CLOCK_MONOTONIC.
+u64 armGetSystemTick(void);
+u64 armGetSystemTickFreq(void);
+u64 armTicksToNs(u64 ticks);
+u64 armNsToTicks(u64 ns);
+
+// services -------------------------------------------------------------------
+
+typedef struct {
+    char name[8];
+} SmServiceName;
+
+Result smInitialize(void);
+void smExit(void);
+SmServiceName smEncodeName(const char* name);
+Result smAtmosphereHasService(bool* out, SmServiceName name);
+
+Result fsInitialize(void);
+void fsExit(void);
+// Mounts "sdmc:" as a directory of that name under the working directory.
+Result fsdevMountSdmc(void);
+int fsdevUnmountAll(void);
+
+typedef struct {
+    u8 major;
+    u8 minor;
+    u8 micro;
+    u8 padding1;
+    u8 revision_major;
+    u8 revision_minor;
+    u8 padding2;
+    u8 padding3;
+    char platform[0x20];
+    char version_hash[0x40];
+    char display_version[0x18];
+    char display_title[0x80];
+} SetSysFirmwareVersion;
+
+Result setsysInitialize(void);
+void setsysExit(void);
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion* out);
+
+typedef enum {
+    NifmServiceType_User = 1,
+    NifmServiceType_System = 2,
+    NifmServiceType_Admin = 3,
+} NifmServiceType;
+
+typedef enum {
+    NifmInternetConnectionType_WiFi = 1,
+    NifmInternetConnectionType_Ethernet = 2,
+} NifmInternetConnectionType;
+
+typedef enum {
+    NifmInternetConnectionStatus_ConnectingUnknown1 = 0,
+    NifmInternetConnectionStatus_ConnectingUnknown2 = 1,
+    NifmInternetConnectionStatus_ConnectingUnknown3 = 2,
+    NifmInternetConnectionStatus_ConnectingUnknown4 = 3,
+    NifmInternetConnectionStatus_Connected = 4,
+} NifmInternetConnectionStatus;
+
+Result nifmInitialize(NifmServiceType service_type);
+void nifmExit(void);
+Result nifmGetInternetConnectionStatus(NifmInternetConnectionType* type, u32* wifi_strength, NifmInternetConnectionStatus* status);
+
+typedef enum {
+    AppletType_None = -2,
+    AppletType_Default = -1,
+} AppletType;
+
+typedef enum {
+    AppletOperationMode_Handheld = 0,
+    AppletOperationMode_Console = 1,
+} AppletOperationMode;
+
+Result appletInitialize(void);
+void appletExit(void);
+Result appletGetOperationModeSystemInfo(u32* info);
+AppletOperationMode appletGetOperationMode(void);
+
+typedef enum {
+    PsmChargerType_Unconnected = 0,
+    PsmChargerType_EnoughPower = 1,
+    PsmChargerType_LowPower = 2,
+    PsmChargerType_NotSupported = 3,
+} PsmChargerType;
+
+Result psmInitialize(void);
+void psmExit(void);
+Result psmGetBatteryChargePercentage(u32* out);
+Result psmGetChargerType(PsmChargerType* out);
+
+Result pmshellInitialize(void);
+void pmshellExit(void);
+Result pmshellGetApplicationProcessIdForShell(u64* pid_out);
+
+Result pminfoInitialize(void);
+void pminfoExit(void);
+Result pminfoGetProgramId(u64* program_id_out, u64 pid);
+
+Result nsInitialize(void);
+void nsExit(void);
+
+Result socketInitializeDefault(void);
+void socketExit(void);
+
+typedef enum {
+    TimeType_UserSystemClock = 0,
+    TimeType_NetworkSystemClock = 1,
+    TimeType_LocalSystemClock = 2,
+    TimeType_Default = TimeType_UserSystemClock,
+} TimeType;
+
+Result timeInitialize(void);
+void timeExit(void);
+// Unix time in seconds; the host's own clock unless time.now is scripted.
+Result timeGetCurrentTime(TimeType type, u64* timestamp);
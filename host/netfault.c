@@ -0,0 +1,359 @@
+// Socket fault injection for the host build. Every host binary is linked with
+// -Wl,--wrap for socket, bind, listen, accept, select, recv and send; the
+// wrappers pass straight through unless RICHNX_NETFAULT names a scenario file:
+//
+//   [accept_unreachable]          ; one scenario per section
+//   accept = ok*2, EHOSTUNREACH*3 ; per-call actions, consumed in order
+//   [slow_client]
+//   recv = ok+1500                ; "+ms" delays the call first
+//
+// An action is "ok" (call through), an errno name or number (fail with it),
+// or either with "+ms"; "*N" repeats. Once a scenario's lists run out every
+// call passes through again. SIGUSR1 arms the next scenario (see
+// tools/faultrun.c, which drives this and measures recovery). With
+// RICHNX_NETFAULT_LOG set, arming, each injected action and exhaustion are
+// appended there as "<CLOCK_MONOTONIC ns> <scenario> <event> [<errno> <delay_ms>]".
+
+#include "host_shim.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#define NETFAULT_SCENARIO_MAX 32
+#define NETFAULT_ACTIONS_MAX 1024
+#define NETFAULT_LINE_MAX 1024
+
+typedef enum {
+    NetOp_Socket = 0,
+    NetOp_Bind,
+    NetOp_Listen,
+    NetOp_Accept,
+    NetOp_Select,
+    NetOp_Recv,
+    NetOp_Send,
+    NetOp_Count,
+} NetOp;
+
+typedef struct {
+    int err;      // 0 = call through
+    uint32_t delay_ms;
+} NetAction;
+
+typedef struct {
+    NetAction* actions;
+    size_t count;
+    size_t cursor;
+} NetSequence;
+
+typedef struct {
+    char name[48];
+    NetSequence ops[NetOp_Count];
+    bool exhausted;
+} NetScenario;
+
+static const char* const g_op_names[NetOp_Count] = {
+    "socket", "bind", "listen", "accept", "select", "recv", "send",
+};
+
+static const struct {
+    const char* name;
+    int value;
+} g_errno_names[] = {
+    { "EINTR", EINTR }, { "EAGAIN", EAGAIN }, { "EBADF", EBADF }, { "EINVAL", EINVAL },
+    { "ENOMEM", ENOMEM }, { "EMFILE", EMFILE }, { "ENFILE", ENFILE }, { "ENOBUFS", ENOBUFS },
+    { "EPIPE", EPIPE }, { "EADDRINUSE", EADDRINUSE }, { "EADDRNOTAVAIL", EADDRNOTAVAIL },
+    { "ENETDOWN", ENETDOWN }, { "ENETUNREACH", ENETUNREACH }, { "ENETRESET", ENETRESET },
+    { "ECONNABORTED", ECONNABORTED }, { "ECONNRESET", ECONNRESET }, { "ETIMEDOUT", ETIMEDOUT },
+    { "ECONNREFUSED", ECONNREFUSED }, { "EHOSTDOWN", EHOSTDOWN }, { "EHOSTUNREACH", EHOSTUNREACH },
+};
+
+static pthread_mutex_t g_fault_lock = PTHREAD_MUTEX_INITIALIZER;
+static NetScenario g_scenarios[NETFAULT_SCENARIO_MAX];
+static int g_scenario_count;
+static int g_armed = -1;
+static volatile sig_atomic_t g_arm_requests;
+static int g_arm_handled;
+static FILE* g_fault_log;
+
+int __real_socket(int domain, int type, int protocol);
+int __real_bind(int fd, const struct sockaddr* addr, socklen_t len);
+int __real_listen(int fd, int backlog);
+int __real_accept(int fd, struct sockaddr* addr, socklen_t* len);
+int __real_select(int nfds, fd_set* r, fd_set* w, fd_set* e, struct timeval* timeout);
+ssize_t __real_recv(int fd, void* buf, size_t len, int flags);
+ssize_t __real_send(int fd, const void* buf, size_t len, int flags);
+
+static unsigned long long mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// Caller holds g_fault_lock.
+static void fault_log(int scenario, const char* event, int err, unsigned delay_ms, bool with_action) {
+    if (!g_fault_log) return;
+    if (with_action) {
+        fprintf(g_fault_log, "%llu %d %s %d %u\n", mono_ns(), scenario, event, err, delay_ms);
+    } else {
+        fprintf(g_fault_log, "%llu %d %s\n", mono_ns(), scenario, event);
+    }
+    fflush(g_fault_log);
+}
+
+// parsing --------------------------------------------------------------------------
+
+static char* trim(char* s) {
+    char* end;
+    while (*s == ' ' || *s == '\t') s++;
+    end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+    *end = '\0';
+    return s;
+}
+
+static bool parse_errno(const char* text, int* out) {
+    size_t i;
+    char* end;
+
+    if (strcmp(text, "ok") == 0) {
+        *out = 0;
+        return true;
+    }
+    for (i = 0; i < sizeof(g_errno_names) / sizeof(g_errno_names[0]); i++) {
+        if (strcmp(text, g_errno_names[i].name) == 0) {
+            *out = g_errno_names[i].value;
+            return true;
+        }
+    }
+    *out = (int)strtol(text, &end, 10);
+    return end != text && *end == '\0' && *out > 0;
+}
+
+static bool parse_sequence(char* text, NetSequence* seq) {
+    char* save = NULL;
+    char* item;
+
+    for (item = strtok_r(text, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* star = strchr(item, '*');
+        char* plus;
+        unsigned long repeat = 1;
+        NetAction action = { 0, 0 };
+        unsigned long i;
+
+        if (star) {
+            *star = '\0';
+            repeat = strtoul(star + 1, NULL, 10);
+        }
+        plus = strchr(item, '+');
+        if (plus) {
+            *plus = '\0';
+            action.delay_ms = (uint32_t)strtoul(plus + 1, NULL, 10);
+        }
+        if (!parse_errno(trim(item), &action.err) || repeat == 0 || seq->count + repeat > NETFAULT_ACTIONS_MAX) {
+            return false;
+        }
+        {
+            NetAction* grown = (NetAction*)realloc(seq->actions, (seq->count + repeat) * sizeof(*grown));
+            if (!grown) return false;
+            seq->actions = grown;
+        }
+        for (i = 0; i < repeat; i++) seq->actions[seq->count++] = action;
+    }
+    return seq->count > 0;
+}
+
+static bool load_scenarios(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[NETFAULT_LINE_MAX];
+    int line_no = 0;
+    NetScenario* current = NULL;
+
+    if (!f) {
+        fprintf(stderr, "netfault: cannot open %s\n", path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char* comment = strpbrk(line, "#;");
+        char* text;
+        char* eq;
+        int op;
+
+        line_no++;
+        if (comment) *comment = '\0';
+        text = trim(line);
+        if (*text == '\0') continue;
+
+        if (*text == '[') {
+            char* close = strchr(text, ']');
+            if (!close || g_scenario_count == NETFAULT_SCENARIO_MAX) goto bad;
+            *close = '\0';
+            current = &g_scenarios[g_scenario_count++];
+            snprintf(current->name, sizeof(current->name), "%s", trim(text + 1));
+            continue;
+        }
+        eq = strchr(text, '=');
+        if (!current || !eq) goto bad;
+        *eq = '\0';
+        for (op = 0; op < NetOp_Count; op++) {
+            if (strcmp(trim(text), g_op_names[op]) == 0) break;
+        }
+        if (op == NetOp_Count || current->ops[op].count > 0 || !parse_sequence(eq + 1, &current->ops[op])) goto bad;
+    }
+    fclose(f);
+    return true;
+
+bad:
+    fprintf(stderr, "netfault: %s:%d: expected [scenario] or <op> = <actions>\n", path, line_no);
+    fclose(f);
+    return false;
+}
+
+// injection ------------------------------------------------------------------------
+
+static bool scenario_exhausted(const NetScenario* s) {
+    int op;
+    for (op = 0; op < NetOp_Count; op++) {
+        if (s->ops[op].cursor < s->ops[op].count) return false;
+    }
+    return true;
+}
+
+// Returns true with *err set when the call should fail.
+static bool netfault_take(NetOp op, int* err) {
+    NetAction action = { 0, 0 };
+    bool have_action = false;
+
+    if (g_scenario_count == 0) return false;
+    pthread_mutex_lock(&g_fault_lock);
+    while (g_arm_handled < g_arm_requests && g_armed + 1 < g_scenario_count) {
+        g_arm_handled++;
+        g_armed++;
+        fault_log(g_armed, "arm", 0, 0, false);
+    }
+    if (g_armed >= 0) {
+        NetScenario* s = &g_scenarios[g_armed];
+        NetSequence* seq = &s->ops[op];
+        if (seq->cursor < seq->count) {
+            action = seq->actions[seq->cursor++];
+            have_action = true;
+            fault_log(g_armed, g_op_names[op], action.err, action.delay_ms, true);
+            if (!s->exhausted && scenario_exhausted(s)) {
+                s->exhausted = true;
+                fault_log(g_armed, "exhausted", 0, 0, false);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_fault_lock);
+
+    if (!have_action) return false;
+    if (action.delay_ms > 0) {
+        struct timespec ts;
+        ts.tv_sec = action.delay_ms / 1000;
+        ts.tv_nsec = (long)(action.delay_ms % 1000) * 1000000L;
+        while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        }
+    }
+    *err = action.err;
+    return action.err != 0;
+}
+
+int __wrap_socket(int domain, int type, int protocol) {
+    int err;
+    if (netfault_take(NetOp_Socket, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_socket(domain, type, protocol);
+}
+
+int __wrap_bind(int fd, const struct sockaddr* addr, socklen_t len) {
+    int err;
+    if (netfault_take(NetOp_Bind, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_bind(fd, addr, len);
+}
+
+int __wrap_listen(int fd, int backlog) {
+    int err;
+    if (netfault_take(NetOp_Listen, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_listen(fd, backlog);
+}
+
+int __wrap_accept(int fd, struct sockaddr* addr, socklen_t* len) {
+    int err;
+    if (netfault_take(NetOp_Accept, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_accept(fd, addr, len);
+}
+
+int __wrap_select(int nfds, fd_set* r, fd_set* w, fd_set* e, struct timeval* timeout) {
+    int err;
+    int rc;
+    if (netfault_take(NetOp_Select, &err)) {
+        errno = err;
+        return -1;
+    }
+    host_shim_exit_if_requested();
+    rc = __real_select(nfds, r, w, e, timeout);
+    host_shim_exit_if_requested();
+    return rc;
+}
+
+ssize_t __wrap_recv(int fd, void* buf, size_t len, int flags) {
+    int err;
+    if (netfault_take(NetOp_Recv, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_recv(fd, buf, len, flags);
+}
+
+ssize_t __wrap_send(int fd, const void* buf, size_t len, int flags) {
+    int err;
+    if (netfault_take(NetOp_Send, &err)) {
+        errno = err;
+        return -1;
+    }
+    return __real_send(fd, buf, len, flags);
+}
+
+// startup --------------------------------------------------------------------------
+
+static void netfault_on_arm(int sig) {
+    (void)sig;
+    g_arm_requests++;
+}
+
+__attribute__((constructor)) static void netfault_startup(void) {
+    const char* path = getenv("RICHNX_NETFAULT");
+    const char* log_path = getenv("RICHNX_NETFAULT_LOG");
+    struct sigaction sa;
+
+    if (!path) return;
+    if (!load_scenarios(path)) exit(2);
+    if (log_path) {
+        g_fault_log = fopen(log_path, "a");
+        if (!g_fault_log) fprintf(stderr, "netfault: cannot open %s\n", log_path);
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = netfault_on_arm;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+    fprintf(stderr, "netfault: %d scenarios loaded from %s; SIGUSR1 arms the next\n", g_scenario_count, path);
+}
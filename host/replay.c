@@ -0,0 +1,520 @@
+// Replays a telemetry trace (trace.bin, see telemetry_trace.h) through
+// telemetry_update on a virtual clock, built by `make host-replay`. Every
+// update runs at its recorded time with the enabled-probe mask it had; IPC
+// calls are answered with the most recent recorded result for that call (per
+// pid for pminfo), so a changed detection policy that issues different calls
+// still sees plausible data.
+//
+// Ground truth comes from the trace itself: the program reported by the
+// pmshell -> pminfo path (0 for no application), counted as a change once it
+// has held for -s seconds. Reported per run, as one JSON object:
+//   truth_changes / detected / missed, detection latency p50/p90/max/mean,
+//   false_switches (active title changed to something other than the truth),
+//   recorded vs replayed IPC call counts.
+//
+//   richnx-replay trace.bin
+//   richnx-replay -i 1 trace.bin        replay with a 1 s title query interval
+
+#include "host_shim.h"
+#include "log_format.h"
+#include "telemetry.h"
+#include "telemetry_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPLAY_PID_MAX 64
+#define REPLAY_PMINFO_MAX 256
+#define REPLAY_BASE_NS (100ULL * 1000000000ULL) // virtual uptime at trace start
+#define REPLAY_NOT_FOUND_RC 0x20F                // pm: process not found
+
+typedef struct {
+    u8 type;
+    u64 t_us;
+    u64 a; // Update: mask; Interval: probe; Ipc: call; ProcessList: rc; Dropped: count
+    u64 b; // Interval: seconds; Ipc: rc; ProcessList: count
+    u64 c; // Ipc: value
+    u64 d; // Ipc: arg
+    u32 pid_index; // ProcessList: offset into g_pids
+} TraceEvent;
+
+typedef struct {
+    u64 t_us;
+    u64 program_id;
+} Observation;
+
+typedef struct {
+    bool known;
+    Result rc;
+    u64 value;
+} Latest;
+
+typedef struct {
+    u64 pid;
+    Result rc;
+    u64 program_id;
+} PminfoEntry;
+
+static TraceEvent* g_events;
+static size_t g_event_count;
+static u64* g_pids;
+static size_t g_pid_count;
+static Observation* g_obs;
+static size_t g_obs_count;
+static u64 g_dropped;
+
+// Latest recorded results, answered through the shim hook.
+static Latest g_battery, g_charger, g_applet, g_pmshell;
+static bool g_docked;
+static PminfoEntry g_pminfo[REPLAY_PMINFO_MAX];
+static size_t g_pminfo_count;
+static Result g_proc_rc;
+static u64 g_proc_list[REPLAY_PID_MAX];
+static u64 g_proc_count;
+static bool g_proc_known;
+
+static u64 g_recorded_calls[IpcCall_Count];
+static u64 g_replayed_calls[IpcCall_Count];
+
+static const char* const g_call_names[IpcCall_Count] = {
+    [IpcCall_PsmBatteryChargePercentage] = "psmGetBatteryChargePercentage",
+    [IpcCall_PsmChargerType] = "psmGetChargerType",
+    [IpcCall_AppletOperationModeSystemInfo] = "appletGetOperationModeSystemInfo",
+    [IpcCall_PmshellApplicationProcessId] = "pmshellGetApplicationProcessIdForShell",
+    [IpcCall_PminfoProgramId] = "pminfoGetProgramId",
+    [IpcCall_SvcProcessList] = "svcGetProcessList",
+    [IpcCall_NifmConnectionStatus] = "nifmGetInternetConnectionStatus",
+};
+
+static void* grow(void* p, size_t* cap, size_t count, size_t elem) {
+    if (count < *cap) return p;
+    *cap = *cap ? *cap * 2 : 1024;
+    p = realloc(p, *cap * elem);
+    if (!p) {
+        fprintf(stderr, "replay: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+// trace parsing ------------------------------------------------------------------
+
+static bool load_trace(const char* path) {
+    FILE* f = fopen(path, "rb");
+    u8 header[TELEMETRY_TRACE_HEADER_SIZE];
+    u8* data;
+    long size;
+    size_t event_cap = 0, pid_cap = 0, obs_cap = 0;
+    LogReader r;
+    u64 t_us = 0;
+    u64 pending_pid = 0;
+
+    if (!f) {
+        fprintf(stderr, "replay: cannot open %s\n", path);
+        return false;
+    }
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+        memcmp(header, TELEMETRY_TRACE_MAGIC, TELEMETRY_TRACE_MAGIC_SIZE) != 0 ||
+        header[TELEMETRY_TRACE_MAGIC_SIZE] != TELEMETRY_TRACE_VERSION) {
+        fprintf(stderr, "replay: %s is not a version %d telemetry trace\n", path, TELEMETRY_TRACE_VERSION);
+        fclose(f);
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f) - (long)sizeof(header);
+    fseek(f, (long)sizeof(header), SEEK_SET);
+    data = (u8*)malloc(size > 0 ? (size_t)size : 1);
+    if (!data || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "replay: cannot read %s\n", path);
+        fclose(f);
+        free(data);
+        return false;
+    }
+    fclose(f);
+
+    r.p = data;
+    r.end = data + size;
+    r.ok = 1;
+    while (r.p < r.end) {
+        TraceEvent e;
+        u64 i;
+
+        memset(&e, 0, sizeof(e));
+        e.type = *r.p++;
+        t_us += log_read_varint(&r);
+        e.t_us = t_us;
+        switch (e.type) {
+            case TraceRecord_Update:
+            case TraceRecord_Dropped:
+                e.a = log_read_varint(&r);
+                if (e.type == TraceRecord_Dropped) g_dropped += e.a;
+                break;
+            case TraceRecord_Interval:
+                e.a = log_read_varint(&r);
+                e.b = log_read_varint(&r);
+                break;
+            case TraceRecord_Ipc:
+                e.a = log_read_varint(&r);
+                e.b = log_read_varint(&r);
+                e.c = log_read_varint(&r);
+                e.d = log_read_varint(&r);
+                if (e.a < IpcCall_Count) g_recorded_calls[e.a]++;
+                break;
+            case TraceRecord_ProcessList:
+                e.a = log_read_varint(&r);
+                e.b = log_read_varint(&r);
+                e.pid_index = (u32)g_pid_count;
+                for (i = 0; i < e.b && r.ok; i++) {
+                    g_pids = (u64*)grow(g_pids, &pid_cap, g_pid_count, sizeof(*g_pids));
+                    g_pids[g_pid_count++] = log_read_varint(&r);
+                }
+                g_recorded_calls[IpcCall_SvcProcessList]++;
+                break;
+            default:
+                r.ok = 0;
+                break;
+        }
+        if (!r.ok) {
+            fprintf(stderr, "replay: %s: truncated or unknown record after %zu events\n", path, g_event_count);
+            break;
+        }
+        g_events = (TraceEvent*)grow(g_events, &event_cap, g_event_count, sizeof(*g_events));
+        g_events[g_event_count++] = e;
+
+        // Ground-truth observations from the pmshell -> pminfo path.
+        if (e.type == TraceRecord_Ipc && e.a == IpcCall_PmshellApplicationProcessId) {
+            pending_pid = 0;
+            if (e.b == 0 && e.c == 0) {
+                g_obs = (Observation*)grow(g_obs, &obs_cap, g_obs_count, sizeof(*g_obs));
+                g_obs[g_obs_count].t_us = e.t_us;
+                g_obs[g_obs_count++].program_id = 0;
+            } else if (e.b == 0) {
+                pending_pid = e.c;
+            }
+        } else if (e.type == TraceRecord_Ipc && e.a == IpcCall_PminfoProgramId && pending_pid != 0 && e.d == pending_pid) {
+            if (e.b == 0 && e.c != 0) {
+                g_obs = (Observation*)grow(g_obs, &obs_cap, g_obs_count, sizeof(*g_obs));
+                g_obs[g_obs_count].t_us = e.t_us;
+                g_obs[g_obs_count++].program_id = e.c;
+            }
+            pending_pid = 0;
+        }
+    }
+    free(data);
+    return true;
+}
+
+// Truth changes: an observed program that holds for stable_us.
+static size_t build_truth(u64 stable_us, Observation* out) {
+    size_t count = 0;
+    size_t j;
+
+    for (j = 0; j < g_obs_count; j++) {
+        const Observation* o = &g_obs[j];
+        bool holds = false;
+        size_t k;
+
+        if (count > 0 && out[count - 1].program_id == o->program_id) continue;
+        for (k = j + 1; k < g_obs_count; k++) {
+            if (g_obs[k].program_id != o->program_id) break;
+            if (g_obs[k].t_us >= o->t_us + stable_us) {
+                holds = true;
+                break;
+            }
+        }
+        if (holds || stable_us == 0) out[count++] = *o;
+    }
+    return count;
+}
+
+// shim hook -----------------------------------------------------------------------
+
+static void apply_event(const TraceEvent* e) {
+    size_t i;
+
+    if (e->type == TraceRecord_ProcessList) {
+        g_proc_known = true;
+        g_proc_rc = (Result)e->a;
+        g_proc_count = e->b < REPLAY_PID_MAX ? e->b : REPLAY_PID_MAX;
+        memcpy(g_proc_list, g_pids + e->pid_index, g_proc_count * sizeof(*g_proc_list));
+        return;
+    }
+    if (e->type != TraceRecord_Ipc) return;
+
+    switch ((IpcCallId)e->a) {
+        case IpcCall_PsmBatteryChargePercentage:
+            g_battery = (Latest){ true, (Result)e->b, e->c };
+            break;
+        case IpcCall_PsmChargerType:
+            g_charger = (Latest){ true, (Result)e->b, e->c };
+            break;
+        case IpcCall_AppletOperationModeSystemInfo:
+            g_applet = (Latest){ true, (Result)e->b, e->c };
+            if (e->b == 0) g_docked = e->c != 0;
+            break;
+        case IpcCall_PmshellApplicationProcessId:
+            g_pmshell = (Latest){ true, (Result)e->b, e->c };
+            break;
+        case IpcCall_PminfoProgramId:
+            for (i = 0; i < g_pminfo_count; i++) {
+                if (g_pminfo[i].pid == e->d) break;
+            }
+            if (i == g_pminfo_count) {
+                if (g_pminfo_count == REPLAY_PMINFO_MAX) return;
+                g_pminfo_count++;
+            }
+            g_pminfo[i].pid = e->d;
+            g_pminfo[i].rc = (Result)e->b;
+            g_pminfo[i].program_id = e->c;
+            break;
+        default:
+            break;
+    }
+}
+
+static bool answer_latest(const Latest* l, HostShimReply* reply) {
+    reply->rc = l->known ? l->rc : 0;
+    reply->value = l->known ? l->value : 0;
+    return true;
+}
+
+static bool replay_hook(HostShimCall call, u64 arg, HostShimReply* reply) {
+    size_t i;
+
+    switch (call) {
+        case HostShimCall_PsmBattery:
+            g_replayed_calls[IpcCall_PsmBatteryChargePercentage]++;
+            return answer_latest(&g_battery, reply);
+        case HostShimCall_PsmCharger:
+            g_replayed_calls[IpcCall_PsmChargerType]++;
+            return answer_latest(&g_charger, reply);
+        case HostShimCall_AppletSystemInfo:
+            g_replayed_calls[IpcCall_AppletOperationModeSystemInfo]++;
+            return answer_latest(&g_applet, reply);
+        case HostShimCall_AppletMode:
+            reply->value = g_docked ? AppletOperationMode_Console : AppletOperationMode_Handheld;
+            return true;
+        case HostShimCall_PmshellPid:
+            g_replayed_calls[IpcCall_PmshellApplicationProcessId]++;
+            return answer_latest(&g_pmshell, reply);
+        case HostShimCall_PminfoProgramId:
+            g_replayed_calls[IpcCall_PminfoProgramId]++;
+            for (i = 0; i < g_pminfo_count; i++) {
+                if (g_pminfo[i].pid == arg) {
+                    reply->rc = g_pminfo[i].rc;
+                    reply->value = g_pminfo[i].program_id;
+                    return true;
+                }
+            }
+            reply->rc = REPLAY_NOT_FOUND_RC;
+            return true;
+        case HostShimCall_ProcessList:
+            g_replayed_calls[IpcCall_SvcProcessList]++;
+            reply->rc = g_proc_known ? g_proc_rc : 0;
+            reply->value = g_proc_known ? g_proc_count : 0;
+            reply->pids = g_proc_list;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// report --------------------------------------------------------------------------
+
+static int compare_u64(const void* a, const void* b) {
+    const u64 x = *(const u64*)a;
+    const u64 y = *(const u64*)b;
+    return (x > y) - (x < y);
+}
+
+static u64 percentile(const u64* sorted, size_t n, double pct) {
+    size_t rank;
+    if (n == 0) return 0;
+    rank = (size_t)((pct / 100.0) * (double)n + 0.999999);
+    if (rank == 0) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static u64 wall_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr, "usage: %s [-s stable_sec] [-i title_interval_sec] [-v] trace.bin\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    static TelemetryState state;
+    Observation* truth;
+    size_t truth_count;
+    u64* latencies;
+    size_t latency_count = 0;
+    u64 stable_sec = 5;
+    long title_interval = -1;
+    bool verbose = false;
+    u64 updates = 0, false_switches = 0, missed = 0, latency_total = 0;
+    u64 prev_active = 0;
+    bool have_prev = false;
+    size_t next_truth = 0;
+    size_t current_truth = (size_t)-1;
+    bool current_detected = true;
+    u64 start_wall;
+    u64 last_t_us = 0;
+    size_t i, j;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:i:v")) != -1) {
+        switch (opt) {
+            case 's': stable_sec = strtoull(optarg, NULL, 10); break;
+            case 'i': title_interval = strtol(optarg, NULL, 10); break;
+            case 'v': verbose = true; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!load_trace(argv[optind])) return 1;
+
+    truth = (Observation*)malloc((g_obs_count + 1) * sizeof(*truth));
+    latencies = (u64*)malloc((g_obs_count + 1) * sizeof(*latencies));
+    if (!truth || !latencies) return 1;
+    truth_count = build_truth(stable_sec * 1000000ULL, truth);
+
+    host_shim_set_hook(replay_hook);
+    host_shim_set_time_ns(REPLAY_BASE_NS);
+    telemetry_init(&state);
+    if (title_interval >= 0) telemetry_set_probe_interval(&state, TelemetryProbe_Title, (u32)title_interval);
+
+    start_wall = wall_ns();
+    for (i = 0; i < g_event_count; i++) {
+        const TraceEvent* u = &g_events[i];
+        u64 active;
+
+        if (u->type == TraceRecord_Interval) {
+            if (title_interval < 0 || u->a != TelemetryProbe_Title) {
+                telemetry_set_probe_interval(&state, (TelemetryProbeId)u->a, (u32)u->b);
+            }
+            continue;
+        }
+        if (u->type != TraceRecord_Update) continue;
+
+        // Results recorded during this update become visible to it.
+        for (j = i + 1; j < g_event_count && g_events[j].type != TraceRecord_Update; j++) {
+            apply_event(&g_events[j]);
+        }
+
+        // Advance the truth timeline to this update.
+        while (next_truth < truth_count && truth[next_truth].t_us <= u->t_us) {
+            if (!current_detected) {
+                missed++;
+                if (verbose) {
+                    fprintf(stderr, "missed 0x%016llX\n", (unsigned long long)truth[current_truth].program_id);
+                }
+            }
+            current_truth = next_truth++;
+            current_detected = false;
+        }
+
+        host_shim_set_time_ns(REPLAY_BASE_NS + u->t_us * 1000ULL);
+        telemetry_update(&state, (u32)u->a);
+        updates++;
+        last_t_us = u->t_us;
+
+        rmutexLock(&state.lock);
+        active = state.active_program_id;
+        rmutexUnlock(&state.lock);
+
+        if (current_truth != (size_t)-1) {
+            const Observation* t = &truth[current_truth];
+            if (!current_detected && active == t->program_id) {
+                const u64 latency_us = u->t_us - t->t_us;
+                current_detected = true;
+                latencies[latency_count++] = latency_us;
+                latency_total += latency_us;
+                if (verbose) {
+                    fprintf(
+                        stderr,
+                        "%8.1fs detected 0x%016llX after %llu ms\n",
+                        (double)u->t_us / 1e6,
+                        (unsigned long long)active,
+                        (unsigned long long)(latency_us / 1000ULL)
+                    );
+                }
+            }
+            if (have_prev && active != prev_active && active != t->program_id) {
+                false_switches++;
+                if (verbose) {
+                    fprintf(
+                        stderr,
+                        "%8.1fs false switch to 0x%016llX (truth 0x%016llX)\n",
+                        (double)u->t_us / 1e6,
+                        (unsigned long long)active,
+                        (unsigned long long)t->program_id
+                    );
+                }
+            }
+        }
+        prev_active = active;
+        have_prev = true;
+    }
+    if (current_truth != (size_t)-1 && !current_detected) missed++;
+    missed += truth_count - next_truth; // changes after the last update
+
+    qsort(latencies, latency_count, sizeof(*latencies), compare_u64);
+    {
+        const double wall_sec = (double)(wall_ns() - start_wall) / 1e9;
+        const double virtual_sec = (double)last_t_us / 1e6;
+
+        printf(
+            "{\"trace\":\"%s\",\"events\":%zu,\"updates\":%llu,\"dropped_records\":%llu,\"virtual_sec\":%.1f,"
+            "\"wall_ms\":%.1f,\"speedup\":%.0f,\"stable_sec\":%llu,\"title_interval_sec\":%ld,"
+            "\"truth_changes\":%zu,\"detected\":%zu,\"missed\":%llu,\"false_switches\":%llu,"
+            "\"latency_ms\":{\"p50\":%llu,\"p90\":%llu,\"max\":%llu,\"mean\":%llu},\"ipc\":[",
+            argv[optind],
+            g_event_count,
+            (unsigned long long)updates,
+            (unsigned long long)g_dropped,
+            virtual_sec,
+            wall_sec * 1000.0,
+            wall_sec > 0 ? virtual_sec / wall_sec : 0.0,
+            (unsigned long long)stable_sec,
+            title_interval,
+            truth_count,
+            latency_count,
+            (unsigned long long)missed,
+            (unsigned long long)false_switches,
+            (unsigned long long)(percentile(latencies, latency_count, 50) / 1000ULL),
+            (unsigned long long)(percentile(latencies, latency_count, 90) / 1000ULL),
+            (unsigned long long)(latency_count ? latencies[latency_count - 1] / 1000ULL : 0),
+            (unsigned long long)(latency_count ? latency_total / latency_count / 1000ULL : 0)
+        );
+        for (i = 0; i < IpcCall_Count; i++) {
+            if (i == IpcCall_NifmConnectionStatus) continue; // main loop only, never recorded
+            printf(
+                "%s{\"call\":\"%s\",\"recorded\":%llu,\"replayed\":%llu}",
+                i ? "," : "",
+                g_call_names[i],
+                (unsigned long long)g_recorded_calls[i],
+                (unsigned long long)g_replayed_calls[i]
+            );
+        }
+        printf("]}\n");
+    }
+
+    free(truth);
+    free(latencies);
+    free(g_events);
+    free(g_pids);
+    free(g_obs);
+    return 0;
+}
@@ -0,0 +1,766 @@
+// Host (Linux) implementation of the libnx subset declared in
+// host/include/switch.h. Kernel objects map onto pthreads and CLOCK_MONOTONIC;
+// service calls return the sequences scripted through host_shim.h.
+
+#include "host_shim.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define HOST_THREAD_MAX 16
+#define HOST_SCRIPT_STEPS_MAX 65536
+#define HOST_SCRIPT_LINE_MAX 4096
+#define HOST_TICK_FREQ 19200000ULL
+#define HOST_RC_TIMED_OUT KERNELRESULT(TimedOut)
+#define HOST_RC_OUT_OF_THREADS MAKERESULT(Module_Kernel, 103)
+
+typedef enum {
+    HostKey_SmInitRc = 0,
+    HostKey_SmHasService,
+    HostKey_FsInitRc,
+    HostKey_SetsysInitRc,
+    HostKey_SetsysFirmware,
+    HostKey_SetsysRc,
+    HostKey_NifmInitRc,
+    HostKey_NifmStatus,
+    HostKey_NifmRc,
+    HostKey_AppletInitRc,
+    HostKey_AppletMode,
+    HostKey_AppletRc,
+    HostKey_PsmInitRc,
+    HostKey_PsmBattery,
+    HostKey_PsmBatteryRc,
+    HostKey_PsmCharger,
+    HostKey_PsmChargerRc,
+    HostKey_PmshellInitRc,
+    HostKey_PmshellPid,
+    HostKey_PmshellRc,
+    HostKey_PminfoInitRc,
+    HostKey_PminfoProgramId,
+    HostKey_PminfoRc,
+    HostKey_NsInitRc,
+    HostKey_SocketInitRc,
+    HostKey_TimeInitRc,
+    HostKey_TimeNow,
+    HostKey_TimeRc,
+    HostKey_SvcProcessCount,
+    HostKey_SvcProcessListRc,
+    HostKey_Count,
+} HostKey;
+
+typedef struct {
+    const char* name;
+    u64 def;
+    bool dotted; // "major.minor.micro" packed as 0xMMmmuu
+} HostKeyDef;
+
+typedef struct {
+    u64* values; // NULL => def
+    size_t count;
+    size_t cursor;
+    u64 calls;
+} HostKeyState;
+
+typedef struct {
+    bool used;
+    bool started;
+    bool exited;
+    pthread_t pthread;
+    ThreadFunc entry;
+    void* arg;
+    void* stack_mem;
+    size_t stack_sz;
+} HostThread;
+
+static const HostKeyDef g_host_shim_keys[HostKey_Count] = {
+    [HostKey_SmInitRc] = { "sm.init.rc", 0, false },
+    [HostKey_SmHasService] = { "sm.has_service", 1, false },
+    [HostKey_FsInitRc] = { "fs.init.rc", 0, false },
+    [HostKey_SetsysInitRc] = { "setsys.init.rc", 0, false },
+    [HostKey_SetsysFirmware] = { "setsys.firmware", 0x120100, true },
+    [HostKey_SetsysRc] = { "setsys.rc", 0, false },
+    [HostKey_NifmInitRc] = { "nifm.init.rc", 0, false },
+    [HostKey_NifmStatus] = { "nifm.status", NifmInternetConnectionStatus_Connected, false },
+    [HostKey_NifmRc] = { "nifm.rc", 0, false },
+    [HostKey_AppletInitRc] = { "applet.init.rc", 0, false },
+    [HostKey_AppletMode] = { "applet.mode", AppletOperationMode_Handheld, false },
+    [HostKey_AppletRc] = { "applet.rc", 0, false },
+    [HostKey_PsmInitRc] = { "psm.init.rc", 0, false },
+    [HostKey_PsmBattery] = { "psm.battery", 100, false },
+    [HostKey_PsmBatteryRc] = { "psm.battery.rc", 0, false },
+    [HostKey_PsmCharger] = { "psm.charger", PsmChargerType_Unconnected, false },
+    [HostKey_PsmChargerRc] = { "psm.charger.rc", 0, false },
+    [HostKey_PmshellInitRc] = { "pmshell.init.rc", 0, false },
+    [HostKey_PmshellPid] = { "pmshell.pid", 0, false },
+    [HostKey_PmshellRc] = { "pmshell.rc", 0, false },
+    [HostKey_PminfoInitRc] = { "pminfo.init.rc", 0, false },
+    [HostKey_PminfoProgramId] = { "pminfo.program_id", 0, false },
+    [HostKey_PminfoRc] = { "pminfo.rc", 0, false },
+    [HostKey_NsInitRc] = { "ns.init.rc", 0, false },
+    [HostKey_SocketInitRc] = { "socket.init.rc", 0, false },
+    [HostKey_TimeInitRc] = { "time.init.rc", 0, false },
+    [HostKey_TimeNow] = { "time.now", 0, false }, // 0 = host clock
+    [HostKey_TimeRc] = { "time.rc", 0, false },
+    [HostKey_SvcProcessCount] = { "svc.process_count", 0, false },
+    [HostKey_SvcProcessListRc] = { "svc.process_list.rc", 0, false },
+};
+
+static pthread_mutex_t g_host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_host_thread_exit = PTHREAD_COND_INITIALIZER;
+static HostKeyState g_host_keys[HostKey_Count];
+static HostThread g_host_threads[HOST_THREAD_MAX];
+static pthread_t g_host_main_thread;
+static volatile sig_atomic_t g_host_exit_requested = 0;
+static HostShimHook g_host_hook;
+static volatile bool g_host_virtual_time;
+static volatile u64 g_host_virtual_ns;
+
+// Provided by the sysmodule's main.c; absent when a host tool links the shim
+// without it.
+extern void __appInit(void) __attribute__((weak));
+extern void __appExit(void) __attribute__((weak));
+
+// Referenced by __libnx_initheap, which the host build never calls.
+void* fake_heap_start;
+void* fake_heap_end;
+
+// script -----------------------------------------------------------------------
+
+static int host_key_find(const char* name) {
+    int i;
+    for (i = 0; i < HostKey_Count; i++) {
+        if (strcmp(g_host_shim_keys[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+static u64 host_value(HostKey key) {
+    HostKeyState* k = &g_host_keys[key];
+    u64 value;
+
+    pthread_mutex_lock(&g_host_lock);
+    if (!k->values) {
+        value = g_host_shim_keys[key].def;
+    } else {
+        value = k->values[k->cursor];
+        if (k->cursor + 1 < k->count) k->cursor++;
+    }
+    k->calls++;
+    pthread_mutex_unlock(&g_host_lock);
+    return value;
+}
+
+static bool host_parse_value(const char* text, bool dotted, u64* out) {
+    char* end;
+
+    if (dotted) {
+        unsigned major = 0, minor = 0, micro = 0;
+        if (sscanf(text, "%u.%u.%u", &major, &minor, &micro) < 2 || major > 0xFF || minor > 0xFF || micro > 0xFF) {
+            return false;
+        }
+        *out = ((u64)major << 16) | ((u64)minor << 8) | micro;
+        return true;
+    }
+    errno = 0;
+    *out = strtoull(text, &end, 0);
+    return errno == 0 && end != text && *end == '\0';
+}
+
+static char* host_trim(char* s) {
+    char* end;
+    while (*s == ' ' || *s == '\t') s++;
+    end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) end--;
+    *end = '\0';
+    return s;
+}
+
+bool host_shim_set(const char* key, const char* values) {
+    const int id = host_key_find(key);
+    char* copy;
+    char* item;
+    char* save = NULL;
+    u64* steps = NULL;
+    size_t count = 0;
+
+    if (id < 0) {
+        fprintf(stderr, "host_shim: unknown key %s\n", key);
+        return false;
+    }
+    copy = strdup(values);
+    if (!copy) return false;
+
+    for (item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char* star = strchr(item, '*');
+        unsigned long repeat = 1;
+        u64 value;
+        unsigned long i;
+
+        if (star) {
+            *star = '\0';
+            repeat = strtoul(star + 1, NULL, 10);
+        }
+        item = host_trim(item);
+        if (!host_parse_value(item, g_host_shim_keys[id].dotted, &value) || repeat == 0 ||
+            count + repeat > HOST_SCRIPT_STEPS_MAX) {
+            fprintf(stderr, "host_shim: bad value '%s' for %s\n", item, key);
+            free(steps);
+            free(copy);
+            return false;
+        }
+        {
+            u64* grown = (u64*)realloc(steps, (count + repeat) * sizeof(*steps));
+            if (!grown) {
+                free(steps);
+                free(copy);
+                return false;
+            }
+            steps = grown;
+        }
+        for (i = 0; i < repeat; i++) steps[count++] = value;
+    }
+    free(copy);
+    if (count == 0) {
+        fprintf(stderr, "host_shim: no values for %s\n", key);
+        return false;
+    }
+
+    pthread_mutex_lock(&g_host_lock);
+    free(g_host_keys[id].values);
+    g_host_keys[id].values = steps;
+    g_host_keys[id].count = count;
+    g_host_keys[id].cursor = 0;
+    pthread_mutex_unlock(&g_host_lock);
+    return true;
+}
+
+bool host_shim_load(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[HOST_SCRIPT_LINE_MAX];
+    int line_no = 0;
+    bool ok = true;
+
+    if (!f) {
+        fprintf(stderr, "host_shim: cannot open %s\n", path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char* comment;
+        char* eq;
+        char* key;
+
+        line_no++;
+        comment = strpbrk(line, "#;");
+        if (comment) *comment = '\0';
+        key = host_trim(line);
+        if (*key == '\0') continue;
+        eq = strchr(key, '=');
+        if (!eq) {
+            fprintf(stderr, "host_shim: %s:%d: expected key = values\n", path, line_no);
+            ok = false;
+            continue;
+        }
+        *eq = '\0';
+        if (!host_shim_set(host_trim(key), host_trim(eq + 1))) {
+            fprintf(stderr, "host_shim: %s:%d: rejected\n", path, line_no);
+            ok = false;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+u64 host_shim_calls(const char* key) {
+    const int id = host_key_find(key);
+    u64 calls;
+
+    if (id < 0) return 0;
+    pthread_mutex_lock(&g_host_lock);
+    calls = g_host_keys[id].calls;
+    pthread_mutex_unlock(&g_host_lock);
+    return calls;
+}
+
+void host_shim_reset(void) {
+    int i;
+
+    pthread_mutex_lock(&g_host_lock);
+    for (i = 0; i < HostKey_Count; i++) {
+        free(g_host_keys[i].values);
+        memset(&g_host_keys[i], 0, sizeof(g_host_keys[i]));
+    }
+    pthread_mutex_unlock(&g_host_lock);
+}
+
+void host_shim_set_hook(HostShimHook hook) {
+    g_host_hook = hook;
+}
+
+static bool host_hook(HostShimCall call, u64 arg, HostShimReply* reply) {
+    memset(reply, 0, sizeof(*reply));
+    return g_host_hook && g_host_hook(call, arg, reply);
+}
+
+// time -------------------------------------------------------------------------
+
+void host_shim_set_time_ns(u64 ns) {
+    g_host_virtual_ns = ns;
+    g_host_virtual_time = true;
+}
+
+void host_shim_use_real_time(void) {
+    g_host_virtual_time = false;
+}
+
+u64 armGetSystemTick(void) {
+    struct timespec ts;
+
+    if (g_host_virtual_time) return armNsToTicks(g_host_virtual_ns);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * HOST_TICK_FREQ + ((u64)ts.tv_nsec * 12) / 625;
+}
+
+u64 armGetSystemTickFreq(void) {
+    return HOST_TICK_FREQ;
+}
+
+u64 armTicksToNs(u64 ticks) {
+    return (ticks * 625) / 12;
+}
+
+u64 armNsToTicks(u64 ns) {
+    return (ns * 12) / 625;
+}
+
+void host_shim_exit_if_requested(void) {
+    if (g_host_exit_requested && pthread_equal(pthread_self(), g_host_main_thread)) {
+        exit(0); // runs __appExit via atexit, like returning from main
+    }
+}
+
+void svcSleepThread(s64 ns) {
+    struct timespec ts;
+
+    host_shim_exit_if_requested();
+    if (ns <= 0) {
+        sched_yield();
+        return;
+    }
+    ts.tv_sec = (time_t)(ns / 1000000000LL);
+    ts.tv_nsec = (long)(ns % 1000000000LL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+        host_shim_exit_if_requested();
+    }
+    host_shim_exit_if_requested();
+}
+
+static void host_deadline(u64 timeout_ns, struct timespec* out) {
+    clock_gettime(CLOCK_REALTIME, out);
+    out->tv_sec += (time_t)(timeout_ns / 1000000000ULL);
+    out->tv_nsec += (long)(timeout_ns % 1000000000ULL);
+    if (out->tv_nsec >= 1000000000L) {
+        out->tv_sec++;
+        out->tv_nsec -= 1000000000L;
+    }
+}
+
+// sync -------------------------------------------------------------------------
+
+void rmutexInit(RMutex* m) {
+    memset(m, 0, sizeof(*m));
+}
+
+void rmutexLock(RMutex* m) {
+    const pthread_t self = pthread_self();
+
+    if (m->counter > 0 && pthread_equal(m->owner, self)) {
+        m->counter++;
+        return;
+    }
+    pthread_mutex_lock(&m->lock);
+    m->owner = self;
+    m->counter = 1;
+}
+
+bool rmutexTryLock(RMutex* m) {
+    const pthread_t self = pthread_self();
+
+    if (m->counter > 0 && pthread_equal(m->owner, self)) {
+        m->counter++;
+        return true;
+    }
+    if (pthread_mutex_trylock(&m->lock) != 0) return false;
+    m->owner = self;
+    m->counter = 1;
+    return true;
+}
+
+void rmutexUnlock(RMutex* m) {
+    if (--m->counter == 0) {
+        memset(&m->owner, 0, sizeof(m->owner));
+        pthread_mutex_unlock(&m->lock);
+    }
+}
+
+void ueventCreate(UEvent* e, bool auto_clear) {
+    memset(e, 0, sizeof(*e));
+    e->auto_clear = auto_clear;
+}
+
+void ueventClear(UEvent* e) {
+    pthread_mutex_lock(&e->lock);
+    e->signaled = false;
+    pthread_mutex_unlock(&e->lock);
+}
+
+void ueventSignal(UEvent* e) {
+    pthread_mutex_lock(&e->lock);
+    e->signaled = true;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+Waiter waiterForUEvent(UEvent* e) {
+    Waiter w;
+    w.event = e;
+    return w;
+}
+
+Result waitSingle(Waiter w, u64 timeout_ns) {
+    UEvent* e = w.event;
+    struct timespec deadline;
+    Result rc = 0;
+
+    host_deadline(timeout_ns, &deadline);
+    pthread_mutex_lock(&e->lock);
+    while (!e->signaled) {
+        if (pthread_cond_timedwait(&e->cond, &e->lock, &deadline) == ETIMEDOUT) {
+            rc = HOST_RC_TIMED_OUT;
+            break;
+        }
+    }
+    if (R_SUCCEEDED(rc) && e->auto_clear) e->signaled = false;
+    pthread_mutex_unlock(&e->lock);
+    return rc;
+}
+
+// threads ----------------------------------------------------------------------
+
+// Handles are slot index + 1 so that 0 stays INVALID_HANDLE.
+static HostThread* host_thread_from_handle(Handle h) {
+    if (h == INVALID_HANDLE || h > HOST_THREAD_MAX || !g_host_threads[h - 1].used) return NULL;
+    return &g_host_threads[h - 1];
+}
+
+static void* host_thread_entry(void* arg) {
+    HostThread* t = (HostThread*)arg;
+    sigset_t stop_signals;
+
+    // Leave SIGINT/SIGTERM to the main thread so a select() here is never
+    // interrupted by them.
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+    t->entry(t->arg);
+    pthread_mutex_lock(&g_host_lock);
+    t->exited = true;
+    pthread_cond_broadcast(&g_host_thread_exit);
+    pthread_mutex_unlock(&g_host_lock);
+    return NULL;
+}
+
+// Priority and core are ignored; the host scheduler decides.
+Result threadCreate(Thread* t, ThreadFunc entry, void* arg, void* stack_mem, size_t stack_sz, int prio, int cpuid) {
+    int i;
+
+    (void)prio;
+    (void)cpuid;
+    pthread_mutex_lock(&g_host_lock);
+    for (i = 0; i < HOST_THREAD_MAX; i++) {
+        if (!g_host_threads[i].used) break;
+    }
+    if (i == HOST_THREAD_MAX) {
+        pthread_mutex_unlock(&g_host_lock);
+        return HOST_RC_OUT_OF_THREADS;
+    }
+    memset(&g_host_threads[i], 0, sizeof(g_host_threads[i]));
+    g_host_threads[i].used = true;
+    g_host_threads[i].entry = entry;
+    g_host_threads[i].arg = arg;
+    g_host_threads[i].stack_mem = stack_mem;
+    g_host_threads[i].stack_sz = stack_sz;
+    pthread_mutex_unlock(&g_host_lock);
+
+    memset(t, 0, sizeof(*t));
+    t->handle = (Handle)(i + 1);
+    t->stack_mem = stack_mem;
+    t->stack_sz = stack_sz;
+    return 0;
+}
+
+Result threadStart(Thread* t) {
+    HostThread* ht = host_thread_from_handle(t->handle);
+    pthread_attr_t attr;
+    int err;
+
+    if (!ht || ht->started) return HOST_RC_OUT_OF_THREADS;
+    pthread_attr_init(&attr);
+    // Run on the caller's static stack so stack high-water marks mean the
+    // same thing as on the console; glibc keeps its TCB at the top of it.
+    if (ht->stack_mem && pthread_attr_setstack(&attr, ht->stack_mem, ht->stack_sz) != 0) {
+        pthread_attr_destroy(&attr);
+        pthread_attr_init(&attr);
+    }
+    err = pthread_create(&ht->pthread, &attr, host_thread_entry, ht);
+    pthread_attr_destroy(&attr);
+    if (err != 0) return HOST_RC_OUT_OF_THREADS;
+    ht->started = true;
+    return 0;
+}
+
+Result waitSingleHandle(Handle h, u64 timeout_ns) {
+    HostThread* ht = host_thread_from_handle(h);
+    struct timespec deadline;
+    Result rc = 0;
+
+    if (!ht) return HOST_RC_TIMED_OUT;
+    host_deadline(timeout_ns, &deadline);
+    pthread_mutex_lock(&g_host_lock);
+    while (ht->started && !ht->exited) {
+        if (pthread_cond_timedwait(&g_host_thread_exit, &g_host_lock, &deadline) == ETIMEDOUT) {
+            rc = HOST_RC_TIMED_OUT;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_host_lock);
+    return rc;
+}
+
+Result threadWaitForExit(Thread* t) {
+    HostThread* ht = host_thread_from_handle(t->handle);
+
+    if (!ht) return HOST_RC_TIMED_OUT;
+    if (ht->started) {
+        pthread_join(ht->pthread, NULL);
+        ht->started = false;
+    }
+    return 0;
+}
+
+Result threadClose(Thread* t) {
+    HostThread* ht = host_thread_from_handle(t->handle);
+
+    if (!ht) return 0;
+    if (ht->started) {
+        if (ht->exited) {
+            pthread_join(ht->pthread, NULL);
+        } else {
+            pthread_detach(ht->pthread);
+        }
+    }
+    pthread_mutex_lock(&g_host_lock);
+    ht->used = false;
+    pthread_mutex_unlock(&g_host_lock);
+    t->handle = INVALID_HANDLE;
+    return 0;
+}
+
+// services ---------------------------------------------------------------------
+
+Result smInitialize(void) { return (Result)host_value(HostKey_SmInitRc); }
+void smExit(void) {}
+
+SmServiceName smEncodeName(const char* name) {
+    SmServiceName out;
+    memset(&out, 0, sizeof(out));
+    memcpy(out.name, name, strnlen(name, sizeof(out.name)));
+    return out;
+}
+
+Result smAtmosphereHasService(bool* out, SmServiceName name) {
+    (void)name;
+    *out = host_value(HostKey_SmHasService) != 0;
+    return 0;
+}
+
+Result fsInitialize(void) { return (Result)host_value(HostKey_FsInitRc); }
+void fsExit(void) {}
+
+Result fsdevMountSdmc(void) {
+    if (mkdir("sdmc:", 0777) != 0 && errno != EEXIST) {
+        fprintf(stderr, "host_shim: cannot create ./sdmc: (errno=%d)\n", errno);
+        return MAKERESULT(2, 1);
+    }
+    return 0;
+}
+
+int fsdevUnmountAll(void) { return 0; }
+
+Result setsysInitialize(void) { return (Result)host_value(HostKey_SetsysInitRc); }
+void setsysExit(void) {}
+
+Result setsysGetFirmwareVersion(SetSysFirmwareVersion* out) {
+    const u64 packed = host_value(HostKey_SetsysFirmware);
+    memset(out, 0, sizeof(*out));
+    out->major = (u8)(packed >> 16);
+    out->minor = (u8)(packed >> 8);
+    out->micro = (u8)packed;
+    snprintf(out->display_version, sizeof(out->display_version), "%u.%u.%u", out->major, out->minor, out->micro);
+    return (Result)host_value(HostKey_SetsysRc);
+}
+
+Result nifmInitialize(NifmServiceType service_type) {
+    (void)service_type;
+    return (Result)host_value(HostKey_NifmInitRc);
+}
+void nifmExit(void) {}
+
+Result nifmGetInternetConnectionStatus(NifmInternetConnectionType* type, u32* wifi_strength, NifmInternetConnectionStatus* status) {
+    if (type) *type = NifmInternetConnectionType_WiFi;
+    if (wifi_strength) *wifi_strength = 3;
+    if (status) *status = (NifmInternetConnectionStatus)host_value(HostKey_NifmStatus);
+    return (Result)host_value(HostKey_NifmRc);
+}
+
+Result appletInitialize(void) { return (Result)host_value(HostKey_AppletInitRc); }
+void appletExit(void) {}
+
+Result appletGetOperationModeSystemInfo(u32* info) {
+    HostShimReply reply;
+
+    *info = 0;
+    if (host_hook(HostShimCall_AppletSystemInfo, 0, &reply)) return reply.rc;
+    return (Result)host_value(HostKey_AppletRc);
+}
+
+AppletOperationMode appletGetOperationMode(void) {
+    HostShimReply reply;
+
+    if (host_hook(HostShimCall_AppletMode, 0, &reply)) return (AppletOperationMode)reply.value;
+    return (AppletOperationMode)host_value(HostKey_AppletMode);
+}
+
+Result psmInitialize(void) { return (Result)host_value(HostKey_PsmInitRc); }
+void psmExit(void) {}
+
+Result psmGetBatteryChargePercentage(u32* out) {
+    HostShimReply reply;
+
+    if (host_hook(HostShimCall_PsmBattery, 0, &reply)) {
+        *out = (u32)reply.value;
+        return reply.rc;
+    }
+    *out = (u32)host_value(HostKey_PsmBattery);
+    return (Result)host_value(HostKey_PsmBatteryRc);
+}
+
+Result psmGetChargerType(PsmChargerType* out) {
+    HostShimReply reply;
+
+    if (host_hook(HostShimCall_PsmCharger, 0, &reply)) {
+        *out = (PsmChargerType)reply.value;
+        return reply.rc;
+    }
+    *out = (PsmChargerType)host_value(HostKey_PsmCharger);
+    return (Result)host_value(HostKey_PsmChargerRc);
+}
+
+Result pmshellInitialize(void) { return (Result)host_value(HostKey_PmshellInitRc); }
+void pmshellExit(void) {}
+
+Result pmshellGetApplicationProcessIdForShell(u64* pid_out) {
+    HostShimReply reply;
+
+    if (host_hook(HostShimCall_PmshellPid, 0, &reply)) {
+        *pid_out = reply.value;
+        return reply.rc;
+    }
+    *pid_out = host_value(HostKey_PmshellPid);
+    return (Result)host_value(HostKey_PmshellRc);
+}
+
+Result pminfoInitialize(void) { return (Result)host_value(HostKey_PminfoInitRc); }
+void pminfoExit(void) {}
+
+Result pminfoGetProgramId(u64* program_id_out, u64 pid) {
+    HostShimReply reply;
+
+    if (host_hook(HostShimCall_PminfoProgramId, pid, &reply)) {
+        *program_id_out = reply.value;
+        return reply.rc;
+    }
+    *program_id_out = host_value(HostKey_PminfoProgramId);
+    return (Result)host_value(HostKey_PminfoRc);
+}
+
+Result nsInitialize(void) { return (Result)host_value(HostKey_NsInitRc); }
+void nsExit(void) {}
+
+Result socketInitializeDefault(void) { return (Result)host_value(HostKey_SocketInitRc); }
+void socketExit(void) {}
+
+Result timeInitialize(void) { return (Result)host_value(HostKey_TimeInitRc); }
+void timeExit(void) {}
+
+Result timeGetCurrentTime(TimeType type, u64* timestamp) {
+    const u64 scripted = host_value(HostKey_TimeNow);
+
+    (void)type;
+    *timestamp = scripted != 0 ? scripted : (u64)time(NULL);
+    return (Result)host_value(HostKey_TimeRc);
+}
+
+// Process ids are 0x50, 0x51, ...; pair with a pminfo.program_id sequence.
+Result svcGetProcessList(s32* out_count, u64* out_pids, u32 max) {
+    HostShimReply reply;
+    u64 count;
+    u64 i;
+
+    if (host_hook(HostShimCall_ProcessList, 0, &reply)) {
+        count = reply.value < max ? reply.value : max;
+        for (i = 0; i < count; i++) out_pids[i] = reply.pids ? reply.pids[i] : 0;
+        *out_count = (s32)count;
+        return reply.rc;
+    }
+    count = host_value(HostKey_SvcProcessCount);
+
+    if (count > max) count = max;
+    for (i = 0; i < count; i++) out_pids[i] = 0x50 + i;
+    *out_count = (s32)count;
+    return (Result)host_value(HostKey_SvcProcessListRc);
+}
+
+// startup ----------------------------------------------------------------------
+
+static void host_on_signal(int sig) {
+    (void)sig;
+    g_host_exit_requested = 1;
+}
+
+// Stands in for libnx's crt0: __appInit before main, __appExit at exit. In the
+// sysmodule build a SIGINT/SIGTERM becomes exit() at the main loop's next sleep
+// or select.
+__attribute__((constructor)) static void host_shim_startup(void) {
+    const char* script = getenv("RICHNX_SHIM_SCRIPT");
+
+    g_host_main_thread = pthread_self();
+    signal(SIGPIPE, SIG_IGN); // Horizon sockets never raise it
+    if (script && !host_shim_load(script)) {
+        exit(2);
+    }
+    if (__appInit) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = host_on_signal;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+        __appInit();
+    }
+    if (__appExit) atexit(__appExit);
+}
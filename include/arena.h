@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "json_writer.h"
+
+#define ARENA_ALIGN 16
+
+// Fixed-capacity bump allocator over static storage. Not thread-safe: each
+// arena is owned by one thread (or only carved up during init). Scratch use
+// brackets allocations with arena_mark()/arena_release().
+typedef struct {
+    const char* name;
+    u8* base;
+    size_t capacity;
+    size_t used;
+    size_t high_water;
+    u64 alloc_count;
+    u64 fail_count;
+} Arena;
+
+// Defines static storage plus an Arena over it at file scope.
+#define ARENA_DEFINE(var, label, bytes)                                          \
+    static u8 var##_storage[(bytes)] __attribute__((aligned(ARENA_ALIGN)));      \
+    static Arena var = { (label), var##_storage, (bytes), 0, 0, 0, 0 }
+
+// Makes an arena show up in /debug/memory; safe to call more than once.
+void arena_register(Arena* arena);
+// Returns ARENA_ALIGN-aligned memory, or NULL (counted as a failure) when full.
+void* arena_alloc(Arena* arena, size_t size);
+size_t arena_mark(const Arena* arena);
+void arena_release(Arena* arena, size_t mark);
+
+// Fills a thread stack with a pattern so its deepest use can be measured later.
+// Call before the thread starts (again on every restart).
+void memory_register_stack(const char* name, void* base, size_t size);
+void memory_register_heap(size_t reserved);
+void memory_write_json(JsonWriter* w);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "json_writer.h"
+
+#ifndef CONFIG_PATH
+#define CONFIG_PATH "sdmc:/switch/switch-dcrpc/config.ini"
+#endif
+
+// Runtime tunables, loaded from CONFIG_PATH. Keys in config.c carry the
+// defaults and ranges; keys marked restart only take effect on next boot.
+// Text keys (char arrays) run to the end of the line, so they cannot hold
+// ';' or '#' (comment markers).
+typedef struct {
+    s32 http_port;
+    s32 http_thread_prio;
+    s32 http_thread_cpuid;
+    s32 reactor_mode;
+    s32 loop_interval_ms;
+    s32 heartbeat_ticks;
+    s32 heartbeat_debug_every;
+    s32 maintenance_ticks;
+    s32 idle_after_sec;
+    s32 idle_interval_sec;
+    s32 title_query_interval_sec;
+    s32 detection_enabled;
+    s32 log_level;
+    s32 log_binary;
+    s32 log_max_kb;
+    s32 log_max_files;
+    s32 trace_record;
+    s32 trace_max_kb;
+    s32 push_refresh_sec;
+    s32 mqtt_enabled;
+    char mqtt_host[64];
+    s32 mqtt_port;
+    char mqtt_console[32];
+    char mqtt_user[32];
+    char mqtt_password[64];
+    s32 mqtt_qos;
+    s32 mqtt_keepalive_sec;
+    s32 mqtt_batch_ms;
+} Config;
+
+void config_init(void);
+void config_get(Config* out);
+// Values from the first load. Restart-only keys must be read from these, even
+// when a thread restarts mid-session.
+void config_get_boot(Config* out);
+// Bumped whenever a value changes, so consumers can re-apply cheaply.
+u32 config_generation(void);
+// Re-reads CONFIG_PATH if its mtime or size changed (creating it with the
+// current values if missing). Keys missing from the file take their defaults.
+// Returns true when any value changed.
+bool config_reload_if_changed(void);
+// Applies "key = value" lines (ini syntax) on top of the current values and
+// saves the file. Nothing is applied if any line is invalid; err then says why.
+bool config_update(const char* text, size_t len, char* err, size_t err_size);
+void config_write_json(JsonWriter* w);
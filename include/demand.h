@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "json_writer.h"
+
+// Client demand for telemetry. HTTP requests mark demand, and push
+// subscribers or an MQTT connection count as active streams. With neither for
+// idle_after_sec the main loop samples only every idle_interval_sec; a request
+// that renders telemetry after a skipped tick refreshes it synchronously first,
+// so it is never answered from data older than one main-loop tick.
+
+// Runs one telemetry update; called from whichever thread needs the refresh,
+// so it must serialize itself against the main loop's updates.
+typedef void (*DemandRefreshFn)(void);
+
+void demand_init(DemandRefreshFn refresh);
+// idle_after_sec 0 disables idle mode.
+void demand_configure(u32 idle_after_sec, u32 idle_interval_sec);
+// Main loop, once per tick: true when this tick should sample. streams_active
+// is whether anything is subscribed to changes.
+bool demand_should_sample(bool streams_active);
+// Counts one telemetry update and the IPC calls it made.
+void demand_record_update(u64 ipc_calls);
+// HTTP, before routing. needs_fresh requests a refresh if a tick was skipped
+// since the last update.
+void demand_note_request(bool needs_fresh);
+void demand_write_json(JsonWriter* w);
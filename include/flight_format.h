@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+// Flight recorder dump layout shared by flight_recorder.c and the host-side
+// decoder in tools/.
+//
+// flight.bin is one FlightDumpHeader, then name_count names of
+// FLIGHT_NAME_SIZE bytes (NUL-padded), then event_count FlightEvents, oldest
+// first. Everything is little-endian in native struct layout. crc32 covers
+// the names and events. Dumps are written to flight.bin.tmp and renamed over
+// flight.bin. On boot the previous session's dump is renamed to
+// flight.prev.bin.
+
+#define FLIGHT_DUMP_MAGIC   0x464E5852u // "RNXF"
+#define FLIGHT_DUMP_VERSION 1
+#define FLIGHT_NAME_SIZE    32
+#define FLIGHT_NAME_NONE    0xFF // event has no name, or the name table was full
+
+typedef enum {
+    FlightEventType_Stage = 1,       // name: stage passed to set_stage
+    FlightEventType_Ipc = 2,         // name: call; arg: duration in us (saturated); value: Result
+    FlightEventType_AcceptError = 3, // arg: error streak; value: errno
+    FlightEventType_Request = 4,     // name: route path; arg: HttpMethod; value: duration in us
+    FlightEventType_Stall = 5,       // name: loop reported stalled by the watchdog
+} FlightEventType;
+
+typedef enum {
+    FlightDumpReason_Periodic = 0,
+    FlightDumpReason_Exit = 1,
+    FlightDumpReason_Stall = 2, // written by the HTTP thread while the main loop is stuck
+} FlightDumpReason;
+
+typedef struct {
+    uint64_t tick; // armGetSystemTick()
+    uint8_t type;  // FlightEventType
+    uint8_t name;  // index into the dump's names
+    uint16_t arg;
+    uint32_t value;
+} FlightEvent;
+
+_Static_assert(sizeof(FlightEvent) == 16, "FlightEvent layout changed; bump FLIGHT_DUMP_VERSION");
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(FlightDumpHeader)
+    uint64_t session_id;
+    uint64_t tick_freq;
+    uint64_t dump_tick;
+    uint64_t recorded; // events since boot; recorded - event_count were overwritten
+    uint32_t event_count;
+    uint16_t name_count;
+    uint8_t reason; // FlightDumpReason
+    uint8_t reserved;
+    uint32_t sequence; // dumps written this session, this one included
+    uint32_t crc32;
+} FlightDumpHeader;
+
+_Static_assert(sizeof(FlightDumpHeader) == 56, "FlightDumpHeader layout changed; bump FLIGHT_DUMP_VERSION");
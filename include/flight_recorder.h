@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "flight_format.h"
+#include "json_writer.h"
+
+// In-RAM ring of the last FLIGHT_EVENTS_MAX structured events (layout in
+// flight_format.h), dumped to SD so a session that dies or hangs leaves a
+// trace behind without verbose logging. Names must be string literals or
+// otherwise outlive the session; they are interned on first use.
+
+// Allocates the ring. Events recorded before this are dropped.
+void flight_recorder_init(void);
+// Renames dir's flight.bin to flight.prev.bin and directs dumps to a new
+// flight.bin. Returns true when a previous dump was kept.
+bool flight_recorder_open(const char* dir, u64 session_id);
+// Writes the ring to flight.bin; safe from any thread.
+bool flight_recorder_dump(FlightDumpReason reason);
+// Main loop: dumps when new events arrived since a dump FLIGHT_DUMP_INTERVAL_MS ago.
+void flight_recorder_poll(void);
+// Final dump; later dumps are ignored.
+void flight_recorder_close(void);
+
+void flight_recorder_record(FlightEventType type, const char* name, u16 arg, u32 value);
+void flight_recorder_write_json(JsonWriter* w);
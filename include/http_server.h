@@ -3,21 +3,97 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <switch.h>
+#include "json_writer.h"
 #include "telemetry.h"
 
+#define HTTP_NET_HISTORY 4
+
+// Network transitions reported by the main loop's link monitor.
+typedef enum {
+    HttpNetEvent_LinkDown = 0,
+    HttpNetEvent_LinkUp,
+    HttpNetEvent_Wake, // resumed from sleep; sockets are rebuilt even if the link looks up
+} HttpNetEvent;
+
+typedef struct {
+    u8 event;       // HttpNetEvent that triggered the rebind
+    u64 at_ms;      // uptime when the event was reported
+    u64 outage_ms;  // how long the link was down (LinkUp only)
+    u64 rebind_ms;  // event to listening again; 0 while still pending
+} HttpNetTransition;
+
+typedef enum {
+    HttpMethod_Unknown = 0,
+    HttpMethod_Get,
+    HttpMethod_Head,
+    HttpMethod_Post,
+    HttpMethod_Put,
+    HttpMethod_Options,
+    HttpMethod_Count,
+} HttpMethod;
+
+// What a request line asks for; see http_server_match_route.
+typedef enum {
+    HttpRoute_NotFound = 0,
+    HttpRoute_State,
+    HttpRoute_Debug,
+    HttpRoute_DebugProbes,
+    HttpRoute_DebugMemory,
+    HttpRoute_DebugBoot,
+    HttpRoute_DebugTimings,
+    HttpRoute_Log,
+    HttpRoute_ConfigGet,
+    HttpRoute_ConfigPut,
+    HttpRoute_Subscribe,
+    HttpRoute_Stats,
+} HttpRoute;
+
 typedef struct {
     TelemetryState* telemetry;
     volatile bool running;
+    bool reactor;                // no thread; the main loop drives http_server_poll
     Thread thread;
     int listen_fd;
     unsigned short port;
     volatile u64 accepted_count;
     volatile u64 request_count;
+    volatile u64 preflight_count;          // OPTIONS answered by the router
+    volatile u64 method_not_allowed_count; // 405s
     volatile int last_errno;
     volatile int stage;
     volatile bool listening;
+    bool thread_live;            // thread handle is open (created and not yet closed)
+    volatile bool exited;        // thread returned on its own (see exit_reason)
+    volatile int client_fd;      // connection being served, -1 when idle
+    int accept_error_streak;
+    char exit_reason[64];
+    UEvent net_event;
+    RMutex net_lock;
+    volatile bool offline;
+    volatile bool rebind_pending;
+    u64 offline_since_ms;
+    u64 rebind_requested_ms;
+    u64 transition_count;
+    u64 rebind_count;
+    u64 max_rebind_ms;
+    HttpNetTransition history[HTTP_NET_HISTORY];
 } HttpServer;
 
-bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port);
+// With reactor set no thread is started: the caller's loop serves requests by
+// calling http_server_poll, and client sockets get send/receive timeouts.
+bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port, bool reactor);
 void http_server_stop(HttpServer* server);
-void http_server_build_debug_json(const HttpServer* server, char* out, size_t out_size);
+// Reactor mode: waits up to wait_ns for a connection (or the link to return)
+// and serves it. A failed select drops the socket for the next pass to reopen.
+void http_server_poll(HttpServer* server, u64 wait_ns);
+// Stops the server thread (unblocking its sockets) and starts a fresh one on
+// the same static stack, keeping counters. Fails if the old thread will not exit.
+bool http_server_restart(HttpServer* server);
+// Called from the main loop on link/power transitions; wakes the server thread.
+void http_server_notify_network(HttpServer* server, HttpNetEvent event);
+void http_server_write_debug_json(const HttpServer* server, JsonWriter* w);
+size_t http_server_build_debug_json(const HttpServer* server, char* out, size_t out_size);
+// Classifies a NUL-terminated request by its request line through the route
+// table. Paths match exactly, ignoring the query string; HEAD maps like GET.
+// Unknown paths and methods a path does not take give HttpRoute_NotFound.
+HttpRoute http_server_match_route(const char* request);
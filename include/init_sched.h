@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "json_writer.h"
+
+#define INIT_SCHED_MAX_SERVICES 16
+#define INIT_SERVICE_BIT(id) (1U << (id))
+
+// Brings a service up. Returns false (with *rc set when there is one) to be
+// retried after the service's backoff.
+typedef bool (*InitStartFn)(Result* rc);
+// Extra precondition checked before every attempt; false skips the service
+// without counting an attempt or growing its backoff.
+typedef bool (*InitGateFn)(void);
+
+typedef struct {
+    const char* name;
+    const char* sm_name; // readiness probe: wait until sm has this service registered (requires sm in deps)
+    u32 deps;            // INIT_SERVICE_BIT mask of table entries that must be ready first
+    InitGateFn gate;     // optional
+    InitStartFn start;
+} InitServiceDef;
+
+typedef enum {
+    InitServiceState_Blocked = 0, // dependencies or gate not satisfied yet
+    InitServiceState_Waiting,     // readiness probe says the service is not registered yet
+    InitServiceState_Backoff,     // last attempt failed
+    InitServiceState_Ready,
+} InitServiceState;
+
+typedef struct {
+    InitServiceState state;
+    u32 attempts;
+    u32 probe_waits;
+    u32 backoff_ms;
+    Result last_rc;
+    u64 next_attempt_ms;
+    u64 first_attempt_ms; // ms since init_sched_setup; valid once attempts > 0
+    u64 ready_ms;
+} InitServiceStatus;
+
+// defs must outlive the scheduler; index in the table is the service id.
+void init_sched_setup(const InitServiceDef* defs, size_t count);
+// Attempts every service whose dependencies, gate, probe and backoff allow it.
+// Returns ms until the earliest pending retry, or 0 if nothing is waiting on a timer.
+u64 init_sched_poll(void);
+bool init_sched_all_ready(void);
+// Boot timeline for /debug/boot.
+void init_sched_write_json(JsonWriter* w);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "json_writer.h"
+
+// Service calls timed around their call sites. Names are listed in ipc_trace.c.
+typedef enum {
+    IpcCall_PsmBatteryChargePercentage = 0,
+    IpcCall_PsmChargerType,
+    IpcCall_AppletOperationModeSystemInfo,
+    IpcCall_PmshellApplicationProcessId,
+    IpcCall_PminfoProgramId,
+    IpcCall_SvcProcessList,
+    IpcCall_NifmConnectionStatus,
+    IpcCall_Count,
+} IpcCallId;
+
+#define IPC_TRACE_BUCKETS 10
+
+static inline u64 ipc_trace_begin(void) {
+    return armGetSystemTick();
+}
+
+// Records one call that started at start_tick; lock-free, callable from any thread.
+void ipc_trace_end(IpcCallId id, u64 start_tick, Result rc);
+// Calls recorded so far across every IpcCallId.
+u64 ipc_trace_total_calls(void);
+void ipc_trace_write_json(JsonWriter* w);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Receives rendered bytes in order when the writer streams through a sink.
+typedef void (*JsonSinkFn)(void* ctx, const char* data, size_t len);
+
+// Streaming JSON writer. It never allocates and always tracks the exact length
+// of the full document, even past the end of a fixed buffer.
+typedef struct {
+    char* buf;
+    size_t cap;
+    size_t pos;      // bytes currently held in buf
+    size_t len;      // total bytes produced so far
+    JsonSinkFn sink; // NULL = fixed buffer mode
+    void* sink_ctx;
+    bool overflow;
+    bool after_key;
+    u8 depth;
+    bool need_comma[JSON_WRITER_MAX_DEPTH + 1];
+} JsonWriter;
+
+// Fixed-buffer mode. buf may be NULL with cap 0 to only measure a document.
+void json_writer_init(JsonWriter* w, char* buf, size_t cap);
+// Sink mode. stage batches small writes; it is flushed to sink whenever full.
+void json_writer_init_sink(JsonWriter* w, char* stage, size_t stage_size, JsonSinkFn sink, void* ctx);
+// Terminates the document and returns its exact length (excluding the NUL).
+// In fixed-buffer mode an overflowing document is discarded (buf becomes "")
+// rather than truncated; check json_writer_ok() and retry with len + 1 bytes.
+size_t json_writer_finish(JsonWriter* w);
+bool json_writer_ok(const JsonWriter* w);
+
+void json_begin_object(JsonWriter* w);
+void json_end_object(JsonWriter* w);
+void json_begin_array(JsonWriter* w);
+void json_end_array(JsonWriter* w);
+void json_key(JsonWriter* w, const char* key);
+
+void json_u64(JsonWriter* w, u64 value);
+void json_s64(JsonWriter* w, s64 value);
+void json_hex32(JsonWriter* w, u32 value); // "0x%08X"
+void json_hex64(JsonWriter* w, u64 value); // "0x%016llX"
+void json_bool(JsonWriter* w, bool value);
+void json_null(JsonWriter* w);
+void json_string(JsonWriter* w, const char* value);
+void json_string_n(JsonWriter* w, const char* value, size_t len);
+
+void json_field_u64(JsonWriter* w, const char* key, u64 value);
+void json_field_s64(JsonWriter* w, const char* key, s64 value);
+void json_field_hex32(JsonWriter* w, const char* key, u32 value);
+void json_field_hex64(JsonWriter* w, const char* key, u64 value);
+void json_field_bool(JsonWriter* w, const char* key, bool value);
+void json_field_string(JsonWriter* w, const char* key, const char* value);
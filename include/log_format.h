@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary log layout shared by logger.c and the host-side decoder in tools/.
+//
+// A file starts with LOG_BIN_MAGIC followed by a version byte and a reserved
+// byte, then a sequence of records: [type:u8][len:u16 little-endian][payload].
+// Format strings are defined once per file before the first event using them,
+// so each file decodes on its own after rotation.
+
+#define LOG_BIN_MAGIC "RNXLOG"
+#define LOG_BIN_MAGIC_SIZE 6
+#define LOG_BIN_VERSION 1
+#define LOG_BIN_HEADER_SIZE 8
+#define LOG_BIN_RECORD_HEADER_SIZE 3
+
+enum {
+    LogRecord_Format = 1,  // varint id, format text
+    LogRecord_Event = 2,   // varint id, varint ms since boot, varint line, args
+    LogRecord_Text = 3,    // varint ms since boot, varint line, rendered text
+    LogRecord_Dropped = 4, // varint count
+};
+
+// Event arguments follow the format string's conversions in order:
+//   d i and '*' width/precision   zigzag varint
+//   u o x X c p                   varint
+//   s                             varint length + bytes
+//   f F e E g G a A               8 raw bytes (IEEE-754 double, little-endian)
+// A line whose arguments do not fit (a string over 255 bytes, a record over
+// the logger's slot size, or a conversion not listed here) is stored as a
+// LogRecord_Text record instead, cut with the logger's "...(truncated N)"
+// marker if needed. The decoder still renders arguments missing from a
+// malformed event as "?".
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    int ok;
+} LogReader;
+
+uint64_t log_read_varint(LogReader* r);
+int64_t log_read_zigzag(LogReader* r);
+// Renders fmt with arguments pulled from r into out (always NUL-terminated).
+// Returns the untruncated length, like snprintf.
+size_t log_format_render(const char* fmt, LogReader* r, char* out, size_t out_size);
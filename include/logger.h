@@ -2,7 +2,103 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <switch.h>
 
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+
+// Calls below this level are compiled out entirely (e.g. -DLOG_COMPILE_MIN_LEVEL=1).
+#ifndef LOG_COMPILE_MIN_LEVEL
+#define LOG_COMPILE_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Runtime threshold, read inline by the LOG_* macros so filtered calls skip
+// argument evaluation and formatting. Set through logger_set_level().
+extern int g_logger_min_level;
+
+// Per-call-site limiter state; one static instance lives inside each
+// LOG_*_RATELIMITED expansion.
+typedef struct {
+    u64 next_tick;
+    u32 suppressed;
+} LogRateLimit;
+
+#define LOG_AT(level, ...)                                                        \
+    do {                                                                          \
+        if ((level) >= LOG_COMPILE_MIN_LEVEL && (level) >= g_logger_min_level) {  \
+            logger_write(__VA_ARGS__);                                            \
+        }                                                                         \
+    } while (0)
+
+// Logs at most once per interval_ms from this call site and reports how many
+// similar lines were swallowed in between.
+#define LOG_AT_RATELIMITED(level, interval_ms, ...)                               \
+    do {                                                                          \
+        if ((level) >= LOG_COMPILE_MIN_LEVEL && (level) >= g_logger_min_level) {  \
+            static LogRateLimit log_site_;                                        \
+            u32 log_suppressed_ = 0;                                              \
+            if (logger_ratelimit(&log_site_, (interval_ms), &log_suppressed_)) {  \
+                if (log_suppressed_ > 0) {                                        \
+                    logger_write("log: suppressed %u similar at %s:%d",           \
+                                 (unsigned int)log_suppressed_, __FILE__, __LINE__); \
+                }                                                                 \
+                logger_write(__VA_ARGS__);                                        \
+            }                                                                     \
+        }                                                                         \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_INFO(...)  LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_WARN(...)  LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN_RATELIMITED(interval_ms, ...) LOG_AT_RATELIMITED(LOG_LEVEL_WARN, interval_ms, __VA_ARGS__)
+
+typedef struct {
+    u64 queued_lines;
+    u64 written_lines;
+    u64 dropped_lines;
+    u64 flush_count;
+    u64 bytes_written;
+    u64 rotation_count;
+    u64 suppressed_lines;
+    u64 truncated_lines;
+    u32 pending_lines;
+    int min_level;
+    bool binary;
+} LoggerStats;
+
+void logger_init(void);
+// Enables SD output. Lines are always kept in the in-memory tail, so /log
+// works while SD logging is off or before the card is mounted.
 void logger_set_enabled(bool enabled);
+// Binary mode stores a format id plus raw arguments in log.bin instead of
+// rendered text in log.log; decode with tools/logdecode.
+void logger_set_binary(bool binary);
+// Caps each file at max_bytes (0 = unlimited) and keeps max_files files per
+// format, counting the live one (log.log, log.1.log, ...).
+void logger_set_rotation(u32 max_bytes, u32 max_files);
+void logger_set_level(int min_level);
+// Returns true when the site may log now; *suppressed receives the number of
+// calls swallowed since it last did.
+bool logger_ratelimit(LogRateLimit* site, u32 interval_ms, u32* suppressed);
+// Unconditional write used by the LOG_* macros.
+// Formats into the in-memory ring; never touches the SD card and never blocks.
+// A line holds at most 510 bytes including its "[s] [line=n] " prefix. Longer
+// lines keep their head, end in "...(truncated N)" with N the bytes cut, and
+// count as truncated_lines. In binary mode an event whose arguments do not fit
+// the slot, or that has a string argument over 255 bytes, is stored as text
+// under the same limit instead.
 void logger_write(const char* fmt, ...);
 void logger_vwrite(const char* fmt, va_list args);
+// Writes queued lines to SD once enough are pending or the flush interval has
+// passed. Single consumer: call from the main loop only.
+void logger_poll(void);
+// Writes every queued line to SD now (shutdown path).
+void logger_flush(void);
+void logger_get_stats(LoggerStats* out);
+// Copies retained lines numbered >= since into out (not NUL-terminated) and
+// returns the byte count. *next_line is the cursor for the next call and
+// *first_line the oldest line still held; a gap means lines were evicted.
+size_t logger_read_recent(u64 since, char* out, size_t out_size, u64* first_line, u64* next_line);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "config.h"
+#include "json_writer.h"
+#include "telemetry.h"
+
+// Optional MQTT 3.1.1 publisher (mqtt_enabled). One retained topic per state
+// field under richnx/<mqtt_console>/ (active_program_id, battery_percent,
+// ...), published at mqtt_qos only when its value changes. Updates arriving
+// within mqtt_batch_ms of each other go out as one write. richnx/<console>/online
+// is "true" while connected and "false" through the broker's last will.
+// Connection loss is retried with exponential backoff (1 s .. 60 s); each
+// reconnect republishes every topic. Runs on its own thread; mqtt_notify is
+// all the telemetry path does.
+
+bool mqtt_start(TelemetryState* telemetry);
+void mqtt_stop(void);
+// Picks up the mqtt_* keys; reconnects if the broker, credentials or console change.
+void mqtt_configure(const Config* cfg);
+// Called after each telemetry update.
+void mqtt_notify(void);
+bool mqtt_connected(void);
+void mqtt_write_json(JsonWriter* w);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "json_writer.h"
+#include "telemetry.h"
+
+// UDP push of telemetry changes to subscribers registered via POST /subscribe.
+// A push thread compares each probe's packed payload after every telemetry
+// update (push_notify) and sends the changed, subscribed probes; every
+// subscriber also gets all of its probes every refresh interval and right
+// after subscribing. Subscriptions lapse unless renewed within their lease.
+//
+// Datagram (little-endian):
+//   magic "RNXP"  version:u8  flags:u8  fields:u8  changed:u8
+//   seq:u32       lease_left_sec:u32
+//   record...     id:u8 len:u8 payload (telemetry_pack_probe)
+// fields lists the probes carried, changed those that differ from the previous
+// datagram to this subscriber. seq counts datagrams per subscription.
+#define PUSH_MAGIC "RNXP"
+#define PUSH_VERSION 1
+#define PUSH_HEADER_SIZE 16
+#define PUSH_FLAG_REFRESH 0x01 // periodic or initial full datagram
+
+#define PUSH_SUBSCRIBER_MAX 8
+#define PUSH_LEASE_DEFAULT_SEC 300
+#define PUSH_LEASE_MIN_SEC 10
+#define PUSH_LEASE_MAX_SEC 3600
+
+typedef struct {
+    bool used;
+    u32 addr; // IPv4, network byte order
+    u16 port;
+    u32 fields; // TELEMETRY_PROBE_BIT mask
+    u32 lease_sec;
+    u64 expires_ms;
+    u64 next_refresh_ms;
+    u32 seq;
+    u64 sent;
+    u64 send_errors;
+} PushSubscriber;
+
+bool push_start(TelemetryState* telemetry);
+void push_stop(void);
+// Called after each telemetry update; wakes the push thread if anyone listens.
+void push_notify(void);
+// True while the thread runs with at least one subscriber.
+bool push_active(void);
+void push_set_refresh_sec(u32 refresh_sec);
+
+// Applies a subscription request from the HTTP thread. body holds
+// "key=value" pairs separated by '&' or newlines:
+//   host=<IPv4>    optional; must equal peer_addr (the requester)
+//   port=<udp>     required
+//   fields=<list>  probe names ("battery,title"), "all" (default) or a bit mask
+//   lease=<sec>    PUSH_LEASE_MIN_SEC..PUSH_LEASE_MAX_SEC; 0 unsubscribes
+// The same host:port renews or replaces its entry. On success *out is a copy
+// of the entry (lease_sec 0 after an unsubscribe); on failure err says why and
+// *busy tells a full table or a stopped push thread from a malformed request.
+bool push_subscribe(const char* body, size_t len, u32 peer_addr, PushSubscriber* out, bool* busy, char* err, size_t err_size);
+void push_write_subscriber_json(const PushSubscriber* sub, JsonWriter* w);
+void push_write_json(JsonWriter* w);
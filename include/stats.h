@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <switch.h>
+#include "json_writer.h"
+#include "telemetry.h"
+
+// Long-term usage statistics on SD. Every main-loop sample is folded into a
+// per-minute bucket; finished minutes roll up into hours and hours into days
+// (UTC). Each resolution is a ring of STATS_BLOCK_SIZE blocks in
+// stats_<resolution>.bin, overwriting its oldest block once full, with one
+// index entry per block in stats_<resolution>.idx. A range query binary
+// searches the index and reads only the blocks that overlap it. The open tail
+// block of each ring is rewritten in place every STATS_FLUSH_INTERVAL_SEC.
+//
+// Block (little-endian):
+//   magic "RNXA"  version:u8  resolution:u8  count:u16  seq:u32
+//   used:u16      reserved:u16  first_start:u32  crc32:u32 (of the payload)
+//   payload       count records of varints (see log_format.h for the coding):
+//     start_delta      resolution units since the previous record (first: since first_start)
+//     covered_sec samples battery_samples
+//     [battery_samples > 0]  zigzag(avg - previous avg)  avg-min  max-avg
+//     charging_sec docked_sec other_title_sec title_count
+//     title_count x { tag [program_id:u64 when tag is 0] sec }
+//   A title tag is 1 + the position of an id met earlier in the same block,
+//   or 0 for an id spelled out in full.
+// Index entry: seq:u32 first_start:u32 last_start:u32 count:u32; seq 0 is an
+// unused slot.
+#define STATS_MAGIC "RNXA"
+#define STATS_VERSION 1
+#define STATS_BLOCK_SIZE 1024
+#define STATS_BLOCK_HEADER_SIZE 24
+#define STATS_TITLES_MAX 4 // per bucket; the rest is summed into other_title_sec
+#define STATS_FLUSH_INTERVAL_SEC 600
+
+typedef enum {
+    StatsResolution_Minute = 0,
+    StatsResolution_Hour,
+    StatsResolution_Day,
+    StatsResolution_Count,
+} StatsResolution;
+
+typedef struct {
+    u64 program_id;
+    u32 sec;
+} StatsTitle;
+
+typedef struct {
+    u32 start; // unix time, a multiple of the resolution
+    u32 covered_sec;
+    u32 samples;
+    u32 battery_samples;
+    u32 battery_sum; // stored as the rounded average
+    u8 battery_min;
+    u8 battery_max;
+    u32 charging_sec;
+    u32 docked_sec;
+    u32 other_title_sec;
+    u8 title_count;
+    StatsTitle titles[STATS_TITLES_MAX];
+} StatsBucket;
+
+// Opens (creating if needed) the rings under dir and restores the in-progress
+// hour and day from the stored minutes and hours.
+bool stats_open(const char* dir);
+// Writes the open tail blocks and closes the files.
+void stats_close(void);
+bool stats_available(void);
+// Folds the current telemetry into the buckets; now is unix time in seconds.
+void stats_sample(TelemetryState* telemetry, u64 now);
+
+bool stats_resolution_parse(const char* name, StatsResolution* out);
+// Renders stored and in-progress buckets with from <= start < to. Stops before
+// the document would exceed budget bytes and then reports "next", the start
+// to pass as from to continue.
+void stats_write_query_json(JsonWriter* w, StatsResolution res, u64 from, u64 to, size_t budget);
+void stats_write_json(JsonWriter* w);
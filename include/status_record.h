@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Fixed-layout session status shared by main.c and the host-side dump tool in tools/.
+//
+// status.bin holds STATUS_RECORD_SLOTS records of sizeof(StatusRecord) bytes,
+// stored little-endian in native struct layout. Writes alternate between the
+// slots in place, so a write torn by a crash leaves the other slot intact. The
+// valid slot with the highest sequence is the current record.
+
+#define STATUS_RECORD_MAGIC   0x53584E52u // "RNXS"
+#define STATUS_RECORD_VERSION 1
+#define STATUS_RECORD_SLOTS   2
+
+typedef enum {
+    StatusState_Unknown = 0,
+    StatusState_Running = 1,
+    StatusState_Stopped = 2,
+} StatusState;
+
+// Bits in StatusRecord.services.
+enum {
+    StatusService_Sm = 0,
+    StatusService_Fs,
+    StatusService_Setsys,
+    StatusService_Applet,
+    StatusService_Psm,
+    StatusService_Pmshell,
+    StatusService_Pminfo,
+    StatusService_Nifm,
+    StatusService_Socket,
+    StatusService_Ns,
+    StatusService_Count,
+};
+
+// Bits in StatusRecord.flags.
+enum {
+    StatusFlag_HttpStarted = 0,
+    StatusFlag_DetectorStarted,
+    StatusFlag_DetectorRunning,
+    StatusFlag_DetectorAlive,
+    StatusFlag_KillSwitch,
+    StatusFlag_UncleanPrevious,
+    StatusFlag_Count,
+};
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint64_t sequence;
+    uint64_t session_id;
+    uint64_t uptime_sec;
+    uint64_t heartbeats;
+    uint32_t state; // StatusState
+    uint32_t last_rc;
+    uint32_t services;
+    uint32_t flags;
+    uint64_t detector_last_heartbeat_sec;
+    uint64_t detector_attempts;
+    uint64_t detector_successes;
+    uint64_t detector_failures;
+    uint32_t detector_fail_streak;
+    uint32_t detector_last_rc;
+    uint64_t detector_cooldown_until_sec;
+    char stage[32];
+    uint32_t reserved;
+    uint32_t checksum; // CRC-32 of every byte before this field
+} StatusRecord;
+
+_Static_assert(sizeof(StatusRecord) == 144, "StatusRecord layout changed; bump STATUS_RECORD_VERSION");
+
+typedef struct {
+    FILE* file;
+    uint64_t sequence;
+    int next_slot;
+} StatusStore;
+
+uint32_t status_record_crc32(const void* data, size_t len);
+// Continues a CRC-32 over more data; start from 0. status_record_crc32(d, n)
+// equals status_record_crc32_update(0, d, n).
+uint32_t status_record_crc32_update(uint32_t crc, const void* data, size_t len);
+bool status_record_valid(const StatusRecord* rec);
+// Reads every slot from f. Returns the index of the newest valid slot, or -1.
+int status_record_read_slots(FILE* f, StatusRecord slots[STATUS_RECORD_SLOTS]);
+
+// Opens (creating if needed) the slot file. When previous is non-NULL it
+// receives the newest valid record; returns false if none exists or the file
+// cannot be opened (check store->file to tell the two apart).
+bool status_store_open(StatusStore* store, const char* path, StatusRecord* previous);
+// Stamps header, sequence and checksum into rec and writes it over the older slot.
+bool status_store_write(StatusStore* store, StatusRecord* rec);
+void status_store_close(StatusStore* store);
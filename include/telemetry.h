@@ -4,12 +4,46 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <switch.h>
+#include "json_writer.h"
+
+// Data sources sampled by the telemetry scheduler. Table order is also run
+// and commit order, so a probe may rely on results committed by earlier ones.
+typedef enum {
+    TelemetryProbe_Battery = 0,
+    TelemetryProbe_Charger,
+    TelemetryProbe_Dock,
+    TelemetryProbe_Title,
+    TelemetryProbe_Count,
+} TelemetryProbeId;
+
+#define TELEMETRY_PROBE_BIT(id) (1U << (id))
+#define TELEMETRY_PROBE_ALL ((1U << TelemetryProbe_Count) - 1U)
+// Upper bound of one probe's packed payload (see telemetry_pack_probe).
+#define TELEMETRY_PROBE_PACK_MAX 255
+
+typedef enum {
+    TelemetryProbeCost_Cheap = 0,  // single IPC round-trip
+    TelemetryProbeCost_Moderate,   // a few IPC round-trips
+    TelemetryProbeCost_Expensive,  // process scans / per-process IPC
+} TelemetryProbeCost;
+
+typedef struct {
+    Result last_result;
+    u32 interval_sec; // 0 = every update
+    u64 next_due_sec;
+    u64 run_count;
+    u64 last_run_ticks;
+    u64 max_run_ticks;
+    u64 total_run_ticks;
+} TelemetryProbeStatus;
 
 typedef struct {
     RMutex lock;
     u64 started_sec;
     u64 last_update_sec;
     u64 sample_count;
+    u32 armed_probes; // probes that have been enabled at least once
+    TelemetryProbeStatus probes[TelemetryProbe_Count];
     char firmware[32];
     u64 active_program_id;
     char active_game[256];
@@ -19,10 +53,8 @@ typedef struct {
     Result last_svc_result;
     u64 last_process_id;
     u32 detection_source; // 0=none, 1=pmdmnt, 2=svc_scan
-    u64 next_query_sec;
     u64 pending_program_id;
     u8 pending_match_count;
-    bool detection_mode;
     u64 detection_attempt_count;
     u64 detection_success_count;
     u64 detection_fail_count;
@@ -31,17 +63,29 @@ typedef struct {
     u64 detection_last_success_sec;
     u32 battery_percent;
     bool battery_percent_valid;
+    u32 charger_type;
     bool is_charging;
     bool is_charging_valid;
     bool is_docked;
     bool is_docked_valid;
     u32 dock_detection_source; // 0=none, 1=applet, 2=charger_heuristic
-    Result last_psm_charge_result;
-    Result last_psm_charger_result;
-    Result last_dock_result;
 } TelemetryState;
 
 void telemetry_init(TelemetryState* state);
 void telemetry_set_firmware(TelemetryState* state, const char* firmware);
-void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query);
-void telemetry_build_json(TelemetryState* state, char* out, size_t out_size);
+// Runs every probe in enabled_probes (TELEMETRY_PROBE_BIT mask) whose interval has elapsed.
+void telemetry_update(TelemetryState* state, u32 enabled_probes);
+// Overrides a probe's table interval; takes effect from its next run.
+void telemetry_set_probe_interval(TelemetryState* state, TelemetryProbeId id, u32 interval_sec);
+void telemetry_write_json(TelemetryState* state, JsonWriter* w);
+// Renders /state into out; returns the exact document length (see json_writer_finish).
+size_t telemetry_build_json(TelemetryState* state, char* out, size_t out_size);
+void telemetry_write_probe_json(TelemetryState* state, JsonWriter* w);
+
+const char* telemetry_probe_name(TelemetryProbeId id);
+// Copies the state under its lock, for consumers on other threads that keep
+// their own snapshot (the render arena belongs to the HTTP thread).
+void telemetry_copy(TelemetryState* state, TelemetryState* out);
+// Packs one probe's payload from a snapshot (at most TELEMETRY_PROBE_PACK_MAX
+// bytes); returns its length.
+size_t telemetry_pack_probe(const TelemetryState* snap, TelemetryProbeId id, u8* out);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "ipc_trace.h"
+#include "json_writer.h"
+
+// Recording of the raw IPC results telemetry probes see, for offline replay
+// (host/replay.c). File layout:
+//   header: "RNXT" version:u8 reserved:u8[3]
+//   record: type:u8 dt_us:varint payload
+// dt_us is the time since the previous record (the first is relative to when
+// recording started). Payloads are varints (see log_format.h for the coding):
+//   Update       enabled_probes
+//   Interval     probe_id interval_sec          (emitted when a probe's interval changes)
+//   Ipc          call_id rc value arg           (IpcCallId; arg is the pid for pminfo)
+//   ProcessList  rc count pid...
+//   Dropped      records lost while the buffer was full
+#define TELEMETRY_TRACE_MAGIC "RNXT"
+#define TELEMETRY_TRACE_MAGIC_SIZE 4
+#define TELEMETRY_TRACE_VERSION 1
+#define TELEMETRY_TRACE_HEADER_SIZE 8
+
+typedef enum {
+    TraceRecord_Update = 1,
+    TraceRecord_Interval = 2,
+    TraceRecord_Ipc = 3,
+    TraceRecord_ProcessList = 4,
+    TraceRecord_Dropped = 5,
+} TraceRecordType;
+
+// Truncates path and starts recording; stops by itself once max_bytes are written.
+bool telemetry_trace_start(const char* path, u32 max_bytes);
+void telemetry_trace_stop(void);
+bool telemetry_trace_active(void);
+// Writes buffered records to the file; called from the main loop.
+void telemetry_trace_flush(void);
+
+// Hooks used by telemetry.c; all return immediately while not recording.
+void telemetry_trace_update(u32 enabled_probes, const u32* intervals_sec, int probe_count);
+void telemetry_trace_ipc(IpcCallId call, Result rc, u64 value, u64 arg);
+void telemetry_trace_process_list(Result rc, const u64* pids, s32 count);
+
+void telemetry_trace_write_json(JsonWriter* w);
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <switch.h>
+#include "json_writer.h"
+
+// Loops that publish tick-based heartbeats. Each side checks the other.
+typedef enum {
+    Watchdog_MainLoop = 0,
+    Watchdog_Http,
+    Watchdog_Count,
+} WatchdogId;
+
+// where must be a string literal; it names what the loop was doing when it
+// last checked in and ends up in stall reasons.
+void watchdog_beat(WatchdogId id, const char* where);
+u64 watchdog_age_ms(WatchdogId id);
+// Edge-triggered: returns true once per stall episode, when the heartbeat age
+// first exceeds limit_ms, and records it as the last stall reason.
+bool watchdog_check(WatchdogId id, u64 limit_ms);
+void watchdog_record_stall(WatchdogId id, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+void watchdog_record_restart(WatchdogId id, bool ok);
+// Counts one return from a blocking wait (sleep, select, event) in id's loop,
+// reported as wakeups and wakeups_per_min.
+void watchdog_count_wake(WatchdogId id);
+void watchdog_write_json(JsonWriter* w);
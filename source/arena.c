@@ -0,0 +1,142 @@
+#include "arena.h"
+
+#include "logger.h"
+
+#include <malloc.h>
+#include <string.h>
+
+// Room to spare: 8 arenas and 4 stacks are registered today.
+#define MEMORY_MAX_ARENAS 16
+#define MEMORY_MAX_STACKS 8
+#define STACK_PAINT_BYTE  0xA5
+
+typedef struct {
+    const char* name;
+    const u8* base;
+    size_t size;
+} StackInfo;
+
+static Arena* g_arenas[MEMORY_MAX_ARENAS];
+static size_t g_arena_count;
+static StackInfo g_stacks[MEMORY_MAX_STACKS];
+static size_t g_stack_count;
+static size_t g_heap_reserved;
+static bool g_arena_overflow_logged;
+static bool g_stack_overflow_logged;
+
+void arena_register(Arena* arena) {
+    size_t i;
+
+    for (i = 0; i < g_arena_count; i++) {
+        if (g_arenas[i] == arena) return;
+    }
+    if (g_arena_count < MEMORY_MAX_ARENAS) {
+        g_arenas[g_arena_count++] = arena;
+    } else if (!g_arena_overflow_logged) {
+        g_arena_overflow_logged = true;
+        LOG_WARN("memory: arena table full (%d), %s missing from /debug/memory", MEMORY_MAX_ARENAS, arena->name);
+    }
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    const size_t start = (arena->used + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+
+    if (start > arena->capacity || size > arena->capacity - start) {
+        arena->fail_count++;
+        return NULL;
+    }
+    arena->used = start + size;
+    arena->alloc_count++;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return arena->base + start;
+}
+
+size_t arena_mark(const Arena* arena) {
+    return arena->used;
+}
+
+void arena_release(Arena* arena, size_t mark) {
+    if (mark <= arena->used) {
+        arena->used = mark;
+    }
+}
+
+void memory_register_stack(const char* name, void* base, size_t size) {
+    size_t i;
+
+    memset(base, STACK_PAINT_BYTE, size);
+    for (i = 0; i < g_stack_count; i++) {
+        if (g_stacks[i].base == base) return;
+    }
+    if (g_stack_count < MEMORY_MAX_STACKS) {
+        g_stacks[g_stack_count].name = name;
+        g_stacks[g_stack_count].base = (const u8*)base;
+        g_stacks[g_stack_count].size = size;
+        g_stack_count++;
+    } else if (!g_stack_overflow_logged) {
+        g_stack_overflow_logged = true;
+        LOG_WARN("memory: stack table full (%d), %s missing from /debug/memory", MEMORY_MAX_STACKS, name);
+    }
+}
+
+void memory_register_heap(size_t reserved) {
+    g_heap_reserved = reserved;
+}
+
+// Stacks grow down, so untouched pattern bytes sit at the low end.
+static size_t stack_high_water(const StackInfo* stack) {
+    size_t untouched = 0;
+
+    while (untouched < stack->size && stack->base[untouched] == STACK_PAINT_BYTE) {
+        untouched++;
+    }
+    return stack->size - untouched;
+}
+
+void memory_write_json(JsonWriter* w) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 mi = mallinfo2(); // host build; mallinfo() is deprecated there
+#else
+    struct mallinfo mi = mallinfo();
+#endif
+    size_t i;
+
+    json_begin_object(w);
+
+    json_key(w, "arenas");
+    json_begin_array(w);
+    for (i = 0; i < g_arena_count; i++) {
+        const Arena* a = g_arenas[i];
+        json_begin_object(w);
+        json_field_string(w, "name", a->name);
+        json_field_u64(w, "capacity", a->capacity);
+        json_field_u64(w, "used", a->used);
+        json_field_u64(w, "high_water", a->high_water);
+        json_field_u64(w, "allocs", a->alloc_count);
+        json_field_u64(w, "failures", a->fail_count);
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_key(w, "stacks");
+    json_begin_array(w);
+    for (i = 0; i < g_stack_count; i++) {
+        json_begin_object(w);
+        json_field_string(w, "name", g_stacks[i].name);
+        json_field_u64(w, "size", g_stacks[i].size);
+        json_field_u64(w, "high_water", stack_high_water(&g_stacks[i]));
+        json_end_object(w);
+    }
+    json_end_array(w);
+
+    json_key(w, "heap");
+    json_begin_object(w);
+    json_field_u64(w, "reserved", g_heap_reserved);
+    json_field_u64(w, "claimed", (u64)mi.arena);
+    json_field_u64(w, "in_use", (u64)mi.uordblks);
+    json_end_object(w);
+
+    json_end_object(w);
+}
@@ -0,0 +1,451 @@
+#include "config.h"
+
+#include "logger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CONFIG_TMP_PATH CONFIG_PATH ".tmp"
+#define CONFIG_LEGACY_DETECTION_OFF_PATH "sdmc:/switch/switch-dcrpc/detection.off"
+#define CONFIG_FILE_MAX 4096
+#define CONFIG_ERROR_MAX 96
+
+typedef struct {
+    const char* name;
+    size_t offset;
+    s32 def;
+    s32 min;
+    s32 max;
+    bool restart; // read once at startup
+    bool boolean;
+    size_t text_size; // text keys: sizeof the char array; 0 for numbers
+    bool secret;      // text keys shown as "***" in /config
+} ConfigKeyDef;
+
+#define CONFIG_KEY(field, def, min, max, restart, boolean) \
+    { #field, offsetof(Config, field), (def), (min), (max), (restart), (boolean), 0, false }
+// Text keys default to empty unless config_init says otherwise.
+#define CONFIG_TEXT_KEY(field, restart, secret) \
+    { #field, offsetof(Config, field), 0, 0, 0, (restart), false, sizeof(((Config*)0)->field), (secret) }
+
+static const ConfigKeyDef g_config_keys[] = {
+    CONFIG_KEY(http_port, 6029, 1, 65535, true, false),
+    CONFIG_KEY(http_thread_prio, 0x2B, 0x18, 0x3F, true, false),
+    CONFIG_KEY(http_thread_cpuid, -2, -2, 3, true, false),
+    CONFIG_KEY(reactor_mode, 0, 0, 1, true, true),
+    CONFIG_KEY(loop_interval_ms, 2000, 100, 60000, false, false),
+    CONFIG_KEY(heartbeat_ticks, 15, 1, 100000, false, false),
+    CONFIG_KEY(heartbeat_debug_every, 10, 0, 100000, false, false),
+    CONFIG_KEY(maintenance_ticks, 3, 1, 1000, false, false),
+    CONFIG_KEY(idle_after_sec, 300, 0, 86400, false, false),
+    CONFIG_KEY(idle_interval_sec, 30, 1, 60, false, false),
+    CONFIG_KEY(title_query_interval_sec, 3, 0, 3600, false, false),
+    CONFIG_KEY(detection_enabled, 1, 0, 1, false, true),
+    CONFIG_KEY(log_level, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG, LOG_LEVEL_ERROR, false, false),
+    CONFIG_KEY(log_binary, 0, 0, 1, false, true),
+    CONFIG_KEY(log_max_kb, 256, 16, 16384, false, false),
+    CONFIG_KEY(log_max_files, 3, 1, 9, false, false),
+    CONFIG_KEY(trace_record, 0, 0, 1, false, true),
+    CONFIG_KEY(trace_max_kb, 1024, 16, 65536, false, false),
+    CONFIG_KEY(push_refresh_sec, 30, 5, 3600, false, false),
+    CONFIG_KEY(mqtt_enabled, 0, 0, 1, false, true),
+    CONFIG_TEXT_KEY(mqtt_host, false, false),
+    CONFIG_KEY(mqtt_port, 1883, 1, 65535, false, false),
+    CONFIG_TEXT_KEY(mqtt_console, false, false),
+    CONFIG_TEXT_KEY(mqtt_user, false, false),
+    CONFIG_TEXT_KEY(mqtt_password, false, true),
+    CONFIG_KEY(mqtt_qos, 1, 0, 1, false, false),
+    CONFIG_KEY(mqtt_keepalive_sec, 60, 10, 3600, false, false),
+    CONFIG_KEY(mqtt_batch_ms, 500, 0, 10000, false, false),
+};
+
+#define CONFIG_KEY_COUNT (sizeof(g_config_keys) / sizeof(g_config_keys[0]))
+
+static RMutex g_config_lock;
+static Config g_config;
+static Config g_config_boot; // values at first load; restart-only keys stay at these
+static u32 g_config_generation;
+static bool g_config_file_known;
+static time_t g_config_mtime;
+static off_t g_config_size;
+static u64 g_config_reloads;
+static char g_config_error[CONFIG_ERROR_MAX];
+
+static s32* config_field(Config* cfg, const ConfigKeyDef* key) {
+    return (s32*)((u8*)cfg + key->offset);
+}
+
+static s32 config_field_value(const Config* cfg, const ConfigKeyDef* key) {
+    return *(const s32*)((const u8*)cfg + key->offset);
+}
+
+static char* config_text(Config* cfg, const ConfigKeyDef* key) {
+    return (char*)cfg + key->offset;
+}
+
+static const char* config_text_value(const Config* cfg, const ConfigKeyDef* key) {
+    return (const char*)cfg + key->offset;
+}
+
+// Text values are stored NUL-padded so Config stays comparable with memcmp.
+static bool config_parse_text(const ConfigKeyDef* key, const char* text, size_t len, char* out) {
+    size_t i;
+
+    if (len >= key->text_size) return false;
+    for (i = 0; i < len; i++) {
+        if ((unsigned char)text[i] < 0x20 || text[i] == 0x7F) return false;
+    }
+    memset(out, 0, key->text_size);
+    memcpy(out, text, len);
+    return true;
+}
+
+static const ConfigKeyDef* config_find_key(const char* name, size_t len) {
+    size_t i;
+    for (i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (strlen(g_config_keys[i].name) == len && memcmp(g_config_keys[i].name, name, len) == 0) {
+            return &g_config_keys[i];
+        }
+    }
+    return NULL;
+}
+
+static bool config_parse_value(const ConfigKeyDef* key, const char* text, size_t len, s32* out) {
+    char buf[24];
+    char* end;
+    long v;
+
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+
+    if (key->boolean) {
+        if (strcmp(buf, "true") == 0 || strcmp(buf, "yes") == 0 || strcmp(buf, "on") == 0) {
+            *out = 1;
+            return true;
+        }
+        if (strcmp(buf, "false") == 0 || strcmp(buf, "no") == 0 || strcmp(buf, "off") == 0) {
+            *out = 0;
+            return true;
+        }
+    }
+
+    v = strtol(buf, &end, 0);
+    if (*end != '\0' || v < key->min || v > key->max) return false;
+    *out = (s32)v;
+    return true;
+}
+
+static bool config_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Parses ini text onto cfg. Blank lines, '#'/';' comments (also after a
+// value) and [section] headers are skipped; unknown keys are logged and ignored.
+static bool config_parse(Config* cfg, const char* text, size_t len, char* err, size_t err_size) {
+    const char* p = text;
+    const char* end = text + len;
+    unsigned int line_no = 0;
+
+    while (p < end) {
+        const char* line = p;
+        const char* line_end = memchr(p, '\n', (size_t)(end - p));
+        const char* eq;
+        const char* k_end;
+        const char* v;
+        const char* v_end;
+        const ConfigKeyDef* key;
+        s32 value;
+
+        if (!line_end) line_end = end;
+        p = line_end < end ? line_end + 1 : end;
+        line_no++;
+
+        while (line < line_end && config_is_space(*line)) line++;
+        if (line == line_end || *line == '#' || *line == ';' || *line == '[') continue;
+
+        eq = memchr(line, '=', (size_t)(line_end - line));
+        if (!eq) {
+            snprintf(err, err_size, "line %u: expected key = value", line_no);
+            return false;
+        }
+        k_end = eq;
+        while (k_end > line && config_is_space(k_end[-1])) k_end--;
+        v = eq + 1;
+        while (v < line_end && config_is_space(*v)) v++;
+        v_end = v;
+        while (v_end < line_end && *v_end != ';' && *v_end != '#') v_end++; // trailing comment
+        while (v_end > v && config_is_space(v_end[-1])) v_end--;
+
+        key = config_find_key(line, (size_t)(k_end - line));
+        if (!key) {
+            LOG_WARN("config: line %u: unknown key '%.*s' ignored", line_no, (int)(k_end - line), line);
+            continue;
+        }
+        if (key->text_size > 0) {
+            if (!config_parse_text(key, v, (size_t)(v_end - v), config_text(cfg, key))) {
+                snprintf(
+                    err,
+                    err_size,
+                    "line %u: %s must be at most %u printable characters",
+                    line_no,
+                    key->name,
+                    (unsigned int)(key->text_size - 1)
+                );
+                return false;
+            }
+            continue;
+        }
+        if (!config_parse_value(key, v, (size_t)(v_end - v), &value)) {
+            snprintf(
+                err,
+                err_size,
+                "line %u: %s must be %s%ld..%ld",
+                line_no,
+                key->name,
+                key->boolean ? "true/false or " : "",
+                (long)key->min,
+                (long)key->max
+            );
+            return false;
+        }
+        *config_field(cfg, key) = value;
+    }
+    return true;
+}
+
+static size_t config_format(const Config* cfg, char* out, size_t out_size) {
+    size_t pos = 0;
+    size_t i;
+    int n;
+
+    n = snprintf(out, out_size, "# switch-dcrpc configuration; reloaded when this file changes.\n");
+    if (n > 0) pos += (size_t)n;
+    for (i = 0; i < CONFIG_KEY_COUNT && pos < out_size; i++) {
+        const ConfigKeyDef* key = &g_config_keys[i];
+        if (key->text_size > 0) {
+            n = snprintf(
+                out + pos,
+                out_size - pos,
+                "%s = %s%s\n",
+                key->name,
+                config_text_value(cfg, key),
+                key->restart ? " ; restart" : ""
+            );
+        } else {
+            n = snprintf(
+                out + pos,
+                out_size - pos,
+                "%s = %ld%s\n",
+                key->name,
+                (long)config_field_value(cfg, key),
+                key->restart ? " ; restart" : ""
+            );
+        }
+        if (n > 0) pos += (size_t)n;
+    }
+    return pos < out_size ? pos : out_size - 1;
+}
+
+static void config_remember_file(void) {
+    struct stat st;
+
+    if (stat(CONFIG_PATH, &st) == 0) {
+        g_config_file_known = true;
+        g_config_mtime = st.st_mtime;
+        g_config_size = st.st_size;
+    }
+}
+
+// Writes through a temp file so a crash mid-write never leaves a torn config.ini.
+static bool config_save(const Config* cfg) {
+    char text[CONFIG_FILE_MAX];
+    const size_t len = config_format(cfg, text, sizeof(text));
+    FILE* f = fopen(CONFIG_TMP_PATH, "wb");
+    bool ok;
+
+    if (!f) return false;
+    ok = fwrite(text, 1, len, f) == len;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(CONFIG_TMP_PATH);
+        return false;
+    }
+    remove(CONFIG_PATH);
+    if (rename(CONFIG_TMP_PATH, CONFIG_PATH) != 0) return false;
+    config_remember_file();
+    return true;
+}
+
+static void config_set_locked(const Config* next) {
+    if (memcmp(next, &g_config, sizeof(g_config)) != 0) {
+        g_config = *next;
+        g_config_generation++;
+    }
+}
+
+static void config_defaults(Config* cfg) {
+    size_t i;
+
+    memset(cfg, 0, sizeof(*cfg));
+    for (i = 0; i < CONFIG_KEY_COUNT; i++) {
+        if (g_config_keys[i].text_size == 0) *config_field(cfg, &g_config_keys[i]) = g_config_keys[i].def;
+    }
+    snprintf(cfg->mqtt_console, sizeof(cfg->mqtt_console), "switch");
+}
+
+void config_init(void) {
+    rmutexInit(&g_config_lock);
+    config_defaults(&g_config);
+    g_config_boot = g_config;
+    g_config_generation = 1;
+}
+
+void config_get(Config* out) {
+    rmutexLock(&g_config_lock);
+    *out = g_config;
+    rmutexUnlock(&g_config_lock);
+}
+
+void config_get_boot(Config* out) {
+    rmutexLock(&g_config_lock);
+    *out = g_config_boot;
+    rmutexUnlock(&g_config_lock);
+}
+
+u32 config_generation(void) {
+    u32 gen;
+    rmutexLock(&g_config_lock);
+    gen = g_config_generation;
+    rmutexUnlock(&g_config_lock);
+    return gen;
+}
+
+bool config_reload_if_changed(void) {
+    static char text[CONFIG_FILE_MAX];
+    struct stat st;
+    Config next;
+    char err[CONFIG_ERROR_MAX];
+    FILE* f;
+    size_t len;
+    u32 before;
+    bool changed;
+    bool first_load;
+
+    if (stat(CONFIG_PATH, &st) != 0) {
+        // First boot (or deleted): seed the file so there is something to edit.
+        if (rename(CONFIG_TMP_PATH, CONFIG_PATH) == 0) return config_reload_if_changed();
+        rmutexLock(&g_config_lock);
+        next = g_config;
+        if (!g_config_file_known && (f = fopen(CONFIG_LEGACY_DETECTION_OFF_PATH, "r")) != NULL) {
+            fclose(f);
+            next.detection_enabled = 0;
+            LOG_INFO("config: migrated %s to detection_enabled = 0", CONFIG_LEGACY_DETECTION_OFF_PATH);
+        }
+        before = g_config_generation;
+        config_set_locked(&next);
+        changed = g_config_generation != before;
+        if (!g_config_file_known) g_config_boot = g_config;
+        config_save(&g_config);
+        rmutexUnlock(&g_config_lock);
+        LOG_INFO("config: wrote defaults to %s", CONFIG_PATH);
+        return changed;
+    }
+    if (g_config_file_known && st.st_mtime == g_config_mtime && st.st_size == g_config_size) {
+        return false;
+    }
+
+    f = fopen(CONFIG_PATH, "rb");
+    if (!f) return false;
+    len = fread(text, 1, sizeof(text), f);
+    fclose(f);
+
+    rmutexLock(&g_config_lock);
+    first_load = !g_config_file_known;
+    g_config_file_known = true;
+    g_config_mtime = st.st_mtime;
+    g_config_size = st.st_size;
+    g_config_reloads++;
+
+    // The file is the whole config: a key deleted from it goes back to its default.
+    config_defaults(&next);
+    err[0] = '\0';
+    if (len == sizeof(text)) {
+        snprintf(err, sizeof(err), "file larger than %u bytes", (unsigned int)sizeof(text));
+    } else if (config_parse(&next, text, len, err, sizeof(err))) {
+        before = g_config_generation;
+        config_set_locked(&next);
+        changed = g_config_generation != before;
+        if (first_load) g_config_boot = g_config;
+        g_config_error[0] = '\0';
+        rmutexUnlock(&g_config_lock);
+        LOG_INFO("config: reloaded %s (%s)", CONFIG_PATH, changed ? "changed" : "unchanged");
+        return changed;
+    }
+    snprintf(g_config_error, sizeof(g_config_error), "%s", err);
+    rmutexUnlock(&g_config_lock);
+    LOG_WARN("config: %s rejected, keeping previous values: %s", CONFIG_PATH, err);
+    return false;
+}
+
+bool config_update(const char* text, size_t len, char* err, size_t err_size) {
+    Config next;
+    bool saved;
+
+    rmutexLock(&g_config_lock);
+    next = g_config;
+    if (!config_parse(&next, text, len, err, err_size)) {
+        rmutexUnlock(&g_config_lock);
+        return false;
+    }
+    config_set_locked(&next);
+    saved = config_save(&g_config);
+    rmutexUnlock(&g_config_lock);
+
+    if (!saved) {
+        LOG_WARN("config: update applied but %s could not be written", CONFIG_PATH);
+    }
+    LOG_INFO("config: updated over HTTP");
+    return true;
+}
+
+void config_write_json(JsonWriter* w) {
+    bool restart_pending = false;
+    size_t i;
+
+    rmutexLock(&g_config_lock);
+    json_begin_object(w);
+    json_key(w, "values");
+    json_begin_object(w);
+    for (i = 0; i < CONFIG_KEY_COUNT; i++) {
+        const ConfigKeyDef* key = &g_config_keys[i];
+        s32 value;
+
+        if (key->text_size > 0) {
+            const char* text = config_text_value(&g_config, key);
+            json_field_string(w, key->name, key->secret && text[0] ? "***" : text);
+            if (key->restart && strcmp(text, config_text_value(&g_config_boot, key)) != 0) {
+                restart_pending = true;
+            }
+            continue;
+        }
+        value = config_field_value(&g_config, key);
+        if (key->boolean) {
+            json_field_bool(w, key->name, value != 0);
+        } else {
+            json_field_s64(w, key->name, value);
+        }
+        if (key->restart && value != config_field_value(&g_config_boot, key)) {
+            restart_pending = true;
+        }
+    }
+    json_end_object(w);
+    json_field_bool(w, "restart_pending", restart_pending);
+    json_field_u64(w, "generation", g_config_generation);
+    json_field_u64(w, "reloads", g_config_reloads);
+    json_field_string(w, "last_error", g_config_error);
+    json_end_object(w);
+    rmutexUnlock(&g_config_lock);
+}
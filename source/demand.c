@@ -0,0 +1,137 @@
+#include "demand.h"
+
+#include "logger.h"
+
+#define DEMAND_IDLE_AFTER_DEFAULT_SEC 300
+#define DEMAND_IDLE_INTERVAL_DEFAULT_SEC 30
+
+typedef struct {
+    RMutex lock; // zero-init is a valid RMutex
+    DemandRefreshFn refresh;
+    u64 idle_after_ms;    // 0 = never idle
+    u64 idle_interval_ms;
+    u64 last_demand_ms;   // last request, or last tick with an active stream
+    u64 last_sample_ms;
+    bool idle;
+    bool stale;           // a tick was skipped since the last update
+    u64 idle_since_ms;
+    u64 idle_total_ms;    // finished idle periods
+    u64 idle_entries;
+    u64 updates;
+    u64 update_ipc_calls;
+    u64 skipped;
+    u64 request_refreshes;
+} DemandState;
+
+static DemandState g_demand = {
+    .idle_after_ms = DEMAND_IDLE_AFTER_DEFAULT_SEC * 1000ULL,
+    .idle_interval_ms = DEMAND_IDLE_INTERVAL_DEFAULT_SEC * 1000ULL,
+};
+
+static u64 demand_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+// Caller holds g_demand.lock.
+static void demand_leave_idle(u64 now, const char* why) {
+    if (!g_demand.idle) return;
+    g_demand.idle = false;
+    g_demand.idle_total_ms += now - g_demand.idle_since_ms;
+    LOG_INFO(
+        "demand: %s, back to full-rate sampling after %llus idle",
+        why,
+        (unsigned long long)((now - g_demand.idle_since_ms) / 1000ULL)
+    );
+}
+
+void demand_init(DemandRefreshFn refresh) {
+    g_demand.refresh = refresh;
+    g_demand.last_demand_ms = demand_now_ms(); // the quiet period starts at boot
+}
+
+void demand_configure(u32 idle_after_sec, u32 idle_interval_sec) {
+    rmutexLock(&g_demand.lock);
+    g_demand.idle_after_ms = (u64)idle_after_sec * 1000ULL;
+    g_demand.idle_interval_ms = (u64)idle_interval_sec * 1000ULL;
+    if (idle_after_sec == 0) demand_leave_idle(demand_now_ms(), "idle mode disabled");
+    rmutexUnlock(&g_demand.lock);
+}
+
+bool demand_should_sample(bool streams_active) {
+    const u64 now = demand_now_ms();
+    bool sample = true;
+
+    rmutexLock(&g_demand.lock);
+    if (streams_active) {
+        g_demand.last_demand_ms = now;
+        demand_leave_idle(now, "stream active");
+    }
+    if (!g_demand.idle && g_demand.idle_after_ms != 0 && now - g_demand.last_demand_ms >= g_demand.idle_after_ms) {
+        g_demand.idle = true;
+        g_demand.idle_since_ms = now;
+        g_demand.idle_entries++;
+        LOG_INFO(
+            "demand: no clients for %llus, sampling every %llus",
+            (unsigned long long)((now - g_demand.last_demand_ms) / 1000ULL),
+            (unsigned long long)(g_demand.idle_interval_ms / 1000ULL)
+        );
+    }
+    if (g_demand.idle && now - g_demand.last_sample_ms < g_demand.idle_interval_ms) {
+        g_demand.skipped++;
+        g_demand.stale = true;
+        sample = false;
+    }
+    rmutexUnlock(&g_demand.lock);
+    return sample;
+}
+
+void demand_record_update(u64 ipc_calls) {
+    rmutexLock(&g_demand.lock);
+    g_demand.updates++;
+    g_demand.update_ipc_calls += ipc_calls;
+    g_demand.last_sample_ms = demand_now_ms();
+    g_demand.stale = false;
+    rmutexUnlock(&g_demand.lock);
+}
+
+void demand_note_request(bool needs_fresh) {
+    const u64 now = demand_now_ms();
+    bool refresh;
+
+    rmutexLock(&g_demand.lock);
+    g_demand.last_demand_ms = now;
+    demand_leave_idle(now, "request");
+    refresh = needs_fresh && g_demand.stale && g_demand.refresh;
+    if (refresh) {
+        g_demand.stale = false;
+        g_demand.request_refreshes++;
+    }
+    rmutexUnlock(&g_demand.lock);
+
+    if (refresh) g_demand.refresh();
+}
+
+void demand_write_json(JsonWriter* w) {
+    const u64 now = demand_now_ms();
+
+    rmutexLock(&g_demand.lock);
+    json_begin_object(w);
+    json_field_bool(w, "idle", g_demand.idle);
+    json_field_u64(w, "idle_after_sec", g_demand.idle_after_ms / 1000ULL);
+    json_field_u64(w, "idle_interval_sec", g_demand.idle_interval_ms / 1000ULL);
+    json_field_u64(w, "quiet_sec", (now - g_demand.last_demand_ms) / 1000ULL);
+    json_field_u64(w, "idle_entries", g_demand.idle_entries);
+    json_field_u64(w, "idle_sec", (g_demand.idle_total_ms + (g_demand.idle ? now - g_demand.idle_since_ms : 0)) / 1000ULL);
+    json_field_u64(w, "updates", g_demand.updates);
+    json_field_u64(w, "skipped_updates", g_demand.skipped);
+    json_field_u64(w, "request_refreshes", g_demand.request_refreshes);
+    json_field_u64(w, "ipc_calls", g_demand.update_ipc_calls);
+    // Estimated at the average number of calls per update.
+    json_field_u64(
+        w,
+        "ipc_calls_saved",
+        g_demand.updates ? g_demand.skipped * g_demand.update_ipc_calls / g_demand.updates : 0
+    );
+    json_end_object(w);
+    rmutexUnlock(&g_demand.lock);
+}
@@ -0,0 +1,220 @@
+#include "flight_recorder.h"
+
+#include "arena.h"
+#include "logger.h"
+#include "status_record.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FLIGHT_EVENTS_MAX 4096 // 64 KiB; a few minutes at the default loop interval
+#define FLIGHT_RING_BYTES (FLIGHT_EVENTS_MAX * sizeof(FlightEvent))
+#define FLIGHT_NAMES_MAX 64
+#define FLIGHT_DUMP_INTERVAL_MS 60000
+#define FLIGHT_PATH_MAX 128
+
+typedef struct {
+    RMutex lock;      // ring and names; zero-init is a valid RMutex
+    RMutex dump_lock; // one dump at a time
+    FlightEvent* events;
+    FlightEvent* snapshot; // the ring in dump order; guarded by dump_lock
+    u64 recorded;
+    const char* names[FLIGHT_NAMES_MAX];
+    int name_count;
+    char name_buf[FLIGHT_NAMES_MAX][FLIGHT_NAME_SIZE]; // rendered names; guarded by dump_lock
+    char path[FLIGHT_PATH_MAX];
+    char tmp_path[FLIGHT_PATH_MAX];
+    u64 session_id;
+    bool closed;
+    bool previous_kept;
+    u32 dumps;
+    u32 dump_failures;
+    u64 last_dump_ms;
+    u64 recorded_at_dump;
+} FlightRecorder;
+
+// The ring, plus the copy a dump writes out so recording never waits on SD.
+ARENA_DEFINE(g_flight_arena, "flight", 2 * FLIGHT_RING_BYTES);
+
+static FlightRecorder g_flight;
+
+static u64 flight_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+// Caller holds the lock. Names are compared by pointer first: callers pass
+// literals, so the strcmp only runs for a name's first few uses.
+static u8 flight_intern(const char* name) {
+    int i;
+
+    if (!name) return FLIGHT_NAME_NONE;
+    for (i = 0; i < g_flight.name_count; i++) {
+        if (g_flight.names[i] == name) return (u8)i;
+    }
+    for (i = 0; i < g_flight.name_count; i++) {
+        if (strcmp(g_flight.names[i], name) == 0) return (u8)i;
+    }
+    if (g_flight.name_count == FLIGHT_NAMES_MAX) return FLIGHT_NAME_NONE;
+    g_flight.names[g_flight.name_count] = name;
+    return (u8)g_flight.name_count++;
+}
+
+void flight_recorder_init(void) {
+    arena_register(&g_flight_arena);
+    if (!g_flight.events) {
+        g_flight.events = (FlightEvent*)arena_alloc(&g_flight_arena, FLIGHT_RING_BYTES);
+        g_flight.snapshot = (FlightEvent*)arena_alloc(&g_flight_arena, FLIGHT_RING_BYTES);
+    }
+}
+
+void flight_recorder_record(FlightEventType type, const char* name, u16 arg, u32 value) {
+    FlightEvent* e;
+
+    if (!g_flight.events) return;
+    rmutexLock(&g_flight.lock);
+    e = &g_flight.events[g_flight.recorded % FLIGHT_EVENTS_MAX];
+    e->tick = armGetSystemTick();
+    e->type = (u8)type;
+    e->name = flight_intern(name);
+    e->arg = arg;
+    e->value = value;
+    g_flight.recorded++;
+    rmutexUnlock(&g_flight.lock);
+}
+
+bool flight_recorder_open(const char* dir, u64 session_id) {
+    char prev_path[FLIGHT_PATH_MAX];
+    FILE* f;
+    bool kept = false;
+
+    snprintf(g_flight.path, sizeof(g_flight.path), "%s/flight.bin", dir);
+    snprintf(g_flight.tmp_path, sizeof(g_flight.tmp_path), "%s/flight.bin.tmp", dir);
+    snprintf(prev_path, sizeof(prev_path), "%s/flight.prev.bin", dir);
+    g_flight.session_id = session_id;
+
+    f = fopen(g_flight.path, "rb");
+    if (f) {
+        fclose(f);
+        remove(prev_path);
+        if (rename(g_flight.path, prev_path) == 0) {
+            kept = true;
+        } else {
+            LOG_WARN("flight: cannot keep previous dump errno=%d", errno);
+        }
+    }
+    g_flight.previous_kept = kept;
+    return kept;
+}
+
+// Caller holds dump_lock. Copies the ring (oldest first) and the names into
+// the dump buffers and fills in the header; the ring lock is held only for
+// the copy.
+static void flight_snapshot(FlightDumpHeader* header, FlightDumpReason reason) {
+    u32 count;
+    u32 first;
+    u32 head_len;
+    int i;
+
+    memset(header, 0, sizeof(*header));
+    memset(g_flight.name_buf, 0, sizeof(g_flight.name_buf));
+
+    rmutexLock(&g_flight.lock);
+    count = g_flight.recorded < FLIGHT_EVENTS_MAX ? (u32)g_flight.recorded : FLIGHT_EVENTS_MAX;
+    first = (u32)((g_flight.recorded - count) % FLIGHT_EVENTS_MAX);
+    // The oldest events run to the end of the ring, the rest wrap to its start.
+    head_len = count < FLIGHT_EVENTS_MAX - first ? count : FLIGHT_EVENTS_MAX - first;
+    memcpy(g_flight.snapshot, &g_flight.events[first], head_len * sizeof(FlightEvent));
+    memcpy(g_flight.snapshot + head_len, g_flight.events, (count - head_len) * sizeof(FlightEvent));
+    for (i = 0; i < g_flight.name_count; i++) {
+        strncpy(g_flight.name_buf[i], g_flight.names[i], FLIGHT_NAME_SIZE - 1);
+    }
+    header->name_count = (u16)g_flight.name_count;
+    header->recorded = g_flight.recorded;
+    header->dump_tick = armGetSystemTick();
+    g_flight.recorded_at_dump = g_flight.recorded;
+    rmutexUnlock(&g_flight.lock);
+
+    header->magic = FLIGHT_DUMP_MAGIC;
+    header->version = FLIGHT_DUMP_VERSION;
+    header->size = (u16)sizeof(*header);
+    header->session_id = g_flight.session_id;
+    header->tick_freq = armGetSystemTickFreq();
+    header->event_count = count;
+    header->reason = (u8)reason;
+    header->sequence = g_flight.dumps + 1;
+    header->crc32 = status_record_crc32_update(0, g_flight.name_buf, (size_t)header->name_count * FLIGHT_NAME_SIZE);
+    header->crc32 = status_record_crc32_update(header->crc32, g_flight.snapshot, count * sizeof(FlightEvent));
+}
+
+// Caller holds dump_lock. Writes through a temp file so a crash mid-dump
+// keeps the previous flight.bin.
+static bool flight_write(const FlightDumpHeader* header) {
+    const size_t names_size = (size_t)header->name_count * FLIGHT_NAME_SIZE;
+    FILE* f = fopen(g_flight.tmp_path, "wb");
+    bool ok;
+
+    if (!f) return false;
+    ok = fwrite(header, sizeof(*header), 1, f) == 1 &&
+         fwrite(g_flight.name_buf, 1, names_size, f) == names_size &&
+         fwrite(g_flight.snapshot, sizeof(FlightEvent), header->event_count, f) == header->event_count;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        remove(g_flight.tmp_path);
+        return false;
+    }
+    remove(g_flight.path);
+    return rename(g_flight.tmp_path, g_flight.path) == 0;
+}
+
+bool flight_recorder_dump(FlightDumpReason reason) {
+    FlightDumpHeader header;
+    bool ok;
+
+    if (!g_flight.events || !g_flight.snapshot || g_flight.path[0] == '\0') return false;
+    rmutexLock(&g_flight.dump_lock);
+    if (g_flight.closed) {
+        rmutexUnlock(&g_flight.dump_lock);
+        return false;
+    }
+
+    flight_snapshot(&header, reason);
+    ok = flight_write(&header);
+    g_flight.last_dump_ms = flight_now_ms();
+    if (ok) {
+        g_flight.dumps++;
+    } else {
+        g_flight.dump_failures++;
+    }
+    rmutexUnlock(&g_flight.dump_lock);
+
+    if (!ok) LOG_WARN_RATELIMITED(FLIGHT_DUMP_INTERVAL_MS, "flight: cannot write %s", g_flight.path);
+    return ok;
+}
+
+void flight_recorder_poll(void) {
+    if (flight_now_ms() - g_flight.last_dump_ms < FLIGHT_DUMP_INTERVAL_MS) return;
+    if (g_flight.recorded == g_flight.recorded_at_dump) return;
+    flight_recorder_dump(FlightDumpReason_Periodic);
+}
+
+void flight_recorder_close(void) {
+    flight_recorder_dump(FlightDumpReason_Exit);
+    rmutexLock(&g_flight.dump_lock);
+    g_flight.closed = true;
+    rmutexUnlock(&g_flight.dump_lock);
+}
+
+void flight_recorder_write_json(JsonWriter* w) {
+    rmutexLock(&g_flight.lock);
+    json_begin_object(w);
+    json_field_u64(w, "capacity", g_flight.events ? FLIGHT_EVENTS_MAX : 0);
+    json_field_u64(w, "recorded", g_flight.recorded);
+    json_field_u64(w, "names", (u64)g_flight.name_count);
+    json_field_u64(w, "dumps", g_flight.dumps);
+    json_field_u64(w, "dump_failures", g_flight.dump_failures);
+    json_field_u64(w, "last_dump_ms", g_flight.last_dump_ms);
+    json_field_bool(w, "previous_kept", g_flight.previous_kept);
+    json_end_object(w);
+    rmutexUnlock(&g_flight.lock);
+}
@@ -1,23 +1,58 @@
 #include "http_server.h"
 
+#include "arena.h"
+#include "config.h"
+#include "demand.h"
+#include "flight_recorder.h"
+#include "init_sched.h"
+#include "ipc_trace.h"
+#include "watchdog.h"
 #include "logger.h"
+#include "mqtt.h"
+#include "push.h"
+#include "stats.h"
+#include "telemetry_trace.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
 #define SERVER_STACK_SIZE (64 * 1024)
-#define SERVER_THREAD_PRIO 0x2B
-#define SERVER_THREAD_CPUID -2
 #define ACCEPT_ERROR_REOPEN_THRESHOLD 32
 #define ACCEPT_ERRNO_NET_UNREACH 113
+#define HTTP_RESPONSE_MAX 4096
+#define HTTP_HEADER_RESERVE 256
+#define HTTP_LOG_CHUNK (8 * 1024)
+#define HTTP_STATS_CHUNK HTTP_LOG_CHUNK
+#define HTTP_REQUEST_MAX 1024
+#define HTTP_ROUTE_SLOTS 32 // power of two, at least twice the number of routes
+#define HTTP_PREFLIGHT_MAX_AGE_SEC 86400
+// One request buffer plus the largest response (a /log or /stats page).
+#define HTTP_ARENA_SIZE (HTTP_REQUEST_MAX + HTTP_HEADER_RESERVE + HTTP_LOG_CHUNK + 2 * ARENA_ALIGN)
+#define HTTP_ERROR_LOG_INTERVAL_MS 1000
+#define HTTP_OFFLINE_WAIT_NS (30ULL * 1000000000ULL) // safety net if a link-up is missed
+#define HTTP_REOPEN_RETRY_NS (1000ULL * 1000000ULL)
+#define HTTP_SELECT_TIMEOUT_NS (1000ULL * 1000000ULL) // thread mode: beat and check running this often
+#define HTTP_CLIENT_TIMEOUT_MS 2000 // reactor mode: a slow client must not hold up the main loop
+#define HTTP_RESTART_EXIT_TIMEOUT_NS (2000ULL * 1000000ULL)
+#define MAIN_STALL_GRACE_MS 10000
+
+static const char* const g_net_event_names[] = {
+    [HttpNetEvent_LinkDown] = "link_down",
+    [HttpNetEvent_LinkUp] = "link_up",
+    [HttpNetEvent_Wake] = "wake",
+};
 
 // Use static stack memory for sysmodule thread stability (avoid heap-backed stack alloc failures).
 static u8 g_http_thread_stack[SERVER_STACK_SIZE] __attribute__((aligned(0x1000)));
+// Per-connection buffers; owned by the server thread and released after each request.
+ARENA_DEFINE(g_http_arena, "http", HTTP_ARENA_SIZE);
 
 static bool http_server_open_listen_socket(HttpServer* server) {
     struct sockaddr_in addr;
@@ -32,7 +67,7 @@ static bool http_server_open_listen_socket(HttpServer* server) {
     if (server->listen_fd < 0) {
         server->last_errno = errno;
         server->stage = -1;
-        logger_write("http: socket failed errno=%d", errno);
+        LOG_ERROR("http: socket failed errno=%d", errno);
         return false;
     }
 
@@ -45,7 +80,7 @@ static bool http_server_open_listen_socket(HttpServer* server) {
     if (bind(server->listen_fd, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
         server->last_errno = errno;
         server->stage = -2;
-        logger_write("http: bind failed errno=%d", errno);
+        LOG_ERROR("http: bind failed errno=%d", errno);
         close(server->listen_fd);
         server->listen_fd = -1;
         return false;
@@ -55,7 +90,7 @@ static bool http_server_open_listen_socket(HttpServer* server) {
     if (listen(server->listen_fd, 4) < 0) {
         server->last_errno = errno;
         server->stage = -3;
-        logger_write("http: listen failed errno=%d", errno);
+        LOG_ERROR("http: listen failed errno=%d", errno);
         close(server->listen_fd);
         server->listen_fd = -1;
         return false;
@@ -63,29 +98,281 @@ static bool http_server_open_listen_socket(HttpServer* server) {
 
     server->listening = true;
     server->stage = 4; // serving
-    logger_write("http: listening on 0.0.0.0:%u", server->port);
+    LOG_INFO("http: listening on 0.0.0.0:%u", server->port);
     return true;
 }
 
-static void send_http_json(int client_fd, const char* json_body) {
-    char response[4096];
-    const int body_len = (int)strlen(json_body);
+typedef void (*JsonRenderFn)(void* ctx, JsonWriter* w);
+
+// A request with its parsed request line. path points into buf and stops
+// before any query string; it is not NUL-terminated.
+typedef struct {
+    int fd;
+    char* buf;
+    int len;
+    HttpMethod method;
+    const char* path;
+    size_t path_len;
+} HttpRequest;
+
+#define HTTP_METHOD_BIT(m) (1u << (m))
+#define HTTP_ALLOW_GET HTTP_METHOD_BIT(HttpMethod_Get) // HEAD is answered wherever GET is
+#define HTTP_ALLOW_POST HTTP_METHOD_BIT(HttpMethod_Post)
+#define HTTP_ALLOW_PUT HTTP_METHOD_BIT(HttpMethod_Put)
+// Methods a cross-origin page may be approved for in a preflight.
+#define HTTP_ALLOW_READ_ONLY (HTTP_ALLOW_GET | HTTP_METHOD_BIT(HttpMethod_Head) | HTTP_METHOD_BIT(HttpMethod_Options))
+
+static const char* const g_http_method_names[] = {
+    [HttpMethod_Get] = "GET",
+    [HttpMethod_Head] = "HEAD",
+    [HttpMethod_Post] = "POST",
+    [HttpMethod_Put] = "PUT",
+    [HttpMethod_Options] = "OPTIONS",
+};
+
+static void send_http_server_error(int client_fd) {
+    static const char response[] =
+        "HTTP/1.1 500 Internal Server Error\r\n"
+        "Connection: close\r\n"
+        "Content-Length: 0\r\n"
+        "\r\n";
+    send(client_fd, response, sizeof(response) - 1, 0);
+}
+
+// Writes the header into the HTTP_HEADER_RESERVE bytes in front of body so the
+// response goes out in a single send() without copying the body again.
+static void send_http_body(const HttpRequest* req, char* body, size_t body_len, const char* content_type, const char* extra_headers) {
+    char header[HTTP_HEADER_RESERVE];
+    int header_len = snprintf(
+        header,
+        sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "Access-Control-Allow-Origin: *\r\n"
+        "Connection: close\r\n"
+        "%s"
+        "Content-Length: %u\r\n"
+        "\r\n",
+        content_type,
+        extra_headers ? extra_headers : "",
+        (unsigned int)body_len
+    );
+    if (header_len < 0 || header_len >= (int)sizeof(header)) {
+        send_http_server_error(req->fd);
+        return;
+    }
+
+    memcpy(body - header_len, header, (size_t)header_len);
+    // HEAD gets the GET headers, Content-Length included, without the body.
+    send(req->fd, body - header_len, (size_t)header_len + (req->method == HttpMethod_Head ? 0 : body_len), 0);
+}
+
+static void send_http_json_sized(const HttpRequest* req, JsonRenderFn render, void* ctx, size_t response_max) {
+    char* response = (char*)arena_alloc(&g_http_arena, response_max);
+    char* body = response + HTTP_HEADER_RESERVE;
+    JsonWriter w;
+    size_t body_len;
+
+    if (!response) {
+        send_http_server_error(req->fd);
+        return;
+    }
+    json_writer_init(&w, body, response_max - HTTP_HEADER_RESERVE);
+    render(ctx, &w);
+    body_len = json_writer_finish(&w);
+    if (!json_writer_ok(&w)) {
+        LOG_WARN("http: response too large need=%u", (unsigned int)body_len);
+        send_http_server_error(req->fd);
+        return;
+    }
+
+    send_http_body(req, body, body_len, "application/json", NULL);
+}
+
+static void send_http_json(const HttpRequest* req, JsonRenderFn render, void* ctx) {
+    send_http_json_sized(req, render, ctx, HTTP_RESPONSE_MAX);
+}
+
+// Serves the in-memory log tail. Clients pass back X-Log-Next-Line as ?since=
+// to fetch only newer lines; X-Log-First-Line > since means lines were evicted.
+static void send_http_log(const HttpRequest* req, u64 since) {
+    char* response = (char*)arena_alloc(&g_http_arena, HTTP_HEADER_RESERVE + HTTP_LOG_CHUNK);
+    char* body = response + HTTP_HEADER_RESERVE;
+    char extra[160];
+    u64 first_line = 0;
+    u64 next_line = 0;
+    size_t body_len;
+
+    if (!response) {
+        send_http_server_error(req->fd);
+        return;
+    }
+    body_len = logger_read_recent(since, body, HTTP_LOG_CHUNK, &first_line, &next_line);
 
     snprintf(
+        extra,
+        sizeof(extra),
+        "X-Log-First-Line: %llu\r\n"
+        "X-Log-Next-Line: %llu\r\n"
+        "Access-Control-Expose-Headers: X-Log-First-Line, X-Log-Next-Line\r\n",
+        (unsigned long long)first_line,
+        (unsigned long long)next_line
+    );
+    send_http_body(req, body, body_len, "text/plain; charset=utf-8", extra);
+}
+
+// Returns the numeric value of key=<n> in the request-line query string.
+static u64 http_query_u64(const char* req, const char* key, u64 fallback) {
+    const char* query = strchr(req, '?');
+    const char* path = strchr(req, ' ');
+    const char* line_end = path ? strpbrk(path + 1, " \r\n") : NULL;
+    const size_t key_len = strlen(key);
+    u64 value = 0;
+
+    if (!query || (line_end && query > line_end)) {
+        return fallback;
+    }
+
+    query++;
+    while (*query && query != line_end) {
+        if (strncmp(query, key, key_len) == 0 && query[key_len] == '=') {
+            const char* p = query + key_len + 1;
+            if (*p < '0' || *p > '9') return fallback;
+            while (*p >= '0' && *p <= '9') {
+                value = value * 10 + (u64)(*p - '0');
+                p++;
+            }
+            return value;
+        }
+        while (*query && *query != '&' && query != line_end) query++;
+        if (*query == '&') query++;
+    }
+    return fallback;
+}
+
+// Copies the value of key=<text> in the request-line query string into out.
+static bool http_query_string(const char* req, const char* key, char* out, size_t out_size) {
+    const char* query = strchr(req, '?');
+    const char* path = strchr(req, ' ');
+    const char* line_end = path ? strpbrk(path + 1, " \r\n") : NULL;
+    const size_t key_len = strlen(key);
+
+    if (!query || (line_end && query > line_end)) {
+        return false;
+    }
+
+    query++;
+    while (*query && query != line_end) {
+        if (strncmp(query, key, key_len) == 0 && query[key_len] == '=') {
+            const char* p = query + key_len + 1;
+            size_t n = 0;
+            while (*p && *p != '&' && p != line_end && n + 1 < out_size) out[n++] = *p++;
+            out[n] = '\0';
+            return true;
+        }
+        while (*query && *query != '&' && query != line_end) query++;
+        if (*query == '&') query++;
+    }
+    return false;
+}
+
+// Reads the rest of a request body into req_buf after the initial recv().
+// On success *body points at the NUL-terminated body inside req_buf.
+static bool http_read_body(int client_fd, char* req_buf, size_t cap, int* req_len, char** body, size_t* body_len) {
+    char* header_end = strstr(req_buf, "\r\n\r\n");
+    const char* line;
+    size_t content_length = 0;
+    size_t have;
+
+    if (!header_end) return false;
+    for (line = strstr(req_buf, "\r\n"); line && line < header_end; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+            content_length = (size_t)strtoul(line + 17, NULL, 10);
+            break;
+        }
+    }
+
+    *body = header_end + 4;
+    if ((size_t)(*body - req_buf) + content_length >= cap) return false;
+
+    have = (size_t)(req_buf + *req_len - *body);
+    while (have < content_length) {
+        const int n = recv(client_fd, req_buf + *req_len, content_length - have, 0);
+        if (n <= 0) return false;
+        *req_len += n;
+        have += (size_t)n;
+    }
+    req_buf[*req_len] = '\0';
+    *body_len = content_length;
+    return true;
+}
+
+static void send_http_text_status(const HttpRequest* req, const char* status, const char* text) {
+    char response[HTTP_HEADER_RESERVE + 128];
+    const int len = snprintf(
         response,
         sizeof(response),
-        "HTTP/1.1 200 OK\r\n"
-        "Content-Type: application/json\r\n"
+        "HTTP/1.1 %s\r\n"
+        "Content-Type: text/plain; charset=utf-8\r\n"
         "Access-Control-Allow-Origin: *\r\n"
         "Connection: close\r\n"
-        "Content-Length: %d\r\n"
+        "Content-Length: %u\r\n"
         "\r\n"
-        "%s",
-        body_len,
-        json_body
+        "%s\n",
+        status,
+        (unsigned int)strlen(text) + 1,
+        text
     );
+    if (len > 0 && len < (int)sizeof(response)) {
+        send(req->fd, response, (size_t)len - (req->method == HttpMethod_Head ? strlen(text) + 1 : 0), 0);
+    }
+}
+
+static void render_config_json(void* ctx, JsonWriter* w) {
+    (void)ctx;
+    config_write_json(w);
+}
 
-    send(client_fd, response, strlen(response), 0);
+static void render_state_json(void* ctx, JsonWriter* w) {
+    telemetry_write_json((TelemetryState*)ctx, w);
+}
+
+static void render_probe_json(void* ctx, JsonWriter* w) {
+    telemetry_write_probe_json((TelemetryState*)ctx, w);
+}
+
+static void render_memory_json(void* ctx, JsonWriter* w) {
+    (void)ctx;
+    memory_write_json(w);
+}
+
+static void render_boot_json(void* ctx, JsonWriter* w) {
+    (void)ctx;
+    init_sched_write_json(w);
+}
+
+static void render_timings_json(void* ctx, JsonWriter* w) {
+    (void)ctx;
+    ipc_trace_write_json(w);
+}
+
+static void render_subscriber_json(void* ctx, JsonWriter* w) {
+    push_write_subscriber_json((const PushSubscriber*)ctx, w);
+}
+
+typedef struct {
+    StatsResolution res;
+    u64 from;
+    u64 to;
+} HttpStatsQuery;
+
+static void render_stats_json(void* ctx, JsonWriter* w) {
+    const HttpStatsQuery* q = (const HttpStatsQuery*)ctx;
+    stats_write_query_json(w, q->res, q->from, q->to, HTTP_STATS_CHUNK);
+}
+
+static void render_debug_json(void* ctx, JsonWriter* w) {
+    http_server_write_debug_json((const HttpServer*)ctx, w);
 }
 
 static void send_http_not_found(int client_fd) {
@@ -97,128 +384,533 @@ static void send_http_not_found(int client_fd) {
     send(client_fd, response, sizeof(response) - 1, 0);
 }
 
-static void server_handle_client(HttpServer* server, int client_fd) {
-    char req_buf[1024];
-    int recv_len = recv(client_fd, req_buf, sizeof(req_buf) - 1, 0);
-    if (recv_len < 0) {
-        logger_write("http: recv failed errno=%d", errno);
+// Writes the methods in mask as a comma-separated list.
+static void http_format_methods(char* out, size_t out_size, u32 mask) {
+    size_t len = 0;
+    int method;
+
+    out[0] = '\0';
+    for (method = HttpMethod_Unknown + 1; method < HttpMethod_Count; method++) {
+        if ((mask & HTTP_METHOD_BIT(method)) && len < out_size) {
+            len += (size_t)snprintf(out + len, out_size - len, "%s%s", len ? ", " : "", g_http_method_names[method]);
+        }
+    }
+}
+
+// Sends a bodiless 204 answer to a CORS preflight, or a 405, listing the
+// path's methods. Cross-origin approval covers only the read-only methods, so
+// a web page cannot PUT /config; a path without GET gets none. Max-Age lets
+// browsers reuse the preflight answer instead of repeating it before every
+// request.
+static void send_http_allow(int client_fd, bool preflight, u32 allowed) {
+    const u32 cors_methods = allowed & HTTP_ALLOW_READ_ONLY;
+    char allow[48];
+    char cors[HTTP_HEADER_RESERVE];
+    char response[HTTP_HEADER_RESERVE + 64];
+    int len;
+
+    http_format_methods(allow, sizeof(allow), allowed);
+    cors[0] = '\0';
+    if (preflight && (cors_methods & HTTP_ALLOW_GET)) {
+        char methods[48];
+
+        http_format_methods(methods, sizeof(methods), cors_methods);
+        snprintf(
+            cors,
+            sizeof(cors),
+            "Access-Control-Allow-Origin: *\r\n"
+            "Access-Control-Allow-Methods: %s\r\n"
+            "Access-Control-Allow-Headers: *\r\n"
+            "Access-Control-Max-Age: %d\r\n",
+            methods,
+            HTTP_PREFLIGHT_MAX_AGE_SEC
+        );
+    }
+    len = snprintf(
+        response,
+        sizeof(response),
+        "HTTP/1.1 %s\r\n"
+        "Allow: %s\r\n"
+        "%s"
+        "Connection: close\r\n"
+        "%s"
+        "\r\n",
+        preflight ? "204 No Content" : "405 Method Not Allowed",
+        allow,
+        cors,
+        preflight ? "" : "Content-Length: 0\r\n"
+    );
+    if (len > 0 && len < (int)sizeof(response)) {
+        send(client_fd, response, (size_t)len, 0);
+    }
+}
+
+// Splits "<method> <path>[?query] ..." at the start of buf.
+static bool http_parse_request_line(const char* buf, HttpMethod* method, const char** path, size_t* path_len) {
+    const size_t method_len = strcspn(buf, " \r\n");
+    int m;
+
+    if (method_len == 0 || buf[method_len] != ' ') return false;
+    *method = HttpMethod_Unknown;
+    for (m = HttpMethod_Unknown + 1; m < HttpMethod_Count; m++) {
+        if (strlen(g_http_method_names[m]) == method_len && memcmp(buf, g_http_method_names[m], method_len) == 0) {
+            *method = (HttpMethod)m;
+            break;
+        }
+    }
+    *path = buf + method_len + 1;
+    *path_len = strcspn(*path, " ?\r\n");
+    return *path_len > 0;
+}
+
+static void handle_state(HttpServer* server, HttpRequest* req) {
+    send_http_json(req, render_state_json, server->telemetry);
+}
+
+static void handle_debug(HttpServer* server, HttpRequest* req) {
+    send_http_json(req, render_debug_json, server);
+}
+
+static void handle_debug_probes(HttpServer* server, HttpRequest* req) {
+    send_http_json(req, render_probe_json, server->telemetry);
+}
+
+static void handle_debug_memory(HttpServer* server, HttpRequest* req) {
+    (void)server;
+    send_http_json(req, render_memory_json, NULL);
+}
+
+static void handle_debug_boot(HttpServer* server, HttpRequest* req) {
+    (void)server;
+    send_http_json(req, render_boot_json, NULL);
+}
+
+static void handle_debug_timings(HttpServer* server, HttpRequest* req) {
+    (void)server;
+    send_http_json(req, render_timings_json, NULL);
+}
+
+static void handle_log(HttpServer* server, HttpRequest* req) {
+    (void)server;
+    send_http_log(req, http_query_u64(req->buf, "since", 0));
+}
+
+static void handle_config_get(HttpServer* server, HttpRequest* req) {
+    (void)server;
+    send_http_json(req, render_config_json, NULL);
+}
+
+static void handle_config_put(HttpServer* server, HttpRequest* req) {
+    char* body;
+    size_t body_len;
+    char err[96];
+
+    (void)server;
+    if (!http_read_body(req->fd, req->buf, HTTP_REQUEST_MAX, &req->len, &body, &body_len)) {
+        send_http_text_status(req, "413 Payload Too Large", "config update must be a complete request under 1 KB");
+        return;
+    }
+    if (!config_update(body, body_len, err, sizeof(err))) {
+        send_http_text_status(req, "400 Bad Request", err);
+        return;
+    }
+    send_http_json(req, render_config_json, NULL);
+}
+
+static void handle_subscribe(HttpServer* server, HttpRequest* req) {
+    char* body;
+    size_t body_len;
+    char err[96];
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    PushSubscriber sub;
+    bool busy;
+
+    (void)server;
+    if (!http_read_body(req->fd, req->buf, HTTP_REQUEST_MAX, &req->len, &body, &body_len)) {
+        send_http_text_status(req, "413 Payload Too Large", "subscription must be a complete request under 1 KB");
+        return;
+    }
+    memset(&peer, 0, sizeof(peer));
+    if (getpeername(req->fd, (struct sockaddr*)&peer, &peer_len) != 0) peer.sin_addr.s_addr = 0;
+    if (!push_subscribe(body, body_len, peer.sin_addr.s_addr, &sub, &busy, err, sizeof(err))) {
+        send_http_text_status(req, busy ? "503 Service Unavailable" : "400 Bad Request", err);
+        return;
+    }
+    send_http_json(req, render_subscriber_json, &sub);
+}
+
+static void handle_stats(HttpServer* server, HttpRequest* req) {
+    HttpStatsQuery q;
+    char res[16];
+
+    (void)server;
+    q.res = StatsResolution_Hour;
+    if (http_query_string(req->buf, "resolution", res, sizeof(res)) && !stats_resolution_parse(res, &q.res)) {
+        send_http_text_status(req, "400 Bad Request", "resolution must be minute, hour or day");
         return;
     }
+    q.from = http_query_u64(req->buf, "from", 0);
+    q.to = http_query_u64(req->buf, "to", UINT64_MAX);
+    if (q.from >= q.to) {
+        send_http_text_status(req, "400 Bad Request", "from must be before to (unix seconds)");
+        return;
+    }
+    if (!stats_available()) {
+        send_http_text_status(req, "503 Service Unavailable", "stats store is not open (no SD card or clock)");
+        return;
+    }
+    send_http_json_sized(req, render_stats_json, &q, HTTP_HEADER_RESERVE + HTTP_STATS_CHUNK);
+}
+
+typedef void (*HttpHandlerFn)(HttpServer* server, HttpRequest* req);
+
+typedef struct {
+    const char* path;
+    u32 methods; // HTTP_ALLOW_* mask
+    HttpRoute route;
+    HttpHandlerFn handler;
+    bool fresh; // renders telemetry: refresh it first if sampling is idle
+} HttpRouteDef;
+
+// Rows that share a path must be adjacent; the index points at the first.
+static const HttpRouteDef g_http_routes[] = {
+    { "/", HTTP_ALLOW_GET, HttpRoute_State, handle_state, true },
+    { "/state", HTTP_ALLOW_GET, HttpRoute_State, handle_state, true },
+    { "/debug", HTTP_ALLOW_GET, HttpRoute_Debug, handle_debug, false },
+    { "/debug/probes", HTTP_ALLOW_GET, HttpRoute_DebugProbes, handle_debug_probes, true },
+    { "/debug/memory", HTTP_ALLOW_GET, HttpRoute_DebugMemory, handle_debug_memory, false },
+    { "/debug/boot", HTTP_ALLOW_GET, HttpRoute_DebugBoot, handle_debug_boot, false },
+    { "/debug/timings", HTTP_ALLOW_GET, HttpRoute_DebugTimings, handle_debug_timings, false },
+    { "/log", HTTP_ALLOW_GET, HttpRoute_Log, handle_log, false },
+    { "/config", HTTP_ALLOW_GET, HttpRoute_ConfigGet, handle_config_get, false },
+    { "/config", HTTP_ALLOW_PUT, HttpRoute_ConfigPut, handle_config_put, false },
+    { "/subscribe", HTTP_ALLOW_POST, HttpRoute_Subscribe, handle_subscribe, true },
+    { "/stats", HTTP_ALLOW_GET, HttpRoute_Stats, handle_stats, false },
+};
+
+#define HTTP_ROUTE_COUNT (sizeof(g_http_routes) / sizeof(g_http_routes[0]))
+_Static_assert(HTTP_ROUTE_COUNT * 2 <= HTTP_ROUTE_SLOTS, "grow HTTP_ROUTE_SLOTS");
+
+// Open-addressed FNV-1a index from a path to 1 + its first row (0 = empty),
+// so a lookup hashes the path once whatever the number of routes.
+static u8 g_http_route_index[HTTP_ROUTE_SLOTS];
+static bool g_http_route_index_ready;
+
+static u32 http_path_hash(const char* path, size_t len) {
+    u32 hash = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (u8)path[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void http_router_build(void) {
+    size_t i;
+
+    memset(g_http_route_index, 0, sizeof(g_http_route_index));
+    for (i = 0; i < HTTP_ROUTE_COUNT; i++) {
+        const char* path = g_http_routes[i].path;
+        u32 slot;
+
+        if (i > 0 && strcmp(path, g_http_routes[i - 1].path) == 0) continue;
+        slot = http_path_hash(path, strlen(path)) & (HTTP_ROUTE_SLOTS - 1);
+        while (g_http_route_index[slot] != 0) slot = (slot + 1) & (HTTP_ROUTE_SLOTS - 1);
+        g_http_route_index[slot] = (u8)(i + 1);
+    }
+    g_http_route_index_ready = true;
+}
+
+// Returns the row serving method on path (HEAD uses the GET row). *allowed
+// gets every method the path answers, OPTIONS included, or 0 for an unknown
+// path; NULL with a nonzero *allowed means the method is not one of them.
+static const HttpRouteDef* http_router_lookup(HttpMethod method, const char* path, size_t path_len, u32* allowed) {
+    const HttpMethod want = method == HttpMethod_Head ? HttpMethod_Get : method;
+    const HttpRouteDef* found = NULL;
+    u32 slot;
+
+    if (!g_http_route_index_ready) http_router_build();
+    *allowed = 0;
+    slot = http_path_hash(path, path_len) & (HTTP_ROUTE_SLOTS - 1);
+    while (g_http_route_index[slot] != 0) {
+        size_t i = g_http_route_index[slot] - 1u;
+        const char* row_path = g_http_routes[i].path;
+
+        if (strncmp(row_path, path, path_len) == 0 && row_path[path_len] == '\0') {
+            for (; i < HTTP_ROUTE_COUNT && strcmp(g_http_routes[i].path, row_path) == 0; i++) {
+                *allowed |= g_http_routes[i].methods;
+                if (g_http_routes[i].methods & HTTP_METHOD_BIT(want)) found = &g_http_routes[i];
+            }
+            if (*allowed & HTTP_ALLOW_GET) *allowed |= HTTP_METHOD_BIT(HttpMethod_Head);
+            *allowed |= HTTP_METHOD_BIT(HttpMethod_Options);
+            return found;
+        }
+        slot = (slot + 1) & (HTTP_ROUTE_SLOTS - 1);
+    }
+    return NULL;
+}
+
+HttpRoute http_server_match_route(const char* request) {
+    HttpMethod method;
+    const char* path;
+    size_t path_len;
+    const HttpRouteDef* route;
+    u32 allowed;
+
+    if (!http_parse_request_line(request, &method, &path, &path_len)) return HttpRoute_NotFound;
+    route = http_router_lookup(method, path, path_len, &allowed);
+    return route ? route->route : HttpRoute_NotFound;
+}
+
+// Returns the matched route's path for the flight recorder, or NULL.
+static const char* server_route(HttpServer* server, int client_fd, char* req_buf, int recv_len, HttpMethod* method) {
+    HttpRequest req;
+    const HttpRouteDef* route;
+    u32 allowed;
 
     req_buf[recv_len] = '\0';
     server->request_count++;
 
-    if (strncmp(req_buf, "GET /debug", 10) == 0) {
-        char json_body[1024];
-        http_server_build_debug_json(server, json_body, sizeof(json_body));
-        send_http_json(client_fd, json_body);
-        return;
+    req.fd = client_fd;
+    req.buf = req_buf;
+    req.len = recv_len;
+    if (!http_parse_request_line(req_buf, &req.method, &req.path, &req.path_len)) {
+        req.method = HttpMethod_Unknown;
+        send_http_text_status(&req, "400 Bad Request", "malformed request line");
+        return NULL;
     }
+    *method = req.method;
 
-    if (strncmp(req_buf, "GET /state", 10) != 0 && strncmp(req_buf, "GET / ", 6) != 0) {
+    route = http_router_lookup(req.method, req.path, req.path_len, &allowed);
+    demand_note_request(route && route->fresh);
+    if (allowed == 0) {
         send_http_not_found(client_fd);
+    } else if (req.method == HttpMethod_Options) {
+        server->preflight_count++;
+        send_http_allow(client_fd, true, allowed);
+    } else if (!route) {
+        server->method_not_allowed_count++;
+        send_http_allow(client_fd, false, allowed);
+    } else {
+        route->handler(server, &req);
+    }
+    return route ? route->path : NULL;
+}
+
+static void server_handle_client(HttpServer* server, int client_fd) {
+    const size_t mark = arena_mark(&g_http_arena);
+    char* req_buf = (char*)arena_alloc(&g_http_arena, HTTP_REQUEST_MAX);
+    const u64 start_tick = armGetSystemTick();
+    HttpMethod method = HttpMethod_Unknown;
+    const char* path = NULL;
+    u64 us;
+    int recv_len;
+
+    if (!req_buf) {
+        send_http_server_error(client_fd);
         return;
     }
+    recv_len = recv(client_fd, req_buf, HTTP_REQUEST_MAX - 1, 0);
+    if (recv_len < 0) {
+        LOG_WARN_RATELIMITED(HTTP_ERROR_LOG_INTERVAL_MS, "http: recv failed errno=%d", errno);
+    } else {
+        path = server_route(server, client_fd, req_buf, recv_len, &method);
+    }
+    us = armTicksToNs(armGetSystemTick() - start_tick) / 1000ULL;
+    flight_recorder_record(FlightEventType_Request, path, (u16)method, us > 0xFFFFFFFFULL ? 0xFFFFFFFFu : (u32)us);
+    arena_release(&g_http_arena, mark);
+}
 
-    {
-        char json_body[2048];
-        telemetry_build_json(server->telemetry, json_body, sizeof(json_body));
-        send_http_json(client_fd, json_body);
+static u64 http_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static void http_server_close_listen_socket(HttpServer* server) {
+    server->listening = false;
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+        server->listen_fd = -1;
     }
 }
 
-static void http_server_thread(void* arg) {
-    HttpServer* server = (HttpServer*)arg;
-    int accept_error_streak = 0;
+// Completes a pending rebind once the listen socket is back.
+static void http_server_record_rebind(HttpServer* server) {
+    u64 rebind_ms;
 
-    if (!http_server_open_listen_socket(server)) {
+    rmutexLock(&server->net_lock);
+    if (!server->rebind_pending) {
+        rmutexUnlock(&server->net_lock);
         return;
     }
+    server->rebind_pending = false;
+    rebind_ms = http_now_ms() - server->rebind_requested_ms;
+    if (rebind_ms == 0) rebind_ms = 1;
+    server->history[(server->transition_count - 1) % HTTP_NET_HISTORY].rebind_ms = rebind_ms;
+    server->rebind_count++;
+    if (rebind_ms > server->max_rebind_ms) server->max_rebind_ms = rebind_ms;
+    rmutexUnlock(&server->net_lock);
 
-    while (server->running) {
-        fd_set readfds;
-        struct timeval timeout;
-        int sel_rc;
-
-        FD_ZERO(&readfds);
-        FD_SET(server->listen_fd, &readfds);
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
-
-        sel_rc = select(server->listen_fd + 1, &readfds, NULL, NULL, &timeout);
-        if (sel_rc < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            server->last_errno = errno;
-            server->stage = -4;
-            logger_write("http: select failed errno=%d", errno);
-            break;
+    LOG_INFO("http: rebound after network transition in %llums", (unsigned long long)rebind_ms);
+}
+
+// The server thread also watches the main loop, which cannot restart itself.
+static void http_server_check_main_loop(void) {
+    Config cfg;
+
+    config_get(&cfg);
+    // The main loop's periodic dump stops with it; keep what led up to the stall.
+    if (watchdog_check(Watchdog_MainLoop, 3ULL * (u64)cfg.loop_interval_ms + MAIN_STALL_GRACE_MS)) {
+        flight_recorder_dump(FlightDumpReason_Stall);
+    }
+}
+
+// In reactor mode the listener's waits are the main loop's waits.
+static void http_server_count_wake(const HttpServer* server) {
+    watchdog_count_wake(server->reactor ? Watchdog_MainLoop : Watchdog_Http);
+}
+
+static void http_server_set_client_timeouts(int client_fd) {
+    struct timeval tv;
+
+    tv.tv_sec = HTTP_CLIENT_TIMEOUT_MS / 1000;
+    tv.tv_usec = (HTTP_CLIENT_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// One pass of the listener: parks up to park_ns while offline, (re)opens the
+// socket, then waits up to wait_ns for a connection and serves it. Returns
+// false when select fails.
+static bool http_server_step(HttpServer* server, u64 wait_ns, u64 park_ns) {
+    fd_set readfds;
+    struct timeval timeout;
+    int sel_rc;
+
+    watchdog_beat(Watchdog_Http, server->offline ? "offline" : "select");
+    if (!server->reactor) http_server_check_main_loop();
+
+    // Offline or asleep: drop the socket and block until the monitor reports the link back.
+    if (server->offline) {
+        http_server_close_listen_socket(server);
+        waitSingle(waiterForUEvent(&server->net_event), park_ns);
+        http_server_count_wake(server);
+        return true;
+    }
+    if (server->rebind_pending && server->listen_fd >= 0) {
+        http_server_close_listen_socket(server);
+    }
+    if (server->listen_fd < 0) {
+        if (!http_server_open_listen_socket(server)) {
+            waitSingle(waiterForUEvent(&server->net_event), wait_ns < HTTP_REOPEN_RETRY_NS ? wait_ns : HTTP_REOPEN_RETRY_NS);
+            http_server_count_wake(server);
+            return true;
         }
-        if (sel_rc == 0 || !FD_ISSET(server->listen_fd, &readfds)) {
-            continue;
+        server->accept_error_streak = 0;
+        http_server_record_rebind(server);
+    }
+
+    FD_ZERO(&readfds);
+    FD_SET(server->listen_fd, &readfds);
+    timeout.tv_sec = (time_t)(wait_ns / 1000000000ULL);
+    timeout.tv_usec = (suseconds_t)((wait_ns % 1000000000ULL) / 1000ULL);
+
+    sel_rc = select(server->listen_fd + 1, &readfds, NULL, NULL, &timeout);
+    http_server_count_wake(server);
+    if (sel_rc < 0) {
+        if (errno == EINTR) {
+            return true;
         }
+        server->last_errno = errno;
+        server->stage = -4;
+        snprintf(server->exit_reason, sizeof(server->exit_reason), "select failed errno=%d", errno);
+        LOG_ERROR("http: %s", server->exit_reason);
+        return false;
+    }
+    if (sel_rc == 0 || !FD_ISSET(server->listen_fd, &readfds)) {
+        return true;
+    }
 
-        {
-            int client_fd = accept(server->listen_fd, NULL, NULL);
-            if (client_fd < 0) {
-                if (errno != EINTR) {
-                    const int accept_errno = errno;
-                    server->last_errno = errno;
-                    server->stage = -5;
-                    logger_write("http: accept failed errno=%d", accept_errno);
-                    accept_error_streak++;
-
-                    if (accept_errno == ACCEPT_ERRNO_NET_UNREACH || accept_error_streak >= ACCEPT_ERROR_REOPEN_THRESHOLD) {
-                        logger_write(
-                            "http: recover-v2 reopen accept_errno=%d streak=%d",
-                            accept_errno,
-                            accept_error_streak
-                        );
-                        accept_error_streak = 0;
-                        server->listening = false;
-                        if (server->listen_fd >= 0) {
-                            close(server->listen_fd);
-                            server->listen_fd = -1;
-                        }
-                        svcSleepThread(500ULL * 1000000ULL);
-                        if (!http_server_open_listen_socket(server)) {
-                            svcSleepThread(1000ULL * 1000000ULL);
-                        }
-                    }
+    {
+        int client_fd = accept(server->listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            if (errno != EINTR) {
+                const int accept_errno = errno;
+                server->last_errno = errno;
+                server->stage = -5;
+                LOG_WARN_RATELIMITED(HTTP_ERROR_LOG_INTERVAL_MS, "http: accept failed errno=%d", accept_errno);
+                server->accept_error_streak++;
+                flight_recorder_record(
+                    FlightEventType_AcceptError, NULL, (u16)server->accept_error_streak, (u32)accept_errno
+                );
+
+                // Fallback for transitions the link monitor did not see.
+                if (accept_errno == ACCEPT_ERRNO_NET_UNREACH || server->accept_error_streak >= ACCEPT_ERROR_REOPEN_THRESHOLD) {
+                    LOG_WARN(
+                        "http: recover-v2 reopen accept_errno=%d streak=%d",
+                        accept_errno,
+                        server->accept_error_streak
+                    );
+                    http_server_close_listen_socket(server);
                 }
-                continue;
             }
-
-            accept_error_streak = 0;
-            server->accepted_count++;
-            server_handle_client(server, client_fd);
-            close(client_fd);
+            return true;
         }
+
+        server->accept_error_streak = 0;
+        server->accepted_count++;
+        watchdog_beat(Watchdog_Http, "client");
+        if (server->reactor) http_server_set_client_timeouts(client_fd);
+        server->client_fd = client_fd;
+        server_handle_client(server, client_fd);
+        server->client_fd = -1;
+        close(client_fd);
     }
+    return true;
+}
 
-    server->listening = false;
-    if (server->listen_fd >= 0) {
-        close(server->listen_fd);
-        server->listen_fd = -1;
+static void http_server_thread(void* arg) {
+    HttpServer* server = (HttpServer*)arg;
+
+    server->accept_error_streak = 0;
+    while (server->running) {
+        if (!http_server_step(server, HTTP_SELECT_TIMEOUT_NS, HTTP_OFFLINE_WAIT_NS)) {
+            server->exited = true;
+            break;
+        }
     }
 
-    logger_write("http: thread stopped");
+    http_server_close_listen_socket(server);
+    LOG_INFO("http: thread stopped");
 }
 
-bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port) {
+void http_server_poll(HttpServer* server, u64 wait_ns) {
+    if (http_server_step(server, wait_ns, wait_ns)) return;
+
+    // No thread to restart: rebuild the socket on a later pass instead.
+    http_server_close_listen_socket(server);
+    watchdog_record_restart(Watchdog_Http, true);
+    waitSingle(waiterForUEvent(&server->net_event), wait_ns < HTTP_REOPEN_RETRY_NS ? wait_ns : HTTP_REOPEN_RETRY_NS);
+    http_server_count_wake(server);
+}
+
+static bool http_server_spawn(HttpServer* server) {
+    Config cfg;
     Result rc;
 
-    memset(server, 0, sizeof(*server));
-    server->telemetry = telemetry;
+    config_get_boot(&cfg); // the thread keys are restart-only, even across watchdog restarts
     server->running = true;
+    server->exited = false;
+    server->exit_reason[0] = '\0';
     server->listen_fd = -1;
-    server->port = port;
-    server->accepted_count = 0;
-    server->request_count = 0;
-    server->last_errno = 0;
-    server->stage = 0;
+    server->client_fd = -1;
     server->listening = false;
+    watchdog_beat(Watchdog_Http, "start");
+    arena_release(&g_http_arena, 0); // a restarted thread may have died mid-request
+    if (server->reactor) return true;
+    memory_register_stack("http", g_http_thread_stack, SERVER_STACK_SIZE);
 
     rc = threadCreate(
         &server->thread,
@@ -226,15 +918,15 @@ bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned s
         server,
         g_http_thread_stack,
         SERVER_STACK_SIZE,
-        SERVER_THREAD_PRIO,
-        SERVER_THREAD_CPUID
+        cfg.http_thread_prio,
+        cfg.http_thread_cpuid
     );
     if (R_FAILED(rc)) {
-        logger_write(
+        LOG_ERROR(
             "http: threadCreate failed rc=0x%08lX prio=%d cpuid=%d",
             (unsigned long)rc,
-            SERVER_THREAD_PRIO,
-            SERVER_THREAD_CPUID
+            (int)cfg.http_thread_prio,
+            (int)cfg.http_thread_cpuid
         );
         server->running = false;
         return false;
@@ -242,50 +934,193 @@ bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned s
 
     rc = threadStart(&server->thread);
     if (R_FAILED(rc)) {
-        logger_write("http: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        LOG_ERROR("http: threadStart failed rc=0x%08lX", (unsigned long)rc);
         threadClose(&server->thread);
         server->running = false;
         return false;
     }
 
+    server->thread_live = true;
     return true;
 }
 
+bool http_server_start(HttpServer* server, TelemetryState* telemetry, unsigned short port, bool reactor) {
+    arena_register(&g_http_arena);
+    http_router_build();
+    memset(server, 0, sizeof(*server));
+    server->telemetry = telemetry;
+    server->port = port;
+    server->reactor = reactor;
+    ueventCreate(&server->net_event, true);
+    rmutexInit(&server->net_lock);
+    return http_server_spawn(server);
+}
+
+bool http_server_restart(HttpServer* server) {
+    const int listen_fd = server->listen_fd;
+    const int client_fd = server->client_fd;
+
+    server->running = false;
+    ueventSignal(&server->net_event);
+    // Kick the thread out of a blocking accept/recv/send.
+    if (listen_fd >= 0) shutdown(listen_fd, SHUT_RDWR);
+    if (client_fd >= 0) shutdown(client_fd, SHUT_RDWR);
+
+    if (server->thread_live) {
+        if (R_FAILED(waitSingleHandle(server->thread.handle, HTTP_RESTART_EXIT_TIMEOUT_NS))) {
+            // Still running on g_http_thread_stack; a second thread cannot share it.
+            LOG_ERROR("http: restart aborted, server thread did not exit");
+            return false;
+        }
+        threadClose(&server->thread);
+        server->thread_live = false;
+    }
+    http_server_close_listen_socket(server);
+
+    LOG_WARN("http: restarting server thread");
+    return http_server_spawn(server);
+}
+
 void http_server_stop(HttpServer* server) {
     if (!server->running) {
         return;
     }
 
     server->running = false;
+    if (server->reactor) {
+        http_server_close_listen_socket(server);
+        return;
+    }
+    ueventSignal(&server->net_event);
     if (server->listen_fd >= 0) {
         shutdown(server->listen_fd, SHUT_RDWR);
     }
 
     threadWaitForExit(&server->thread);
     threadClose(&server->thread);
+    server->thread_live = false;
 }
 
-void http_server_build_debug_json(const HttpServer* server, char* out, size_t out_size) {
-    snprintf(
-        out,
-        out_size,
-        "{"
-        "\"running\":%s,"
-        "\"listening\":%s,"
-        "\"stage\":%d,"
-        "\"listen_fd\":%d,"
-        "\"port\":%u,"
-        "\"accepted_count\":%llu,"
-        "\"request_count\":%llu,"
-        "\"last_errno\":%d"
-        "}",
-        server->running ? "true" : "false",
-        server->listening ? "true" : "false",
-        server->stage,
-        server->listen_fd,
-        (unsigned int)server->port,
-        (unsigned long long)server->accepted_count,
-        (unsigned long long)server->request_count,
-        server->last_errno
+void http_server_notify_network(HttpServer* server, HttpNetEvent event) {
+    const u64 now = http_now_ms();
+    HttpNetTransition* t;
+
+    if (!server->running) {
+        return;
+    }
+
+    rmutexLock(&server->net_lock);
+    if (event == HttpNetEvent_LinkDown) {
+        if (!server->offline) {
+            server->offline = true;
+            server->offline_since_ms = now;
+        }
+        rmutexUnlock(&server->net_lock);
+        LOG_INFO("http: link down, listener parked");
+        ueventSignal(&server->net_event);
+        return;
+    }
+
+    t = &server->history[server->transition_count % HTTP_NET_HISTORY];
+    memset(t, 0, sizeof(*t));
+    t->event = (u8)event;
+    t->at_ms = now;
+    if (server->offline) {
+        t->outage_ms = now - server->offline_since_ms;
+    }
+    server->transition_count++;
+    server->offline = false;
+    server->rebind_pending = true;
+    server->rebind_requested_ms = now;
+    rmutexUnlock(&server->net_lock);
+
+    LOG_INFO(
+        "http: %s, rebinding (outage=%llums)",
+        g_net_event_names[event],
+        (unsigned long long)t->outage_ms
     );
+    ueventSignal(&server->net_event);
+}
+
+void http_server_write_debug_json(const HttpServer* server, JsonWriter* w) {
+    LoggerStats log_stats;
+
+    logger_get_stats(&log_stats);
+
+    json_begin_object(w);
+    json_field_bool(w, "running", server->running);
+    json_field_bool(w, "reactor", server->reactor);
+    json_field_bool(w, "listening", server->listening);
+    json_field_s64(w, "stage", server->stage);
+    json_field_s64(w, "listen_fd", server->listen_fd);
+    json_field_u64(w, "port", server->port);
+    json_field_u64(w, "accepted_count", server->accepted_count);
+    json_field_u64(w, "request_count", server->request_count);
+    json_field_u64(w, "preflight_count", server->preflight_count);
+    json_field_u64(w, "method_not_allowed_count", server->method_not_allowed_count);
+    json_field_s64(w, "last_errno", server->last_errno);
+    json_field_bool(w, "exited", server->exited);
+    json_field_string(w, "exit_reason", server->exit_reason);
+    json_key(w, "watchdog");
+    watchdog_write_json(w);
+    json_key(w, "trace");
+    telemetry_trace_write_json(w);
+    json_key(w, "push");
+    push_write_json(w);
+    json_key(w, "mqtt");
+    mqtt_write_json(w);
+    json_key(w, "stats");
+    stats_write_json(w);
+    json_key(w, "demand");
+    demand_write_json(w);
+    json_key(w, "flight");
+    flight_recorder_write_json(w);
+    json_key(w, "network");
+    rmutexLock((RMutex*)&server->net_lock);
+    json_begin_object(w);
+    json_field_bool(w, "offline", server->offline);
+    json_field_u64(w, "transitions", server->transition_count);
+    json_field_u64(w, "rebinds", server->rebind_count);
+    json_field_u64(w, "max_rebind_ms", server->max_rebind_ms);
+    json_key(w, "recent");
+    json_begin_array(w);
+    {
+        const u64 count = server->transition_count < HTTP_NET_HISTORY ? server->transition_count : HTTP_NET_HISTORY;
+        u64 i;
+        for (i = 0; i < count; i++) {
+            const HttpNetTransition* t = &server->history[(server->transition_count - 1 - i) % HTTP_NET_HISTORY];
+            json_begin_object(w);
+            json_field_string(w, "event", g_net_event_names[t->event]);
+            json_field_u64(w, "at_ms", t->at_ms);
+            json_field_u64(w, "outage_ms", t->outage_ms);
+            json_field_u64(w, "rebind_ms", t->rebind_ms);
+            json_end_object(w);
+        }
+    }
+    json_end_array(w);
+    json_end_object(w);
+    rmutexUnlock((RMutex*)&server->net_lock);
+    json_key(w, "logger");
+    json_begin_object(w);
+    json_field_u64(w, "queued", log_stats.queued_lines);
+    json_field_u64(w, "written", log_stats.written_lines);
+    json_field_u64(w, "dropped", log_stats.dropped_lines);
+    json_field_u64(w, "pending", log_stats.pending_lines);
+    json_field_u64(w, "flushes", log_stats.flush_count);
+    json_field_u64(w, "bytes", log_stats.bytes_written);
+    json_field_u64(w, "rotations", log_stats.rotation_count);
+    json_field_bool(w, "binary", log_stats.binary);
+    json_field_u64(w, "suppressed", log_stats.suppressed_lines);
+    json_field_u64(w, "truncated", log_stats.truncated_lines);
+    json_field_s64(w, "level", log_stats.min_level);
+    json_end_object(w);
+    json_end_object(w);
+}
+
+size_t http_server_build_debug_json(const HttpServer* server, char* out, size_t out_size) {
+    JsonWriter w;
+
+    json_writer_init(&w, out, out_size);
+    http_server_write_debug_json(server, &w);
+    return json_writer_finish(&w);
 }
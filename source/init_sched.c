@@ -0,0 +1,165 @@
+#include "init_sched.h"
+
+#include "logger.h"
+
+#include <string.h>
+
+#define INIT_BACKOFF_MIN_MS 100
+#define INIT_BACKOFF_MAX_MS 8000
+#define INIT_PROBE_MAX_MS   1000 // probes are cheap; keep polling them briskly
+
+static const InitServiceDef* g_init_defs;
+static size_t g_init_count;
+static InitServiceStatus g_init_status[INIT_SCHED_MAX_SERVICES];
+static u32 g_init_ready_mask;
+static u64 g_init_start_tick;
+static bool g_init_complete_logged;
+static RMutex g_init_lock;
+
+static const char* const g_init_state_names[] = {
+    [InitServiceState_Blocked] = "blocked",
+    [InitServiceState_Waiting] = "waiting",
+    [InitServiceState_Backoff] = "backoff",
+    [InitServiceState_Ready] = "ready",
+};
+
+static u64 init_now_ms(void) {
+    return armTicksToNs(armGetSystemTick() - g_init_start_tick) / 1000000ULL;
+}
+
+static u32 init_next_backoff(u32 backoff_ms, u32 max_ms) {
+    if (backoff_ms == 0) return INIT_BACKOFF_MIN_MS;
+    return backoff_ms >= max_ms / 2 ? max_ms : backoff_ms * 2;
+}
+
+// Missing registrations are reported as not ready; if the query itself is
+// unsupported the probe gets out of the way and the init call decides.
+static bool init_probe_registered(const char* sm_name) {
+    bool registered = false;
+
+    if (!sm_name) return true;
+    if (R_FAILED(smAtmosphereHasService(&registered, smEncodeName(sm_name)))) {
+        return true;
+    }
+    return registered;
+}
+
+bool init_sched_all_ready(void) {
+    return g_init_count > 0 && g_init_ready_mask == (u32)((1ULL << g_init_count) - 1);
+}
+
+void init_sched_setup(const InitServiceDef* defs, size_t count) {
+    rmutexInit(&g_init_lock);
+    g_init_defs = defs;
+    g_init_count = count < INIT_SCHED_MAX_SERVICES ? count : INIT_SCHED_MAX_SERVICES;
+    g_init_ready_mask = 0;
+    g_init_complete_logged = false;
+    g_init_start_tick = armGetSystemTick();
+    memset(g_init_status, 0, sizeof(g_init_status));
+}
+
+u64 init_sched_poll(void) {
+    u64 next_due = 0;
+    size_t id;
+
+    for (id = 0; id < g_init_count; id++) {
+        const InitServiceDef* def = &g_init_defs[id];
+        InitServiceStatus* st = &g_init_status[id];
+        u64 now = init_now_ms();
+        Result rc = 0;
+        bool ok;
+
+        if (st->state == InitServiceState_Ready) continue;
+
+        if ((g_init_ready_mask & def->deps) != def->deps || (def->gate && !def->gate())) {
+            st->state = InitServiceState_Blocked;
+            continue;
+        }
+        if (st->next_attempt_ms > now) {
+            const u64 wait = st->next_attempt_ms - now;
+            if (next_due == 0 || wait < next_due) next_due = wait;
+            continue;
+        }
+
+        if (!init_probe_registered(def->sm_name)) {
+            rmutexLock(&g_init_lock);
+            st->state = InitServiceState_Waiting;
+            st->probe_waits++;
+            st->backoff_ms = init_next_backoff(st->backoff_ms, INIT_PROBE_MAX_MS);
+            st->next_attempt_ms = now + st->backoff_ms;
+            rmutexUnlock(&g_init_lock);
+            if (next_due == 0 || st->backoff_ms < next_due) next_due = st->backoff_ms;
+            continue;
+        }
+
+        ok = def->start(&rc);
+        rmutexLock(&g_init_lock);
+        st->attempts++;
+        st->last_rc = rc;
+        if (st->attempts == 1) st->first_attempt_ms = now;
+        now = init_now_ms();
+        if (ok) {
+            st->state = InitServiceState_Ready;
+            st->ready_ms = now;
+            g_init_ready_mask |= INIT_SERVICE_BIT(id);
+        } else {
+            st->state = InitServiceState_Backoff;
+            st->backoff_ms = init_next_backoff(st->backoff_ms, INIT_BACKOFF_MAX_MS);
+            st->next_attempt_ms = now + st->backoff_ms;
+        }
+        rmutexUnlock(&g_init_lock);
+
+        if (ok) {
+            LOG_INFO(
+                "init: %s ready at %llums (attempts=%u probe_waits=%u)",
+                def->name,
+                (unsigned long long)now,
+                (unsigned int)st->attempts,
+                (unsigned int)st->probe_waits
+            );
+            // Dependents later in the table can start in this same pass.
+        } else {
+            LOG_AT(
+                st->attempts == 1 ? LOG_LEVEL_WARN : LOG_LEVEL_DEBUG,
+                "init: %s failed rc=0x%08lX attempt=%u retry_in=%ums",
+                def->name,
+                (unsigned long)rc,
+                (unsigned int)st->attempts,
+                (unsigned int)st->backoff_ms
+            );
+            if (next_due == 0 || st->backoff_ms < next_due) next_due = st->backoff_ms;
+        }
+    }
+
+    if (!g_init_complete_logged && init_sched_all_ready()) {
+        g_init_complete_logged = true;
+        LOG_INFO("init: all %u services ready at %llums", (unsigned int)g_init_count, (unsigned long long)init_now_ms());
+    }
+    return next_due;
+}
+
+void init_sched_write_json(JsonWriter* w) {
+    size_t id;
+
+    rmutexLock(&g_init_lock);
+    json_begin_object(w);
+    json_field_bool(w, "complete", init_sched_all_ready());
+    json_key(w, "services");
+    json_begin_array(w);
+    for (id = 0; id < g_init_count; id++) {
+        const InitServiceStatus* st = &g_init_status[id];
+
+        json_begin_object(w);
+        json_field_string(w, "name", g_init_defs[id].name);
+        json_field_string(w, "state", g_init_state_names[st->state]);
+        json_field_u64(w, "attempts", st->attempts);
+        json_field_u64(w, "probe_waits", st->probe_waits);
+        json_field_hex32(w, "last_rc", st->last_rc);
+        json_field_u64(w, "first_attempt_ms", st->first_attempt_ms);
+        json_field_u64(w, "ready_ms", st->ready_ms);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+    rmutexUnlock(&g_init_lock);
+}
@@ -0,0 +1,117 @@
+#include "ipc_trace.h"
+
+#include "flight_recorder.h"
+
+#include <stdatomic.h>
+
+typedef struct {
+    _Atomic u64 count;
+    _Atomic u64 errors;
+    _Atomic u64 total_ticks;
+    _Atomic u64 min_ticks; // 0 until the first sample
+    _Atomic u64 max_ticks;
+    _Atomic u64 buckets[IPC_TRACE_BUCKETS];
+} IpcCallStats;
+
+static const char* const g_ipc_call_names[IpcCall_Count] = {
+    [IpcCall_PsmBatteryChargePercentage] = "psmGetBatteryChargePercentage",
+    [IpcCall_PsmChargerType] = "psmGetChargerType",
+    [IpcCall_AppletOperationModeSystemInfo] = "appletGetOperationModeSystemInfo",
+    [IpcCall_PmshellApplicationProcessId] = "pmshellGetApplicationProcessIdForShell",
+    [IpcCall_PminfoProgramId] = "pminfoGetProgramId",
+    [IpcCall_SvcProcessList] = "svcGetProcessList",
+    [IpcCall_NifmConnectionStatus] = "nifmGetInternetConnectionStatus",
+};
+
+// Upper bounds in microseconds; the last bucket catches everything slower.
+static const u32 g_ipc_bucket_us[IPC_TRACE_BUCKETS - 1] = { 10, 25, 50, 100, 250, 500, 1000, 2500, 10000 };
+
+static IpcCallStats g_ipc_stats[IpcCall_Count];
+
+void ipc_trace_end(IpcCallId id, u64 start_tick, Result rc) {
+    IpcCallStats* stats;
+    const u64 ticks = armGetSystemTick() - start_tick;
+    const u64 us = armTicksToNs(ticks) / 1000ULL;
+    u64 cur;
+    int bucket = 0;
+
+    if ((unsigned int)id >= IpcCall_Count) {
+        return;
+    }
+    stats = &g_ipc_stats[id];
+
+    atomic_fetch_add_explicit(&stats->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->total_ticks, ticks, memory_order_relaxed);
+    if (R_FAILED(rc)) {
+        atomic_fetch_add_explicit(&stats->errors, 1, memory_order_relaxed);
+    }
+
+    cur = atomic_load_explicit(&stats->min_ticks, memory_order_relaxed);
+    while ((cur == 0 || ticks < cur) &&
+           !atomic_compare_exchange_weak_explicit(&stats->min_ticks, &cur, ticks ? ticks : 1,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    cur = atomic_load_explicit(&stats->max_ticks, memory_order_relaxed);
+    while (ticks > cur &&
+           !atomic_compare_exchange_weak_explicit(&stats->max_ticks, &cur, ticks,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+
+    while (bucket < IPC_TRACE_BUCKETS - 1 && us >= g_ipc_bucket_us[bucket]) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&stats->buckets[bucket], 1, memory_order_relaxed);
+    flight_recorder_record(FlightEventType_Ipc, g_ipc_call_names[id], us > 0xFFFF ? 0xFFFF : (u16)us, (u32)rc);
+}
+
+static u64 ticks_to_us(u64 ticks) {
+    return armTicksToNs(ticks) / 1000ULL;
+}
+
+u64 ipc_trace_total_calls(void) {
+    u64 total = 0;
+    int id;
+
+    for (id = 0; id < IpcCall_Count; id++) {
+        total += atomic_load_explicit(&g_ipc_stats[id].count, memory_order_relaxed);
+    }
+    return total;
+}
+
+void ipc_trace_write_json(JsonWriter* w) {
+    int id;
+    int i;
+
+    json_begin_object(w);
+    json_key(w, "bucket_upper_us");
+    json_begin_array(w);
+    for (i = 0; i < IPC_TRACE_BUCKETS - 1; i++) {
+        json_u64(w, g_ipc_bucket_us[i]);
+    }
+    json_end_array(w);
+
+    json_key(w, "calls");
+    json_begin_array(w);
+    for (id = 0; id < IpcCall_Count; id++) {
+        const IpcCallStats* stats = &g_ipc_stats[id];
+        const u64 count = atomic_load_explicit(&stats->count, memory_order_relaxed);
+        const u64 total = atomic_load_explicit(&stats->total_ticks, memory_order_relaxed);
+
+        json_begin_object(w);
+        json_field_string(w, "name", g_ipc_call_names[id]);
+        json_field_u64(w, "count", count);
+        json_field_u64(w, "errors", atomic_load_explicit(&stats->errors, memory_order_relaxed));
+        json_field_u64(w, "min_us", ticks_to_us(atomic_load_explicit(&stats->min_ticks, memory_order_relaxed)));
+        json_field_u64(w, "max_us", ticks_to_us(atomic_load_explicit(&stats->max_ticks, memory_order_relaxed)));
+        json_field_u64(w, "mean_us", count ? ticks_to_us(total / count) : 0);
+        json_key(w, "hist");
+        json_begin_array(w);
+        for (i = 0; i < IPC_TRACE_BUCKETS; i++) {
+            json_u64(w, atomic_load_explicit(&stats->buckets[i], memory_order_relaxed));
+        }
+        json_end_array(w);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+}
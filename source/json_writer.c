@@ -0,0 +1,299 @@
+#include "json_writer.h"
+
+#include <string.h>
+
+static const char g_hex_digits[] = "0123456789ABCDEF";
+
+static void writer_flush(JsonWriter* w) {
+    if (w->sink && w->pos > 0) {
+        w->sink(w->sink_ctx, w->buf, w->pos);
+        w->pos = 0;
+    }
+}
+
+static void writer_put(JsonWriter* w, const char* data, size_t n) {
+    w->len += n;
+
+    if (w->sink) {
+        while (n > 0) {
+            size_t room = w->cap - w->pos;
+            if (room == 0) {
+                writer_flush(w);
+                room = w->cap;
+            }
+            if (room > n) room = n;
+            memcpy(w->buf + w->pos, data, room);
+            w->pos += room;
+            data += room;
+            n -= room;
+        }
+        return;
+    }
+
+    if (w->overflow) {
+        return;
+    }
+    // Keep one byte for the terminating NUL.
+    if (w->pos + n >= w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->pos, data, n);
+    w->pos += n;
+}
+
+static void writer_putc(JsonWriter* w, char c) {
+    writer_put(w, &c, 1);
+}
+
+// Emits the separator owed before a value or key at the current depth.
+static void writer_begin_value(JsonWriter* w) {
+    if (w->after_key) {
+        w->after_key = false;
+        return;
+    }
+    if (w->need_comma[w->depth]) {
+        writer_putc(w, ',');
+    }
+}
+
+static void writer_end_value(JsonWriter* w) {
+    w->need_comma[w->depth] = true;
+}
+
+void json_writer_init(JsonWriter* w, char* buf, size_t cap) {
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->cap = buf ? cap : 0;
+    if (w->cap > 0) {
+        w->buf[0] = '\0';
+    }
+}
+
+void json_writer_init_sink(JsonWriter* w, char* stage, size_t stage_size, JsonSinkFn sink, void* ctx) {
+    memset(w, 0, sizeof(*w));
+    w->buf = stage;
+    w->cap = stage_size;
+    w->sink = sink;
+    w->sink_ctx = ctx;
+}
+
+size_t json_writer_finish(JsonWriter* w) {
+    if (w->sink) {
+        writer_flush(w);
+        return w->len;
+    }
+
+    if (w->cap == 0) {
+        w->overflow = true;
+        return w->len;
+    }
+    if (w->overflow) {
+        w->buf[0] = '\0';
+        w->pos = 0;
+        return w->len;
+    }
+    w->buf[w->pos] = '\0';
+    return w->len;
+}
+
+bool json_writer_ok(const JsonWriter* w) {
+    return !w->overflow;
+}
+
+static void writer_open(JsonWriter* w, char c) {
+    writer_begin_value(w);
+    writer_putc(w, c);
+    if (w->depth < JSON_WRITER_MAX_DEPTH) {
+        w->depth++;
+    }
+    w->need_comma[w->depth] = false;
+}
+
+static void writer_close(JsonWriter* w, char c) {
+    writer_putc(w, c);
+    if (w->depth > 0) {
+        w->depth--;
+    }
+    writer_end_value(w);
+}
+
+void json_begin_object(JsonWriter* w) {
+    writer_open(w, '{');
+}
+
+void json_end_object(JsonWriter* w) {
+    writer_close(w, '}');
+}
+
+void json_begin_array(JsonWriter* w) {
+    writer_open(w, '[');
+}
+
+void json_end_array(JsonWriter* w) {
+    writer_close(w, ']');
+}
+
+void json_key(JsonWriter* w, const char* key) {
+    json_string(w, key);
+    writer_putc(w, ':');
+    w->after_key = true;
+}
+
+void json_u64(JsonWriter* w, u64 value) {
+    char tmp[20];
+    size_t i = sizeof(tmp);
+
+    do {
+        tmp[--i] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+
+    writer_begin_value(w);
+    writer_put(w, tmp + i, sizeof(tmp) - i);
+    writer_end_value(w);
+}
+
+void json_s64(JsonWriter* w, s64 value) {
+    char tmp[21];
+    size_t i = sizeof(tmp);
+    u64 mag = value < 0 ? (u64)0 - (u64)value : (u64)value;
+
+    do {
+        tmp[--i] = (char)('0' + (mag % 10));
+        mag /= 10;
+    } while (mag != 0);
+    if (value < 0) {
+        tmp[--i] = '-';
+    }
+
+    writer_begin_value(w);
+    writer_put(w, tmp + i, sizeof(tmp) - i);
+    writer_end_value(w);
+}
+
+static void writer_hex(JsonWriter* w, u64 value, int digits) {
+    char tmp[20];
+    int i;
+
+    tmp[0] = '"';
+    tmp[1] = '0';
+    tmp[2] = 'x';
+    for (i = 0; i < digits; i++) {
+        tmp[3 + i] = g_hex_digits[(value >> ((digits - 1 - i) * 4)) & 0xF];
+    }
+    tmp[3 + digits] = '"';
+
+    writer_begin_value(w);
+    writer_put(w, tmp, (size_t)digits + 4);
+    writer_end_value(w);
+}
+
+void json_hex32(JsonWriter* w, u32 value) {
+    writer_hex(w, value, 8);
+}
+
+void json_hex64(JsonWriter* w, u64 value) {
+    writer_hex(w, value, 16);
+}
+
+void json_bool(JsonWriter* w, bool value) {
+    writer_begin_value(w);
+    if (value) {
+        writer_put(w, "true", 4);
+    } else {
+        writer_put(w, "false", 5);
+    }
+    writer_end_value(w);
+}
+
+void json_null(JsonWriter* w) {
+    writer_begin_value(w);
+    writer_put(w, "null", 4);
+    writer_end_value(w);
+}
+
+void json_string_n(JsonWriter* w, const char* value, size_t len) {
+    size_t run = 0;
+    size_t i;
+
+    writer_begin_value(w);
+    writer_putc(w, '"');
+
+    // Copy unescaped runs in one go; only quotes, backslashes and control
+    // characters need rewriting. UTF-8 sequences pass through untouched.
+    for (i = 0; i < len; i++) {
+        const unsigned char c = (unsigned char)value[i];
+        char esc[6];
+        size_t esc_len = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        writer_put(w, value + run, i - run);
+        run = i + 1;
+
+        esc[0] = '\\';
+        switch (c) {
+            case '"': esc[1] = '"'; break;
+            case '\\': esc[1] = '\\'; break;
+            case '\b': esc[1] = 'b'; break;
+            case '\f': esc[1] = 'f'; break;
+            case '\n': esc[1] = 'n'; break;
+            case '\r': esc[1] = 'r'; break;
+            case '\t': esc[1] = 't'; break;
+            default:
+                esc[1] = 'u';
+                esc[2] = '0';
+                esc[3] = '0';
+                esc[4] = g_hex_digits[c >> 4];
+                esc[5] = g_hex_digits[c & 0xF];
+                esc_len = 6;
+                break;
+        }
+        writer_put(w, esc, esc_len);
+    }
+    writer_put(w, value + run, len - run);
+
+    writer_putc(w, '"');
+    writer_end_value(w);
+}
+
+void json_string(JsonWriter* w, const char* value) {
+    if (!value) {
+        json_null(w);
+        return;
+    }
+    json_string_n(w, value, strlen(value));
+}
+
+void json_field_u64(JsonWriter* w, const char* key, u64 value) {
+    json_key(w, key);
+    json_u64(w, value);
+}
+
+void json_field_s64(JsonWriter* w, const char* key, s64 value) {
+    json_key(w, key);
+    json_s64(w, value);
+}
+
+void json_field_hex32(JsonWriter* w, const char* key, u32 value) {
+    json_key(w, key);
+    json_hex32(w, value);
+}
+
+void json_field_hex64(JsonWriter* w, const char* key, u64 value) {
+    json_key(w, key);
+    json_hex64(w, value);
+}
+
+void json_field_bool(JsonWriter* w, const char* key, bool value) {
+    json_key(w, key);
+    json_bool(w, value);
+}
+
+void json_field_string(JsonWriter* w, const char* key, const char* value) {
+    json_key(w, key);
+    json_string(w, value);
+}
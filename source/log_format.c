@@ -0,0 +1,192 @@
+#include "log_format.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    char* out;
+    size_t cap;
+    size_t len;
+} RenderBuf;
+
+static void render_put(RenderBuf* b, const char* s, size_t n) {
+    if (b->len + 1 < b->cap) {
+        size_t room = b->cap - 1 - b->len;
+        memcpy(b->out + b->len, s, n < room ? n : room);
+    }
+    b->len += n;
+}
+
+static void render_printf_result(RenderBuf* b, int n) {
+    if (n > 0) b->len += (size_t)n;
+}
+
+static char* render_tail(RenderBuf* b, size_t* room) {
+    if (b->len + 1 >= b->cap) {
+        *room = 0;
+        return NULL;
+    }
+    *room = b->cap - b->len;
+    return b->out + b->len;
+}
+
+uint64_t log_read_varint(LogReader* r) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+
+    while (r->p < r->end && shift < 64) {
+        const uint8_t byte = *r->p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+        shift += 7;
+    }
+    r->ok = 0;
+    return 0;
+}
+
+int64_t log_read_zigzag(LogReader* r) {
+    const uint64_t v = log_read_varint(r);
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Width and precision stars are replaced by their recorded values so every
+// conversion can be printed with a single argument.
+size_t log_format_render(const char* fmt, LogReader* r, char* out, size_t out_size) {
+    RenderBuf b = { out, out_size, 0 };
+    const char* p = fmt;
+
+    while (*p) {
+        char spec[64];
+        size_t sn = 0;
+        size_t room;
+        char* dst;
+        char conv;
+
+        if (*p != '%') {
+            const char* start = p;
+            while (*p && *p != '%') p++;
+            render_put(&b, start, (size_t)(p - start));
+            continue;
+        }
+        if (p[1] == '%') {
+            render_put(&b, "%", 1);
+            p += 2;
+            continue;
+        }
+
+        spec[sn++] = *p++;
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') {
+            if (sn < 32) spec[sn++] = *p;
+            p++;
+        }
+        for (;;) {
+            if (*p == '*') {
+                const int64_t v = log_read_zigzag(r);
+                const int n = snprintf(spec + sn, 16, "%lld", r->ok ? (long long)v : 0LL);
+                if (n > 0 && n < 16) sn += (size_t)n;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                if (sn < 48) spec[sn++] = *p;
+                p++;
+            }
+            if (*p != '.') break;
+            if (sn < 48) spec[sn++] = '.';
+            p++;
+        }
+        while (*p == 'h' || *p == 'l' || *p == 'z' || *p == 'j' || *p == 't' || *p == 'L') p++;
+
+        conv = *p;
+        if (conv == '\0') break;
+        p++;
+
+        if (!r->ok || r->p >= r->end) {
+            r->ok = 0;
+            render_put(&b, "?", 1);
+            continue;
+        }
+
+        dst = render_tail(&b, &room);
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                const int64_t v = log_read_zigzag(r);
+                memcpy(spec + sn, "ll", 2);
+                spec[sn + 2] = conv;
+                spec[sn + 3] = '\0';
+                render_printf_result(&b, snprintf(dst, room, spec, (long long)v));
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X': {
+                const uint64_t v = log_read_varint(r);
+                memcpy(spec + sn, "ll", 2);
+                spec[sn + 2] = conv;
+                spec[sn + 3] = '\0';
+                render_printf_result(&b, snprintf(dst, room, spec, (unsigned long long)v));
+                break;
+            }
+            case 'c': {
+                const uint64_t v = log_read_varint(r);
+                spec[sn] = 'c';
+                spec[sn + 1] = '\0';
+                render_printf_result(&b, snprintf(dst, room, spec, (int)v));
+                break;
+            }
+            case 'p':
+                render_printf_result(&b, snprintf(dst, room, "0x%llx", (unsigned long long)log_read_varint(r)));
+                break;
+            case 's': {
+                const uint64_t len = log_read_varint(r);
+                char text[256];
+                if (!r->ok || len > (uint64_t)(r->end - r->p) || len >= sizeof(text)) {
+                    r->ok = 0;
+                    render_put(&b, "?", 1);
+                    break;
+                }
+                memcpy(text, r->p, (size_t)len);
+                text[len] = '\0';
+                r->p += len;
+                spec[sn] = 's';
+                spec[sn + 1] = '\0';
+                render_printf_result(&b, snprintf(dst, room, spec, text));
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                uint64_t bits = 0;
+                double v;
+                int i;
+                if (r->end - r->p < 8) {
+                    r->ok = 0;
+                    render_put(&b, "?", 1);
+                    break;
+                }
+                for (i = 0; i < 8; i++) bits |= (uint64_t)r->p[i] << (i * 8);
+                r->p += 8;
+                memcpy(&v, &bits, sizeof(v));
+                spec[sn] = conv;
+                spec[sn + 1] = '\0';
+                render_printf_result(&b, snprintf(dst, room, spec, v));
+                break;
+            }
+            default:
+                r->ok = 0;
+                render_put(&b, "?", 1);
+                break;
+        }
+    }
+
+    if (b.cap > 0) {
+        b.out[b.len < b.cap ? b.len : b.cap - 1] = '\0';
+    }
+    return b.len;
+}
@@ -1,34 +1,432 @@
 #include "logger.h"
 
+#include "arena.h"
+#include "log_format.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <switch.h>
 
-#define LOG_PATH "sdmc:/switch/switch-dcrpc/log.log"
+#ifndef LOG_DIR
+#define LOG_DIR "sdmc:/switch/switch-dcrpc/"
+#endif
+#define LOG_RING_SLOTS 64 // power of two
+#define LOG_SLOT_TEXT 512 // keep logger.h's line limit in sync
+#define LOG_TRUNC_MARKER_MAX 24 // "...(truncated N)"
+#define LOG_FLUSH_BATCH_LINES 16
+#define LOG_FLUSH_INTERVAL_NS (5ULL * 1000000000ULL)
+#define LOG_BATCH_BYTES 4096
+#define LOG_MAX_BYTES_DEFAULT (256U * 1024U)
+#define LOG_MAX_FILES_DEFAULT 3
+#define LOG_MAX_FILES_LIMIT 9
+#define LOG_FMT_MAX 128
+#define LOG_ARG_STRING_MAX 255
+#define LOG_RECENT_BYTES (16 * 1024)
+#define LOG_RECENT_ENTRY_HEADER 10 // u64 line + u16 length
+// Ring slots, the recent tail and both sink batches, each padded to the arena alignment.
+#define LOG_ARENA_SIZE \
+    (LOG_RING_SLOTS * sizeof(LogSlot) + LOG_RECENT_BYTES + 2 * LOG_BATCH_BYTES + 4 * ARENA_ALIGN)
+
+enum {
+    LogSlotKind_Text = 0,
+    LogSlotKind_Binary,
+};
+
+// Bounded multi-producer ring: a slot may be written when seq == reservation
+// position and read once seq == position + 1.
+typedef struct {
+    _Atomic u32 seq;
+    u8 kind;
+    u16 len;
+    u16 prefix_len; // text slots: length of the "[s] [line=]" prefix
+    u64 line;
+    u64 ms;
+    char text[LOG_SLOT_TEXT];
+} LogSlot;
+
+// One output file family (log.log, log.1.log, ...), written only by the flusher.
+typedef struct {
+    const char* ext;
+    bool binary;
+    bool size_known;
+    u64 size;
+    size_t used;
+    u8 fmt_written[LOG_FMT_MAX / 8];
+    char* batch; // LOG_BATCH_BYTES from the logging arena
+} LogSink;
+
+int g_logger_min_level = LOG_LEVEL_INFO;
 
 static bool g_logger_enabled = false;
-static u64 g_log_line = 0;
+static bool g_logger_binary = false;
+static u32 g_log_max_bytes = LOG_MAX_BYTES_DEFAULT;
+static u32 g_log_max_files = LOG_MAX_FILES_DEFAULT;
+static LogSlot* g_log_ring; // LOG_RING_SLOTS entries; NULL until logger_init
+static _Atomic u32 g_log_head = 0;
+static u32 g_log_tail = 0; // owned by the flushing thread
+static _Atomic u64 g_log_line = 0;
+static _Atomic u64 g_log_dropped = 0;
+static _Atomic u64 g_log_suppressed = 0;
+static _Atomic u64 g_log_truncated = 0;
+static const char* _Atomic g_log_formats[LOG_FMT_MAX];
+static u64 g_log_dropped_reported = 0;
+static u64 g_log_written = 0;
+static u64 g_log_bytes_written = 0;
+static u64 g_log_flush_count = 0;
+static u64 g_log_rotation_count = 0;
+static u64 g_log_last_flush_tick = 0;
+static LogSink g_log_text_sink = { .ext = "log", .binary = false };
+static LogSink g_log_bin_sink = { .ext = "bin", .binary = true };
+
+// Everything above that is sized by a #define is carved from here once, in logger_init.
+ARENA_DEFINE(g_log_arena, "logging", LOG_ARENA_SIZE);
+
+// Most recent rendered lines, kept as [line:u64][len:u16][text] entries in a
+// byte ring. Written by the flusher, read by the HTTP thread.
+static RMutex g_log_recent_lock;
+static char* g_log_recent;
+static size_t g_log_recent_start = 0;
+static size_t g_log_recent_used = 0;
+
+static size_t put_varint(u8* out, size_t cap, u64 value) {
+    size_t n = 0;
+
+    do {
+        u8 byte = (u8)(value & 0x7F);
+        value >>= 7;
+        if (value != 0) byte |= 0x80;
+        if (n >= cap) return 0;
+        out[n++] = byte;
+    } while (value != 0);
+    return n;
+}
+
+static u64 zigzag(s64 value) {
+    return ((u64)value << 1) ^ (u64)(value >> 63);
+}
+
+static void log_sink_path(const LogSink* sink, u32 index, char* out, size_t out_size) {
+    if (index == 0) {
+        snprintf(out, out_size, LOG_DIR "log.%s", sink->ext);
+    } else {
+        snprintf(out, out_size, LOG_DIR "log.%u.%s", (unsigned int)index, sink->ext);
+    }
+}
+
+void logger_init(void) {
+    u32 i;
+
+    arena_register(&g_log_arena);
+    if (!g_log_ring) {
+        g_log_ring = (LogSlot*)arena_alloc(&g_log_arena, LOG_RING_SLOTS * sizeof(LogSlot));
+        g_log_recent = (char*)arena_alloc(&g_log_arena, LOG_RECENT_BYTES);
+        g_log_text_sink.batch = (char*)arena_alloc(&g_log_arena, LOG_BATCH_BYTES);
+        g_log_bin_sink.batch = (char*)arena_alloc(&g_log_arena, LOG_BATCH_BYTES);
+    }
+    for (i = 0; i < LOG_RING_SLOTS; i++) {
+        atomic_store_explicit(&g_log_ring[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&g_log_head, 0, memory_order_relaxed);
+    g_log_tail = 0;
+    g_log_last_flush_tick = armGetSystemTick();
+    rmutexInit(&g_log_recent_lock);
+}
 
 void logger_set_enabled(bool enabled) {
     g_logger_enabled = enabled;
 }
 
+void logger_set_level(int min_level) {
+    g_logger_min_level = min_level;
+}
+
+bool logger_ratelimit(LogRateLimit* site, u32 interval_ms, u32* suppressed) {
+    const u64 now = armGetSystemTick();
+
+    if (now < site->next_tick) {
+        if (site->suppressed < 0xFFFFFFFFU) site->suppressed++;
+        atomic_fetch_add_explicit(&g_log_suppressed, 1, memory_order_relaxed);
+        *suppressed = 0;
+        return false;
+    }
+
+    *suppressed = site->suppressed;
+    site->suppressed = 0;
+    site->next_tick = now + armNsToTicks((u64)interval_ms * 1000000ULL);
+    return true;
+}
+
+void logger_set_binary(bool binary) {
+    g_logger_binary = binary;
+}
+
+void logger_set_rotation(u32 max_bytes, u32 max_files) {
+    if (max_files < 1) max_files = 1;
+    if (max_files > LOG_MAX_FILES_LIMIT) max_files = LOG_MAX_FILES_LIMIT;
+    g_log_max_bytes = max_bytes;
+    g_log_max_files = max_files;
+}
+
+// Returns a stable id for fmt, registering it on first use; -1 once the table is full.
+static int logger_format_id(const char* fmt) {
+    int i;
+
+    for (i = 0; i < LOG_FMT_MAX; i++) {
+        const char* known = atomic_load_explicit(&g_log_formats[i], memory_order_acquire);
+        if (known == fmt) {
+            return i;
+        }
+        if (known == NULL) {
+            const char* expected = NULL;
+            if (atomic_compare_exchange_strong_explicit(
+                    &g_log_formats[i], &expected, fmt, memory_order_acq_rel, memory_order_acquire)) {
+                return i;
+            }
+            if (expected == fmt) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+// Walks fmt like printf does and stores each argument raw (see log_format.h).
+// *complete is cleared when an argument was cut or left out.
+static size_t logger_encode_args(u8* out, size_t cap, const char* fmt, va_list args, bool* complete) {
+    size_t used = 0;
+    const char* p = fmt;
+
+    *complete = false;
+
+    while (*p) {
+        int length = 0; // 0=int, 1=long, 2=long long, 3=size_t, 4=intmax_t, 5=ptrdiff_t
+        size_t n = 0;
+        char conv;
+
+        if (*p++ != '%') continue;
+        if (*p == '%') {
+            p++;
+            continue;
+        }
+
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0') p++;
+        for (;;) {
+            if (*p == '*') {
+                n = put_varint(out + used, cap - used, zigzag(va_arg(args, int)));
+                if (n == 0) return used;
+                used += n;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') p++;
+            if (*p != '.') break;
+            p++;
+        }
+        while (*p == 'h') p++;
+        if (*p == 'l') {
+            length = 1;
+            p++;
+            if (*p == 'l') {
+                length = 2;
+                p++;
+            }
+        } else if (*p == 'z') {
+            length = 3;
+            p++;
+        } else if (*p == 'j') {
+            length = 4;
+            p++;
+        } else if (*p == 't') {
+            length = 5;
+            p++;
+        } else if (*p == 'L') {
+            p++;
+        }
+
+        conv = *p;
+        if (conv == '\0') break;
+        p++;
+
+        switch (conv) {
+            case 'd':
+            case 'i': {
+                s64 v;
+                switch (length) {
+                    case 1: v = va_arg(args, long); break;
+                    case 2: v = va_arg(args, long long); break;
+                    case 3: v = (s64)va_arg(args, size_t); break;
+                    case 4: v = va_arg(args, intmax_t); break;
+                    case 5: v = va_arg(args, ptrdiff_t); break;
+                    default: v = va_arg(args, int); break;
+                }
+                n = put_varint(out + used, cap - used, zigzag(v));
+                break;
+            }
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+            case 'c': {
+                u64 v;
+                switch (length) {
+                    case 1: v = va_arg(args, unsigned long); break;
+                    case 2: v = va_arg(args, unsigned long long); break;
+                    case 3: v = va_arg(args, size_t); break;
+                    case 4: v = va_arg(args, uintmax_t); break;
+                    case 5: v = (u64)va_arg(args, ptrdiff_t); break;
+                    default: v = va_arg(args, unsigned int); break;
+                }
+                n = put_varint(out + used, cap - used, v);
+                break;
+            }
+            case 'p':
+                n = put_varint(out + used, cap - used, (u64)(uintptr_t)va_arg(args, void*));
+                break;
+            case 's': {
+                const char* s = va_arg(args, const char*);
+                size_t len = s ? strnlen(s, LOG_ARG_STRING_MAX + 1) : 0;
+                if (len > LOG_ARG_STRING_MAX) return used;
+                n = put_varint(out + used, cap - used, len);
+                if (n == 0 || used + n + len > cap) return used;
+                memcpy(out + used + n, s, len);
+                n += len;
+                break;
+            }
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A': {
+                const double v = va_arg(args, double);
+                u64 bits;
+                int i;
+                if (used + 8 > cap) return used;
+                memcpy(&bits, &v, sizeof(bits));
+                for (i = 0; i < 8; i++) out[used + i] = (u8)(bits >> (i * 8));
+                n = 8;
+                break;
+            }
+            default:
+                // Unknown conversion: the rest cannot be decoded reliably.
+                return used;
+        }
+        if (n == 0) return used;
+        used += n;
+    }
+
+    *complete = true;
+    return used;
+}
+
+// Returns the record length, or 0 when it cannot be encoded in full (text
+// fallback, which marks any truncation).
+static size_t logger_encode_event(u8* out, size_t cap, u64 ms, u64 line, const char* fmt, va_list args) {
+    const int id = logger_format_id(fmt);
+    size_t used = LOG_BIN_RECORD_HEADER_SIZE;
+    size_t n;
+    size_t payload;
+    bool complete;
+
+    if (id < 0) {
+        return 0;
+    }
+
+    n = put_varint(out + used, cap - used, (u64)id);
+    used += n;
+    n = put_varint(out + used, cap - used, ms);
+    used += n;
+    n = put_varint(out + used, cap - used, line);
+    used += n;
+    used += logger_encode_args(out + used, cap - used, fmt, args, &complete);
+    if (!complete) {
+        return 0;
+    }
+
+    payload = used - LOG_BIN_RECORD_HEADER_SIZE;
+    out[0] = LogRecord_Event;
+    out[1] = (u8)(payload & 0xFF);
+    out[2] = (u8)(payload >> 8);
+    return used;
+}
+
 void logger_vwrite(const char* fmt, va_list args) {
-    if (!g_logger_enabled) {
-        return;
+    u32 pos;
+    LogSlot* slot;
+    u64 ms;
+    u64 line;
+    int n;
+    int m;
+
+    if (!g_log_ring) return;
+
+    pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+    for (;;) {
+        s32 diff;
+        slot = &g_log_ring[pos & (LOG_RING_SLOTS - 1)];
+        diff = (s32)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &g_log_head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            atomic_fetch_add_explicit(&g_log_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&g_log_head, memory_order_relaxed);
+        }
     }
 
-    FILE* f = fopen(LOG_PATH, "a");
-    if (!f) {
-        return;
+    ms = armTicksToNs(armGetSystemTick()) / 1000000ULL;
+    line = atomic_fetch_add_explicit(&g_log_line, 1, memory_order_relaxed);
+
+    if (g_logger_binary) {
+        va_list encode_args;
+        size_t len;
+
+        va_copy(encode_args, args);
+        len = logger_encode_event((u8*)slot->text, sizeof(slot->text), ms, line, fmt, encode_args);
+        va_end(encode_args);
+        if (len > 0) {
+            slot->kind = LogSlotKind_Binary;
+            slot->len = (u16)len;
+            slot->line = line;
+            slot->ms = ms;
+            atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+            return;
+        }
+    }
+
+    n = snprintf(slot->text, sizeof(slot->text), "[%llu s] [line=%llu] ",
+                 (unsigned long long)(ms / 1000ULL),
+                 (unsigned long long)line);
+    if (n < 0) n = 0;
+    if (n > LOG_SLOT_TEXT - 2) n = LOG_SLOT_TEXT - 2;
+    slot->prefix_len = (u16)n;
+    m = vsnprintf(slot->text + n, sizeof(slot->text) - (size_t)n - 1, fmt, args);
+    if (m < 0) m = 0;
+    if (n + m > LOG_SLOT_TEXT - 2) {
+        // Keep the head and say how much is missing rather than cut silently.
+        const int keep = LOG_SLOT_TEXT - 2 - LOG_TRUNC_MARKER_MAX;
+        const int marker = snprintf(slot->text + keep, LOG_TRUNC_MARKER_MAX + 1, "...(truncated %d)", n + m - keep);
+        n = keep + (marker > LOG_TRUNC_MARKER_MAX ? LOG_TRUNC_MARKER_MAX : marker);
+        atomic_fetch_add_explicit(&g_log_truncated, 1, memory_order_relaxed);
+    } else {
+        n += m;
     }
+    slot->text[n++] = '\n';
+    slot->kind = LogSlotKind_Text;
+    slot->len = (u16)n;
+    slot->line = line;
+    slot->ms = ms;
 
-    const u64 sec_since_boot = armTicksToNs(armGetSystemTick()) / 1000000000ULL;
-    fprintf(f, "[%llu s] [line=%llu] ",
-            (unsigned long long)sec_since_boot,
-            (unsigned long long)g_log_line++);
-    vfprintf(f, fmt, args);
-    fputc('\n', f);
-    fclose(f);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
 }
 
 void logger_write(const char* fmt, ...) {
@@ -37,3 +435,348 @@ void logger_write(const char* fmt, ...) {
     logger_vwrite(fmt, args);
     va_end(args);
 }
+
+static u32 logger_pending(void) {
+    return atomic_load_explicit(&g_log_head, memory_order_acquire) - g_log_tail;
+}
+
+static void log_sink_commit(LogSink* sink) {
+    char path[96];
+    FILE* f;
+
+    if (sink->used == 0) {
+        return;
+    }
+
+    log_sink_path(sink, 0, path, sizeof(path));
+    f = fopen(path, "a");
+    if (f) {
+        fwrite(sink->batch, 1, sink->used, f);
+        fclose(f);
+        sink->size += sink->used;
+        g_log_bytes_written += sink->used;
+    }
+    sink->used = 0;
+}
+
+// Shifts log.N.ext up by one (dropping the oldest) and starts an empty log.ext.
+static void log_sink_rotate(LogSink* sink) {
+    char from[96];
+    char to[96];
+    u32 i;
+
+    log_sink_path(sink, g_log_max_files - 1, to, sizeof(to));
+    remove(to);
+    for (i = g_log_max_files - 1; i > 0; i--) {
+        log_sink_path(sink, i - 1, from, sizeof(from));
+        log_sink_path(sink, i, to, sizeof(to));
+        rename(from, to);
+    }
+    if (g_log_max_files == 1) {
+        log_sink_path(sink, 0, to, sizeof(to));
+        remove(to);
+    }
+
+    sink->size = 0;
+    memset(sink->fmt_written, 0, sizeof(sink->fmt_written));
+    g_log_rotation_count++;
+}
+
+static void log_sink_put(LogSink* sink, const void* data, size_t len) {
+    if (sink->used + len > LOG_BATCH_BYTES) {
+        log_sink_commit(sink);
+    }
+    memcpy(sink->batch + sink->used, data, len);
+    sink->used += len;
+}
+
+static void log_sink_put_record(LogSink* sink, u8 type, const void* payload, size_t len) {
+    u8 header[LOG_BIN_RECORD_HEADER_SIZE];
+
+    header[0] = type;
+    header[1] = (u8)(len & 0xFF);
+    header[2] = (u8)(len >> 8);
+    log_sink_put(sink, header, sizeof(header));
+    log_sink_put(sink, payload, len);
+}
+
+// Reserves room for len more bytes in the current file, rotating first when
+// the file would exceed the cap, and writes the binary header into new files.
+static void log_sink_prepare(LogSink* sink, size_t len) {
+    if (!sink->size_known) {
+        char path[96];
+        struct stat st;
+        log_sink_path(sink, 0, path, sizeof(path));
+        sink->size = (stat(path, &st) == 0) ? (u64)st.st_size : 0;
+        sink->size_known = true;
+    }
+
+    if (g_log_max_bytes > 0 && sink->size + sink->used > 0 &&
+        sink->size + sink->used + len > g_log_max_bytes) {
+        log_sink_commit(sink);
+        log_sink_rotate(sink);
+    }
+
+    if (sink->binary && sink->size + sink->used == 0) {
+        u8 header[LOG_BIN_HEADER_SIZE] = { 0 };
+        memcpy(header, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE);
+        header[LOG_BIN_MAGIC_SIZE] = LOG_BIN_VERSION;
+        log_sink_put(sink, header, sizeof(header));
+        memset(sink->fmt_written, 0, sizeof(sink->fmt_written));
+    }
+}
+
+static void log_sink_append_event(LogSink* sink, const u8* record, size_t len) {
+    u64 id = 0;
+    u32 shift = 0;
+    size_t i = LOG_BIN_RECORD_HEADER_SIZE;
+
+    while (i < len) {
+        const u8 byte = record[i++];
+        id |= (u64)(byte & 0x7F) << shift;
+        shift += 7;
+        if (!(byte & 0x80)) break;
+    }
+
+    if (id >= LOG_FMT_MAX) {
+        return;
+    }
+
+    {
+        const char* fmt = atomic_load_explicit(&g_log_formats[id], memory_order_acquire);
+        const size_t fmt_len = strnlen(fmt, LOG_BATCH_BYTES / 2);
+        u8 def[LOG_BIN_RECORD_HEADER_SIZE + 2];
+        size_t id_len;
+
+        // Reserve for the definition too, so rotation cannot separate an
+        // event from the format record it depends on.
+        log_sink_prepare(sink, sizeof(def) + fmt_len + len);
+        if (sink->fmt_written[id / 8] & (1U << (id % 8))) {
+            log_sink_put(sink, record, len);
+            return;
+        }
+
+        id_len = put_varint(def + LOG_BIN_RECORD_HEADER_SIZE, 2, id);
+        def[0] = LogRecord_Format;
+        def[1] = (u8)((id_len + fmt_len) & 0xFF);
+        def[2] = (u8)((id_len + fmt_len) >> 8);
+        log_sink_put(sink, def, LOG_BIN_RECORD_HEADER_SIZE + id_len);
+        log_sink_put(sink, fmt, fmt_len);
+        sink->fmt_written[id / 8] |= (u8)(1U << (id % 8));
+    }
+    log_sink_put(sink, record, len);
+}
+
+// Binary mode fallback for lines whose format could not be registered.
+static void logger_append_text_record(const LogSlot* slot) {
+    u8 payload[LOG_SLOT_TEXT + 20];
+    size_t used = 0;
+    const size_t text_len = (size_t)slot->len - slot->prefix_len - 1; // drop prefix and newline
+
+    used += put_varint(payload + used, sizeof(payload) - used, slot->ms);
+    used += put_varint(payload + used, sizeof(payload) - used, slot->line);
+    memcpy(payload + used, slot->text + slot->prefix_len, text_len);
+    used += text_len;
+
+    log_sink_prepare(&g_log_bin_sink, LOG_BIN_RECORD_HEADER_SIZE + used);
+    log_sink_put_record(&g_log_bin_sink, LogRecord_Text, payload, used);
+}
+
+static void logger_report_dropped(u64 count) {
+    if (g_logger_binary) {
+        u8 payload[10];
+        const size_t n = put_varint(payload, sizeof(payload), count);
+        log_sink_prepare(&g_log_bin_sink, LOG_BIN_RECORD_HEADER_SIZE + n);
+        log_sink_put_record(&g_log_bin_sink, LogRecord_Dropped, payload, n);
+    } else {
+        char line[64];
+        const int n = snprintf(line, sizeof(line), "[logger] dropped %llu lines (ring full)\n",
+                               (unsigned long long)count);
+        if (n > 0) {
+            log_sink_prepare(&g_log_text_sink, (size_t)n);
+            log_sink_put(&g_log_text_sink, line, (size_t)n);
+        }
+    }
+}
+
+static void log_recent_copy_in(size_t off, const void* data, size_t len) {
+    const size_t first = (len < LOG_RECENT_BYTES - off) ? len : LOG_RECENT_BYTES - off;
+    memcpy(g_log_recent + off, data, first);
+    memcpy(g_log_recent, (const char*)data + first, len - first);
+}
+
+static void log_recent_copy_out(size_t off, void* data, size_t len) {
+    const size_t first = (len < LOG_RECENT_BYTES - off) ? len : LOG_RECENT_BYTES - off;
+    memcpy(data, g_log_recent + off, first);
+    memcpy((char*)data + first, g_log_recent, len - first);
+}
+
+static void log_recent_entry_header(size_t off, u64* line, u16* len) {
+    u8 header[LOG_RECENT_ENTRY_HEADER];
+    log_recent_copy_out(off, header, sizeof(header));
+    memcpy(line, header, sizeof(*line));
+    memcpy(len, header + sizeof(*line), sizeof(*len));
+}
+
+static void log_recent_append(u64 line, const char* text, u16 len) {
+    const size_t need = LOG_RECENT_ENTRY_HEADER + len;
+    u8 header[LOG_RECENT_ENTRY_HEADER];
+
+    rmutexLock(&g_log_recent_lock);
+    while (g_log_recent_used + need > LOG_RECENT_BYTES) {
+        u64 old_line;
+        u16 old_len;
+        log_recent_entry_header(g_log_recent_start, &old_line, &old_len);
+        g_log_recent_start = (g_log_recent_start + LOG_RECENT_ENTRY_HEADER + old_len) % LOG_RECENT_BYTES;
+        g_log_recent_used -= LOG_RECENT_ENTRY_HEADER + old_len;
+    }
+
+    memcpy(header, &line, sizeof(line));
+    memcpy(header + sizeof(line), &len, sizeof(len));
+    {
+        const size_t off = (g_log_recent_start + g_log_recent_used) % LOG_RECENT_BYTES;
+        log_recent_copy_in(off, header, sizeof(header));
+        log_recent_copy_in((off + sizeof(header)) % LOG_RECENT_BYTES, text, len);
+    }
+    g_log_recent_used += need;
+    rmutexUnlock(&g_log_recent_lock);
+}
+
+// Renders a binary slot back to the text-log form for the in-memory tail.
+static u16 logger_render_binary(const LogSlot* slot, char* out, size_t out_size) {
+    LogReader r;
+    const char* fmt;
+    u64 id;
+    int n;
+    size_t len;
+
+    r.p = (const u8*)slot->text + LOG_BIN_RECORD_HEADER_SIZE;
+    r.end = (const u8*)slot->text + slot->len;
+    r.ok = 1;
+    id = log_read_varint(&r);
+    log_read_varint(&r); // ms
+    log_read_varint(&r); // line
+
+    n = snprintf(out, out_size, "[%llu s] [line=%llu] ",
+                 (unsigned long long)(slot->ms / 1000ULL), (unsigned long long)slot->line);
+    len = (n > 0) ? (size_t)n : 0;
+    fmt = (id < LOG_FMT_MAX) ? atomic_load_explicit(&g_log_formats[id], memory_order_acquire) : NULL;
+    if (fmt && len < out_size) {
+        len += log_format_render(fmt, &r, out + len, out_size - len);
+    }
+    if (len > out_size - 2) len = out_size - 2;
+    out[len++] = '\n';
+    return (u16)len;
+}
+
+static void logger_drain(void) {
+    const u64 dropped = atomic_load_explicit(&g_log_dropped, memory_order_relaxed);
+
+    g_log_last_flush_tick = armGetSystemTick();
+    if (logger_pending() == 0 && dropped == g_log_dropped_reported) {
+        return;
+    }
+
+    g_log_flush_count++;
+
+    if (dropped != g_log_dropped_reported) {
+        if (g_logger_enabled) {
+            logger_report_dropped(dropped - g_log_dropped_reported);
+        }
+        g_log_dropped_reported = dropped;
+    }
+
+    for (;;) {
+        LogSlot* slot = &g_log_ring[g_log_tail & (LOG_RING_SLOTS - 1)];
+        const u32 seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != g_log_tail + 1) {
+            break;
+        }
+
+        if (slot->kind == LogSlotKind_Binary) {
+            char text[LOG_SLOT_TEXT];
+            const u16 len = logger_render_binary(slot, text, sizeof(text));
+            log_recent_append(slot->line, text, len);
+            if (g_logger_enabled) {
+                log_sink_append_event(&g_log_bin_sink, (const u8*)slot->text, slot->len);
+            }
+        } else {
+            log_recent_append(slot->line, slot->text, slot->len);
+            if (g_logger_enabled && g_logger_binary) {
+                logger_append_text_record(slot);
+            } else if (g_logger_enabled) {
+                log_sink_prepare(&g_log_text_sink, slot->len);
+                log_sink_put(&g_log_text_sink, slot->text, slot->len);
+            }
+        }
+        g_log_written++;
+
+        atomic_store_explicit(&slot->seq, g_log_tail + LOG_RING_SLOTS, memory_order_release);
+        g_log_tail++;
+    }
+
+    log_sink_commit(&g_log_text_sink);
+    log_sink_commit(&g_log_bin_sink);
+}
+
+void logger_poll(void) {
+    const u64 elapsed_ns = armTicksToNs(armGetSystemTick() - g_log_last_flush_tick);
+
+    if (logger_pending() >= LOG_FLUSH_BATCH_LINES || elapsed_ns >= LOG_FLUSH_INTERVAL_NS) {
+        logger_drain();
+    }
+}
+
+void logger_flush(void) {
+    logger_drain();
+}
+
+void logger_get_stats(LoggerStats* out) {
+    out->queued_lines = atomic_load_explicit(&g_log_line, memory_order_relaxed);
+    out->written_lines = g_log_written;
+    out->dropped_lines = atomic_load_explicit(&g_log_dropped, memory_order_relaxed);
+    out->flush_count = g_log_flush_count;
+    out->bytes_written = g_log_bytes_written;
+    out->rotation_count = g_log_rotation_count;
+    out->suppressed_lines = atomic_load_explicit(&g_log_suppressed, memory_order_relaxed);
+    out->truncated_lines = atomic_load_explicit(&g_log_truncated, memory_order_relaxed);
+    out->min_level = g_logger_min_level;
+    out->pending_lines = logger_pending();
+    out->binary = g_logger_binary;
+}
+
+size_t logger_read_recent(u64 since, char* out, size_t out_size, u64* first_line, u64* next_line) {
+    size_t off;
+    size_t remaining;
+    size_t copied = 0;
+    u64 next = since;
+    bool have_first = false;
+
+    rmutexLock(&g_log_recent_lock);
+    off = g_log_recent_start;
+    remaining = g_log_recent_used;
+    *first_line = since;
+    while (remaining > 0) {
+        u64 line;
+        u16 len;
+        log_recent_entry_header(off, &line, &len);
+        if (!have_first) {
+            *first_line = line;
+            have_first = true;
+        }
+        if (line >= since) {
+            if (copied + len > out_size) {
+                break;
+            }
+            log_recent_copy_out((off + LOG_RECENT_ENTRY_HEADER) % LOG_RECENT_BYTES, out + copied, len);
+            copied += len;
+            if (line + 1 > next) next = line + 1;
+        }
+        off = (off + LOG_RECENT_ENTRY_HEADER + len) % LOG_RECENT_BYTES;
+        remaining -= LOG_RECENT_ENTRY_HEADER + len;
+    }
+    rmutexUnlock(&g_log_recent_lock);
+
+    *next_line = next;
+    return copied;
+}
@@ -3,18 +3,34 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <switch.h>
+#include "arena.h"
+#include "config.h"
+#include "demand.h"
+#include "flight_recorder.h"
 #include "http_server.h"
+#include "init_sched.h"
+#include "ipc_trace.h"
 #include "logger.h"
+#include "mqtt.h"
+#include "push.h"
+#include "stats.h"
+#include "status_record.h"
 #include "telemetry.h"
+#include "telemetry_trace.h"
+#include "watchdog.h"
 
 #define INNER_HEAP_SIZE            0x400000
-#define LOOP_SLEEP_NS              (2ULL * 1000000000ULL)
-#define APPINIT_DELAY_NS           (20ULL * 1000000000ULL)
-#define INIT_RETRY_TICKS           3
-#define HEARTBEAT_TICKS            15
-#define HTTP_PORT                  6029
-#define STATUS_PATH                "sdmc:/switch/switch-dcrpc/status.txt"
-#define DETECTION_DISABLE_FLAG_PATH "sdmc:/switch/switch-dcrpc/detection.off"
+#define WAKE_GAP_NS                (10ULL * 1000000000ULL) // loop tick this late => we were asleep
+#define HTTP_STALL_MS              45000 // > the server's 30 s offline wait
+#define HTTP_RESTART_BACKOFF_MIN_MS 1000
+#define HTTP_RESTART_BACKOFF_MAX_MS 60000
+#define HTTP_HEALTHY_RESET_MS      120000 // healthy this long => backoff starts over
+#define STATUS_PATH                "sdmc:/switch/switch-dcrpc/status.bin"
+#define STATUS_ERROR_LOG_INTERVAL_MS 60000
+#define TRACE_PATH                 "sdmc:/switch/switch-dcrpc/trace.bin"
+#define STATS_DIR                  "sdmc:/switch/switch-dcrpc"
+#define FLIGHT_DIR                 "sdmc:/switch/switch-dcrpc"
+#define HEARTBEAT_JSON_CHUNK       240 // per log line; under the binary log's 255-byte string argument cap
 #define ENABLE_PM_SERVICES         1
 #define ENABLE_DETECTION_WORKER    0
 #define ENABLE_RISKY_MAINLOOP_DETECTION 1
@@ -45,6 +61,21 @@ static bool g_pmshell_ready = false;
 static bool g_pminfo_ready = false;
 static bool g_nifm_ready = false;
 static bool g_socket_ready = false;
+static bool g_time_ready = false;
+static bool g_http_started = false;
+static bool g_net_link_known = false;
+static bool g_net_link_up = false;
+static u64 g_last_tick_ns = 0;
+static u32 g_config_applied_gen = 0;
+static bool g_trace_recording = false;
+static u64 g_http_restart_due_ms = 0;
+static u32 g_http_restart_backoff_ms = 0;
+static u64 g_http_healthy_since_ms = 0;
+static bool g_http_unhealthy = false;
+static u64 g_loop_interval_ns = 2ULL * 1000000000ULL;
+static u32 g_heartbeat_ticks = 15;
+static u32 g_heartbeat_debug_every = 10; // heartbeats per /debug snapshot in the log; 0 = never
+static u32 g_maintenance_ticks = 3;
 static bool g_fw_valid = false;
 static char g_fw_str[32];
 static char g_stage[64] = "boot";
@@ -73,7 +104,9 @@ static Thread g_detection_thread;
 static u8 g_detection_thread_stack[DETECTION_STACK_SIZE] __attribute__((aligned(0x1000)));
 
 static TelemetryState g_telemetry;
+static RMutex g_update_lock; // the main loop and idle-mode request refreshes both update telemetry
 static HttpServer g_server;
+static StatusStore g_status_store;
 
 static u64 sec_since_boot_now(void) {
     return armTicksToNs(armGetSystemTick()) / 1000000000ULL;
@@ -81,32 +114,206 @@ static u64 sec_since_boot_now(void) {
 
 static void set_stage(const char* stage) {
     snprintf(g_stage, sizeof(g_stage), "%s", stage ? stage : "unknown");
-    logger_write("stage: %s", g_stage);
+    watchdog_beat(Watchdog_MainLoop, stage ? stage : "unknown");
+    flight_recorder_record(FlightEventType_Stage, stage ? stage : "unknown", 0, 0);
+    LOG_DEBUG("stage: %s", g_stage);
 }
 
-static bool file_exists(const char* path) {
-    FILE* f = fopen(path, "r");
-    if (!f) return false;
-    fclose(f);
-    return true;
+static void heartbeat_json_sink(void* ctx, const char* data, size_t len) {
+    u32* parts = (u32*)ctx;
+    char chunk[HEARTBEAT_JSON_CHUNK + 1];
+
+    memcpy(chunk, data, len);
+    chunk[len] = '\0';
+    (*parts)++;
+    LOG_INFO("heartbeat-http: part=%u %s", (unsigned int)*parts, chunk);
 }
 
-static void refresh_detection_kill_switch(void) {
-    bool enabled_now;
+// Logs the /debug document in chunks that fit a log line; concatenating the
+// parts after "part=N " gives the JSON back.
+static void log_debug_snapshot(void) {
+    char stage[HEARTBEAT_JSON_CHUNK];
+    JsonWriter w;
+    u32 parts = 0;
+    size_t len;
+
+    if (g_logger_min_level > LOG_LEVEL_INFO) return;
+    json_writer_init_sink(&w, stage, sizeof(stage), heartbeat_json_sink, &parts);
+    http_server_write_debug_json(&g_server, &w);
+    len = json_writer_finish(&w);
+    if (!json_writer_ok(&w)) {
+        LOG_WARN("heartbeat-http: render failed after %u bytes in %u parts", (unsigned int)len, (unsigned int)parts);
+    }
+}
 
-    if (!g_fs_ready) return;
+// Pushes config values into the loop and the other modules. Restart-only keys
+// (port, thread placement) are read where they are used.
+static void apply_config_if_changed(void) {
+    Config cfg;
+    bool detection_off;
+    bool trace_on;
+
+    if (config_generation() == g_config_applied_gen) return;
+    g_config_applied_gen = config_generation();
+    config_get(&cfg);
+
+    g_loop_interval_ns = (u64)cfg.loop_interval_ms * 1000000ULL;
+    g_heartbeat_ticks = (u32)cfg.heartbeat_ticks;
+    g_heartbeat_debug_every = (u32)cfg.heartbeat_debug_every;
+    g_maintenance_ticks = (u32)cfg.maintenance_ticks;
+    logger_set_level(cfg.log_level);
+    logger_set_binary(cfg.log_binary != 0);
+    logger_set_rotation((u32)cfg.log_max_kb * 1024U, (u32)cfg.log_max_files);
+    telemetry_set_probe_interval(&g_telemetry, TelemetryProbe_Title, (u32)cfg.title_query_interval_sec);
+    push_set_refresh_sec((u32)cfg.push_refresh_sec);
+    demand_configure((u32)cfg.idle_after_sec, (u32)cfg.idle_interval_sec);
+    mqtt_configure(&cfg);
+
+    detection_off = (cfg.detection_enabled == 0);
+    if (detection_off != g_detection_kill_switch) {
+        g_detection_kill_switch = detection_off;
+        LOG_INFO("detector: kill-switch %s (config)", g_detection_kill_switch ? "enabled" : "disabled");
+    }
 
-    enabled_now = file_exists(DETECTION_DISABLE_FLAG_PATH);
-    if (enabled_now != g_detection_kill_switch) {
-        g_detection_kill_switch = enabled_now;
-        logger_write(
-            "detector: kill-switch %s (%s)",
-            g_detection_kill_switch ? "enabled" : "disabled",
-            DETECTION_DISABLE_FLAG_PATH
-        );
+    // Each enable starts a fresh trace.bin; a trace that hit its size limit
+    // stays as it is until recording is switched off and on again.
+    trace_on = g_fs_ready && cfg.trace_record != 0;
+    if (trace_on != g_trace_recording) {
+        g_trace_recording = trace_on;
+        if (trace_on) {
+            telemetry_trace_start(TRACE_PATH, (u32)cfg.trace_max_kb * 1024U);
+        } else {
+            telemetry_trace_stop();
+        }
     }
 }
 
+static u32 telemetry_probe_mask(bool allow_title_query) {
+    u32 probes = 0;
+
+    if (g_psm_ready) {
+        probes |= TELEMETRY_PROBE_BIT(TelemetryProbe_Battery) | TELEMETRY_PROBE_BIT(TelemetryProbe_Charger);
+    }
+    if (g_applet_ready) {
+        probes |= TELEMETRY_PROBE_BIT(TelemetryProbe_Dock);
+    }
+    if (allow_title_query) {
+        probes |= TELEMETRY_PROBE_BIT(TelemetryProbe_Title);
+    }
+    return probes;
+}
+
+static bool net_link_up(void) {
+    NifmInternetConnectionType type;
+    NifmInternetConnectionStatus status;
+    u32 strength = 0;
+    const u64 start = ipc_trace_begin();
+    const Result rc = nifmGetInternetConnectionStatus(&type, &strength, &status);
+
+    ipc_trace_end(IpcCall_NifmConnectionStatus, start, rc);
+    return R_SUCCEEDED(rc) && status == NifmInternetConnectionStatus_Connected;
+}
+
+// Turns sleep/wake and nifm link changes into server events so the listener
+// is parked while offline and rebuilt as soon as the link returns.
+static void monitor_network(u64 now_ns) {
+    const u64 last_ns = g_last_tick_ns;
+    bool up;
+
+    g_last_tick_ns = now_ns;
+    if (!g_http_started) return;
+
+    if (last_ns != 0 && now_ns - last_ns > g_loop_interval_ns + WAKE_GAP_NS) {
+        LOG_INFO("net: wake detected (loop gap %llums)", (unsigned long long)((now_ns - last_ns) / 1000000ULL));
+        http_server_notify_network(&g_server, HttpNetEvent_Wake);
+    }
+
+    if (!g_nifm_ready) return;
+
+    up = net_link_up();
+    if (g_net_link_known && up == g_net_link_up) return;
+
+    if (g_net_link_known || !up) {
+        LOG_INFO("net: link %s", up ? "up" : "down");
+        http_server_notify_network(&g_server, up ? HttpNetEvent_LinkUp : HttpNetEvent_LinkDown);
+    }
+    g_net_link_known = true;
+    g_net_link_up = up;
+}
+
+static u64 ms_since_boot_now(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+// Restarts the HTTP thread when it has exited or stopped beating. Attempts
+// back off exponentially until the server has stayed healthy for a while.
+static void supervise_http(void) {
+    const u64 now = ms_since_boot_now();
+    bool failed;
+
+    if (!g_http_started || g_server.reactor) return;
+
+    if (g_server.exited) {
+        if (!g_http_unhealthy) {
+            watchdog_record_stall(Watchdog_Http, "exited: %s", g_server.exit_reason);
+        }
+        failed = true;
+    } else {
+        // watchdog_check reports a stall once; the age keeps it failed until the thread beats again.
+        failed = watchdog_check(Watchdog_Http, HTTP_STALL_MS) ||
+                 watchdog_age_ms(Watchdog_Http) > HTTP_STALL_MS ||
+                 !g_server.running;
+    }
+
+    if (!failed) {
+        if (g_http_unhealthy) {
+            g_http_unhealthy = false;
+            g_http_healthy_since_ms = now;
+        } else if (g_http_restart_backoff_ms != 0 && now - g_http_healthy_since_ms >= HTTP_HEALTHY_RESET_MS) {
+            g_http_restart_backoff_ms = 0;
+        }
+        return;
+    }
+
+    g_http_unhealthy = true;
+    if (now < g_http_restart_due_ms) return;
+
+    set_stage("http.restart");
+    watchdog_record_restart(Watchdog_Http, http_server_restart(&g_server));
+    if (g_http_restart_backoff_ms == 0) {
+        g_http_restart_backoff_ms = HTTP_RESTART_BACKOFF_MIN_MS;
+    } else if (g_http_restart_backoff_ms < HTTP_RESTART_BACKOFF_MAX_MS / 2) {
+        g_http_restart_backoff_ms *= 2;
+    } else {
+        g_http_restart_backoff_ms = HTTP_RESTART_BACKOFF_MAX_MS;
+    }
+    g_http_restart_due_ms = now + g_http_restart_backoff_ms;
+}
+
+// Runs on the main loop, or on the HTTP thread when a request finds idle-mode
+// data (see demand.h).
+static void refresh_telemetry(void) {
+    const bool allow_title_query =
+        ENABLE_RISKY_MAINLOOP_DETECTION && g_http_started && g_detection_services_ready && !g_detection_kill_switch;
+    u64 ipc_calls;
+
+    rmutexLock(&g_update_lock);
+    ipc_calls = ipc_trace_total_calls();
+    telemetry_update(&g_telemetry, telemetry_probe_mask(allow_title_query));
+    demand_record_update(ipc_trace_total_calls() - ipc_calls);
+    rmutexUnlock(&g_update_lock);
+    push_notify();
+    mqtt_notify();
+}
+
+static void sample_stats(void) {
+    u64 now;
+
+    if (!g_time_ready || !stats_available()) return;
+    if (R_FAILED(timeGetCurrentTime(TimeType_Default, &now))) return;
+    stats_sample(&g_telemetry, now);
+}
+
 static void log_active_title_if_changed(void) {
     u64 active_program_id = 0;
 
@@ -119,7 +326,7 @@ static void log_active_title_if_changed(void) {
     }
 
     g_last_logged_active_program_id = active_program_id;
-    logger_write("title: active_program_id=0x%016llX", (unsigned long long)active_program_id);
+    LOG_INFO("title: active_program_id=0x%016llX", (unsigned long long)active_program_id);
 }
 
 static void detection_worker_thread(void* arg) {
@@ -128,7 +335,7 @@ static void detection_worker_thread(void* arg) {
 
     g_detection_thread_alive = true;
     g_detection_thread_last_heartbeat_sec = sec_since_boot_now();
-    logger_write(
+    LOG_INFO(
         "detector: thread started prio=%d cpuid=%d",
         DETECTION_THREAD_PRIO,
         DETECTION_THREAD_CPUID
@@ -147,7 +354,7 @@ static void detection_worker_thread(void* arg) {
                 nsExit();
                 ns_ready_local = false;
                 g_ns_ready = false;
-                logger_write("detector: ns shutdown because kill-switch is active");
+                LOG_INFO("detector: ns shutdown because kill-switch is active");
             }
             svcSleepThread(DETECTION_SLEEP_NS);
             continue;
@@ -160,7 +367,7 @@ static void detection_worker_thread(void* arg) {
         if (g_detection_disabled_until_sec != 0) {
             g_detection_disabled_until_sec = 0;
             g_detection_fail_streak = 0;
-            logger_write("detector: cooldown elapsed, resuming");
+            LOG_INFO("detector: cooldown elapsed, resuming");
         }
 
         if (!ns_ready_local) {
@@ -168,14 +375,14 @@ static void detection_worker_thread(void* arg) {
             if (R_FAILED(g_detection_last_rc)) {
                 g_detection_fail_count++;
                 if (g_detection_fail_streak < 0xFFFFFFFFU) g_detection_fail_streak++;
-                logger_write(
+                LOG_WARN(
                     "detector: nsInitialize failed rc=0x%08lX streak=%u",
                     (unsigned long)g_detection_last_rc,
                     (unsigned int)g_detection_fail_streak
                 );
                 if (g_detection_fail_streak >= DETECTION_FAIL_STREAK_MAX) {
                     g_detection_disabled_until_sec = now + DETECTION_COOLDOWN_SEC;
-                    logger_write(
+                    LOG_WARN(
                         "detector: auto-cooldown for %us after init failures",
                         (unsigned int)DETECTION_COOLDOWN_SEC
                     );
@@ -187,10 +394,12 @@ static void detection_worker_thread(void* arg) {
             ns_ready_local = true;
             g_ns_ready = true;
             g_detection_fail_streak = 0;
-            logger_write("detector: ns ready");
+            LOG_INFO("detector: ns ready");
         }
 
-        telemetry_update(&g_telemetry, true, g_psm_ready, g_applet_ready);
+        telemetry_update(&g_telemetry, telemetry_probe_mask(true));
+        push_notify();
+        mqtt_notify();
 
         rmutexLock(&g_telemetry.lock);
         ns_rc = g_telemetry.last_ns_result;
@@ -203,13 +412,13 @@ static void detection_worker_thread(void* arg) {
 
         if (R_SUCCEEDED(ns_rc)) {
             if (g_detection_fail_streak > 0) {
-                logger_write("detector: recovered after fail_streak=%u", (unsigned int)g_detection_fail_streak);
+                LOG_INFO("detector: recovered after fail_streak=%u", (unsigned int)g_detection_fail_streak);
             }
             g_detection_fail_streak = 0;
             g_detection_success_count++;
             if (active_program_id != g_detection_last_logged_program_id) {
                 g_detection_last_logged_program_id = active_program_id;
-                logger_write(
+                LOG_INFO(
                     "detector: active changed program=0x%016llX game=%s",
                     (unsigned long long)active_program_id,
                     active_game
@@ -219,7 +428,7 @@ static void detection_worker_thread(void* arg) {
             g_detection_fail_count++;
             if (g_detection_fail_streak < 0xFFFFFFFFU) g_detection_fail_streak++;
             if (g_detection_fail_streak == 1 || (g_detection_fail_streak % 3) == 0) {
-                logger_write(
+                LOG_WARN(
                     "detector: query failed ns_rc=0x%08lX streak=%u",
                     (unsigned long)ns_rc,
                     (unsigned int)g_detection_fail_streak
@@ -227,7 +436,7 @@ static void detection_worker_thread(void* arg) {
             }
             if (g_detection_fail_streak >= DETECTION_FAIL_STREAK_MAX) {
                 g_detection_disabled_until_sec = now + DETECTION_COOLDOWN_SEC;
-                logger_write(
+                LOG_WARN(
                     "detector: auto-cooldown for %us after query failures",
                     (unsigned int)DETECTION_COOLDOWN_SEC
                 );
@@ -235,7 +444,7 @@ static void detection_worker_thread(void* arg) {
                     nsExit();
                     ns_ready_local = false;
                     g_ns_ready = false;
-                    logger_write("detector: ns shutdown for cooldown");
+                    LOG_INFO("detector: ns shutdown for cooldown");
                 }
             }
         }
@@ -248,7 +457,7 @@ static void detection_worker_thread(void* arg) {
         g_ns_ready = false;
     }
     g_detection_thread_alive = false;
-    logger_write("detector: thread stopped");
+    LOG_INFO("detector: thread stopped");
 }
 
 static void stop_detection_worker(void) {
@@ -257,7 +466,7 @@ static void stop_detection_worker(void) {
     threadClose(&g_detection_thread);
     g_detection_thread_alive = false;
     g_detection_thread_started = false;
-    logger_write("detector: worker stop requested (non-blocking)");
+    LOG_INFO("detector: worker stop requested (non-blocking)");
 }
 
 static bool start_detection_worker(void) {
@@ -270,6 +479,7 @@ static bool start_detection_worker(void) {
     g_detection_thread_running = true;
     g_detection_thread_alive = false;
     g_detection_thread_last_heartbeat_sec = sec_since_boot_now();
+    memory_register_stack("detection", g_detection_thread_stack, DETECTION_STACK_SIZE);
     rc = threadCreate(
         &g_detection_thread,
         detection_worker_thread,
@@ -282,7 +492,7 @@ static bool start_detection_worker(void) {
     if (R_FAILED(rc)) {
         g_detection_thread_running = false;
         g_detection_last_rc = rc;
-        logger_write(
+        LOG_ERROR(
             "detector: threadCreate failed rc=0x%08lX prio=%d cpuid=%d",
             (unsigned long)rc,
             DETECTION_THREAD_PRIO,
@@ -296,85 +506,236 @@ static bool start_detection_worker(void) {
         g_detection_thread_running = false;
         g_detection_last_rc = rc;
         threadClose(&g_detection_thread);
-        logger_write("detector: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        LOG_ERROR("detector: threadStart failed rc=0x%08lX", (unsigned long)rc);
         return false;
     }
 
     g_detection_thread_started = true;
-    logger_write("detector: worker started");
+    LOG_INFO("detector: worker started");
     return true;
 }
 
-static void update_status_file(const char* state) {
-    FILE* f;
-
-    if (!g_fs_ready) return;
-
-    f = fopen(STATUS_PATH, "w");
-    if (!f) return;
-
-    fprintf(
-        f,
-        "state=%s\n"
-        "session_id=%llu\n"
-        "uptime_sec=%llu\n"
-        "stage=%s\n"
-        "last_rc=0x%08lX\n"
-        "heartbeats=%llu\n"
-        "sm=%d fs=%d setsys=%d applet=%d psm=%d pmshell=%d pminfo=%d nifm=%d socket=%d\n" 
-        "detector_started=%d detector_running=%d detector_ns=%d kill_switch=%d\n"
-        "detector_alive=%d detector_last_hb=%llu\n"
-        "detector_attempts=%llu detector_ok=%llu detector_fail=%llu detector_streak=%u\n"
-        "detector_cooldown_until=%llu detector_last_rc=0x%08lX\n",
-        state ? state : "UNKNOWN",
-        (unsigned long long)g_session_id,
-        (unsigned long long)sec_since_boot_now(),
-        g_stage,
-        (unsigned long)g_last_rc,
-        (unsigned long long)g_heartbeat_count,
-        g_sm_ready,
-        g_fs_ready,
-        g_setsys_ready,
-        g_applet_ready,
-        g_psm_ready,
-        g_pmshell_ready,
-        g_pminfo_ready,
-        g_nifm_ready,
-        g_socket_ready,
-        g_detection_thread_started,
-        g_detection_thread_running ? 1 : 0,
-        g_ns_ready,
-        g_detection_kill_switch,
-        g_detection_thread_alive ? 1 : 0,
-        (unsigned long long)g_detection_thread_last_heartbeat_sec,
-        (unsigned long long)g_detection_attempt_count,
-        (unsigned long long)g_detection_success_count,
-        (unsigned long long)g_detection_fail_count,
-        (unsigned int)g_detection_fail_streak,
-        (unsigned long long)g_detection_disabled_until_sec,
-        (unsigned long)g_detection_last_rc
-    );
-    fclose(f);
+static u32 status_bit(bool set, int bit) {
+    return set ? (1U << bit) : 0;
 }
 
-static void detect_previous_unclean_shutdown(void) {
-    FILE* f;
-    char buf[512];
-    size_t n;
+static void update_status_record(StatusState state) {
+    StatusRecord rec;
+
+    if (!g_status_store.file) return;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.session_id = g_session_id;
+    rec.uptime_sec = sec_since_boot_now();
+    rec.heartbeats = g_heartbeat_count;
+    rec.state = (u32)state;
+    rec.last_rc = (u32)g_last_rc;
+    rec.services =
+        status_bit(g_sm_ready, StatusService_Sm) |
+        status_bit(g_fs_ready, StatusService_Fs) |
+        status_bit(g_setsys_ready, StatusService_Setsys) |
+        status_bit(g_applet_ready, StatusService_Applet) |
+        status_bit(g_psm_ready, StatusService_Psm) |
+        status_bit(g_pmshell_ready, StatusService_Pmshell) |
+        status_bit(g_pminfo_ready, StatusService_Pminfo) |
+        status_bit(g_nifm_ready, StatusService_Nifm) |
+        status_bit(g_socket_ready, StatusService_Socket) |
+        status_bit(g_ns_ready, StatusService_Ns);
+    rec.flags =
+        status_bit(g_server.running, StatusFlag_HttpStarted) |
+        status_bit(g_detection_thread_started, StatusFlag_DetectorStarted) |
+        status_bit(g_detection_thread_running, StatusFlag_DetectorRunning) |
+        status_bit(g_detection_thread_alive, StatusFlag_DetectorAlive) |
+        status_bit(g_detection_kill_switch, StatusFlag_KillSwitch) |
+        status_bit(g_unclean_prev, StatusFlag_UncleanPrevious);
+    rec.detector_last_heartbeat_sec = g_detection_thread_last_heartbeat_sec;
+    rec.detector_attempts = g_detection_attempt_count;
+    rec.detector_successes = g_detection_success_count;
+    rec.detector_failures = g_detection_fail_count;
+    rec.detector_fail_streak = g_detection_fail_streak;
+    rec.detector_last_rc = (u32)g_detection_last_rc;
+    rec.detector_cooldown_until_sec = g_detection_disabled_until_sec;
+    snprintf(rec.stage, sizeof(rec.stage), "%.*s", (int)sizeof(rec.stage) - 1, g_stage);
+
+    if (!status_store_write(&g_status_store, &rec)) {
+        LOG_WARN_RATELIMITED(STATUS_ERROR_LOG_INTERVAL_MS, "status: write failed");
+    }
+}
 
-    f = fopen(STATUS_PATH, "r");
-    if (!f) return;
+// Opens status.bin and checks whether the newest record of the previous
+// session was left in the RUNNING state.
+static void detect_previous_unclean_shutdown(void) {
+    StatusRecord prev;
 
-    n = fread(buf, 1, sizeof(buf) - 1, f);
-    fclose(f);
-    buf[n] = '\0';
+    if (!status_store_open(&g_status_store, STATUS_PATH, &prev)) {
+        if (!g_status_store.file) {
+            LOG_WARN("status: cannot open %s", STATUS_PATH);
+        }
+        return;
+    }
 
-    if (strstr(buf, "state=RUNNING") != NULL) {
+    if (prev.state == StatusState_Running) {
         g_unclean_prev = true;
-        logger_write("warn: previous session did not shutdown cleanly (possible crash/hang)");
+        LOG_WARN(
+            "warn: previous session did not shutdown cleanly (possible crash/hang) stage=%.*s uptime=%llus heartbeats=%llu",
+            (int)sizeof(prev.stage),
+            prev.stage,
+            (unsigned long long)prev.uptime_sec,
+            (unsigned long long)prev.heartbeats
+        );
+    }
+}
+
+// service init ----------------------------------------------------------------
+
+typedef enum {
+    InitService_Sm = 0,
+    InitService_Fs,
+    InitService_Setsys,
+    InitService_Nifm,
+    InitService_Applet,
+    InitService_Psm,
+    InitService_Socket,
+    InitService_Time,
+    InitService_Http,
+    InitService_Pmshell,
+    InitService_Pminfo,
+    InitService_Count,
+} InitServiceId;
+
+static bool init_result(Result rc, Result* out_rc, bool* ready) {
+    g_last_rc = rc;
+    *out_rc = rc;
+    if (R_SUCCEEDED(rc)) *ready = true;
+    return R_SUCCEEDED(rc);
+}
+
+static bool init_sm(Result* rc) {
+    set_stage("sm.init");
+    return init_result(smInitialize(), rc, &g_sm_ready);
+}
+
+static bool init_fs(Result* out_rc) {
+    Result rc;
+
+    set_stage("fs.init");
+    rc = fsInitialize();
+    if (R_SUCCEEDED(rc)) {
+        rc = fsdevMountSdmc();
+        if (R_FAILED(rc)) fsExit();
+    }
+    if (!init_result(rc, out_rc, &g_fs_ready)) return false;
+
+    mkdir("sdmc:/switch", 0777);
+    mkdir("sdmc:/switch/switch-dcrpc", 0777);
+    logger_set_enabled(true);
+    LOG_INFO("boot: fs ready");
+    config_reload_if_changed();
+    apply_config_if_changed();
+    detect_previous_unclean_shutdown();
+    if (flight_recorder_open(FLIGHT_DIR, g_session_id) && g_unclean_prev) {
+        LOG_WARN("flight: last events of the previous session kept in %s/flight.prev.bin", FLIGHT_DIR);
+    }
+    update_status_record(StatusState_Running);
+    return true;
+}
+
+static bool init_setsys(Result* out_rc) {
+    SetSysFirmwareVersion fw;
+    Result rc;
+
+    set_stage("setsys.init");
+    if (!init_result(setsysInitialize(), out_rc, &g_setsys_ready)) return false;
+
+    rc = setsysGetFirmwareVersion(&fw);
+    g_last_rc = rc;
+    if (R_SUCCEEDED(rc)) {
+        snprintf(g_fw_str, sizeof(g_fw_str), "%u.%u.%u", fw.major, fw.minor, fw.micro);
+        g_fw_valid = true;
+        telemetry_set_firmware(&g_telemetry, g_fw_str);
+        LOG_INFO("init: firmware=%s", g_fw_str);
     }
+    return true;
+}
+
+static bool init_nifm(Result* rc) {
+    set_stage("nifm.init");
+    return init_result(nifmInitialize(NifmServiceType_User), rc, &g_nifm_ready);
+}
+
+static bool init_applet(Result* rc) {
+    set_stage("applet.init");
+    return init_result(appletInitialize(), rc, &g_applet_ready);
+}
+
+static bool init_psm(Result* rc) {
+    set_stage("psm.init");
+    return init_result(psmInitialize(), rc, &g_psm_ready);
+}
+
+static bool init_socket(Result* rc) {
+    set_stage("socket.init");
+    return init_result(socketInitializeDefault(), rc, &g_socket_ready);
+}
+
+// Usage statistics need both the SD card and a wall clock.
+static bool init_time(Result* rc) {
+    set_stage("time.init");
+    if (!init_result(timeInitialize(), rc, &g_time_ready)) return false;
+    if (!stats_open(STATS_DIR)) LOG_WARN("stats: store unavailable, /stats disabled");
+    return true;
+}
+
+static bool init_http(Result* rc) {
+    Config cfg;
+
+    config_get_boot(&cfg); // http_port and reactor_mode are restart-only
+    set_stage("http.start");
+    // Subscriptions arrive over HTTP, so the push thread must be up first.
+    if (!push_start(&g_telemetry)) LOG_WARN("push: start failed, /subscribe disabled");
+    if (!mqtt_start(&g_telemetry)) LOG_WARN("mqtt: start failed, publishing disabled");
+    g_http_started = http_server_start(&g_server, &g_telemetry, (unsigned short)cfg.http_port, cfg.reactor_mode != 0);
+    *rc = 0;
+    LOG_INFO(
+        "http: start %s port=%d mode=%s",
+        g_http_started ? "ok" : "failed",
+        (int)cfg.http_port,
+        cfg.reactor_mode ? "reactor" : "thread"
+    );
+    return g_http_started;
+}
+
+static bool init_pmshell(Result* rc) {
+    set_stage("pmshell.init");
+    return init_result(pmshellInitialize(), rc, &g_pmshell_ready);
+}
+
+static bool init_pminfo(Result* rc) {
+    set_stage("pminfo.init");
+    return init_result(pminfoInitialize(), rc, &g_pminfo_ready);
+}
+
+// pm services are only touched once HTTP is serving and detection is allowed.
+static bool init_detection_allowed(void) {
+    return ENABLE_PM_SERVICES && ENABLE_RISKY_MAINLOOP_DETECTION && !g_detection_kill_switch;
 }
 
+#define INIT_DEP(id) INIT_SERVICE_BIT(InitService_##id)
+
+static const InitServiceDef g_init_services[InitService_Count] = {
+    [InitService_Sm] = { "sm", NULL, 0, NULL, init_sm },
+    [InitService_Fs] = { "fs", "fsp-srv", INIT_DEP(Sm), NULL, init_fs },
+    [InitService_Setsys] = { "setsys", "set:sys", INIT_DEP(Sm), NULL, init_setsys },
+    [InitService_Nifm] = { "nifm", "nifm:u", INIT_DEP(Sm), NULL, init_nifm },
+    [InitService_Applet] = { "applet", NULL, INIT_DEP(Sm), NULL, init_applet },
+    [InitService_Psm] = { "psm", "psm", INIT_DEP(Sm), NULL, init_psm },
+    [InitService_Socket] = { "socket", "bsd:u", INIT_DEP(Sm), NULL, init_socket },
+    [InitService_Time] = { "time", "time:u", INIT_DEP(Sm) | INIT_DEP(Fs), NULL, init_time },
+    [InitService_Http] = { "http", NULL, INIT_DEP(Socket), NULL, init_http },
+    [InitService_Pmshell] = { "pmshell", "pm:shell", INIT_DEP(Sm) | INIT_DEP(Http), init_detection_allowed, init_pmshell },
+    [InitService_Pminfo] = { "pminfo", "pm:info", INIT_DEP(Sm) | INIT_DEP(Http), init_detection_allowed, init_pminfo },
+};
+
 void __libnx_initheap(void) {
     static u8 inner_heap[INNER_HEAP_SIZE];
     extern void* fake_heap_start;
@@ -385,29 +746,25 @@ void __libnx_initheap(void) {
 }
 
 void __appInit(void) {
-    Result rc;
-
-    // Delay early-boot service.
-    svcSleepThread(APPINIT_DELAY_NS);
-
-    rc = smInitialize();
-    if (R_FAILED(rc)) {
-        logger_set_enabled(false);
-        return;
-    }
-
-    g_sm_ready = true;
+    // Services, including sm, are brought up by the init scheduler in main().
     logger_set_enabled(false);
 }
 
 void __appExit(void) {
     set_stage("exit");
-    logger_write("shutdown: begin");
-    update_status_file("STOPPED");
+    LOG_INFO("shutdown: begin");
+    update_status_record(StatusState_Stopped);
+    status_store_close(&g_status_store);
+    telemetry_trace_stop();
+    stats_close();
 
     stop_detection_worker();
     http_server_stop(&g_server);
+    push_stop();
+    mqtt_stop();
+    flight_recorder_close();
     if (g_socket_ready) socketExit();
+    if (g_time_ready) timeExit();
     if (g_nifm_ready) nifmExit();
     if (g_applet_ready) appletExit();
     if (g_psm_ready) psmExit();
@@ -415,6 +772,7 @@ void __appExit(void) {
     if (g_pmshell_ready) pmshellExit();
     if (g_ns_ready) nsExit();
     if (g_setsys_ready) setsysExit();
+    logger_flush();
     if (g_fs_ready) {
         fsdevUnmountAll();
         fsExit();
@@ -428,140 +786,70 @@ void __appExit(void) {
 
 int main(int argc, char* argv[]) {
     u64 ticks = 0;
-    bool http_started = false;
+    u64 next_tick_ns = 0;
 
     (void)argc;
     (void)argv;
 
+    logger_init();
+    flight_recorder_init();
+    memory_register_heap(INNER_HEAP_SIZE);
     memset(&g_server, 0, sizeof(g_server));
     telemetry_init(&g_telemetry);
+    demand_init(refresh_telemetry);
+    config_init();
+    apply_config_if_changed();
     g_session_id = sec_since_boot_now();
+    init_sched_setup(g_init_services, InitService_Count);
 
     while (1) {
-        if ((ticks % INIT_RETRY_TICKS) == 0) {
-            Result rc;
-
-            if (!g_fs_ready) {
-                set_stage("fs.init");
-                rc = fsInitialize();
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) {
-                    rc = fsdevMountSdmc();
-                    g_last_rc = rc;
-                    if (R_SUCCEEDED(rc)) {
-                        g_fs_ready = true;
-                        mkdir("sdmc:/switch", 0777);
-                        mkdir("sdmc:/switch/switch-dcrpc", 0777);
-                        logger_set_enabled(true);
-                        logger_write("boot: fs ready");
-                        detect_previous_unclean_shutdown();
-                        update_status_file("RUNNING");
-                    } else {
-                        fsExit();
-                    }
-                }
-            }
-
-            if (!g_setsys_ready) {
-                set_stage("setsys.init");
-                rc = setsysInitialize();
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) {
-                    SetSysFirmwareVersion fw;
-                    rc = setsysGetFirmwareVersion(&fw);
-                    g_last_rc = rc;
-                    if (R_SUCCEEDED(rc)) {
-                        snprintf(g_fw_str, sizeof(g_fw_str), "%u.%u.%u", fw.major, fw.minor, fw.micro);
-                        g_fw_valid = true;
-                        telemetry_set_firmware(&g_telemetry, g_fw_str);
-                        logger_write("init: firmware=%s", g_fw_str);
-                    }
-                    g_setsys_ready = true;
-                }
-            }
-
-            if (!g_nifm_ready) {
-                set_stage("nifm.init");
-                rc = nifmInitialize(NifmServiceType_User);
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) g_nifm_ready = true;
-            }
-
-            if (!g_applet_ready) {
-                set_stage("applet.init");
-                rc = appletInitialize();
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) g_applet_ready = true;
-            }
-
-            if (!g_psm_ready) {
-                set_stage("psm.init");
-                rc = psmInitialize();
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) {
-                    g_psm_ready = true;
-                }
+        const u64 retry_ms = init_sched_poll();
+        const u64 now_ns = armTicksToNs(armGetSystemTick());
+        u64 sleep_ns;
+
+        if (now_ns < next_tick_ns) {
+            sleep_ns = next_tick_ns - now_ns;
+            if (retry_ms > 0 && retry_ms * 1000000ULL < sleep_ns) sleep_ns = retry_ms * 1000000ULL;
+            logger_poll();
+            // Reactor mode waits for the next deadline in the listener's select instead.
+            if (g_http_started && g_server.reactor) {
+                http_server_poll(&g_server, sleep_ns);
+            } else {
+                svcSleepThread((s64)sleep_ns);
+                watchdog_count_wake(Watchdog_MainLoop);
             }
-
-            if (!g_socket_ready) {
-                set_stage("socket.init");
-                rc = socketInitializeDefault();
-                g_last_rc = rc;
-                if (R_SUCCEEDED(rc)) g_socket_ready = true;
-            }
-
-            if (g_socket_ready && !http_started) {
-                set_stage("http.start");
-                http_started = http_server_start(&g_server, &g_telemetry, HTTP_PORT);
-                logger_write("http: start %s port=%d", http_started ? "ok" : "failed", HTTP_PORT);
+            continue;
+        }
+        next_tick_ns = now_ns + g_loop_interval_ns;
+        set_stage("loop");
+        monitor_network(now_ns);
+        supervise_http();
+
+        if ((ticks % g_maintenance_ticks) == 0 && g_fs_ready) {
+            config_reload_if_changed();
+            telemetry_trace_flush();
+            flight_recorder_poll();
+        }
+        apply_config_if_changed();
+
+        if ((ticks % g_maintenance_ticks) == 0) {
+            g_detection_services_ready = (g_pmshell_ready && g_pminfo_ready);
+            if (g_detection_services_ready && !g_detection_services_ready_logged) {
+                g_detection_services_ready_logged = true;
+                LOG_INFO(
+                    "detect: services ready (pmshell=%d pminfo=%d)",
+                    g_pmshell_ready,
+                    g_pminfo_ready
+                );
             }
 
-            refresh_detection_kill_switch();
-
-            // Start detection
-            if (http_started && ENABLE_RISKY_MAINLOOP_DETECTION && !g_detection_kill_switch) { 
-                if (ENABLE_PM_SERVICES && !g_pmshell_ready) { 
-                    set_stage("pmshell.init"); 
-                    rc = pmshellInitialize(); 
-                    g_last_rc = rc; 
-                    if (R_SUCCEEDED(rc)) { 
-                        g_pmshell_ready = true; 
-                        logger_write("init: pmshell ready"); 
-                    } else { 
-                        logger_write("init: pmshell failed rc=0x%08lX", (unsigned long)rc); 
-                    } 
-                } 
-
-                if (ENABLE_PM_SERVICES && !g_pminfo_ready) {
-                    set_stage("pminfo.init");
-                    rc = pminfoInitialize();
-                    g_last_rc = rc;
-                    if (R_SUCCEEDED(rc)) {
-                        g_pminfo_ready = true;
-                        logger_write("init: pminfo ready");
-                    } else {
-                        logger_write("init: pminfo failed rc=0x%08lX", (unsigned long)rc);
-                    }
-                }
-                
-                g_detection_services_ready = (g_pmshell_ready && g_pminfo_ready); 
-                if (g_detection_services_ready && !g_detection_services_ready_logged) { 
-                    g_detection_services_ready_logged = true; 
-                    logger_write( 
-                        "detect: services ready (pmshell=%d pminfo=%d)", 
-                        g_pmshell_ready, 
-                        g_pminfo_ready 
-                    ); 
-                } 
-            } 
-
-            if (ENABLE_DETECTION_WORKER && http_started && !g_detection_thread_started && !g_detection_kill_switch) {
+            if (ENABLE_DETECTION_WORKER && g_http_started && !g_detection_thread_started && !g_detection_kill_switch) {
                 const u64 uptime = sec_since_boot_now();
                 if (uptime >= DETECTION_START_DELAY_SEC) {
                     start_detection_worker();
                 } else if (!g_detection_wait_logged) {
                     g_detection_wait_logged = true;
-                    logger_write(
+                    LOG_INFO(
                         "detector: delayed start active (uptime=%llus < %us)",
                         (unsigned long long)uptime,
                         (unsigned int)DETECTION_START_DELAY_SEC
@@ -575,7 +863,7 @@ int main(int argc, char* argv[]) {
                     (g_detection_thread_last_heartbeat_sec > 0) &&
                     ((now - g_detection_thread_last_heartbeat_sec) > DETECTION_HEARTBEAT_TIMEOUT_SEC);
                 if (!g_detection_thread_alive || stale_heartbeat) {
-                    logger_write(
+                    LOG_WARN(
                         "detector: stale worker detected (alive=%d last_hb=%llus now=%llus), disabling detection",
                         g_detection_thread_alive ? 1 : 0,
                         (unsigned long long)g_detection_thread_last_heartbeat_sec,
@@ -584,7 +872,7 @@ int main(int argc, char* argv[]) {
                     g_detection_kill_switch = true;
                     g_detection_disabled_until_sec = now + DETECTION_STALE_DISABLE_SEC;
                     stop_detection_worker();
-                    logger_write(
+                    LOG_WARN(
                         "detector: disabled for %us after stale worker",
                         (unsigned int)DETECTION_STALE_DISABLE_SEC
                     );
@@ -593,7 +881,7 @@ int main(int argc, char* argv[]) {
         }
 
         if (ticks == 0) {
-            logger_write(
+            LOG_INFO(
                 "telemetry: mode=%s",
                 ENABLE_DETECTION_WORKER ? "worker-detection" :
                 (ENABLE_RISKY_MAINLOOP_DETECTION ?
@@ -602,22 +890,18 @@ int main(int argc, char* argv[]) {
             );
         }
         set_stage("telemetry.update");
-        telemetry_update(
-            &g_telemetry,
-            ENABLE_RISKY_MAINLOOP_DETECTION && http_started && g_detection_services_ready && !g_detection_kill_switch,
-            g_psm_ready,
-            g_applet_ready
-        );
-        if (ENABLE_RISKY_MAINLOOP_DETECTION && http_started && g_detection_services_ready && !g_detection_kill_switch) {
+        if (demand_should_sample(push_active() || mqtt_connected())) {
+            refresh_telemetry();
+        }
+        sample_stats();
+        if (ENABLE_RISKY_MAINLOOP_DETECTION && g_http_started && g_detection_services_ready && !g_detection_kill_switch) {
             log_active_title_if_changed();
         }
 
-        if ((ticks % HEARTBEAT_TICKS) == 0) {
-            char dbg[512];
+        if ((ticks % g_heartbeat_ticks) == 0) {
             g_heartbeat_count++;
             set_stage("heartbeat");
-            http_server_build_debug_json(&g_server, dbg, sizeof(dbg));
-            logger_write(
+            LOG_INFO(
                 "heartbeat: n=%llu uptime=%llus stage=%s rc=0x%08lX sm=%d fs=%d setsys=%d applet=%d pmshell=%d pminfo=%d nifm=%d socket=%d http_started=%d detector_started=%d detector_run=%d detector_alive=%d detector_hb=%llu detector_ns=%d detector_streak=%u detector_kill=%d cooldown_until=%llu unclean_prev=%d", 
                 (unsigned long long)g_heartbeat_count,
                 (unsigned long long)sec_since_boot_now(),
@@ -631,7 +915,7 @@ int main(int argc, char* argv[]) {
                 g_pminfo_ready, 
                 g_nifm_ready,
                 g_socket_ready,
-                http_started,
+                g_http_started,
                 g_detection_thread_started,
                 g_detection_thread_running ? 1 : 0,
                 g_detection_thread_alive ? 1 : 0,
@@ -642,12 +926,14 @@ int main(int argc, char* argv[]) {
                 (unsigned long long)g_detection_disabled_until_sec,
                 g_unclean_prev
             );
-            logger_write("heartbeat-http: %s", dbg);
-            update_status_file("RUNNING");
+            // The snapshot is most of the log's volume and stays raw text in binary mode.
+            if (g_heartbeat_debug_every != 0 && (g_heartbeat_count - 1) % g_heartbeat_debug_every == 0) {
+                log_debug_snapshot();
+            }
+            update_status_record(StatusState_Running);
         }
 
         ticks++;
-        svcSleepThread(LOOP_SLEEP_NS);
     }
 
     return 0;
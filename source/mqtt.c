@@ -0,0 +1,766 @@
+#include "mqtt.h"
+
+#include "arena.h"
+#include "logger.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MQTT_STACK_SIZE (16 * 1024)
+#define MQTT_THREAD_PRIO 0x2C
+#define MQTT_THREAD_CPUID -2
+#define MQTT_TX_MAX 1024
+#define MQTT_RX_MAX 256
+#define MQTT_VALUE_MAX 64
+#define MQTT_TOPIC_MAX 96
+#define MQTT_CONNECT_TIMEOUT_MS 5000
+#define MQTT_RESPONSE_TIMEOUT_MS 10000 // CONNACK, PINGRESP, PUBACK before a retry
+#define MQTT_BACKOFF_MIN_MS 1000
+#define MQTT_BACKOFF_MAX_MS 60000
+#define MQTT_BACKOFF_RESET_MS 30000 // a connection must last this long to reset backoff
+#define MQTT_IDLE_WAIT_NS (3600ULL * 1000000000ULL) // disabled: only mqtt_configure wakes us
+#define MQTT_ERROR_LOG_INTERVAL_MS 60000
+#define MQTT_STOP_TIMEOUT_NS (2000ULL * 1000000ULL)
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+typedef enum {
+    MqttState_Disabled = 0,
+    MqttState_Backoff,
+    MqttState_Connected,
+} MqttState;
+
+static const char* const g_mqtt_state_names[] = {
+    [MqttState_Disabled] = "disabled",
+    [MqttState_Backoff] = "backoff",
+    [MqttState_Connected] = "connected",
+};
+
+typedef void (*MqttFormatFn)(const TelemetryState* s, char* out, size_t size);
+
+typedef struct {
+    const char* name; // topic suffix
+    MqttFormatFn format;
+} MqttTopicDef;
+
+typedef struct {
+    char value[MQTT_VALUE_MAX]; // last value handed to the broker
+    bool dirty;                 // publish even if unchanged (after a reconnect)
+    u16 pending_id;             // QoS 1 packet awaiting PUBACK; 0 = none
+    u64 pending_ms;
+} MqttTopicState;
+
+typedef struct {
+    bool enabled;
+    char host[64];
+    s32 port;
+    char console[32];
+    char user[32];
+    char password[64];
+    s32 qos;
+    s32 keepalive_sec;
+    s32 batch_ms;
+} MqttSettings;
+
+static void format_online(const TelemetryState* s, char* out, size_t size);
+static void format_firmware(const TelemetryState* s, char* out, size_t size);
+static void format_program_id(const TelemetryState* s, char* out, size_t size);
+static void format_game(const TelemetryState* s, char* out, size_t size);
+static void format_battery(const TelemetryState* s, char* out, size_t size);
+static void format_charging(const TelemetryState* s, char* out, size_t size);
+static void format_charger_type(const TelemetryState* s, char* out, size_t size);
+static void format_docked(const TelemetryState* s, char* out, size_t size);
+
+static const MqttTopicDef g_mqtt_topics[] = {
+    { "online", format_online }, // must stay first: the will message targets it
+    { "firmware", format_firmware },
+    { "active_program_id", format_program_id },
+    { "active_game", format_game },
+    { "battery_percent", format_battery },
+    { "is_charging", format_charging },
+    { "charger_type", format_charger_type },
+    { "is_docked", format_docked },
+};
+
+#define MQTT_TOPIC_COUNT (sizeof(g_mqtt_topics) / sizeof(g_mqtt_topics[0]))
+
+typedef struct {
+    TelemetryState snap;
+    MqttTopicState topics[MQTT_TOPIC_COUNT];
+    u8 tx[MQTT_TX_MAX];
+    u8 rx[MQTT_RX_MAX];
+} MqttScratch;
+
+typedef struct {
+    RMutex lock; // zero-init is a valid RMutex; guards pending settings
+    MqttSettings pending;
+    volatile bool reconfigure;
+    MqttSettings cur; // thread-owned copy
+    TelemetryState* telemetry;
+    Thread thread;
+    UEvent event;
+    volatile bool running;
+    volatile bool notified;
+    volatile int state;
+    int fd;
+    MqttScratch* scratch;
+    size_t tx_len;
+    size_t rx_len;
+    u16 next_packet_id;
+    u32 backoff_ms;
+    u64 reconnect_due_ms;
+    u64 connected_ms;
+    u64 batch_due_ms; // 0 = no batch pending
+    u64 last_tx_ms;
+    u64 ping_sent_ms; // 0 = no PINGREQ outstanding
+    // counters for /debug
+    volatile u64 connects;
+    volatile u64 connect_failures;
+    volatile u64 disconnects;
+    volatile u64 batches;
+    volatile u64 publishes;
+    volatile u64 acks;
+    volatile u64 retransmits;
+    volatile u64 pings;
+    volatile u64 bytes_sent;
+    volatile int last_errno;
+    volatile int last_connack;
+} MqttClient;
+
+static u8 g_mqtt_thread_stack[MQTT_STACK_SIZE] __attribute__((aligned(0x1000)));
+// Snapshot, per-topic state and packet buffers; owned by the MQTT thread.
+ARENA_DEFINE(g_mqtt_arena, "mqtt", sizeof(MqttScratch) + ARENA_ALIGN);
+
+static MqttClient g_mqtt = { .fd = -1 };
+
+static u64 mqtt_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+// topic values ---------------------------------------------------------------------
+
+static void format_online(const TelemetryState* s, char* out, size_t size) {
+    (void)s;
+    snprintf(out, size, "true");
+}
+
+static void format_firmware(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "%s", s->firmware);
+}
+
+static void format_program_id(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "0x%016llX", (unsigned long long)s->active_program_id);
+}
+
+static void format_game(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "%s", s->active_game);
+}
+
+static void format_battery(const TelemetryState* s, char* out, size_t size) {
+    if (s->battery_percent_valid) {
+        snprintf(out, size, "%u", (unsigned int)s->battery_percent);
+    } else {
+        snprintf(out, size, "null");
+    }
+}
+
+static void format_charging(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "%s", !s->is_charging_valid ? "null" : (s->is_charging ? "true" : "false"));
+}
+
+static void format_charger_type(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "%u", (unsigned int)s->charger_type);
+}
+
+static void format_docked(const TelemetryState* s, char* out, size_t size) {
+    snprintf(out, size, "%s", !s->is_docked_valid ? "null" : (s->is_docked ? "true" : "false"));
+}
+
+// packets --------------------------------------------------------------------------
+
+static size_t mqtt_topic_name(char* out, size_t size, const char* suffix) {
+    const int n = snprintf(out, size, "richnx/%s/%s", g_mqtt.cur.console, suffix);
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
+static u8* mqtt_put_u16(u8* p, u16 v) {
+    *p++ = (u8)(v >> 8);
+    *p++ = (u8)v;
+    return p;
+}
+
+static u8* mqtt_put_string(u8* p, const char* s, size_t len) {
+    p = mqtt_put_u16(p, (u16)len);
+    memcpy(p, s, len);
+    return p + len;
+}
+
+// Appends a packet's fixed header; returns NULL if header plus body do not fit.
+static u8* mqtt_begin_packet(u8 type, size_t body_len) {
+    u8 header[5];
+    size_t n = 0;
+    size_t rem = body_len;
+    u8* p;
+
+    header[n++] = type;
+    do {
+        u8 b = (u8)(rem & 0x7F);
+        rem >>= 7;
+        if (rem > 0) b |= 0x80;
+        header[n++] = b;
+    } while (rem > 0);
+
+    if (g_mqtt.tx_len + n + body_len > MQTT_TX_MAX) return NULL;
+    p = g_mqtt.scratch->tx + g_mqtt.tx_len;
+    memcpy(p, header, n);
+    g_mqtt.tx_len += n + body_len;
+    return p + n;
+}
+
+static void mqtt_close(const char* why) {
+    if (g_mqtt.fd < 0) return;
+    close(g_mqtt.fd);
+    g_mqtt.fd = -1;
+    g_mqtt.disconnects++;
+    LOG_WARN("mqtt: disconnected (%s)", why);
+}
+
+static bool mqtt_flush(void) {
+    size_t off = 0;
+
+    while (off < g_mqtt.tx_len) {
+        const ssize_t n = send(g_mqtt.fd, g_mqtt.scratch->tx + off, g_mqtt.tx_len - off, 0);
+        if (n <= 0) {
+            g_mqtt.last_errno = errno;
+            g_mqtt.tx_len = 0;
+            return false;
+        }
+        off += (size_t)n;
+    }
+    g_mqtt.bytes_sent += g_mqtt.tx_len;
+    g_mqtt.tx_len = 0;
+    g_mqtt.last_tx_ms = mqtt_now_ms();
+    return true;
+}
+
+static u16 mqtt_packet_id(void) {
+    if (++g_mqtt.next_packet_id == 0) g_mqtt.next_packet_id = 1;
+    return g_mqtt.next_packet_id;
+}
+
+// Queues a retained PUBLISH; returns false when the buffer is full.
+static bool mqtt_queue_publish(const char* suffix, const char* value, int qos, bool dup, u16 packet_id) {
+    char topic[MQTT_TOPIC_MAX];
+    const size_t topic_len = mqtt_topic_name(topic, sizeof(topic), suffix);
+    const size_t value_len = strlen(value);
+    u8* p;
+
+    if (topic_len == 0) return true; // console name too long; nothing sensible to send
+    p = mqtt_begin_packet(
+        (u8)(MQTT_PUBLISH | (dup ? 0x08 : 0) | (qos << 1) | 0x01),
+        2 + topic_len + (qos > 0 ? 2 : 0) + value_len
+    );
+    if (!p) return false;
+    p = mqtt_put_string(p, topic, topic_len);
+    if (qos > 0) p = mqtt_put_u16(p, packet_id);
+    memcpy(p, value, value_len);
+    return true;
+}
+
+static bool mqtt_send_connect(void) {
+    const MqttSettings* cfg = &g_mqtt.cur;
+    char client_id[24];
+    char will_topic[MQTT_TOPIC_MAX];
+    const size_t will_len = mqtt_topic_name(will_topic, sizeof(will_topic), g_mqtt_topics[0].name);
+    const size_t user_len = strlen(cfg->user);
+    const size_t pass_len = strlen(cfg->password);
+    size_t id_len;
+    size_t body;
+    u8 flags = 0x02 | 0x04 | 0x08 | 0x20; // clean session, will at QoS 1, retained
+    u8* p;
+
+    snprintf(client_id, sizeof(client_id), "richnx-%.16s", cfg->console); // 3.1.1 brokers must accept 23
+    id_len = strlen(client_id);
+    body = 10 + 2 + id_len + 2 + will_len + 2 + 5;
+    if (user_len > 0) {
+        flags |= 0x80;
+        body += 2 + user_len;
+        if (pass_len > 0) {
+            flags |= 0x40;
+            body += 2 + pass_len;
+        }
+    }
+    p = mqtt_begin_packet(MQTT_CONNECT, body);
+    if (!p) return false;
+    p = mqtt_put_string(p, "MQTT", 4);
+    *p++ = 4; // protocol level 3.1.1
+    *p++ = flags;
+    p = mqtt_put_u16(p, (u16)cfg->keepalive_sec);
+    p = mqtt_put_string(p, client_id, id_len);
+    p = mqtt_put_string(p, will_topic, will_len);
+    p = mqtt_put_string(p, "false", 5);
+    if (flags & 0x80) p = mqtt_put_string(p, cfg->user, user_len);
+    if (flags & 0x40) p = mqtt_put_string(p, cfg->password, pass_len);
+    return mqtt_flush();
+}
+
+// Reads whatever the broker sent and handles complete packets. Returns false
+// if the connection is gone or the broker sent something unexpected.
+static bool mqtt_receive(void) {
+    u8* rx = g_mqtt.scratch->rx;
+
+    for (;;) {
+        const ssize_t n = recv(g_mqtt.fd, rx + g_mqtt.rx_len, MQTT_RX_MAX - g_mqtt.rx_len, MSG_DONTWAIT);
+        if (n == 0) return false;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            g_mqtt.last_errno = errno;
+            return false;
+        }
+        g_mqtt.rx_len += (size_t)n;
+
+        // Only CONNACK, PUBACK and PINGRESP are expected; all fit in 4 bytes.
+        while (g_mqtt.rx_len >= 2) {
+            const u8 type = rx[0] & 0xF0;
+            const size_t len = rx[1];
+            if (rx[1] & 0x80) return false;
+            if (g_mqtt.rx_len < 2 + len) break;
+
+            if (type == MQTT_PUBACK && len == 2) {
+                const u16 id = (u16)((rx[2] << 8) | rx[3]);
+                size_t t;
+                for (t = 0; t < MQTT_TOPIC_COUNT; t++) {
+                    if (g_mqtt.scratch->topics[t].pending_id == id) {
+                        g_mqtt.scratch->topics[t].pending_id = 0;
+                        g_mqtt.acks++;
+                    }
+                }
+            } else if (type == MQTT_PINGRESP) {
+                g_mqtt.ping_sent_ms = 0;
+            } else {
+                return false;
+            }
+            memmove(rx, rx + 2 + len, g_mqtt.rx_len - 2 - len);
+            g_mqtt.rx_len -= 2 + len;
+        }
+        if (g_mqtt.rx_len == MQTT_RX_MAX) return false;
+    }
+    return true;
+}
+
+// connection -----------------------------------------------------------------------
+
+static int mqtt_open_socket(void) {
+    struct addrinfo hints;
+    struct addrinfo* res = NULL;
+    char port[8];
+    struct timeval tv;
+    fd_set wfds;
+    int fd;
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%d", (int)g_mqtt.cur.port);
+    if (getaddrinfo(g_mqtt.cur.host, port, &hints, &res) != 0 || !res) {
+        g_mqtt.last_errno = EHOSTUNREACH;
+        return -1;
+    }
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        g_mqtt.last_errno = errno;
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    // Bounded connect: non-blocking connect, then wait for writability.
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    if (connect(fd, res->ai_addr, res->ai_addrlen) != 0 && errno != EINPROGRESS) {
+        err = errno;
+    } else {
+        FD_ZERO(&wfds);
+        FD_SET(fd, &wfds);
+        tv.tv_sec = MQTT_CONNECT_TIMEOUT_MS / 1000;
+        tv.tv_usec = 0;
+        if (select(fd + 1, NULL, &wfds, NULL, &tv) != 1) {
+            err = ETIMEDOUT;
+        } else if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len) != 0) {
+            err = errno;
+        }
+    }
+    freeaddrinfo(res);
+    if (err != 0) {
+        g_mqtt.last_errno = err;
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    tv.tv_sec = MQTT_CONNECT_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// Connects and waits for CONNACK; on success every topic is marked for republish.
+static bool mqtt_connect(void) {
+    struct timeval tv;
+    fd_set rfds;
+    size_t t;
+
+    g_mqtt.fd = mqtt_open_socket();
+    if (g_mqtt.fd < 0) return false;
+    g_mqtt.tx_len = 0;
+    g_mqtt.rx_len = 0;
+    if (!mqtt_send_connect()) goto fail;
+
+    FD_ZERO(&rfds);
+    FD_SET(g_mqtt.fd, &rfds);
+    tv.tv_sec = MQTT_RESPONSE_TIMEOUT_MS / 1000;
+    tv.tv_usec = 0;
+    while (g_mqtt.rx_len < 4) {
+        ssize_t n;
+        if (select(g_mqtt.fd + 1, &rfds, NULL, NULL, &tv) != 1) {
+            g_mqtt.last_errno = ETIMEDOUT;
+            goto fail;
+        }
+        n = recv(g_mqtt.fd, g_mqtt.scratch->rx + g_mqtt.rx_len, 4 - g_mqtt.rx_len, 0);
+        if (n <= 0) {
+            g_mqtt.last_errno = n < 0 ? errno : ECONNRESET;
+            goto fail;
+        }
+        g_mqtt.rx_len += (size_t)n;
+    }
+    g_mqtt.rx_len = 0;
+    if (g_mqtt.scratch->rx[0] != MQTT_CONNACK || g_mqtt.scratch->rx[1] != 2) goto fail;
+    g_mqtt.last_connack = g_mqtt.scratch->rx[3];
+    if (g_mqtt.last_connack != 0) goto fail;
+
+    for (t = 0; t < MQTT_TOPIC_COUNT; t++) {
+        g_mqtt.scratch->topics[t].dirty = true;
+        g_mqtt.scratch->topics[t].pending_id = 0;
+    }
+    g_mqtt.ping_sent_ms = 0;
+    g_mqtt.batch_due_ms = mqtt_now_ms(); // publish the current state right away
+    return true;
+
+fail:
+    close(g_mqtt.fd);
+    g_mqtt.fd = -1;
+    return false;
+}
+
+// A clean DISCONNECT makes the broker discard the will, so "online" is set
+// to false by hand first; QoS 0 is enough as the broker handles the packets
+// in order.
+static void mqtt_disconnect_clean(void) {
+    if (g_mqtt.fd < 0) return;
+    g_mqtt.tx_len = 0;
+    if (mqtt_queue_publish(g_mqtt_topics[0].name, "false", 0, false, 0) && mqtt_begin_packet(MQTT_DISCONNECT, 0)) {
+        mqtt_flush();
+    }
+    close(g_mqtt.fd);
+    g_mqtt.fd = -1;
+}
+
+static void mqtt_schedule_reconnect(u64 now) {
+    g_mqtt.state = MqttState_Backoff;
+    if (g_mqtt.connected_ms != 0 && now - g_mqtt.connected_ms >= MQTT_BACKOFF_RESET_MS) g_mqtt.backoff_ms = 0;
+    g_mqtt.connected_ms = 0;
+    g_mqtt.backoff_ms = g_mqtt.backoff_ms == 0 ? MQTT_BACKOFF_MIN_MS :
+                        (g_mqtt.backoff_ms >= MQTT_BACKOFF_MAX_MS / 2 ? MQTT_BACKOFF_MAX_MS : g_mqtt.backoff_ms * 2);
+    g_mqtt.reconnect_due_ms = now + g_mqtt.backoff_ms;
+}
+
+// publishing -----------------------------------------------------------------------
+
+// Publishes changed topics and retransmits unacknowledged QoS 1 ones, in one write.
+static bool mqtt_publish_changes(u64 now, bool collect) {
+    MqttScratch* s = g_mqtt.scratch;
+    char value[MQTT_VALUE_MAX];
+    bool any = false;
+    size_t t;
+
+    if (collect) telemetry_copy(g_mqtt.telemetry, &s->snap);
+    g_mqtt.tx_len = 0;
+    for (t = 0; t < MQTT_TOPIC_COUNT; t++) {
+        MqttTopicState* ts = &s->topics[t];
+        bool dup = false;
+
+        if (collect) {
+            g_mqtt_topics[t].format(&s->snap, value, sizeof(value));
+            if (ts->dirty || strcmp(value, ts->value) != 0) {
+                snprintf(ts->value, sizeof(ts->value), "%s", value);
+                ts->dirty = false;
+                ts->pending_id = g_mqtt.cur.qos > 0 ? mqtt_packet_id() : 0;
+            } else if (ts->pending_id == 0 || now - ts->pending_ms < MQTT_RESPONSE_TIMEOUT_MS) {
+                continue;
+            } else {
+                dup = true;
+            }
+        } else if (ts->pending_id == 0 || now - ts->pending_ms < MQTT_RESPONSE_TIMEOUT_MS) {
+            continue;
+        } else {
+            dup = true;
+        }
+
+        if (!mqtt_queue_publish(g_mqtt_topics[t].name, ts->value, g_mqtt.cur.qos, dup, ts->pending_id)) {
+            if (!mqtt_flush()) return false;
+            mqtt_queue_publish(g_mqtt_topics[t].name, ts->value, g_mqtt.cur.qos, dup, ts->pending_id);
+        }
+        ts->pending_ms = now;
+        any = true;
+        if (dup) {
+            g_mqtt.retransmits++;
+        } else {
+            g_mqtt.publishes++;
+        }
+    }
+    if (!any) return true;
+    g_mqtt.batches++;
+    return mqtt_flush();
+}
+
+// Earliest QoS 1 retransmit deadline, or 0.
+static u64 mqtt_retry_due(void) {
+    u64 due = 0;
+    size_t t;
+
+    for (t = 0; t < MQTT_TOPIC_COUNT; t++) {
+        const MqttTopicState* ts = &g_mqtt.scratch->topics[t];
+        if (ts->pending_id == 0) continue;
+        if (due == 0 || ts->pending_ms + MQTT_RESPONSE_TIMEOUT_MS < due) due = ts->pending_ms + MQTT_RESPONSE_TIMEOUT_MS;
+    }
+    return due;
+}
+
+// thread ---------------------------------------------------------------------------
+
+static bool mqtt_settings_valid(const MqttSettings* cfg) {
+    return cfg->host[0] != '\0' && cfg->console[0] != '\0' && strpbrk(cfg->console, "/+#") == NULL;
+}
+
+static void mqtt_apply_settings(void) {
+    MqttSettings next;
+
+    rmutexLock(&g_mqtt.lock);
+    next = g_mqtt.pending;
+    g_mqtt.reconfigure = false;
+    rmutexUnlock(&g_mqtt.lock);
+
+    if (memcmp(&next, &g_mqtt.cur, sizeof(next)) == 0) return;
+    if (g_mqtt.fd >= 0) {
+        mqtt_disconnect_clean();
+        LOG_INFO("mqtt: settings changed, reconnecting");
+    }
+    g_mqtt.cur = next;
+    g_mqtt.backoff_ms = 0;
+    g_mqtt.reconnect_due_ms = 0;
+    g_mqtt.connected_ms = 0;
+    if (g_mqtt.cur.enabled && !mqtt_settings_valid(&g_mqtt.cur)) {
+        LOG_WARN("mqtt: enabled but mqtt_host is empty or mqtt_console holds / + #");
+    }
+    g_mqtt.state = (g_mqtt.cur.enabled && mqtt_settings_valid(&g_mqtt.cur)) ? MqttState_Backoff : MqttState_Disabled;
+}
+
+// Runs one round of work and returns how long the thread may sleep.
+static u64 mqtt_service(void) {
+    u64 now = mqtt_now_ms();
+    u64 keepalive_ms;
+    u64 next;
+    u64 retry;
+
+    if (g_mqtt.reconfigure) mqtt_apply_settings();
+    keepalive_ms = (u64)g_mqtt.cur.keepalive_sec * 1000ULL;
+    if (g_mqtt.state == MqttState_Disabled) {
+        g_mqtt.notified = false;
+        return MQTT_IDLE_WAIT_NS;
+    }
+
+    if (g_mqtt.fd < 0) {
+        if (now < g_mqtt.reconnect_due_ms) return (g_mqtt.reconnect_due_ms - now) * 1000000ULL;
+        if (!mqtt_connect()) {
+            g_mqtt.connect_failures++;
+            mqtt_schedule_reconnect(now);
+            LOG_WARN_RATELIMITED(
+                MQTT_ERROR_LOG_INTERVAL_MS,
+                "mqtt: connect to %s:%d failed errno=%d connack=%d, retry in %ums",
+                g_mqtt.cur.host,
+                (int)g_mqtt.cur.port,
+                g_mqtt.last_errno,
+                g_mqtt.last_connack,
+                (unsigned int)g_mqtt.backoff_ms
+            );
+            return (u64)g_mqtt.backoff_ms * 1000000ULL;
+        }
+        now = mqtt_now_ms();
+        g_mqtt.connects++;
+        g_mqtt.connected_ms = now;
+        g_mqtt.state = MqttState_Connected;
+        LOG_INFO("mqtt: connected to %s:%d as richnx-%s", g_mqtt.cur.host, (int)g_mqtt.cur.port, g_mqtt.cur.console);
+    }
+
+    if (!mqtt_receive()) {
+        mqtt_close("connection lost");
+        mqtt_schedule_reconnect(now);
+        return (u64)g_mqtt.backoff_ms * 1000000ULL;
+    }
+    if (g_mqtt.ping_sent_ms != 0 && now - g_mqtt.ping_sent_ms >= MQTT_RESPONSE_TIMEOUT_MS) {
+        mqtt_close("no PINGRESP");
+        mqtt_schedule_reconnect(now);
+        return (u64)g_mqtt.backoff_ms * 1000000ULL;
+    }
+
+    if (g_mqtt.notified && g_mqtt.batch_due_ms == 0) {
+        g_mqtt.batch_due_ms = now + (u64)g_mqtt.cur.batch_ms;
+    }
+    g_mqtt.notified = false;
+    retry = mqtt_retry_due();
+    if ((g_mqtt.batch_due_ms != 0 && now >= g_mqtt.batch_due_ms) || (retry != 0 && now >= retry)) {
+        const bool collect = g_mqtt.batch_due_ms != 0 && now >= g_mqtt.batch_due_ms;
+        if (collect) g_mqtt.batch_due_ms = 0;
+        if (!mqtt_publish_changes(now, collect)) {
+            mqtt_close("send failed");
+            mqtt_schedule_reconnect(now);
+            return (u64)g_mqtt.backoff_ms * 1000000ULL;
+        }
+    }
+    if (g_mqtt.ping_sent_ms == 0 && now - g_mqtt.last_tx_ms >= keepalive_ms * 3 / 4) {
+        g_mqtt.tx_len = 0;
+        if (!mqtt_begin_packet(MQTT_PINGREQ, 0) || !mqtt_flush()) {
+            mqtt_close("send failed");
+            mqtt_schedule_reconnect(now);
+            return (u64)g_mqtt.backoff_ms * 1000000ULL;
+        }
+        g_mqtt.ping_sent_ms = now;
+        g_mqtt.pings++;
+    }
+
+    next = g_mqtt.last_tx_ms + keepalive_ms * 3 / 4;
+    if (g_mqtt.ping_sent_ms != 0) next = g_mqtt.ping_sent_ms + MQTT_RESPONSE_TIMEOUT_MS;
+    if (g_mqtt.batch_due_ms != 0 && g_mqtt.batch_due_ms < next) next = g_mqtt.batch_due_ms;
+    retry = mqtt_retry_due();
+    if (retry != 0 && retry < next) next = retry;
+    return (next > now ? next - now : 1) * 1000000ULL;
+}
+
+static void mqtt_thread(void* arg) {
+    (void)arg;
+
+    while (g_mqtt.running) {
+        const u64 wait_ns = mqtt_service();
+        if (!g_mqtt.running) break;
+        waitSingle(waiterForUEvent(&g_mqtt.event), wait_ns);
+    }
+    mqtt_disconnect_clean();
+}
+
+// lifecycle ------------------------------------------------------------------------
+
+bool mqtt_start(TelemetryState* telemetry) {
+    Result rc;
+
+    if (g_mqtt.running) return true;
+    arena_register(&g_mqtt_arena);
+    if (!g_mqtt.scratch) {
+        g_mqtt.scratch = (MqttScratch*)arena_alloc(&g_mqtt_arena, sizeof(MqttScratch));
+        if (!g_mqtt.scratch) return false;
+        memset(g_mqtt.scratch, 0, sizeof(*g_mqtt.scratch));
+    }
+    ueventCreate(&g_mqtt.event, true);
+    g_mqtt.telemetry = telemetry;
+    g_mqtt.running = true;
+
+    memory_register_stack("mqtt", g_mqtt_thread_stack, MQTT_STACK_SIZE);
+    rc = threadCreate(&g_mqtt.thread, mqtt_thread, NULL, g_mqtt_thread_stack, MQTT_STACK_SIZE, MQTT_THREAD_PRIO, MQTT_THREAD_CPUID);
+    if (R_FAILED(rc)) {
+        LOG_ERROR("mqtt: threadCreate failed rc=0x%08lX", (unsigned long)rc);
+        g_mqtt.running = false;
+        return false;
+    }
+    rc = threadStart(&g_mqtt.thread);
+    if (R_FAILED(rc)) {
+        LOG_ERROR("mqtt: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        threadClose(&g_mqtt.thread);
+        g_mqtt.running = false;
+        return false;
+    }
+    return true;
+}
+
+void mqtt_stop(void) {
+    if (!g_mqtt.running) return;
+    g_mqtt.running = false;
+    ueventSignal(&g_mqtt.event);
+    if (R_SUCCEEDED(waitSingleHandle(g_mqtt.thread.handle, MQTT_STOP_TIMEOUT_NS))) {
+        threadClose(&g_mqtt.thread);
+    } else {
+        LOG_WARN("mqtt: thread did not exit");
+    }
+}
+
+void mqtt_configure(const Config* cfg) {
+    MqttSettings next;
+
+    memset(&next, 0, sizeof(next));
+    next.enabled = cfg->mqtt_enabled != 0;
+    memcpy(next.host, cfg->mqtt_host, sizeof(next.host));
+    next.port = cfg->mqtt_port;
+    memcpy(next.console, cfg->mqtt_console, sizeof(next.console));
+    memcpy(next.user, cfg->mqtt_user, sizeof(next.user));
+    memcpy(next.password, cfg->mqtt_password, sizeof(next.password));
+    next.qos = cfg->mqtt_qos;
+    next.keepalive_sec = cfg->mqtt_keepalive_sec;
+    next.batch_ms = cfg->mqtt_batch_ms;
+
+    rmutexLock(&g_mqtt.lock);
+    g_mqtt.pending = next;
+    g_mqtt.reconfigure = true;
+    rmutexUnlock(&g_mqtt.lock);
+    if (g_mqtt.running) ueventSignal(&g_mqtt.event);
+}
+
+void mqtt_notify(void) {
+    if (!g_mqtt.running || g_mqtt.state != MqttState_Connected) return;
+    g_mqtt.notified = true;
+    ueventSignal(&g_mqtt.event);
+}
+
+bool mqtt_connected(void) {
+    return g_mqtt.running && g_mqtt.state == MqttState_Connected;
+}
+
+void mqtt_write_json(JsonWriter* w) {
+    json_begin_object(w);
+    json_field_string(w, "state", g_mqtt_state_names[g_mqtt.state]);
+    json_field_string(w, "host", g_mqtt.cur.host);
+    json_field_u64(w, "port", (u64)g_mqtt.cur.port);
+    json_field_u64(w, "qos", (u64)g_mqtt.cur.qos);
+    json_field_u64(w, "connects", g_mqtt.connects);
+    json_field_u64(w, "connect_failures", g_mqtt.connect_failures);
+    json_field_u64(w, "disconnects", g_mqtt.disconnects);
+    json_field_u64(w, "backoff_ms", g_mqtt.state == MqttState_Backoff ? g_mqtt.backoff_ms : 0);
+    json_field_u64(w, "batches", g_mqtt.batches);
+    json_field_u64(w, "publishes", g_mqtt.publishes);
+    json_field_u64(w, "acks", g_mqtt.acks);
+    json_field_u64(w, "retransmits", g_mqtt.retransmits);
+    json_field_u64(w, "pings", g_mqtt.pings);
+    json_field_u64(w, "bytes_sent", g_mqtt.bytes_sent);
+    json_field_s64(w, "last_errno", g_mqtt.last_errno);
+    json_field_s64(w, "last_connack", g_mqtt.last_connack);
+    json_end_object(w);
+}
@@ -0,0 +1,527 @@
+#include "push.h"
+
+#include "arena.h"
+#include "logger.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define PUSH_STACK_SIZE (16 * 1024)
+#define PUSH_THREAD_PRIO 0x2C
+#define PUSH_THREAD_CPUID -2
+#define PUSH_DATAGRAM_MAX (PUSH_HEADER_SIZE + TelemetryProbe_Count * (2 + TELEMETRY_PROBE_PACK_MAX))
+#define PUSH_REFRESH_DEFAULT_SEC 30
+#define PUSH_IDLE_WAIT_NS (60ULL * 1000000000ULL) // no subscribers: only push_subscribe wakes us
+#define PUSH_ERROR_LOG_INTERVAL_MS 60000
+#define PUSH_STOP_TIMEOUT_NS (2000ULL * 1000000ULL)
+
+typedef struct {
+    TelemetryState snap;
+    u8 last[TelemetryProbe_Count][TELEMETRY_PROBE_PACK_MAX];
+    u8 last_len[TelemetryProbe_Count];
+    u8 datagram[PUSH_DATAGRAM_MAX];
+} PushScratch;
+
+typedef struct {
+    RMutex lock; // zero-init is a valid RMutex; guards subs and the counters below
+    PushSubscriber subs[PUSH_SUBSCRIBER_MAX];
+    int count;
+    TelemetryState* telemetry;
+    Thread thread;
+    UEvent event;
+    volatile bool running;
+    volatile bool notified;
+    volatile u32 refresh_sec;
+    int fd;
+    bool have_last;
+    u64 last_sample_count;
+    PushScratch* scratch;
+    u64 wakeups;
+    u64 change_datagrams;
+    u64 refresh_datagrams;
+    u64 send_errors;
+    u64 expired;
+} PushState;
+
+static u8 g_push_thread_stack[PUSH_STACK_SIZE] __attribute__((aligned(0x1000)));
+// Snapshot and per-probe last-sent payloads; owned by the push thread.
+ARENA_DEFINE(g_push_arena, "push", sizeof(PushScratch) + ARENA_ALIGN);
+
+static PushState g_push = { .refresh_sec = PUSH_REFRESH_DEFAULT_SEC, .fd = -1 };
+
+static u64 push_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+static const char* push_addr_text(u32 addr, char* buf, size_t size) {
+    struct in_addr in;
+    in.s_addr = addr;
+    return inet_ntop(AF_INET, &in, buf, (socklen_t)size) ? buf : "?";
+}
+
+// subscriptions --------------------------------------------------------------------
+
+static bool push_parse_fields(const char* text, size_t len, u32* out) {
+    char buf[64];
+    char* save = NULL;
+    char* item;
+    char* end;
+    u32 mask = 0;
+
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+
+    mask = (u32)strtoul(buf, &end, 0);
+    if (end != buf && *end == '\0') {
+        *out = mask & TELEMETRY_PROBE_ALL;
+        return *out != 0;
+    }
+    mask = 0;
+    for (item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        int id;
+        if (strcmp(item, "all") == 0) {
+            mask |= TELEMETRY_PROBE_ALL;
+            continue;
+        }
+        for (id = 0; id < TelemetryProbe_Count; id++) {
+            if (strcmp(item, telemetry_probe_name((TelemetryProbeId)id)) == 0) break;
+        }
+        if (id == TelemetryProbe_Count) return false;
+        mask |= TELEMETRY_PROBE_BIT(id);
+    }
+    *out = mask;
+    return mask != 0;
+}
+
+static bool push_parse_u32(const char* text, size_t len, u32 max, u32* out) {
+    char buf[16];
+    char* end;
+    unsigned long v;
+
+    if (len == 0 || len >= sizeof(buf)) return false;
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+    v = strtoul(buf, &end, 10);
+    if (*end != '\0' || v > max) return false;
+    *out = (u32)v;
+    return true;
+}
+
+static bool push_parse_request(
+    const char* body, size_t len, u32 peer_addr, PushSubscriber* req, char* err, size_t err_size
+) {
+    const char* p = body;
+    const char* end = body + len;
+    bool have_port = false;
+
+    memset(req, 0, sizeof(*req));
+    req->addr = peer_addr;
+    req->fields = TELEMETRY_PROBE_ALL;
+    req->lease_sec = PUSH_LEASE_DEFAULT_SEC;
+
+    while (p < end) {
+        const char* item = p;
+        const char* item_end = p;
+        const char* eq;
+        size_t key_len;
+        const char* v;
+        size_t v_len;
+        u32 value;
+
+        while (item_end < end && *item_end != '&' && *item_end != '\n') item_end++;
+        p = item_end < end ? item_end + 1 : end;
+        while (item < item_end && (*item == ' ' || *item == '\t')) item++;
+        while (item_end > item && (item_end[-1] == ' ' || item_end[-1] == '\t' || item_end[-1] == '\r')) item_end--;
+        if (item == item_end) continue;
+
+        eq = memchr(item, '=', (size_t)(item_end - item));
+        if (!eq) {
+            snprintf(err, err_size, "expected key=value");
+            return false;
+        }
+        key_len = (size_t)(eq - item);
+        v = eq + 1;
+        v_len = (size_t)(item_end - v);
+
+        if (key_len == 4 && memcmp(item, "host", 4) == 0) {
+            char host[INET_ADDRSTRLEN];
+            struct in_addr in;
+            if (v_len == 0 || v_len >= sizeof(host)) goto bad_host;
+            memcpy(host, v, v_len);
+            host[v_len] = '\0';
+            if (inet_pton(AF_INET, host, &in) != 1) goto bad_host;
+            // Streams only go back to the requester, so a request (or a web
+            // page's no-preflight POST) cannot aim them at a third party.
+            if (in.s_addr != peer_addr) {
+                snprintf(err, err_size, "host must be the requester's own address");
+                return false;
+            }
+        } else if (key_len == 4 && memcmp(item, "port", 4) == 0) {
+            if (!push_parse_u32(v, v_len, 65535, &value) || value == 0) {
+                snprintf(err, err_size, "port must be 1..65535");
+                return false;
+            }
+            req->port = (u16)value;
+            have_port = true;
+        } else if (key_len == 6 && memcmp(item, "fields", 6) == 0) {
+            if (!push_parse_fields(v, v_len, &req->fields)) {
+                snprintf(err, err_size, "fields must be probe names, \"all\" or a bit mask");
+                return false;
+            }
+        } else if (key_len == 5 && memcmp(item, "lease", 5) == 0) {
+            if (!push_parse_u32(v, v_len, PUSH_LEASE_MAX_SEC, &value) || (value != 0 && value < PUSH_LEASE_MIN_SEC)) {
+                snprintf(err, err_size, "lease must be 0 or %u..%u", PUSH_LEASE_MIN_SEC, PUSH_LEASE_MAX_SEC);
+                return false;
+            }
+            req->lease_sec = value;
+        } else {
+            snprintf(err, err_size, "unknown key %.*s", (int)(key_len > 16 ? 16 : key_len), item);
+            return false;
+        }
+    }
+    if (!have_port) {
+        snprintf(err, err_size, "port is required");
+        return false;
+    }
+    if (req->addr == 0) {
+        snprintf(err, err_size, "host is required");
+        return false;
+    }
+    return true;
+
+bad_host:
+    snprintf(err, err_size, "host must be an IPv4 address");
+    return false;
+}
+
+bool push_subscribe(const char* body, size_t len, u32 peer_addr, PushSubscriber* out, bool* busy, char* err, size_t err_size) {
+    PushSubscriber req;
+    PushSubscriber* slot = NULL;
+    char host[INET_ADDRSTRLEN];
+    const u64 now = push_now_ms();
+    int i;
+
+    *busy = false;
+    if (!push_parse_request(body, len, peer_addr, &req, err, err_size)) return false;
+    if (!g_push.running) {
+        *busy = true;
+        snprintf(err, err_size, "push thread is not running");
+        return false;
+    }
+
+    rmutexLock(&g_push.lock);
+    for (i = 0; i < PUSH_SUBSCRIBER_MAX; i++) {
+        PushSubscriber* s = &g_push.subs[i];
+        if (s->used && s->addr == req.addr && s->port == req.port) {
+            slot = s;
+            break;
+        }
+        if (!s->used && !slot) slot = s;
+    }
+    if (req.lease_sec == 0) {
+        if (slot && slot->used && slot->addr == req.addr && slot->port == req.port) {
+            slot->used = false;
+            g_push.count--;
+        }
+        rmutexUnlock(&g_push.lock);
+        *out = req;
+        LOG_INFO("push: unsubscribed %s:%u", push_addr_text(req.addr, host, sizeof(host)), (unsigned int)req.port);
+        return true;
+    }
+    if (!slot) {
+        rmutexUnlock(&g_push.lock);
+        *busy = true;
+        snprintf(err, err_size, "subscriber table full (%d entries)", PUSH_SUBSCRIBER_MAX);
+        return false;
+    }
+    if (!slot->used) {
+        memset(slot, 0, sizeof(*slot));
+        slot->used = true;
+        slot->addr = req.addr;
+        slot->port = req.port;
+        g_push.count++;
+        LOG_INFO(
+            "push: subscribed %s:%u fields=0x%X lease=%us",
+            push_addr_text(req.addr, host, sizeof(host)),
+            (unsigned int)req.port,
+            (unsigned int)req.fields,
+            (unsigned int)req.lease_sec
+        );
+    }
+    // A new or changed field set gets a full datagram right away.
+    if (slot->fields != req.fields) slot->next_refresh_ms = 0;
+    slot->fields = req.fields;
+    slot->lease_sec = req.lease_sec;
+    slot->expires_ms = now + (u64)req.lease_sec * 1000ULL;
+    *out = *slot;
+    rmutexUnlock(&g_push.lock);
+
+    ueventSignal(&g_push.event);
+    return true;
+}
+
+// sending --------------------------------------------------------------------------
+
+static u8* push_put_u32(u8* p, u32 v) {
+    int i;
+    for (i = 0; i < 4; i++) *p++ = (u8)(v >> (i * 8));
+    return p;
+}
+
+// Caller holds the lock.
+static void push_send(PushSubscriber* sub, u32 fields, u32 changed, bool refresh, u64 now) {
+    PushScratch* s = g_push.scratch;
+    struct sockaddr_in addr;
+    u8* p = s->datagram;
+    int id;
+
+    memcpy(p, PUSH_MAGIC, 4);
+    p += 4;
+    *p++ = PUSH_VERSION;
+    *p++ = refresh ? PUSH_FLAG_REFRESH : 0;
+    *p++ = (u8)fields;
+    *p++ = (u8)changed;
+    p = push_put_u32(p, ++sub->seq);
+    p = push_put_u32(p, sub->expires_ms > now ? (u32)((sub->expires_ms - now) / 1000ULL) : 0);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        if (!(fields & TELEMETRY_PROBE_BIT(id))) continue;
+        *p++ = (u8)id;
+        *p++ = s->last_len[id];
+        memcpy(p, s->last[id], s->last_len[id]);
+        p += s->last_len[id];
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = sub->addr;
+    addr.sin_port = htons(sub->port);
+    if (g_push.fd < 0) {
+        g_push.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    }
+    if (g_push.fd < 0 ||
+        sendto(g_push.fd, s->datagram, (size_t)(p - s->datagram), MSG_DONTWAIT, (const struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        const int err = errno;
+        sub->send_errors++;
+        g_push.send_errors++;
+        LOG_WARN_RATELIMITED(PUSH_ERROR_LOG_INTERVAL_MS, "push: send failed errno=%d", err);
+        // The socket may not survive a network reset; start over on the next send.
+        if (g_push.fd >= 0 && err != EAGAIN && err != EWOULDBLOCK) {
+            close(g_push.fd);
+            g_push.fd = -1;
+        }
+        return;
+    }
+    sub->sent++;
+    if (refresh) {
+        g_push.refresh_datagrams++;
+    } else {
+        g_push.change_datagrams++;
+    }
+}
+
+// Repacks every probe after a telemetry update; returns the probes whose payload changed.
+static u32 push_collect_changes(void) {
+    PushScratch* s = g_push.scratch;
+    u8 packed[TELEMETRY_PROBE_PACK_MAX];
+    u32 changed = 0;
+    int id;
+
+    telemetry_copy(g_push.telemetry, &s->snap);
+    if (g_push.have_last && s->snap.sample_count == g_push.last_sample_count) return 0;
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        const size_t len = telemetry_pack_probe(&s->snap, (TelemetryProbeId)id, packed);
+        if (!g_push.have_last || len != s->last_len[id] || memcmp(packed, s->last[id], len) != 0) {
+            memcpy(s->last[id], packed, len);
+            s->last_len[id] = (u8)len;
+            changed |= TELEMETRY_PROBE_BIT(id);
+        }
+    }
+    g_push.have_last = true;
+    g_push.last_sample_count = s->snap.sample_count;
+    return changed;
+}
+
+// Sends what is due and returns how long the thread may sleep.
+static u64 push_service(void) {
+    const u64 now = push_now_ms();
+    const u64 refresh_ms = (u64)g_push.refresh_sec * 1000ULL;
+    u64 next_ms = now + refresh_ms;
+    bool refresh_due = false;
+    u32 changed = 0;
+    char host[INET_ADDRSTRLEN];
+    int i;
+
+    rmutexLock(&g_push.lock);
+    for (i = 0; i < PUSH_SUBSCRIBER_MAX; i++) {
+        PushSubscriber* sub = &g_push.subs[i];
+        if (!sub->used) continue;
+        if (now >= sub->expires_ms) {
+            sub->used = false;
+            g_push.count--;
+            g_push.expired++;
+            LOG_INFO("push: lease expired for %s:%u", push_addr_text(sub->addr, host, sizeof(host)), (unsigned int)sub->port);
+            continue;
+        }
+        // A shortened refresh interval applies to the current period as well.
+        if (sub->next_refresh_ms > now + refresh_ms) sub->next_refresh_ms = now + refresh_ms;
+        if (now >= sub->next_refresh_ms) refresh_due = true;
+    }
+    if (g_push.count == 0) {
+        g_push.notified = false;
+        rmutexUnlock(&g_push.lock);
+        return PUSH_IDLE_WAIT_NS;
+    }
+
+    if (g_push.notified || refresh_due || !g_push.have_last) {
+        g_push.notified = false;
+        changed = push_collect_changes();
+    }
+    for (i = 0; i < PUSH_SUBSCRIBER_MAX; i++) {
+        PushSubscriber* sub = &g_push.subs[i];
+        if (!sub->used) continue;
+        if (now >= sub->next_refresh_ms) {
+            push_send(sub, sub->fields, changed & sub->fields, true, now);
+            sub->next_refresh_ms = now + refresh_ms;
+        } else if (changed & sub->fields) {
+            push_send(sub, changed & sub->fields, changed & sub->fields, false, now);
+        }
+        if (sub->next_refresh_ms < next_ms) next_ms = sub->next_refresh_ms;
+        if (sub->expires_ms < next_ms) next_ms = sub->expires_ms;
+    }
+    rmutexUnlock(&g_push.lock);
+
+    return (next_ms > now ? next_ms - now : 1) * 1000000ULL;
+}
+
+static void push_thread(void* arg) {
+    (void)arg;
+
+    while (g_push.running) {
+        const u64 wait_ns = push_service();
+        if (!g_push.running) break;
+        waitSingle(waiterForUEvent(&g_push.event), wait_ns);
+        g_push.wakeups++;
+    }
+    if (g_push.fd >= 0) {
+        close(g_push.fd);
+        g_push.fd = -1;
+    }
+}
+
+// lifecycle ------------------------------------------------------------------------
+
+bool push_start(TelemetryState* telemetry) {
+    Result rc;
+
+    if (g_push.running) return true;
+    arena_register(&g_push_arena);
+    if (!g_push.scratch) {
+        g_push.scratch = (PushScratch*)arena_alloc(&g_push_arena, sizeof(PushScratch));
+        if (!g_push.scratch) return false;
+    }
+    ueventCreate(&g_push.event, true);
+    g_push.telemetry = telemetry;
+    g_push.running = true;
+
+    memory_register_stack("push", g_push_thread_stack, PUSH_STACK_SIZE);
+    rc = threadCreate(&g_push.thread, push_thread, NULL, g_push_thread_stack, PUSH_STACK_SIZE, PUSH_THREAD_PRIO, PUSH_THREAD_CPUID);
+    if (R_FAILED(rc)) {
+        LOG_ERROR("push: threadCreate failed rc=0x%08lX", (unsigned long)rc);
+        g_push.running = false;
+        return false;
+    }
+    rc = threadStart(&g_push.thread);
+    if (R_FAILED(rc)) {
+        LOG_ERROR("push: threadStart failed rc=0x%08lX", (unsigned long)rc);
+        threadClose(&g_push.thread);
+        g_push.running = false;
+        return false;
+    }
+    return true;
+}
+
+void push_stop(void) {
+    if (!g_push.running) return;
+    g_push.running = false;
+    ueventSignal(&g_push.event);
+    if (R_SUCCEEDED(waitSingleHandle(g_push.thread.handle, PUSH_STOP_TIMEOUT_NS))) {
+        threadClose(&g_push.thread);
+    } else {
+        LOG_WARN("push: thread did not exit");
+    }
+}
+
+void push_notify(void) {
+    if (!g_push.running || g_push.count == 0) return;
+    g_push.notified = true;
+    ueventSignal(&g_push.event);
+}
+
+bool push_active(void) {
+    return g_push.running && g_push.count > 0;
+}
+
+void push_set_refresh_sec(u32 refresh_sec) {
+    if (refresh_sec == 0 || refresh_sec == g_push.refresh_sec) return;
+    g_push.refresh_sec = refresh_sec;
+    if (g_push.running) ueventSignal(&g_push.event);
+}
+
+// reporting ------------------------------------------------------------------------
+
+static void push_write_fields(JsonWriter* w, u32 fields) {
+    int id;
+
+    json_key(w, "fields");
+    json_begin_array(w);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        if (fields & TELEMETRY_PROBE_BIT(id)) json_string(w, telemetry_probe_name((TelemetryProbeId)id));
+    }
+    json_end_array(w);
+}
+
+void push_write_subscriber_json(const PushSubscriber* sub, JsonWriter* w) {
+    const u64 now = push_now_ms();
+    char host[INET_ADDRSTRLEN];
+
+    json_begin_object(w);
+    json_field_string(w, "host", push_addr_text(sub->addr, host, sizeof(host)));
+    json_field_u64(w, "port", sub->port);
+    push_write_fields(w, sub->fields);
+    json_field_u64(w, "lease_sec", sub->lease_sec);
+    json_field_u64(w, "expires_in_sec", sub->expires_ms > now ? (sub->expires_ms - now) / 1000ULL : 0);
+    json_field_u64(w, "refresh_sec", g_push.refresh_sec);
+    json_field_u64(w, "seq", sub->seq);
+    json_field_u64(w, "sent", sub->sent);
+    json_field_u64(w, "send_errors", sub->send_errors);
+    json_end_object(w);
+}
+
+void push_write_json(JsonWriter* w) {
+    int i;
+
+    rmutexLock(&g_push.lock);
+    json_begin_object(w);
+    json_field_bool(w, "running", g_push.running);
+    json_field_u64(w, "refresh_sec", g_push.refresh_sec);
+    json_field_u64(w, "wakeups", g_push.wakeups);
+    json_field_u64(w, "change_datagrams", g_push.change_datagrams);
+    json_field_u64(w, "refresh_datagrams", g_push.refresh_datagrams);
+    json_field_u64(w, "send_errors", g_push.send_errors);
+    json_field_u64(w, "expired", g_push.expired);
+    json_key(w, "subscribers");
+    json_begin_array(w);
+    for (i = 0; i < PUSH_SUBSCRIBER_MAX; i++) {
+        if (g_push.subs[i].used) push_write_subscriber_json(&g_push.subs[i], w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+    rmutexUnlock(&g_push.lock);
+}
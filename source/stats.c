@@ -0,0 +1,802 @@
+#include "stats.h"
+
+#include "arena.h"
+#include "log_format.h"
+#include "logger.h"
+#include "status_record.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define STATS_GAP_MAX_SEC 60 // longer gaps between samples (sleep) count as uncovered
+#define STATS_DICT_MAX 16
+// start_delta + 9 varints of at most 5 bytes + battery + 4 titles of tag, id, sec
+#define STATS_RECORD_MAX (5 * 10 + 3 * 5 + STATS_TITLES_MAX * (1 + 8 + 5))
+#define STATS_BUCKET_JSON_MAX 512
+#define STATS_PATH_MAX 96
+
+typedef struct {
+    const char* name;
+    u32 seconds;
+    u32 blocks_max; // ring capacity
+} StatsTierDef;
+
+// At four titles per bucket a block holds about 90 minutes, 2 days of hours or
+// 25 days, so the rings keep roughly 80 days of minutes, 2 years of hours and
+// 4 years of days.
+static const StatsTierDef g_stats_tiers[StatsResolution_Count] = {
+    [StatsResolution_Minute] = { "minute", 60, 1536 },
+    [StatsResolution_Hour] = { "hour", 3600, 384 },
+    [StatsResolution_Day] = { "day", 86400, 64 },
+};
+
+#define STATS_INDEX_ENTRIES (1536 + 384 + 64) // sum of blocks_max
+
+typedef struct {
+    u32 seq;
+    u32 first_start;
+    u32 last_start;
+    u32 count;
+} StatsIndexEntry;
+
+// Encoder/decoder state carried from record to record within a block.
+typedef struct {
+    u32 last_start;
+    u8 prev_avg;
+    u8 dict_count;
+    u64 dict[STATS_DICT_MAX];
+} StatsCodec;
+
+typedef struct {
+    FILE* data;
+    FILE* idx;
+    StatsIndexEntry* index; // blocks_max entries, slot order
+    u8* tail;               // the open block, STATS_BLOCK_SIZE bytes
+    bool tail_open;
+    bool tail_dirty;
+    u32 tail_slot;
+    size_t tail_used; // payload bytes
+    StatsCodec codec;
+    u32 next_seq;
+    StatsBucket acc; // bucket being filled
+    bool acc_used;
+    u64 records;
+    u64 blocks_written;
+} StatsTier;
+
+typedef struct {
+    TelemetryState snap;
+    StatsIndexEntry index[STATS_INDEX_ENTRIES];
+    u8 tails[StatsResolution_Count][STATS_BLOCK_SIZE];
+    u8 read_block[STATS_BLOCK_SIZE];
+} StatsScratch;
+
+typedef struct {
+    RMutex lock; // zero-init is a valid RMutex
+    bool open;
+    StatsScratch* scratch;
+    StatsTier tiers[StatsResolution_Count];
+    u64 last_sample;
+    u64 last_flush;
+    u64 samples;
+    u64 dropped; // buckets older than what a ring already holds (clock went back)
+    u64 write_errors;
+    u64 read_errors;
+    u64 queries;
+    u64 blocks_read;
+    StatsCodec restore_codec; // see stats_index_from_block
+} StatsStore;
+
+// Index, open tail blocks and the query block buffer; owned by the store under its lock.
+ARENA_DEFINE(g_stats_arena, "stats", sizeof(StatsScratch) + ARENA_ALIGN);
+
+static StatsStore g_stats;
+
+// encoding -------------------------------------------------------------------------
+
+static u8* stats_put_varint(u8* p, u64 value) {
+    while (value >= 0x80) {
+        *p++ = (u8)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (u8)value;
+    return p;
+}
+
+static void stats_put_u16(u8* p, u16 v) {
+    p[0] = (u8)v;
+    p[1] = (u8)(v >> 8);
+}
+
+static void stats_put_u32(u8* p, u32 v) {
+    stats_put_u16(p, (u16)v);
+    stats_put_u16(p + 2, (u16)(v >> 16));
+}
+
+static u16 stats_get_u16(const u8* p) {
+    return (u16)(p[0] | (p[1] << 8));
+}
+
+static u32 stats_get_u32(const u8* p) {
+    return (u32)stats_get_u16(p) | ((u32)stats_get_u16(p + 2) << 16);
+}
+
+static u8 stats_battery_avg(const StatsBucket* b) {
+    return (u8)((b->battery_sum + b->battery_samples / 2) / b->battery_samples);
+}
+
+// Encodes b after the records already described by codec; returns the length.
+static size_t stats_encode(StatsCodec* codec, u32 seconds, const StatsBucket* b, u8* out) {
+    u8* p = out;
+    u8 i;
+
+    p = stats_put_varint(p, (b->start - codec->last_start) / seconds);
+    codec->last_start = b->start;
+    p = stats_put_varint(p, b->covered_sec);
+    p = stats_put_varint(p, b->samples);
+    p = stats_put_varint(p, b->battery_samples);
+    if (b->battery_samples > 0) {
+        const u8 avg = stats_battery_avg(b);
+        const s64 delta = (s64)avg - (s64)codec->prev_avg;
+        p = stats_put_varint(p, ((u64)delta << 1) ^ (u64)(delta >> 63));
+        p = stats_put_varint(p, (u64)(avg - b->battery_min));
+        p = stats_put_varint(p, (u64)(b->battery_max - avg));
+        codec->prev_avg = avg;
+    }
+    p = stats_put_varint(p, b->charging_sec);
+    p = stats_put_varint(p, b->docked_sec);
+    p = stats_put_varint(p, b->other_title_sec);
+    p = stats_put_varint(p, b->title_count);
+    for (i = 0; i < b->title_count; i++) {
+        const u64 id = b->titles[i].program_id;
+        u8 tag = 0;
+        u8 d;
+        for (d = 0; d < codec->dict_count; d++) {
+            if (codec->dict[d] == id) {
+                tag = (u8)(d + 1);
+                break;
+            }
+        }
+        p = stats_put_varint(p, tag);
+        if (tag == 0) {
+            stats_put_u32(p, (u32)id);
+            stats_put_u32(p + 4, (u32)(id >> 32));
+            p += 8;
+            if (codec->dict_count < STATS_DICT_MAX) codec->dict[codec->dict_count++] = id;
+        }
+        p = stats_put_varint(p, b->titles[i].sec);
+    }
+    return (size_t)(p - out);
+}
+
+static bool stats_decode(StatsCodec* codec, u32 seconds, LogReader* r, StatsBucket* b) {
+    u64 n;
+    u8 i;
+
+    memset(b, 0, sizeof(*b));
+    b->start = codec->last_start + (u32)log_read_varint(r) * seconds;
+    codec->last_start = b->start;
+    b->covered_sec = (u32)log_read_varint(r);
+    b->samples = (u32)log_read_varint(r);
+    b->battery_samples = (u32)log_read_varint(r);
+    if (b->battery_samples > 0) {
+        const u8 avg = (u8)((s64)codec->prev_avg + log_read_zigzag(r));
+        b->battery_min = (u8)(avg - log_read_varint(r));
+        b->battery_max = (u8)(avg + log_read_varint(r));
+        b->battery_sum = (u32)avg * b->battery_samples;
+        codec->prev_avg = avg;
+    }
+    b->charging_sec = (u32)log_read_varint(r);
+    b->docked_sec = (u32)log_read_varint(r);
+    b->other_title_sec = (u32)log_read_varint(r);
+    n = log_read_varint(r);
+    if (n > STATS_TITLES_MAX) return false;
+    b->title_count = (u8)n;
+    for (i = 0; i < b->title_count && r->ok; i++) {
+        const u64 tag = log_read_varint(r);
+        if (tag == 0) {
+            if (r->end - r->p < 8) return false;
+            b->titles[i].program_id = (u64)stats_get_u32(r->p) | ((u64)stats_get_u32(r->p + 4) << 32);
+            r->p += 8;
+            if (codec->dict_count < STATS_DICT_MAX) codec->dict[codec->dict_count++] = b->titles[i].program_id;
+        } else if (tag <= codec->dict_count) {
+            b->titles[i].program_id = codec->dict[tag - 1];
+        } else {
+            return false;
+        }
+        b->titles[i].sec = (u32)log_read_varint(r);
+    }
+    return r->ok != 0;
+}
+
+static bool stats_block_valid(const u8* block, StatsResolution res) {
+    const u16 used = stats_get_u16(block + 12);
+
+    return memcmp(block, STATS_MAGIC, 4) == 0 && block[4] == STATS_VERSION && block[5] == (u8)res &&
+           used <= STATS_BLOCK_SIZE - STATS_BLOCK_HEADER_SIZE &&
+           stats_get_u32(block + 20) == status_record_crc32(block + STATS_BLOCK_HEADER_SIZE, used);
+}
+
+// Visits a block's records with from <= start < to in order; returns false
+// once past to or when the visitor asks to stop.
+typedef bool (*StatsVisitFn)(void* ctx, const StatsBucket* b, bool partial);
+
+static bool stats_block_visit(const u8* block, StatsResolution res, u64 from, u64 to, StatsVisitFn visit, void* ctx) {
+    const u16 count = stats_get_u16(block + 6);
+    LogReader r = { block + STATS_BLOCK_HEADER_SIZE, block + STATS_BLOCK_HEADER_SIZE + stats_get_u16(block + 12), 1 };
+    StatsCodec codec;
+    StatsBucket b;
+    u16 i;
+
+    memset(&codec, 0, sizeof(codec));
+    codec.last_start = stats_get_u32(block + 16);
+    for (i = 0; i < count; i++) {
+        if (!stats_decode(&codec, g_stats_tiers[res].seconds, &r, &b)) return true;
+        if (b.start < from) continue;
+        if (b.start >= to || !visit(ctx, &b, false)) return false;
+    }
+    return true;
+}
+
+// buckets --------------------------------------------------------------------------
+
+static void stats_add_title(StatsBucket* b, u64 program_id, u32 sec) {
+    u8 smallest = 0;
+    u8 i;
+
+    for (i = 0; i < b->title_count; i++) {
+        if (b->titles[i].program_id == program_id) {
+            b->titles[i].sec += sec;
+            return;
+        }
+        if (b->titles[i].sec < b->titles[smallest].sec) smallest = i;
+    }
+    if (b->title_count < STATS_TITLES_MAX) {
+        b->titles[b->title_count].program_id = program_id;
+        b->titles[b->title_count].sec = sec;
+        b->title_count++;
+    } else if (sec > b->titles[smallest].sec) {
+        b->other_title_sec += b->titles[smallest].sec;
+        b->titles[smallest].program_id = program_id;
+        b->titles[smallest].sec = sec;
+    } else {
+        b->other_title_sec += sec;
+    }
+}
+
+static void stats_merge(StatsBucket* into, const StatsBucket* from) {
+    u8 i;
+
+    into->covered_sec += from->covered_sec;
+    into->samples += from->samples;
+    if (from->battery_samples > 0) {
+        if (into->battery_samples == 0 || from->battery_min < into->battery_min) into->battery_min = from->battery_min;
+        if (into->battery_samples == 0 || from->battery_max > into->battery_max) into->battery_max = from->battery_max;
+        into->battery_samples += from->battery_samples;
+        into->battery_sum += from->battery_sum;
+    }
+    into->charging_sec += from->charging_sec;
+    into->docked_sec += from->docked_sec;
+    into->other_title_sec += from->other_title_sec;
+    for (i = 0; i < from->title_count; i++) stats_add_title(into, from->titles[i].program_id, from->titles[i].sec);
+}
+
+// files ----------------------------------------------------------------------------
+
+static void stats_path(char* out, size_t size, const char* dir, StatsResolution res, const char* ext) {
+    snprintf(out, size, "%s/stats_%s.%s", dir, g_stats_tiers[res].name, ext);
+}
+
+static FILE* stats_fopen(const char* path) {
+    FILE* f = fopen(path, "r+b");
+
+    if (!f) f = fopen(path, "w+b");
+    // Every write is a whole block or index entry at a fixed offset.
+    if (f) setvbuf(f, NULL, _IONBF, 0);
+    return f;
+}
+
+static bool stats_write_at(FILE* f, long offset, const void* data, size_t len) {
+    return fseek(f, offset, SEEK_SET) == 0 && fwrite(data, 1, len, f) == len && fflush(f) == 0;
+}
+
+static bool stats_read_at(FILE* f, long offset, void* data, size_t len) {
+    return fseek(f, offset, SEEK_SET) == 0 && fread(data, 1, len, f) == len;
+}
+
+static void stats_tail_write(StatsResolution res) {
+    StatsTier* t = &g_stats.tiers[res];
+    const long slot = (long)t->tail_slot;
+
+    if (!t->tail_open || !t->tail_dirty) return;
+    stats_put_u32(t->tail + 20, status_record_crc32(t->tail + STATS_BLOCK_HEADER_SIZE, t->tail_used));
+    if (!stats_write_at(t->data, slot * STATS_BLOCK_SIZE, t->tail, STATS_BLOCK_SIZE) ||
+        !stats_write_at(t->idx, slot * (long)sizeof(StatsIndexEntry), &t->index[slot], sizeof(StatsIndexEntry))) {
+        g_stats.write_errors++;
+        LOG_WARN_RATELIMITED(60000, "stats: %s block %ld write failed", g_stats_tiers[res].name, slot);
+        return;
+    }
+    t->tail_dirty = false;
+    t->blocks_written++;
+}
+
+// Starts a new tail block in the slot after the current one, recycling the oldest.
+static void stats_tail_begin(StatsResolution res, u32 first_start) {
+    StatsTier* t = &g_stats.tiers[res];
+    StatsIndexEntry* e;
+
+    if (t->tail_open) {
+        stats_tail_write(res);
+        t->tail_slot = (t->tail_slot + 1) % g_stats_tiers[res].blocks_max;
+    }
+    t->tail_open = true;
+    t->tail_used = 0;
+    memset(&t->codec, 0, sizeof(t->codec));
+    t->codec.last_start = first_start;
+    memset(t->tail, 0, STATS_BLOCK_SIZE);
+    memcpy(t->tail, STATS_MAGIC, 4);
+    t->tail[4] = STATS_VERSION;
+    t->tail[5] = (u8)res;
+    stats_put_u32(t->tail + 8, t->next_seq);
+    stats_put_u32(t->tail + 16, first_start);
+
+    e = &t->index[t->tail_slot];
+    e->seq = t->next_seq++;
+    e->first_start = first_start;
+    e->last_start = first_start;
+    e->count = 0;
+}
+
+static void stats_tier_append(StatsResolution res, const StatsBucket* b) {
+    StatsTier* t = &g_stats.tiers[res];
+    u8 record[STATS_RECORD_MAX];
+    StatsCodec codec;
+    StatsIndexEntry* e;
+    size_t len;
+
+    if (t->tail_open && t->index[t->tail_slot].count > 0 && b->start <= t->index[t->tail_slot].last_start) {
+        g_stats.dropped++;
+        return;
+    }
+    codec = t->codec;
+    len = stats_encode(&codec, g_stats_tiers[res].seconds, b, record);
+    if (!t->tail_open || t->tail_used + len > STATS_BLOCK_SIZE - STATS_BLOCK_HEADER_SIZE || t->index[t->tail_slot].count >= 0xFFFF) {
+        stats_tail_begin(res, b->start);
+        codec = t->codec;
+        len = stats_encode(&codec, g_stats_tiers[res].seconds, b, record);
+    }
+    memcpy(t->tail + STATS_BLOCK_HEADER_SIZE + t->tail_used, record, len);
+    t->tail_used += len;
+    t->codec = codec;
+    t->tail_dirty = true;
+    t->records++;
+
+    e = &t->index[t->tail_slot];
+    e->last_start = b->start;
+    e->count++;
+    stats_put_u16(t->tail + 6, (u16)e->count);
+    stats_put_u16(t->tail + 12, (u16)t->tail_used);
+}
+
+// Closes the bucket in progress at res if start opens a new one, rolling it
+// into the next resolution, and makes sure a bucket for start is open.
+static void stats_roll(StatsResolution res, u32 start) {
+    StatsTier* t = &g_stats.tiers[res];
+
+    if (t->acc_used && t->acc.start != start) {
+        stats_tier_append(res, &t->acc);
+        if (res + 1 < StatsResolution_Count) {
+            const StatsResolution up = (StatsResolution)(res + 1);
+            StatsTier* u = &g_stats.tiers[up];
+            stats_roll(up, t->acc.start - t->acc.start % g_stats_tiers[up].seconds);
+            stats_merge(&u->acc, &t->acc);
+        }
+        t->acc_used = false;
+    }
+    if (!t->acc_used) {
+        memset(&t->acc, 0, sizeof(t->acc));
+        t->acc.start = start;
+        t->acc_used = true;
+    }
+}
+
+// Slots in seq order: the ring's oldest block first.
+static u32 stats_tier_base(const StatsTier* t, StatsResolution res, u32* used) {
+    const u32 max = g_stats_tiers[res].blocks_max;
+    const u32 next = (t->tail_slot + 1) % max;
+
+    if (!t->tail_open) {
+        *used = 0;
+        return 0;
+    }
+    if (t->index[next].seq != 0 && next != t->tail_slot) {
+        *used = max;
+        return next;
+    }
+    *used = t->tail_slot + 1;
+    return 0;
+}
+
+// Visits stored buckets with from <= start < to, reading only overlapping blocks.
+static bool stats_tier_scan(StatsResolution res, u64 from, u64 to, StatsVisitFn visit, void* ctx) {
+    StatsTier* t = &g_stats.tiers[res];
+    const u32 max = g_stats_tiers[res].blocks_max;
+    u32 used;
+    const u32 base = stats_tier_base(t, res, &used);
+    u32 lo = 0;
+    u32 hi = used;
+    u32 i;
+
+    // First block whose last record is at or after from.
+    while (lo < hi) {
+        const u32 mid = lo + (hi - lo) / 2;
+        if (t->index[(base + mid) % max].last_start < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (i = lo; i < used; i++) {
+        const u32 slot = (base + i) % max;
+        const u8* block = t->tail;
+        if (t->index[slot].first_start >= to) break;
+        if (t->index[slot].count == 0) continue;
+        if (slot != t->tail_slot) {
+            block = g_stats.scratch->read_block;
+            g_stats.blocks_read++;
+            if (!stats_read_at(t->data, (long)slot * STATS_BLOCK_SIZE, g_stats.scratch->read_block, STATS_BLOCK_SIZE) ||
+                !stats_block_valid(block, res)) {
+                g_stats.read_errors++;
+                continue;
+            }
+        }
+        if (!stats_block_visit(block, res, from, to, visit, ctx)) return false;
+    }
+    return true;
+}
+
+// open / restore --------------------------------------------------------------------
+
+// Fills e from a valid block, replaying its records; returns the payload bytes
+// they span. The codec state after the last record is left in restore_codec.
+static size_t stats_index_from_block(StatsIndexEntry* e, const u8* block, StatsResolution res) {
+    const u16 count = stats_get_u16(block + 6);
+    LogReader r = { block + STATS_BLOCK_HEADER_SIZE, block + STATS_BLOCK_HEADER_SIZE + stats_get_u16(block + 12), 1 };
+    StatsCodec* codec = &g_stats.restore_codec;
+    StatsBucket b;
+
+    memset(codec, 0, sizeof(*codec));
+    codec->last_start = stats_get_u32(block + 16);
+    e->seq = stats_get_u32(block + 8);
+    e->first_start = codec->last_start;
+    e->last_start = codec->last_start;
+    e->count = 0;
+    while (e->count < count) {
+        const u8* before = r.p;
+        StatsCodec saved = *codec;
+        if (!stats_decode(codec, g_stats_tiers[res].seconds, &r, &b)) {
+            // Keep the records before a damaged one.
+            *codec = saved;
+            r.p = before;
+            break;
+        }
+        e->last_start = b.start;
+        e->count++;
+    }
+    return (size_t)(r.p - (block + STATS_BLOCK_HEADER_SIZE));
+}
+
+static bool stats_tier_open(const char* dir, StatsResolution res, StatsIndexEntry* index) {
+    StatsTier* t = &g_stats.tiers[res];
+    const u32 max = g_stats_tiers[res].blocks_max;
+    char path[STATS_PATH_MAX];
+    u32 blocks;
+    u32 newest = 0;
+    u32 slot;
+    long size;
+
+    t->index = index;
+    t->tail = g_stats.scratch->tails[res];
+    stats_path(path, sizeof(path), dir, res, "bin");
+    t->data = stats_fopen(path);
+    stats_path(path, sizeof(path), dir, res, "idx");
+    t->idx = stats_fopen(path);
+    if (!t->data || !t->idx) return false;
+
+    fseek(t->data, 0, SEEK_END);
+    size = ftell(t->data);
+    blocks = size > 0 ? (u32)(size / STATS_BLOCK_SIZE) : 0;
+    if (blocks > max) blocks = max;
+    memset(index, 0, sizeof(StatsIndexEntry) * max);
+    fseek(t->idx, 0, SEEK_SET);
+    if (fread(index, sizeof(StatsIndexEntry), max, t->idx) == 0) clearerr(t->idx);
+
+    // The index is written after its block, so an entry past the data is stale
+    // and a block without an entry (lost or missing index) is re-read.
+    for (slot = 0; slot < max; slot++) {
+        if (slot >= blocks) {
+            memset(&index[slot], 0, sizeof(index[slot]));
+        } else if (index[slot].seq == 0 &&
+                   stats_read_at(t->data, (long)slot * STATS_BLOCK_SIZE, g_stats.scratch->read_block, STATS_BLOCK_SIZE) &&
+                   stats_block_valid(g_stats.scratch->read_block, res)) {
+            stats_index_from_block(&index[slot], g_stats.scratch->read_block, res);
+            stats_write_at(t->idx, (long)slot * (long)sizeof(StatsIndexEntry), &index[slot], sizeof(index[slot]));
+        }
+    }
+    for (slot = 0; slot < max; slot++) {
+        if (index[slot].seq > index[newest].seq) newest = slot;
+    }
+    if (index[newest].seq == 0) {
+        t->next_seq = 1;
+        return true;
+    }
+    t->next_seq = index[newest].seq + 1;
+    t->tail_slot = newest;
+    t->tail_open = true;
+
+    // Reopen the newest block for appending, replaying it to restore the codec.
+    if (stats_read_at(t->data, (long)newest * STATS_BLOCK_SIZE, t->tail, STATS_BLOCK_SIZE) && stats_block_valid(t->tail, res)) {
+        t->tail_used = stats_index_from_block(&index[newest], t->tail, res);
+        t->codec = g_stats.restore_codec;
+        stats_put_u16(t->tail + 6, (u16)index[newest].count);
+        stats_put_u16(t->tail + 12, (u16)t->tail_used);
+        return true;
+    }
+    // Unreadable tail: leave it and continue in the next slot.
+    LOG_WARN("stats: %s block %u is damaged, starting a new one", g_stats_tiers[res].name, (unsigned int)newest);
+    index[newest].count = 0;
+    t->tail_used = STATS_BLOCK_SIZE;
+    return true;
+}
+
+static bool stats_restore_visit(void* ctx, const StatsBucket* b, bool partial) {
+    (void)partial;
+    stats_merge((StatsBucket*)ctx, b);
+    return true;
+}
+
+// The hour and day in progress at shutdown are rebuilt from the finer ring.
+static void stats_restore_acc(StatsResolution res) {
+    const StatsTier* lower = &g_stats.tiers[res - 1];
+    StatsTier* t = &g_stats.tiers[res];
+    const u32 seconds = g_stats_tiers[res].seconds;
+    u32 last;
+    u32 start;
+
+    if (!lower->tail_open || lower->index[lower->tail_slot].count == 0) return;
+    last = lower->index[lower->tail_slot].last_start;
+    start = last - last % seconds;
+    if (t->tail_open && t->index[t->tail_slot].count > 0 && t->index[t->tail_slot].last_start >= start) return;
+
+    memset(&t->acc, 0, sizeof(t->acc));
+    t->acc.start = start;
+    t->acc_used = true;
+    stats_tier_scan((StatsResolution)(res - 1), start, (u64)start + seconds, stats_restore_visit, &t->acc);
+}
+
+// public ---------------------------------------------------------------------------
+
+bool stats_open(const char* dir) {
+    StatsIndexEntry* index;
+    int res;
+
+    arena_register(&g_stats_arena);
+    stats_close();
+    rmutexLock(&g_stats.lock);
+    if (!g_stats.scratch) {
+        g_stats.scratch = (StatsScratch*)arena_alloc(&g_stats_arena, sizeof(StatsScratch));
+        if (!g_stats.scratch) {
+            rmutexUnlock(&g_stats.lock);
+            return false;
+        }
+    }
+    memset(g_stats.tiers, 0, sizeof(g_stats.tiers));
+    index = g_stats.scratch->index;
+    for (res = 0; res < StatsResolution_Count; res++) {
+        if (!stats_tier_open(dir, (StatsResolution)res, index)) {
+            rmutexUnlock(&g_stats.lock);
+            LOG_WARN("stats: cannot open %s/stats_%s.*", dir, g_stats_tiers[res].name);
+            stats_close();
+            return false;
+        }
+        index += g_stats_tiers[res].blocks_max;
+    }
+    stats_restore_acc(StatsResolution_Hour);
+    stats_restore_acc(StatsResolution_Day);
+    g_stats.last_sample = 0;
+    g_stats.last_flush = 0;
+    g_stats.open = true;
+    rmutexUnlock(&g_stats.lock);
+
+    LOG_INFO(
+        "stats: open (%u minute, %u hour, %u day records in the tail blocks)",
+        (unsigned int)g_stats.tiers[StatsResolution_Minute].index[g_stats.tiers[StatsResolution_Minute].tail_slot].count,
+        (unsigned int)g_stats.tiers[StatsResolution_Hour].index[g_stats.tiers[StatsResolution_Hour].tail_slot].count,
+        (unsigned int)g_stats.tiers[StatsResolution_Day].index[g_stats.tiers[StatsResolution_Day].tail_slot].count
+    );
+    return true;
+}
+
+void stats_close(void) {
+    int res;
+
+    rmutexLock(&g_stats.lock);
+    for (res = 0; res < StatsResolution_Count; res++) {
+        StatsTier* t = &g_stats.tiers[res];
+        if (g_stats.open) stats_tail_write((StatsResolution)res);
+        if (t->data) fclose(t->data);
+        if (t->idx) fclose(t->idx);
+        t->data = NULL;
+        t->idx = NULL;
+    }
+    g_stats.open = false;
+    rmutexUnlock(&g_stats.lock);
+}
+
+bool stats_available(void) {
+    return g_stats.open;
+}
+
+void stats_sample(TelemetryState* telemetry, u64 now) {
+    TelemetryState* s;
+    StatsBucket* b;
+    u32 elapsed = 0;
+    int res;
+
+    if (!g_stats.open || now > 0xFFFFFFFFULL) return;
+    s = &g_stats.scratch->snap;
+    telemetry_copy(telemetry, s);
+
+    rmutexLock(&g_stats.lock);
+    if (g_stats.last_sample != 0 && now >= g_stats.last_sample && now - g_stats.last_sample <= STATS_GAP_MAX_SEC) {
+        elapsed = (u32)(now - g_stats.last_sample);
+    }
+    g_stats.last_sample = now;
+    if (g_stats.last_flush == 0) g_stats.last_flush = now;
+    g_stats.samples++;
+
+    stats_roll(StatsResolution_Minute, (u32)(now - now % g_stats_tiers[StatsResolution_Minute].seconds));
+    b = &g_stats.tiers[StatsResolution_Minute].acc;
+    b->samples++;
+    b->covered_sec += elapsed;
+    if (s->battery_percent_valid && s->battery_percent <= 100) {
+        if (b->battery_samples == 0 || s->battery_percent < b->battery_min) b->battery_min = (u8)s->battery_percent;
+        if (b->battery_samples == 0 || s->battery_percent > b->battery_max) b->battery_max = (u8)s->battery_percent;
+        b->battery_samples++;
+        b->battery_sum += s->battery_percent;
+    }
+    if (s->is_charging_valid && s->is_charging) b->charging_sec += elapsed;
+    if (s->is_docked_valid && s->is_docked) b->docked_sec += elapsed;
+    if (s->active_program_id != 0 && elapsed > 0) stats_add_title(b, s->active_program_id, elapsed);
+
+    if (now < g_stats.last_flush || now - g_stats.last_flush >= STATS_FLUSH_INTERVAL_SEC) {
+        for (res = 0; res < StatsResolution_Count; res++) stats_tail_write((StatsResolution)res);
+        g_stats.last_flush = now;
+    }
+    rmutexUnlock(&g_stats.lock);
+}
+
+bool stats_resolution_parse(const char* name, StatsResolution* out) {
+    int res;
+
+    for (res = 0; res < StatsResolution_Count; res++) {
+        if (strcmp(name, g_stats_tiers[res].name) == 0) {
+            *out = (StatsResolution)res;
+            return true;
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    JsonWriter* w;
+    u64 from;
+    u64 to;
+    size_t budget;
+    u64 emitted;
+    bool truncated;
+    u32 next;
+} StatsQuery;
+
+static bool stats_query_visit(void* ctx, const StatsBucket* b, bool partial) {
+    StatsQuery* q = (StatsQuery*)ctx;
+    JsonWriter* w = q->w;
+    u8 i;
+
+    if (w->len + STATS_BUCKET_JSON_MAX > q->budget) {
+        q->truncated = true;
+        q->next = b->start;
+        return false;
+    }
+    json_begin_object(w);
+    json_field_u64(w, "start", b->start);
+    if (partial) json_field_bool(w, "partial", true);
+    json_field_u64(w, "covered_sec", b->covered_sec);
+    json_field_u64(w, "samples", b->samples);
+    json_key(w, "battery");
+    if (b->battery_samples > 0) {
+        json_begin_object(w);
+        json_field_u64(w, "min", b->battery_min);
+        json_field_u64(w, "avg", stats_battery_avg(b));
+        json_field_u64(w, "max", b->battery_max);
+        json_end_object(w);
+    } else {
+        json_null(w);
+    }
+    json_field_u64(w, "charging_sec", b->charging_sec);
+    json_field_u64(w, "docked_sec", b->docked_sec);
+    json_key(w, "titles");
+    json_begin_array(w);
+    for (i = 0; i < b->title_count; i++) {
+        json_begin_object(w);
+        json_field_hex64(w, "program_id", b->titles[i].program_id);
+        json_field_u64(w, "sec", b->titles[i].sec);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_field_u64(w, "other_title_sec", b->other_title_sec);
+    json_end_object(w);
+    q->emitted++;
+    return true;
+}
+
+void stats_write_query_json(JsonWriter* w, StatsResolution res, u64 from, u64 to, size_t budget) {
+    StatsQuery q;
+    const u64 blocks_before = g_stats.blocks_read;
+    StatsTier* t = &g_stats.tiers[res];
+
+    memset(&q, 0, sizeof(q));
+    q.w = w;
+    q.from = from;
+    q.to = to;
+    q.budget = budget;
+
+    rmutexLock(&g_stats.lock);
+    g_stats.queries++;
+    json_begin_object(w);
+    json_field_string(w, "resolution", g_stats_tiers[res].name);
+    json_field_u64(w, "from", from);
+    json_field_u64(w, "to", to);
+    json_key(w, "buckets");
+    json_begin_array(w);
+    if (g_stats.open && stats_tier_scan(res, from, to, stats_query_visit, &q) && t->acc_used && t->acc.start >= from &&
+        t->acc.start < to) {
+        stats_query_visit(&q, &t->acc, true);
+    }
+    json_end_array(w);
+    json_field_u64(w, "count", q.emitted);
+    json_field_u64(w, "blocks_read", g_stats.blocks_read - blocks_before);
+    if (q.truncated) json_field_u64(w, "next", q.next);
+    json_end_object(w);
+    rmutexUnlock(&g_stats.lock);
+}
+
+void stats_write_json(JsonWriter* w) {
+    int res;
+
+    rmutexLock(&g_stats.lock);
+    json_begin_object(w);
+    json_field_bool(w, "open", g_stats.open);
+    json_field_u64(w, "last_sample", g_stats.last_sample);
+    json_field_u64(w, "samples", g_stats.samples);
+    json_field_u64(w, "queries", g_stats.queries);
+    json_field_u64(w, "blocks_read", g_stats.blocks_read);
+    json_field_u64(w, "dropped", g_stats.dropped);
+    json_field_u64(w, "write_errors", g_stats.write_errors);
+    json_field_u64(w, "read_errors", g_stats.read_errors);
+    for (res = 0; res < StatsResolution_Count; res++) {
+        const StatsTier* t = &g_stats.tiers[res];
+        u32 used = 0;
+        if (t->index) stats_tier_base(t, (StatsResolution)res, &used);
+        json_key(w, g_stats_tiers[res].name);
+        json_begin_object(w);
+        json_field_u64(w, "blocks", used);
+        json_field_u64(w, "blocks_max", g_stats_tiers[res].blocks_max);
+        json_field_u64(w, "records", t->records);
+        json_field_u64(w, "blocks_written", t->blocks_written);
+        json_field_bool(w, "tail_dirty", t->tail_dirty);
+        json_end_object(w);
+    }
+    json_end_object(w);
+    rmutexUnlock(&g_stats.lock);
+}
@@ -0,0 +1,100 @@
+#include "status_record.h"
+
+#include <string.h>
+
+uint32_t status_record_crc32(const void* data, size_t len) {
+    return status_record_crc32_update(0, data, len);
+}
+
+uint32_t status_record_crc32_update(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    size_t i;
+
+    crc = ~crc;
+    for (i = 0; i < len; i++) {
+        int bit;
+        crc ^= p[i];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+bool status_record_valid(const StatusRecord* rec) {
+    return rec->magic == STATUS_RECORD_MAGIC &&
+           rec->version == STATUS_RECORD_VERSION &&
+           rec->size == sizeof(StatusRecord) &&
+           rec->checksum == status_record_crc32(rec, offsetof(StatusRecord, checksum));
+}
+
+int status_record_read_slots(FILE* f, StatusRecord slots[STATUS_RECORD_SLOTS]) {
+    int newest = -1;
+    int i;
+
+    memset(slots, 0, sizeof(StatusRecord) * STATUS_RECORD_SLOTS);
+    if (fseek(f, 0, SEEK_SET) != 0) return -1;
+
+    for (i = 0; i < STATUS_RECORD_SLOTS; i++) {
+        if (fread(&slots[i], sizeof(StatusRecord), 1, f) != 1) {
+            memset(&slots[i], 0, sizeof(StatusRecord));
+            break;
+        }
+        if (!status_record_valid(&slots[i])) continue;
+        if (newest < 0 || slots[i].sequence > slots[newest].sequence) {
+            newest = i;
+        }
+    }
+    return newest;
+}
+
+bool status_store_open(StatusStore* store, const char* path, StatusRecord* previous) {
+    StatusRecord slots[STATUS_RECORD_SLOTS];
+    int newest;
+
+    memset(store, 0, sizeof(*store));
+    store->file = fopen(path, "r+b");
+    if (!store->file) {
+        store->file = fopen(path, "w+b");
+        if (!store->file) return false;
+    }
+    // Every write is a single positioned fwrite; keep stdio from holding it back.
+    setvbuf(store->file, NULL, _IONBF, 0);
+
+    newest = status_record_read_slots(store->file, slots);
+    if (newest < 0) {
+        if (previous) memset(previous, 0, sizeof(*previous));
+        return false;
+    }
+
+    store->sequence = slots[newest].sequence;
+    store->next_slot = (newest + 1) % STATUS_RECORD_SLOTS;
+    if (previous) *previous = slots[newest];
+    return true;
+}
+
+bool status_store_write(StatusStore* store, StatusRecord* rec) {
+    if (!store->file) return false;
+
+    rec->magic = STATUS_RECORD_MAGIC;
+    rec->version = STATUS_RECORD_VERSION;
+    rec->size = (uint16_t)sizeof(StatusRecord);
+    rec->sequence = ++store->sequence;
+    rec->reserved = 0;
+    rec->checksum = status_record_crc32(rec, offsetof(StatusRecord, checksum));
+
+    if (fseek(store->file, (long)(store->next_slot * sizeof(StatusRecord)), SEEK_SET) != 0 ||
+        fwrite(rec, sizeof(StatusRecord), 1, store->file) != 1) {
+        return false;
+    }
+    fflush(store->file);
+    store->next_slot = (store->next_slot + 1) % STATUS_RECORD_SLOTS;
+    return true;
+}
+
+void status_store_close(StatusStore* store) {
+    if (store->file) {
+        fclose(store->file);
+        store->file = NULL;
+    }
+}
@@ -1,9 +1,16 @@
 #include "telemetry.h"
 
+#include "arena.h"
+#include "ipc_trace.h"
+#include "json_writer.h"
+#include "telemetry_trace.h"
+
 #include <stdio.h>
 #include <string.h>
 
 #define PROGRAM_QUERY_INTERVAL_SEC 3
+#define SYSMODULE_PROGRAM_ID       0x00FF0000A1B2C3D4ULL
+#define QLAUNCH_PROGRAM_ID         0x0100000000001000ULL
 
 static u64 sec_since_boot_now(void) {
     return armTicksToNs(armGetSystemTick()) / 1000000000ULL;
@@ -22,165 +29,249 @@ static void copy_utf8_trunc(char* dst, size_t dst_size, const char* src) {
     dst[n] = '\0';
 }
 
-static void json_escape(const char* in, char* out, size_t out_size) {
-    size_t oi = 0;
-    size_t i;
+typedef struct {
+    Result rc;
+    u32 percent;
+} BatterySample;
+
+typedef struct {
+    Result rc;
+    PsmChargerType type;
+} ChargerSample;
+
+typedef struct {
+    Result rc;
+    bool docked;
+} DockSample;
+
+typedef struct {
+    Result pm_rc;
+    Result pminfo_rc;
+    Result svc_rc;
+    u64 process_id;
+    u64 program_id;
+    u32 source;
+} TitleSample;
+
+// Raw IPC results gathered without the state lock, one member per probe.
+typedef union {
+    BatterySample battery;
+    ChargerSample charger;
+    DockSample dock;
+    TitleSample title;
+} ProbeSample;
+
+#define PROBE_PACK_MAX TELEMETRY_PROBE_PACK_MAX
+// Room for two snapshots so a renderer can nest another.
+#define TELEMETRY_ARENA_SIZE (2 * (sizeof(TelemetryState) + ARENA_ALIGN))
+
+// Snapshot buffers for the serializers; rendering only runs on the HTTP thread.
+ARENA_DEFINE(g_telemetry_arena, "telemetry", TELEMETRY_ARENA_SIZE);
+
+typedef struct {
+    const char* name;
+    u32 interval_sec; // default; 0 = every update
+    TelemetryProbeCost cost;
+    // Performs the IPC work; runs without the state lock.
+    void (*sample)(ProbeSample* sample);
+    // Folds a sample into the state under the lock; the return value is cached as last_result.
+    Result (*commit)(TelemetryState* state, const ProbeSample* sample, u64 now);
+    // Writes this probe's fields into the enclosing /state object.
+    void (*write_json)(const TelemetryState* state, JsonWriter* w);
+    // Writes at most PROBE_PACK_MAX bytes; returns the payload length.
+    size_t (*pack)(const TelemetryState* state, u8* out);
+} TelemetryProbeDef;
+
+static u8* pack_u8(u8* p, u8 v) {
+    *p++ = v;
+    return p;
+}
 
-    if (out_size == 0) {
-        return;
-    }
+static u8* pack_u32(u8* p, u32 v) {
+    int i;
+    for (i = 0; i < 4; i++) *p++ = (u8)(v >> (i * 8));
+    return p;
+}
 
-    for (i = 0; in && in[i] != '\0' && oi + 2 < out_size; i++) {
-        const char c = in[i];
-        if (c == '\\' || c == '"') {
-            if (oi + 2 >= out_size) break;
-            out[oi++] = '\\';
-            out[oi++] = c;
-        } else if ((unsigned char)c < 0x20) {
-            out[oi++] = ' ';
-        } else {
-            out[oi++] = c;
-        }
+static u8* pack_u64(u8* p, u64 v) {
+    int i;
+    for (i = 0; i < 8; i++) *p++ = (u8)(v >> (i * 8));
+    return p;
+}
+
+static void json_field_tristate(JsonWriter* w, const char* key, bool valid, bool value) {
+    json_key(w, key);
+    if (valid) {
+        json_bool(w, value);
+    } else {
+        json_null(w);
     }
+}
+
+// battery ---------------------------------------------------------------------
+
+static void battery_sample(ProbeSample* sample) {
+    const u64 start = ipc_trace_begin();
 
-    out[oi] = '\0';
+    sample->battery.percent = 0;
+    sample->battery.rc = psmGetBatteryChargePercentage(&sample->battery.percent);
+    ipc_trace_end(IpcCall_PsmBatteryChargePercentage, start, sample->battery.rc);
+    telemetry_trace_ipc(IpcCall_PsmBatteryChargePercentage, sample->battery.rc, sample->battery.percent, 0);
 }
 
-void telemetry_init(TelemetryState* state) {
-    memset(state, 0, sizeof(*state));
-    rmutexInit(&state->lock);
-    state->started_sec = sec_since_boot_now();
-    state->next_query_sec = state->started_sec;
-    state->pending_program_id = 0;
-    state->pending_match_count = 0;
-    state->detection_mode = false;
-    snprintf(state->active_game, sizeof(state->active_game), "HOME");
-    snprintf(state->firmware, sizeof(state->firmware), "unknown");
+static Result battery_commit(TelemetryState* state, const ProbeSample* sample, u64 now) {
+    (void)now;
+    state->battery_percent_valid = R_SUCCEEDED(sample->battery.rc);
+    if (state->battery_percent_valid) {
+        state->battery_percent = sample->battery.percent;
+    }
+    return sample->battery.rc;
 }
 
-void telemetry_set_firmware(TelemetryState* state, const char* firmware) {
-    rmutexLock(&state->lock);
-    copy_utf8_trunc(state->firmware, sizeof(state->firmware), firmware ? firmware : "unknown");
-    rmutexUnlock(&state->lock);
+static void battery_json(const TelemetryState* state, JsonWriter* w) {
+    json_key(w, "battery_percent");
+    if (state->battery_percent_valid) {
+        json_u64(w, state->battery_percent);
+    } else {
+        json_null(w);
+    }
+    json_field_hex32(w, "last_psm_charge_result", state->probes[TelemetryProbe_Battery].last_result);
 }
 
-void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_battery_query, bool allow_dock_query) {
-    u64 now = sec_since_boot_now();
-    u64 program_id = 0;
-    u64 process_id = 0;
-    Result pm_rc = 0;
-    Result pminfo_rc = 0;
-    Result ns_rc = 0;
-    Result svc_rc = 0;
-    Result psm_charge_rc = 0;
-    Result psm_charger_rc = 0;
-    Result dock_rc = 0;
-    u32 battery_percent = 0;
-    u32 opmode_info = 0;
-    PsmChargerType charger_type = PsmChargerType_Unconnected;
-    AppletOperationMode opmode = AppletOperationMode_Handheld;
-    bool query_attempted = false;
-    bool have_program = false;
-    bool battery_percent_valid = false;
-    bool is_charging_valid = false;
-    bool is_docked_valid = false;
-    bool is_docked = false;
-    u32 dock_detection_source = 0;
-    bool should_query_program = false;
-    u32 source = 0;
-
-    if (allow_battery_query) {
-        psm_charge_rc = psmGetBatteryChargePercentage(&battery_percent);
-        if (R_SUCCEEDED(psm_charge_rc)) {
-            battery_percent_valid = true;
-        }
+static size_t battery_pack(const TelemetryState* state, u8* out) {
+    u8* p = out;
+    p = pack_u8(p, state->battery_percent_valid ? 1 : 0);
+    p = pack_u32(p, state->battery_percent);
+    p = pack_u32(p, state->probes[TelemetryProbe_Battery].last_result);
+    return (size_t)(p - out);
+}
 
-        psm_charger_rc = psmGetChargerType(&charger_type);
-        if (R_SUCCEEDED(psm_charger_rc)) {
-            is_charging_valid = true;
-        }
-    }
+// charger ---------------------------------------------------------------------
 
-    if (allow_dock_query) {
-        dock_rc = appletGetOperationModeSystemInfo(&opmode_info);
-        if (R_SUCCEEDED(dock_rc)) {
-            opmode = appletGetOperationMode();
-            is_docked = (opmode == AppletOperationMode_Console);
-            is_docked_valid = true;
-            dock_detection_source = 1;
-        }
-        (void)opmode_info;
+static void charger_sample(ProbeSample* sample) {
+    const u64 start = ipc_trace_begin();
 
-        // Fallback for sysmodule contexts where applet mode may be unavailable.
-        if (!is_docked_valid && is_charging_valid) {
-            is_docked = (charger_type == PsmChargerType_EnoughPower);
-            is_docked_valid = true;
-            dock_detection_source = 2;
-        }
-    }
+    sample->charger.type = PsmChargerType_Unconnected;
+    sample->charger.rc = psmGetChargerType(&sample->charger.type);
+    ipc_trace_end(IpcCall_PsmChargerType, start, sample->charger.rc);
+    telemetry_trace_ipc(IpcCall_PsmChargerType, sample->charger.rc, (u64)sample->charger.type, 0);
+}
 
-    rmutexLock(&state->lock);
-    state->sample_count++;
-    state->last_update_sec = now;
-    if (allow_battery_query) {
-        state->last_psm_charge_result = psm_charge_rc;
-        state->last_psm_charger_result = psm_charger_rc;
-        state->battery_percent_valid = battery_percent_valid;
-        state->is_charging_valid = is_charging_valid;
-
-        if (battery_percent_valid) {
-            state->battery_percent = battery_percent;
-        }
-        if (is_charging_valid) {
-            state->is_charging = (charger_type != PsmChargerType_Unconnected);
-        }
-    }
-    if (allow_dock_query) {
-        state->last_dock_result = dock_rc;
-        state->is_docked_valid = is_docked_valid;
-        state->dock_detection_source = dock_detection_source;
-        if (is_docked_valid) {
-            state->is_docked = is_docked;
-        }
+static Result charger_commit(TelemetryState* state, const ProbeSample* sample, u64 now) {
+    (void)now;
+    state->is_charging_valid = R_SUCCEEDED(sample->charger.rc);
+    if (state->is_charging_valid) {
+        state->charger_type = (u32)sample->charger.type;
+        state->is_charging = (sample->charger.type != PsmChargerType_Unconnected);
     }
+    return sample->charger.rc;
+}
 
-    if (allow_pm_query) {
-        state->detection_mode = true;
-    }
-    should_query_program = allow_pm_query && now >= state->next_query_sec;
-    if (should_query_program) {
-        state->next_query_sec = now + PROGRAM_QUERY_INTERVAL_SEC;
+static void charger_json(const TelemetryState* state, JsonWriter* w) {
+    json_field_tristate(w, "is_charging", state->is_charging_valid, state->is_charging);
+    json_field_hex32(w, "last_psm_charger_result", state->probes[TelemetryProbe_Charger].last_result);
+}
+
+static size_t charger_pack(const TelemetryState* state, u8* out) {
+    u8* p = out;
+    p = pack_u8(p, state->is_charging_valid ? 1 : 0);
+    p = pack_u8(p, state->is_charging ? 1 : 0);
+    p = pack_u32(p, state->charger_type);
+    p = pack_u32(p, state->probes[TelemetryProbe_Charger].last_result);
+    return (size_t)(p - out);
+}
+
+// dock ------------------------------------------------------------------------
+
+static void dock_sample(ProbeSample* sample) {
+    u32 opmode_info = 0;
+    const u64 start = ipc_trace_begin();
+
+    sample->dock.docked = false;
+    sample->dock.rc = appletGetOperationModeSystemInfo(&opmode_info);
+    ipc_trace_end(IpcCall_AppletOperationModeSystemInfo, start, sample->dock.rc);
+    if (R_SUCCEEDED(sample->dock.rc)) {
+        sample->dock.docked = (appletGetOperationMode() == AppletOperationMode_Console);
     }
-    rmutexUnlock(&state->lock);
-    
-    if (!should_query_program) {
-        return;
+    telemetry_trace_ipc(IpcCall_AppletOperationModeSystemInfo, sample->dock.rc, sample->dock.docked ? 1 : 0, opmode_info);
+}
+
+static Result dock_commit(TelemetryState* state, const ProbeSample* sample, u64 now) {
+    (void)now;
+    if (R_SUCCEEDED(sample->dock.rc)) {
+        state->is_docked = sample->dock.docked;
+        state->is_docked_valid = true;
+        state->dock_detection_source = 1;
+    } else if (state->is_charging_valid) {
+        // Fallback for sysmodule contexts where applet mode may be unavailable.
+        // Relies on the charger probe committing earlier in the same pass.
+        state->is_docked = (state->charger_type == PsmChargerType_EnoughPower);
+        state->is_docked_valid = true;
+        state->dock_detection_source = 2;
+    } else {
+        state->is_docked_valid = false;
+        state->dock_detection_source = 0;
     }
+    return sample->dock.rc;
+}
 
-    query_attempted = true;
-    pm_rc = pmshellGetApplicationProcessIdForShell(&process_id);
-    if (R_SUCCEEDED(pm_rc) && process_id != 0) {
-        pminfo_rc = pminfoGetProgramId(&program_id, process_id);
-        if (R_SUCCEEDED(pminfo_rc) && program_id != 0) {
-            have_program = true;
-            source = 1;
-        } else {
+static void dock_json(const TelemetryState* state, JsonWriter* w) {
+    json_field_tristate(w, "is_docked", state->is_docked_valid, state->is_docked);
+    json_field_u64(w, "dock_detection_source", state->dock_detection_source);
+    json_field_hex32(w, "last_dock_result", state->probes[TelemetryProbe_Dock].last_result);
+}
 
+static size_t dock_pack(const TelemetryState* state, u8* out) {
+    u8* p = out;
+    p = pack_u8(p, state->is_docked_valid ? 1 : 0);
+    p = pack_u8(p, state->is_docked ? 1 : 0);
+    p = pack_u8(p, (u8)state->dock_detection_source);
+    p = pack_u32(p, state->probes[TelemetryProbe_Dock].last_result);
+    return (size_t)(p - out);
+}
+
+// title -----------------------------------------------------------------------
+
+static void title_sample(ProbeSample* sample) {
+    TitleSample* t = &sample->title;
+    u64 start;
+
+    memset(t, 0, sizeof(*t));
+    start = ipc_trace_begin();
+    t->pm_rc = pmshellGetApplicationProcessIdForShell(&t->process_id);
+    ipc_trace_end(IpcCall_PmshellApplicationProcessId, start, t->pm_rc);
+    telemetry_trace_ipc(IpcCall_PmshellApplicationProcessId, t->pm_rc, t->process_id, 0);
+    if (R_SUCCEEDED(t->pm_rc) && t->process_id != 0) {
+        start = ipc_trace_begin();
+        t->pminfo_rc = pminfoGetProgramId(&t->program_id, t->process_id);
+        ipc_trace_end(IpcCall_PminfoProgramId, start, t->pminfo_rc);
+        telemetry_trace_ipc(IpcCall_PminfoProgramId, t->pminfo_rc, t->program_id, t->process_id);
+        if (R_SUCCEEDED(t->pminfo_rc) && t->program_id != 0) {
+            t->source = 1;
+            return;
         }
     }
 
     // Fallback: If pm-shit doesn't work
-    if (!have_program) {
+    {
         u64 pids[64];
         s32 out_count = 0;
-        svc_rc = svcGetProcessList(&out_count, pids, (s32)(sizeof(pids) / sizeof(pids[0])));
-        if (R_SUCCEEDED(svc_rc) && out_count > 0) {
+        start = ipc_trace_begin();
+        t->svc_rc = svcGetProcessList(&out_count, pids, (s32)(sizeof(pids) / sizeof(pids[0])));
+        ipc_trace_end(IpcCall_SvcProcessList, start, t->svc_rc);
+        telemetry_trace_process_list(t->svc_rc, pids, out_count);
+        if (R_SUCCEEDED(t->svc_rc) && out_count > 0) {
             u64 best = 0;
             int i;
             for (i = 0; i < out_count; i++) {
                 u64 pid = pids[i];
                 u64 candidate = 0;
-                Result rc = pminfoGetProgramId(&candidate, pid);
+                Result rc;
+
+                start = ipc_trace_begin();
+                rc = pminfoGetProgramId(&candidate, pid);
+                ipc_trace_end(IpcCall_PminfoProgramId, start, rc);
+                telemetry_trace_ipc(IpcCall_PminfoProgramId, rc, candidate, pid);
                 if (R_FAILED(rc) || candidate == 0) {
                     continue;
                 }
@@ -192,48 +283,49 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
                     continue; 
                 }
 
-                if (candidate == 0x0100000000001000ULL) { // qlaunch
+                if (candidate == QLAUNCH_PROGRAM_ID) {
                     continue;
                 }
-                if (candidate == 0x00FF0000A1B2C3D4ULL) { // sysmodule title id
+                if (candidate == SYSMODULE_PROGRAM_ID) {
                     continue;
                 }
 
                 if (candidate > best) {
                     best = candidate;
-                    process_id = pid;
-                    program_id = candidate;
-                    pminfo_rc = rc;
+                    t->process_id = pid;
+                    t->program_id = candidate;
+                    t->pminfo_rc = rc;
                 }
             }
 
             if (best != 0) {
-                have_program = true;
-                source = 2;
+                t->source = 2;
             }
         }
     }
+}
 
-    rmutexLock(&state->lock);
-    if (query_attempted) {
-        state->detection_attempt_count++;
-        state->detection_last_query_sec = now;
-        state->last_pm_result = pm_rc;
-        state->last_pminfo_result = pminfo_rc;
-        state->last_ns_result = ns_rc;
-        state->last_svc_result = svc_rc;
-        state->last_process_id = process_id;
-        state->detection_source = source;
-
-        if (have_program) {
-            state->detection_success_count++;
-            state->detection_fail_streak = 0;
-            state->detection_last_success_sec = now;
-        } else {
-            state->detection_fail_count++;
-            if (state->detection_fail_streak < 0xFFFFFFFFU) {
-                state->detection_fail_streak++;
-            }
+static Result title_commit(TelemetryState* state, const ProbeSample* sample, u64 now) {
+    const TitleSample* t = &sample->title;
+    const bool have_program = (t->source != 0);
+
+    state->detection_attempt_count++;
+    state->detection_last_query_sec = now;
+    state->last_pm_result = t->pm_rc;
+    state->last_pminfo_result = t->pminfo_rc;
+    state->last_ns_result = 0;
+    state->last_svc_result = t->svc_rc;
+    state->last_process_id = t->process_id;
+    state->detection_source = t->source;
+
+    if (have_program) {
+        state->detection_success_count++;
+        state->detection_fail_streak = 0;
+        state->detection_last_success_sec = now;
+    } else {
+        state->detection_fail_count++;
+        if (state->detection_fail_streak < 0xFFFFFFFFU) {
+            state->detection_fail_streak++;
         }
     }
 
@@ -242,168 +334,253 @@ void telemetry_update(TelemetryState* state, bool allow_pm_query, bool allow_bat
         state->pending_match_count = 0;
         state->active_program_id = 0;
         copy_utf8_trunc(state->active_game, sizeof(state->active_game), "HOME");
-        rmutexUnlock(&state->lock);
-        return;
+        return t->pm_rc;
     }
 
-    if (state->pending_program_id == program_id) {
+    if (state->pending_program_id == t->program_id) {
         if (state->pending_match_count < 255) state->pending_match_count++;
     } else {
-        state->pending_program_id = program_id;
+        state->pending_program_id = t->program_id;
         state->pending_match_count = 1;
     }
 
     if (state->pending_match_count >= 2) {
-        state->active_program_id = program_id;
+        state->active_program_id = t->program_id;
         snprintf(state->active_game, sizeof(state->active_game), "0x%016llX",
-                 (unsigned long long)program_id);
+                 (unsigned long long)t->program_id);
     }
+    return t->pm_rc;
+}
+
+static void title_json(const TelemetryState* state, JsonWriter* w) {
+    json_field_hex64(w, "active_program_id", state->active_program_id);
+    json_field_string(w, "active_game", state->active_game);
+    json_field_hex32(w, "last_pm_result", state->last_pm_result);
+    json_field_hex32(w, "last_pminfo_result", state->last_pminfo_result);
+    json_field_hex32(w, "last_ns_result", state->last_ns_result);
+    json_field_hex32(w, "last_svc_result", state->last_svc_result);
+    json_field_hex64(w, "last_process_id", state->last_process_id);
+    json_field_u64(w, "detection_source", state->detection_source);
+    json_field_bool(w, "detection_mode", (state->armed_probes & TELEMETRY_PROBE_BIT(TelemetryProbe_Title)) != 0);
+    json_field_u64(w, "detection_attempt_count", state->detection_attempt_count);
+    json_field_u64(w, "detection_success_count", state->detection_success_count);
+    json_field_u64(w, "detection_fail_count", state->detection_fail_count);
+    json_field_u64(w, "detection_fail_streak", state->detection_fail_streak);
+    json_field_u64(w, "detection_last_query_sec", state->detection_last_query_sec);
+    json_field_u64(w, "detection_last_success_sec", state->detection_last_success_sec);
+}
+
+static size_t title_pack(const TelemetryState* state, u8* out) {
+    u8* p = out;
+    p = pack_u64(p, state->active_program_id);
+    p = pack_u64(p, state->last_process_id);
+    p = pack_u8(p, (u8)state->detection_source);
+    p = pack_u32(p, state->detection_fail_streak);
+    p = pack_u32(p, state->last_pm_result);
+    p = pack_u32(p, state->last_pminfo_result);
+    p = pack_u32(p, state->last_svc_result);
+    return (size_t)(p - out);
+}
+
+// registry --------------------------------------------------------------------
+
+static const TelemetryProbeDef g_probes[TelemetryProbe_Count] = {
+    [TelemetryProbe_Battery] = {
+        "battery", 0, TelemetryProbeCost_Cheap,
+        battery_sample, battery_commit, battery_json, battery_pack
+    },
+    [TelemetryProbe_Charger] = {
+        "charger", 0, TelemetryProbeCost_Cheap,
+        charger_sample, charger_commit, charger_json, charger_pack
+    },
+    [TelemetryProbe_Dock] = {
+        "dock", 0, TelemetryProbeCost_Cheap,
+        dock_sample, dock_commit, dock_json, dock_pack
+    },
+    [TelemetryProbe_Title] = {
+        "title", PROGRAM_QUERY_INTERVAL_SEC, TelemetryProbeCost_Expensive,
+        title_sample, title_commit, title_json, title_pack
+    },
+};
+
+static const char* probe_cost_name(TelemetryProbeCost cost) {
+    switch (cost) {
+        case TelemetryProbeCost_Cheap: return "cheap";
+        case TelemetryProbeCost_Moderate: return "moderate";
+        case TelemetryProbeCost_Expensive: return "expensive";
+    }
+    return "unknown";
+}
+
+// Copies the state into the render arena so serializers can run without
+// holding the lock. Callers release the arena back to their mark.
+static TelemetryState* telemetry_snapshot(TelemetryState* state) {
+    TelemetryState* snap = (TelemetryState*)arena_alloc(&g_telemetry_arena, sizeof(*snap));
+
+    if (!snap) return NULL;
+    rmutexLock(&state->lock);
+    memcpy(snap, state, sizeof(*snap));
     rmutexUnlock(&state->lock);
+    return snap;
 }
 
-void telemetry_build_json(TelemetryState* state, char* out, size_t out_size) {
-    char escaped_game[512];
-    char escaped_firmware[64];
-    u64 started_sec = 0;
-    u64 last_update_sec = 0;
-    u64 sample_count = 0;
-    u64 active_program_id = 0;
-    Result last_pm_result = 0;
-    Result last_pminfo_result = 0;
-    Result last_ns_result = 0;
-    Result last_svc_result = 0;
-    u64 last_process_id = 0;
-    u32 detection_source = 0;
-    bool detection_mode = false;
-    u64 detection_attempt_count = 0;
-    u64 detection_success_count = 0;
-    u64 detection_fail_count = 0;
-    u32 detection_fail_streak = 0;
-    u64 detection_last_query_sec = 0;
-    u64 detection_last_success_sec = 0;
-    u32 battery_percent = 0;
-    bool battery_percent_valid = false;
-    bool is_charging = false;
-    bool is_charging_valid = false;
-    bool is_docked = false;
-    bool is_docked_valid = false;
-    Result last_psm_charge_result = 0;
-    Result last_psm_charger_result = 0;
-    Result last_dock_result = 0;
-    u32 dock_detection_source = 0;
-    char battery_percent_json[16];
-    char is_charging_json[8];
-    char is_docked_json[8];
-    char active_game[sizeof(state->active_game)];
-    char firmware[sizeof(state->firmware)];
+void telemetry_init(TelemetryState* state) {
+    int id;
 
+    arena_register(&g_telemetry_arena);
+    memset(state, 0, sizeof(*state));
+    rmutexInit(&state->lock);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        state->probes[id].interval_sec = g_probes[id].interval_sec;
+    }
+    state->started_sec = sec_since_boot_now();
+    state->pending_program_id = 0;
+    state->pending_match_count = 0;
+    snprintf(state->active_game, sizeof(state->active_game), "HOME");
+    snprintf(state->firmware, sizeof(state->firmware), "unknown");
+}
+
+void telemetry_set_firmware(TelemetryState* state, const char* firmware) {
     rmutexLock(&state->lock);
-    started_sec = state->started_sec;
-    last_update_sec = state->last_update_sec;
-    sample_count = state->sample_count;
-    active_program_id = state->active_program_id;
-    last_pm_result = state->last_pm_result;
-    last_pminfo_result = state->last_pminfo_result;
-    last_ns_result = state->last_ns_result;
-    last_svc_result = state->last_svc_result;
-    last_process_id = state->last_process_id;
-    detection_source = state->detection_source;
-    detection_mode = state->detection_mode;
-    detection_attempt_count = state->detection_attempt_count;
-    detection_success_count = state->detection_success_count;
-    detection_fail_count = state->detection_fail_count;
-    detection_fail_streak = state->detection_fail_streak;
-    detection_last_query_sec = state->detection_last_query_sec;
-    detection_last_success_sec = state->detection_last_success_sec;
-    battery_percent = state->battery_percent;
-    battery_percent_valid = state->battery_percent_valid;
-    is_charging = state->is_charging;
-    is_charging_valid = state->is_charging_valid;
-    is_docked = state->is_docked;
-    is_docked_valid = state->is_docked_valid;
-    last_psm_charge_result = state->last_psm_charge_result;
-    last_psm_charger_result = state->last_psm_charger_result;
-    last_dock_result = state->last_dock_result;
-    dock_detection_source = state->dock_detection_source;
-    copy_utf8_trunc(active_game, sizeof(active_game), state->active_game);
-    copy_utf8_trunc(firmware, sizeof(firmware), state->firmware);
+    copy_utf8_trunc(state->firmware, sizeof(state->firmware), firmware ? firmware : "unknown");
     rmutexUnlock(&state->lock);
+}
 
-    json_escape(active_game, escaped_game, sizeof(escaped_game));
-    json_escape(firmware, escaped_firmware, sizeof(escaped_firmware));
-    if (battery_percent_valid) {
-        snprintf(battery_percent_json, sizeof(battery_percent_json), "%u", (unsigned int)battery_percent);
-    } else {
-        snprintf(battery_percent_json, sizeof(battery_percent_json), "null");
+void telemetry_set_probe_interval(TelemetryState* state, TelemetryProbeId id, u32 interval_sec) {
+    if ((unsigned int)id >= TelemetryProbe_Count) return;
+    rmutexLock(&state->lock);
+    state->probes[id].interval_sec = interval_sec;
+    rmutexUnlock(&state->lock);
+}
+
+void telemetry_update(TelemetryState* state, u32 enabled_probes) {
+    const u64 now = sec_since_boot_now();
+    ProbeSample samples[TelemetryProbe_Count];
+    u64 run_ticks[TelemetryProbe_Count];
+    u32 intervals[TelemetryProbe_Count];
+    u32 due = 0;
+    int id;
+
+    rmutexLock(&state->lock);
+    state->sample_count++;
+    state->last_update_sec = now;
+    state->armed_probes |= enabled_probes;
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        TelemetryProbeStatus* status = &state->probes[id];
+        intervals[id] = status->interval_sec;
+        if (!(enabled_probes & TELEMETRY_PROBE_BIT(id)) || now < status->next_due_sec) {
+            continue;
+        }
+        due |= TELEMETRY_PROBE_BIT(id);
+        status->next_due_sec = now + status->interval_sec;
     }
-    if (is_charging_valid) {
-        snprintf(is_charging_json, sizeof(is_charging_json), "%s", is_charging ? "true" : "false");
-    } else {
-        snprintf(is_charging_json, sizeof(is_charging_json), "null");
+    rmutexUnlock(&state->lock);
+    telemetry_trace_update(enabled_probes, intervals, TelemetryProbe_Count);
+
+    if (due == 0) {
+        return;
     }
-    if (is_docked_valid) {
-        snprintf(is_docked_json, sizeof(is_docked_json), "%s", is_docked ? "true" : "false");
-    } else {
-        snprintf(is_docked_json, sizeof(is_docked_json), "null");
+
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        u64 start;
+        if (!(due & TELEMETRY_PROBE_BIT(id))) continue;
+        start = armGetSystemTick();
+        g_probes[id].sample(&samples[id]);
+        run_ticks[id] = armGetSystemTick() - start;
+    }
+
+    rmutexLock(&state->lock);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        TelemetryProbeStatus* status = &state->probes[id];
+        if (!(due & TELEMETRY_PROBE_BIT(id))) continue;
+        status->last_result = g_probes[id].commit(state, &samples[id], now);
+        status->run_count++;
+        status->last_run_ticks = run_ticks[id];
+        status->total_run_ticks += run_ticks[id];
+        if (run_ticks[id] > status->max_run_ticks) {
+            status->max_run_ticks = run_ticks[id];
+        }
+    }
+    rmutexUnlock(&state->lock);
+}
+
+void telemetry_write_json(TelemetryState* state, JsonWriter* w) {
+    const size_t mark = arena_mark(&g_telemetry_arena);
+    const TelemetryState* snap = telemetry_snapshot(state);
+    int id;
+
+    if (!snap) {
+        json_null(w);
+        return;
+    }
+
+    json_begin_object(w);
+    json_field_string(w, "service", "RichNX");
+    json_field_string(w, "firmware", snap->firmware);
+    json_field_u64(w, "started_sec", snap->started_sec);
+    json_field_u64(w, "last_update_sec", snap->last_update_sec);
+    json_field_u64(w, "sample_count", snap->sample_count);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        g_probes[id].write_json(snap, w);
     }
+    json_end_object(w);
+    arena_release(&g_telemetry_arena, mark);
+}
+
+size_t telemetry_build_json(TelemetryState* state, char* out, size_t out_size) {
+    JsonWriter w;
+
+    json_writer_init(&w, out, out_size);
+    telemetry_write_json(state, &w);
+    return json_writer_finish(&w);
+}
+
+void telemetry_write_probe_json(TelemetryState* state, JsonWriter* w) {
+    const size_t mark = arena_mark(&g_telemetry_arena);
+    const TelemetryState* snap = telemetry_snapshot(state);
+    int id;
+
+    if (!snap) {
+        json_null(w);
+        return;
+    }
+
+    json_begin_object(w);
+    json_field_hex32(w, "armed", snap->armed_probes);
+    json_key(w, "probes");
+    json_begin_array(w);
+    for (id = 0; id < TelemetryProbe_Count; id++) {
+        const TelemetryProbeStatus* status = &snap->probes[id];
+        const u64 mean_ticks = status->run_count ? (status->total_run_ticks / status->run_count) : 0;
+
+        json_begin_object(w);
+        json_field_string(w, "name", g_probes[id].name);
+        json_field_string(w, "cost", probe_cost_name(g_probes[id].cost));
+        json_field_u64(w, "interval_sec", status->interval_sec);
+        json_field_hex32(w, "last_result", status->last_result);
+        json_field_u64(w, "run_count", status->run_count);
+        json_field_u64(w, "next_due_sec", status->next_due_sec);
+        json_field_u64(w, "last_us", armTicksToNs(status->last_run_ticks) / 1000ULL);
+        json_field_u64(w, "mean_us", armTicksToNs(mean_ticks) / 1000ULL);
+        json_field_u64(w, "max_us", armTicksToNs(status->max_run_ticks) / 1000ULL);
+        json_end_object(w);
+    }
+    json_end_array(w);
+    json_end_object(w);
+    arena_release(&g_telemetry_arena, mark);
+}
+
+const char* telemetry_probe_name(TelemetryProbeId id) {
+    return (unsigned int)id < TelemetryProbe_Count ? g_probes[id].name : "unknown";
+}
+
+void telemetry_copy(TelemetryState* state, TelemetryState* out) {
+    rmutexLock(&state->lock);
+    memcpy(out, state, sizeof(*out));
+    rmutexUnlock(&state->lock);
+}
 
-    snprintf(
-        out,
-        out_size,
-        "{"
-        "\"service\":\"RichNX\","
-        "\"firmware\":\"%s\","
-        "\"active_program_id\":\"0x%016llX\","
-        "\"active_game\":\"%s\","
-        "\"started_sec\":%llu,"
-        "\"last_update_sec\":%llu,"
-        "\"sample_count\":%llu,"
-        "\"last_pm_result\":\"0x%08lX\","
-        "\"last_pminfo_result\":\"0x%08lX\","
-        "\"last_ns_result\":\"0x%08lX\","
-        "\"last_svc_result\":\"0x%08lX\","
-        "\"last_process_id\":\"0x%016llX\","
-        "\"detection_source\":%u,"
-        "\"detection_mode\":%s,"
-        "\"detection_attempt_count\":%llu,"
-        "\"detection_success_count\":%llu,"
-        "\"detection_fail_count\":%llu,"
-        "\"detection_fail_streak\":%u,"
-        "\"detection_last_query_sec\":%llu,"
-        "\"detection_last_success_sec\":%llu,"
-        "\"battery_percent\":%s,"
-        "\"is_charging\":%s,"
-        "\"is_docked\":%s,"
-        "\"dock_detection_source\":%u,"
-        "\"last_psm_charge_result\":\"0x%08lX\","
-        "\"last_psm_charger_result\":\"0x%08lX\","
-        "\"last_dock_result\":\"0x%08lX\""
-        "}",
-        escaped_firmware,
-        (unsigned long long)active_program_id,
-        escaped_game,
-        (unsigned long long)started_sec,
-        (unsigned long long)last_update_sec,
-        (unsigned long long)sample_count,
-        (unsigned long)last_pm_result,
-        (unsigned long)last_pminfo_result,
-        (unsigned long)last_ns_result,
-        (unsigned long)last_svc_result,
-        (unsigned long long)last_process_id,
-        (unsigned int)detection_source,
-        detection_mode ? "true" : "false",
-        (unsigned long long)detection_attempt_count,
-        (unsigned long long)detection_success_count,
-        (unsigned long long)detection_fail_count,
-        (unsigned int)detection_fail_streak,
-        (unsigned long long)detection_last_query_sec,
-        (unsigned long long)detection_last_success_sec,
-        battery_percent_json,
-        is_charging_json,
-        is_docked_json,
-        (unsigned int)dock_detection_source,
-        (unsigned long)last_psm_charge_result,
-        (unsigned long)last_psm_charger_result,
-        (unsigned long)last_dock_result
-    );
+size_t telemetry_pack_probe(const TelemetryState* snap, TelemetryProbeId id, u8* out) {
+    if ((unsigned int)id >= TelemetryProbe_Count) return 0;
+    return g_probes[id].pack(snap, out);
 }
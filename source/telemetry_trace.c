@@ -0,0 +1,242 @@
+#include "telemetry_trace.h"
+
+#include "arena.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_BUFFER_SIZE 4096
+#define TRACE_PROCESS_LIST_MAX 64
+// type + dt + rc + count + pids, each varint at most 10 bytes
+#define TRACE_RECORD_MAX (1 + 10 * (3 + TRACE_PROCESS_LIST_MAX))
+#define TRACE_PROBE_MAX 8
+
+typedef struct {
+    RMutex lock; // zero-init is a valid RMutex
+    volatile bool active;
+    bool full;
+    FILE* file;
+    u8* buf;
+    size_t buf_len;
+    u64 last_tick;
+    u64 file_bytes;
+    u64 max_bytes;
+    u64 records;
+    u64 dropped;
+    u64 dropped_pending;
+    u32 intervals[TRACE_PROBE_MAX];
+    bool intervals_known;
+} TraceRecorder;
+
+// Record staging buffer; owned by the recorder under its lock.
+ARENA_DEFINE(g_trace_arena, "trace", TRACE_BUFFER_SIZE);
+
+static TraceRecorder g_trace;
+
+static u8* put_varint(u8* p, u64 value) {
+    while (value >= 0x80) {
+        *p++ = (u8)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (u8)value;
+    return p;
+}
+
+static u8* put_header(u8* p, TraceRecordType type) {
+    const u64 now = armGetSystemTick();
+    const u64 dt_us = armTicksToNs(now - g_trace.last_tick) / 1000ULL;
+
+    g_trace.last_tick = now;
+    *p++ = (u8)type;
+    return put_varint(p, dt_us);
+}
+
+// Caller holds the lock. Stops recording for good once max_bytes is reached.
+static void trace_append(const u8* record, size_t len) {
+    if (g_trace.file_bytes + g_trace.buf_len + len > g_trace.max_bytes) {
+        g_trace.active = false;
+        g_trace.full = true;
+        return;
+    }
+    if (g_trace.buf_len + len > TRACE_BUFFER_SIZE) {
+        g_trace.dropped++;
+        g_trace.dropped_pending++;
+        return;
+    }
+    memcpy(g_trace.buf + g_trace.buf_len, record, len);
+    g_trace.buf_len += len;
+    g_trace.records++;
+}
+
+static void trace_emit(const u8* record, size_t len) {
+    if (g_trace.dropped_pending > 0) {
+        u8 dropped[24];
+        u8* p = put_header(dropped, TraceRecord_Dropped);
+        p = put_varint(p, g_trace.dropped_pending);
+        if (g_trace.buf_len + (size_t)(p - dropped) + len <= TRACE_BUFFER_SIZE) {
+            g_trace.dropped_pending = 0;
+            trace_append(dropped, (size_t)(p - dropped));
+        }
+    }
+    trace_append(record, len);
+}
+
+static void trace_flush_locked(void) {
+    if (!g_trace.file || g_trace.buf_len == 0) return;
+    if (fwrite(g_trace.buf, 1, g_trace.buf_len, g_trace.file) != g_trace.buf_len) {
+        LOG_WARN_RATELIMITED(60000, "trace: write failed, %u bytes lost", (unsigned int)g_trace.buf_len);
+    } else {
+        g_trace.file_bytes += g_trace.buf_len;
+    }
+    fflush(g_trace.file);
+    g_trace.buf_len = 0;
+}
+
+bool telemetry_trace_start(const char* path, u32 max_bytes) {
+    static const u8 header[TELEMETRY_TRACE_HEADER_SIZE] = { 'R', 'N', 'X', 'T', TELEMETRY_TRACE_VERSION, 0, 0, 0 };
+    bool ok;
+
+    arena_register(&g_trace_arena);
+    telemetry_trace_stop();
+
+    rmutexLock(&g_trace.lock);
+    if (!g_trace.buf) {
+        g_trace.buf = (u8*)arena_alloc(&g_trace_arena, TRACE_BUFFER_SIZE);
+    }
+    g_trace.file = g_trace.buf ? fopen(path, "wb") : NULL;
+    ok = g_trace.file && fwrite(header, 1, sizeof(header), g_trace.file) == sizeof(header);
+    if (!ok) {
+        if (g_trace.file) fclose(g_trace.file);
+        g_trace.file = NULL;
+        rmutexUnlock(&g_trace.lock);
+        LOG_WARN("trace: cannot open %s", path);
+        return false;
+    }
+    g_trace.buf_len = 0;
+    g_trace.file_bytes = sizeof(header);
+    g_trace.max_bytes = max_bytes;
+    g_trace.records = 0;
+    g_trace.dropped = 0;
+    g_trace.dropped_pending = 0;
+    g_trace.intervals_known = false;
+    g_trace.full = false;
+    g_trace.last_tick = armGetSystemTick();
+    g_trace.active = true;
+    rmutexUnlock(&g_trace.lock);
+
+    LOG_INFO("trace: recording to %s (max %u KB)", path, (unsigned int)(max_bytes / 1024));
+    return true;
+}
+
+void telemetry_trace_stop(void) {
+    rmutexLock(&g_trace.lock);
+    if (g_trace.file) {
+        trace_flush_locked();
+        fclose(g_trace.file);
+        g_trace.file = NULL;
+        LOG_INFO(
+            "trace: stopped (%llu records, %llu bytes, %llu dropped)",
+            (unsigned long long)g_trace.records,
+            (unsigned long long)g_trace.file_bytes,
+            (unsigned long long)g_trace.dropped
+        );
+    }
+    g_trace.active = false;
+    rmutexUnlock(&g_trace.lock);
+}
+
+bool telemetry_trace_active(void) {
+    return g_trace.active;
+}
+
+void telemetry_trace_flush(void) {
+    bool closed_full = false;
+
+    if (!g_trace.file) return;
+    rmutexLock(&g_trace.lock);
+    trace_flush_locked();
+    if (g_trace.full && g_trace.file) {
+        fclose(g_trace.file);
+        g_trace.file = NULL;
+        closed_full = true;
+    }
+    rmutexUnlock(&g_trace.lock);
+    if (closed_full) {
+        LOG_INFO("trace: size limit reached after %llu records", (unsigned long long)g_trace.records);
+    }
+}
+
+void telemetry_trace_update(u32 enabled_probes, const u32* intervals_sec, int probe_count) {
+    u8 record[TRACE_RECORD_MAX];
+    u8* p;
+    int i;
+
+    if (!g_trace.active) return;
+    rmutexLock(&g_trace.lock);
+    if (probe_count > TRACE_PROBE_MAX) probe_count = TRACE_PROBE_MAX;
+    for (i = 0; g_trace.active && i < probe_count; i++) {
+        if (g_trace.intervals_known && g_trace.intervals[i] == intervals_sec[i]) continue;
+        g_trace.intervals[i] = intervals_sec[i];
+        p = put_header(record, TraceRecord_Interval);
+        p = put_varint(p, (u64)i);
+        p = put_varint(p, intervals_sec[i]);
+        trace_emit(record, (size_t)(p - record));
+    }
+    g_trace.intervals_known = true;
+    if (g_trace.active) {
+        p = put_header(record, TraceRecord_Update);
+        p = put_varint(p, enabled_probes);
+        trace_emit(record, (size_t)(p - record));
+    }
+    rmutexUnlock(&g_trace.lock);
+}
+
+void telemetry_trace_ipc(IpcCallId call, Result rc, u64 value, u64 arg) {
+    u8 record[TRACE_RECORD_MAX];
+    u8* p;
+
+    if (!g_trace.active) return;
+    rmutexLock(&g_trace.lock);
+    if (g_trace.active) {
+        p = put_header(record, TraceRecord_Ipc);
+        p = put_varint(p, (u64)call);
+        p = put_varint(p, rc);
+        p = put_varint(p, value);
+        p = put_varint(p, arg);
+        trace_emit(record, (size_t)(p - record));
+    }
+    rmutexUnlock(&g_trace.lock);
+}
+
+void telemetry_trace_process_list(Result rc, const u64* pids, s32 count) {
+    u8 record[TRACE_RECORD_MAX];
+    u8* p;
+    s32 i;
+
+    if (!g_trace.active) return;
+    if (count < 0) count = 0;
+    if (count > TRACE_PROCESS_LIST_MAX) count = TRACE_PROCESS_LIST_MAX;
+    rmutexLock(&g_trace.lock);
+    if (g_trace.active) {
+        p = put_header(record, TraceRecord_ProcessList);
+        p = put_varint(p, rc);
+        p = put_varint(p, (u64)count);
+        for (i = 0; i < count; i++) p = put_varint(p, pids[i]);
+        trace_emit(record, (size_t)(p - record));
+    }
+    rmutexUnlock(&g_trace.lock);
+}
+
+void telemetry_trace_write_json(JsonWriter* w) {
+    rmutexLock(&g_trace.lock);
+    json_begin_object(w);
+    json_field_bool(w, "active", g_trace.active);
+    json_field_bool(w, "full", g_trace.full);
+    json_field_u64(w, "records", g_trace.records);
+    json_field_u64(w, "bytes", g_trace.file_bytes + g_trace.buf_len);
+    json_field_u64(w, "max_bytes", g_trace.max_bytes);
+    json_field_u64(w, "dropped", g_trace.dropped);
+    json_end_object(w);
+    rmutexUnlock(&g_trace.lock);
+}
@@ -0,0 +1,133 @@
+#include "watchdog.h"
+
+#include "flight_recorder.h"
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+#define WATCHDOG_REASON_MAX 96
+
+typedef struct {
+    _Atomic u64 last_tick;
+    const char* _Atomic where;
+    atomic_bool stalled; // inside a stall episode reported by watchdog_check
+    u64 stalls;
+    u64 restarts;
+    u64 restart_failures;
+    u64 last_stall_ms;
+    _Atomic u64 wakeups;
+    _Atomic u64 first_wake_tick;
+    char last_stall_reason[WATCHDOG_REASON_MAX];
+} WatchdogEntry;
+
+static const char* const g_watchdog_names[Watchdog_Count] = {
+    [Watchdog_MainLoop] = "main",
+    [Watchdog_Http] = "http",
+};
+
+static WatchdogEntry g_watchdog[Watchdog_Count];
+static RMutex g_watchdog_lock; // guards the counters and reason text; zero-init is a valid RMutex
+
+static u64 watchdog_now_ms(void) {
+    return armTicksToNs(armGetSystemTick()) / 1000000ULL;
+}
+
+void watchdog_beat(WatchdogId id, const char* where) {
+    WatchdogEntry* e = &g_watchdog[id];
+
+    atomic_store_explicit(&e->where, where, memory_order_relaxed);
+    atomic_store_explicit(&e->last_tick, armGetSystemTick(), memory_order_release);
+    if (atomic_load_explicit(&e->stalled, memory_order_relaxed)) {
+        atomic_store_explicit(&e->stalled, false, memory_order_relaxed);
+        LOG_INFO("watchdog: %s loop is beating again", g_watchdog_names[id]);
+    }
+}
+
+u64 watchdog_age_ms(WatchdogId id) {
+    const u64 last = atomic_load_explicit(&g_watchdog[id].last_tick, memory_order_acquire);
+    if (last == 0) return 0;
+    return armTicksToNs(armGetSystemTick() - last) / 1000000ULL;
+}
+
+void watchdog_record_stall(WatchdogId id, const char* fmt, ...) {
+    WatchdogEntry* e = &g_watchdog[id];
+    va_list args;
+
+    rmutexLock(&g_watchdog_lock);
+    e->stalls++;
+    e->last_stall_ms = watchdog_now_ms();
+    va_start(args, fmt);
+    vsnprintf(e->last_stall_reason, sizeof(e->last_stall_reason), fmt, args);
+    va_end(args);
+    rmutexUnlock(&g_watchdog_lock);
+
+    LOG_WARN("watchdog: %s %s", g_watchdog_names[id], e->last_stall_reason);
+    flight_recorder_record(FlightEventType_Stall, g_watchdog_names[id], 0, 0);
+}
+
+bool watchdog_check(WatchdogId id, u64 limit_ms) {
+    WatchdogEntry* e = &g_watchdog[id];
+    const u64 age = watchdog_age_ms(id);
+    const char* where;
+
+    if (age <= limit_ms || atomic_load_explicit(&e->stalled, memory_order_relaxed)) {
+        return false;
+    }
+    atomic_store_explicit(&e->stalled, true, memory_order_relaxed);
+    where = atomic_load_explicit(&e->where, memory_order_relaxed);
+    watchdog_record_stall(id, "stalled %llums in %s", (unsigned long long)age, where ? where : "?");
+    return true;
+}
+
+void watchdog_record_restart(WatchdogId id, bool ok) {
+    rmutexLock(&g_watchdog_lock);
+    if (ok) {
+        g_watchdog[id].restarts++;
+    } else {
+        g_watchdog[id].restart_failures++;
+    }
+    rmutexUnlock(&g_watchdog_lock);
+}
+
+void watchdog_count_wake(WatchdogId id) {
+    WatchdogEntry* e = &g_watchdog[id];
+
+    if (atomic_fetch_add_explicit(&e->wakeups, 1, memory_order_relaxed) == 0) {
+        atomic_store_explicit(&e->first_wake_tick, armGetSystemTick(), memory_order_relaxed);
+    }
+}
+
+// Averaged from the first counted wake-up.
+static u64 watchdog_wakeups_per_min(const WatchdogEntry* e) {
+    const u64 wakeups = atomic_load_explicit(&e->wakeups, memory_order_relaxed);
+    const u64 first = atomic_load_explicit(&e->first_wake_tick, memory_order_relaxed);
+    const u64 elapsed_ms = first ? armTicksToNs(armGetSystemTick() - first) / 1000000ULL : 0;
+
+    return elapsed_ms >= 1000 ? wakeups * 60000ULL / elapsed_ms : 0;
+}
+
+void watchdog_write_json(JsonWriter* w) {
+    int id;
+
+    rmutexLock(&g_watchdog_lock);
+    json_begin_object(w);
+    for (id = 0; id < Watchdog_Count; id++) {
+        const WatchdogEntry* e = &g_watchdog[id];
+
+        json_key(w, g_watchdog_names[id]);
+        json_begin_object(w);
+        json_field_u64(w, "age_ms", watchdog_age_ms((WatchdogId)id));
+        json_field_u64(w, "stalls", e->stalls);
+        json_field_u64(w, "restarts", e->restarts);
+        json_field_u64(w, "restart_failures", e->restart_failures);
+        json_field_u64(w, "last_stall_ms", e->last_stall_ms);
+        json_field_string(w, "last_stall", e->last_stall_reason);
+        json_field_u64(w, "wakeups", atomic_load_explicit(&e->wakeups, memory_order_relaxed));
+        json_field_u64(w, "wakeups_per_min", watchdog_wakeups_per_min(e));
+        json_end_object(w);
+    }
+    json_end_object(w);
+    rmutexUnlock(&g_watchdog_lock);
+}
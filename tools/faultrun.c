@@ -0,0 +1,368 @@
+// Measures how the HTTP server recovers from injected socket faults. Starts the
+// host build under host/netfault.c's fault layer, then for each [scenario] in
+// the file arms it (SIGUSR1), probes GET /state at a fixed interval until the
+// scenario's faults are used up and a probe succeeds again, and prints one
+// JSON line per scenario:
+//
+//   faultrun -s host/netfault.ini -- ./richnx-host
+//   faultrun -s my.ini -i 20 -w 60 -- ./richnx-host
+//
+// Times are from the first injected fault: recover_ms ends at the first
+// successful probe sent after the last one, recover_after_faults_ms measures
+// the same point from the last injected fault (the server's own recovery
+// latency), outage_ms is what a client saw (first failed probe to the next
+// success) and lost counts failed probes. http_restarts is the watchdog's
+// restart count delta. A scenario whose faults are never all consumed, or
+// that does not recover within -w seconds, reports "recovered":false.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SCENARIO_MAX 32
+#define RESPONSE_MAX (256 * 1024)
+#define LOG_LINE_MAX 256
+
+typedef struct {
+    char name[48];
+    bool armed;
+    bool exhausted;
+    uint64_t armed_ns;
+    uint64_t first_fault_ns;
+    uint64_t last_fault_ns;
+    uint64_t exhausted_ns;
+    uint32_t injected; // actions that failed the call
+    uint32_t delayed;  // actions with a delay
+} ScenarioLog;
+
+typedef struct {
+    const char* script;
+    int port;
+    int interval_ms;
+    int timeout_ms;
+    int baseline_ms;
+    int recover_limit_sec;
+    char** server_argv;
+} Options;
+
+static Options g_opt;
+static ScenarioLog g_scenarios[SCENARIO_MAX];
+static int g_scenario_count;
+static char g_log_path[64];
+static char g_response[RESPONSE_MAX];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline) {
+    const uint64_t now = now_ns();
+    struct timespec ts;
+
+    if (deadline <= now) return;
+    ts.tv_sec = (time_t)((deadline - now) / 1000000000ULL);
+    ts.tv_nsec = (long)((deadline - now) % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static double ms_between(uint64_t from_ns, uint64_t to_ns) {
+    return to_ns > from_ns ? (double)(to_ns - from_ns) / 1e6 : 0.0;
+}
+
+// probes --------------------------------------------------------------------------
+
+// One GET with a connect per request; fills g_response and returns true on 200.
+static bool http_get(const char* path) {
+    struct sockaddr_in addr;
+    struct timeval tv;
+    char request[128];
+    size_t len = 0;
+    int fd;
+    int status = 0;
+    int n;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    tv.tv_sec = g_opt.timeout_ms / 1000;
+    tv.tv_usec = (g_opt.timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_opt.port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    n = snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nConnection: close\r\n\r\n", path);
+    if (send(fd, request, (size_t)n, MSG_NOSIGNAL) != n) {
+        close(fd);
+        return false;
+    }
+    // The server always closes after one response.
+    while (len + 1 < sizeof(g_response)) {
+        const ssize_t got = recv(fd, g_response + len, sizeof(g_response) - 1 - len, 0);
+        if (got <= 0) break;
+        len += (size_t)got;
+    }
+    g_response[len] = '\0';
+    close(fd);
+    return sscanf(g_response, "HTTP/1.%*d %d", &status) == 1 && status == 200 && strstr(g_response, "\r\n\r\n");
+}
+
+// Watchdog restart count of the HTTP thread from /debug, or -1.
+static long fetch_http_restarts(void) {
+    const char* p;
+
+    if (!http_get("/debug")) return -1;
+    p = strstr(g_response, "\"watchdog\":");
+    if (p) p = strstr(p, "\"http\":");
+    if (p) p = strstr(p, "\"restarts\":");
+    return p ? strtol(p + strlen("\"restarts\":"), NULL, 10) : -1;
+}
+
+// fault log ----------------------------------------------------------------------
+
+// Rereads the fault layer's log: "<ns> <scenario> <event> [<errno> <delay_ms>]".
+static void read_fault_log(void) {
+    FILE* f = fopen(g_log_path, "r");
+    char line[LOG_LINE_MAX];
+    int i;
+
+    if (!f) return;
+    for (i = 0; i < g_scenario_count; i++) {
+        ScenarioLog* s = &g_scenarios[i];
+        s->armed = s->exhausted = false;
+        s->armed_ns = s->first_fault_ns = s->last_fault_ns = s->exhausted_ns = 0;
+        s->injected = s->delayed = 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long ns;
+        int index;
+        char event[16];
+        int err = 0;
+        unsigned delay_ms = 0;
+        ScenarioLog* s;
+        const int fields = sscanf(line, "%llu %d %15s %d %u", &ns, &index, event, &err, &delay_ms);
+
+        if (fields < 3 || index < 0 || index >= g_scenario_count) continue;
+        s = &g_scenarios[index];
+        if (strcmp(event, "arm") == 0) {
+            s->armed = true;
+            s->armed_ns = ns;
+        } else if (strcmp(event, "exhausted") == 0) {
+            s->exhausted = true;
+            s->exhausted_ns = ns;
+        } else if (fields == 5 && (err != 0 || delay_ms != 0)) {
+            if (err != 0) s->injected++;
+            if (delay_ms != 0) s->delayed++;
+            if (s->first_fault_ns == 0) s->first_fault_ns = ns;
+            // A delayed call ends delay_ms after it was logged.
+            if (ns + delay_ms * 1000000ULL > s->last_fault_ns) s->last_fault_ns = ns + delay_ms * 1000000ULL;
+        }
+    }
+    fclose(f);
+}
+
+static bool load_scenario_names(const char* path) {
+    FILE* f = fopen(path, "r");
+    char line[512];
+
+    if (!f) {
+        fprintf(stderr, "faultrun: cannot open %s\n", path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char* p = line;
+        char* close;
+
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p != '[') continue;
+        close = strchr(p, ']');
+        if (!close) continue;
+        *close = '\0';
+        if (g_scenario_count == SCENARIO_MAX) break;
+        snprintf(g_scenarios[g_scenario_count++].name, sizeof(g_scenarios[0].name), "%s", p + 1);
+    }
+    fclose(f);
+    if (g_scenario_count == 0) fprintf(stderr, "faultrun: no [scenario] sections in %s\n", path);
+    return g_scenario_count > 0;
+}
+
+// scenarios ----------------------------------------------------------------------
+
+static bool wait_until_serving(uint64_t limit_ns) {
+    const uint64_t deadline = now_ns() + limit_ns;
+
+    while (now_ns() < deadline) {
+        if (http_get("/state")) return true;
+        sleep_until_ns(now_ns() + (uint64_t)g_opt.interval_ms * 1000000ULL);
+    }
+    return false;
+}
+
+static void run_scenario(pid_t server, int index) {
+    const uint64_t interval_ns = (uint64_t)g_opt.interval_ms * 1000000ULL;
+    const uint64_t limit_ns = (uint64_t)g_opt.recover_limit_sec * 1000000000ULL;
+    const long restarts_before = fetch_http_restarts();
+    uint64_t start;
+    uint64_t scheduled;
+    uint64_t first_failure_ns = 0;
+    uint64_t outage_end_ns = 0;
+    uint64_t recovered_ns = 0;
+    uint32_t probes = 0;
+    uint32_t lost = 0;
+    long restarts_after;
+    ScenarioLog* s = &g_scenarios[index];
+
+    kill(server, SIGUSR1);
+    start = now_ns();
+    scheduled = start;
+    while (now_ns() - start < limit_ns) {
+        uint64_t sent;
+        uint64_t done;
+        bool ok;
+
+        sleep_until_ns(scheduled);
+        scheduled += interval_ns;
+        sent = now_ns();
+        ok = http_get("/state");
+        done = now_ns();
+        probes++;
+
+        if (!ok) {
+            lost++;
+            if (first_failure_ns == 0) first_failure_ns = sent;
+            outage_end_ns = 0;
+            continue;
+        }
+        if (first_failure_ns != 0 && outage_end_ns == 0) outage_end_ns = done;
+        read_fault_log();
+        if (s->exhausted && sent >= s->last_fault_ns && sent >= s->exhausted_ns) {
+            recovered_ns = done;
+            break;
+        }
+        if (scheduled < now_ns()) scheduled = now_ns();
+    }
+    read_fault_log();
+    restarts_after = fetch_http_restarts();
+
+    printf(
+        "{\"scenario\":\"%s\",\"armed\":%s,\"exhausted\":%s,\"recovered\":%s,\"injected\":%u,\"delayed\":%u,"
+        "\"probes\":%u,\"lost\":%u,\"first_failure_ms\":%.1f,\"recover_ms\":%.1f,\"recover_after_faults_ms\":%.1f,"
+        "\"outage_ms\":%.1f,\"http_restarts\":%ld}\n",
+        s->name,
+        s->armed ? "true" : "false",
+        s->exhausted ? "true" : "false",
+        recovered_ns ? "true" : "false",
+        s->injected,
+        s->delayed,
+        probes,
+        lost,
+        first_failure_ns ? ms_between(start, first_failure_ns) : 0.0,
+        recovered_ns && s->first_fault_ns ? ms_between(s->first_fault_ns, recovered_ns) : 0.0,
+        recovered_ns ? ms_between(s->last_fault_ns, recovered_ns) : 0.0,
+        first_failure_ns && outage_end_ns ? ms_between(first_failure_ns, outage_end_ns) : 0.0,
+        restarts_before >= 0 && restarts_after >= 0 ? restarts_after - restarts_before : -1L
+    );
+    fflush(stdout);
+}
+
+static void usage(const char* argv0) {
+    fprintf(
+        stderr,
+        "usage: %s -s scenarios.ini [-p port] [-i probe_ms] [-t timeout_ms] [-b baseline_ms] [-w limit_sec] -- server [args]\n"
+        "  runs the server (a host build) with RICHNX_NETFAULT set and arms each [scenario] in turn\n",
+        argv0
+    );
+}
+
+static bool parse_options(int argc, char** argv) {
+    int opt;
+
+    g_opt.port = 6029;
+    g_opt.interval_ms = 50;
+    g_opt.timeout_ms = 1000;
+    g_opt.baseline_ms = 1000;
+    g_opt.recover_limit_sec = 30;
+
+    while ((opt = getopt(argc, argv, "s:p:i:t:b:w:")) != -1) {
+        switch (opt) {
+            case 's': g_opt.script = optarg; break;
+            case 'p': g_opt.port = atoi(optarg); break;
+            case 'i': g_opt.interval_ms = atoi(optarg); break;
+            case 't': g_opt.timeout_ms = atoi(optarg); break;
+            case 'b': g_opt.baseline_ms = atoi(optarg); break;
+            case 'w': g_opt.recover_limit_sec = atoi(optarg); break;
+            default: return false;
+        }
+    }
+    if (!g_opt.script || optind >= argc || g_opt.port < 1 || g_opt.port > 65535 || g_opt.interval_ms < 1 ||
+        g_opt.timeout_ms < 1 || g_opt.baseline_ms < 0 || g_opt.recover_limit_sec < 1) {
+        return false;
+    }
+    g_opt.server_argv = argv + optind;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    pid_t server;
+    int status;
+    int i;
+
+    if (!parse_options(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!load_scenario_names(g_opt.script)) return 2;
+
+    snprintf(g_log_path, sizeof(g_log_path), "/tmp/faultrun.%d.log", (int)getpid());
+    unlink(g_log_path);
+    server = fork();
+    if (server < 0) {
+        perror("faultrun: fork");
+        return 1;
+    }
+    if (server == 0) {
+        setenv("RICHNX_NETFAULT", g_opt.script, 1);
+        setenv("RICHNX_NETFAULT_LOG", g_log_path, 1);
+        execvp(g_opt.server_argv[0], g_opt.server_argv);
+        perror("faultrun: exec");
+        _exit(127);
+    }
+
+    if (!wait_until_serving(10ULL * 1000000000ULL)) {
+        fprintf(stderr, "faultrun: server not answering on port %d\n", g_opt.port);
+        kill(server, SIGTERM);
+        waitpid(server, &status, 0);
+        return 1;
+    }
+    for (i = 0; i < g_scenario_count; i++) {
+        // Let the server settle on a healthy baseline before each scenario.
+        if (!wait_until_serving(10ULL * 1000000000ULL)) {
+            fprintf(stderr, "faultrun: server did not come back before %s\n", g_scenarios[i].name);
+            break;
+        }
+        sleep_until_ns(now_ns() + (uint64_t)g_opt.baseline_ms * 1000000ULL);
+        run_scenario(server, i);
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, &status, 0);
+    unlink(g_log_path);
+    return i == g_scenario_count ? 0 : 1;
+}
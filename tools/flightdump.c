@@ -0,0 +1,131 @@
+// Host-side decoder for the sysmodule's flight recorder dumps (flight.bin,
+// flight.prev.bin). Prints one line per event, oldest first, with the time
+// since boot and the time before the dump was written.
+// Exit status is 0 for a valid dump, 3 if the CRC does not match (events are
+// still printed), 1 if the file cannot be read.
+
+#include "flight_format.h"
+#include "status_record.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// HttpMethod in http_server.h.
+static const char* const g_method_names[] = { "?", "GET", "HEAD", "POST", "PUT", "OPTIONS" };
+
+static const char* reason_name(uint8_t reason) {
+    switch (reason) {
+        case FlightDumpReason_Periodic: return "periodic";
+        case FlightDumpReason_Exit: return "exit";
+        case FlightDumpReason_Stall: return "stall";
+        default: return "?";
+    }
+}
+
+static const char* event_name(const char (*names)[FLIGHT_NAME_SIZE], uint16_t name_count, uint8_t name) {
+    return name < name_count ? names[name] : "?";
+}
+
+static void print_event(const FlightEvent* e, const FlightDumpHeader* h, const char (*names)[FLIGHT_NAME_SIZE]) {
+    const double freq = (double)h->tick_freq;
+    const char* name = event_name(names, h->name_count, e->name);
+
+    printf("%12.3f %+10.3f  ", (double)e->tick / freq, -((double)(h->dump_tick - e->tick) / freq));
+    switch (e->type) {
+        case FlightEventType_Stage:
+            printf("stage    %s\n", name);
+            break;
+        case FlightEventType_Ipc:
+            printf(
+                "ipc      %s rc=0x%08lX us=%u%s\n",
+                name,
+                (unsigned long)e->value,
+                (unsigned int)e->arg,
+                e->arg == 0xFFFF ? "+" : ""
+            );
+            break;
+        case FlightEventType_AcceptError:
+            printf("accept   errno=%lu streak=%u\n", (unsigned long)e->value, (unsigned int)e->arg);
+            break;
+        case FlightEventType_Request:
+            printf(
+                "request  %s %s us=%lu\n",
+                e->arg < sizeof(g_method_names) / sizeof(g_method_names[0]) ? g_method_names[e->arg] : "?",
+                e->name == FLIGHT_NAME_NONE ? "(unrouted)" : name,
+                (unsigned long)e->value
+            );
+            break;
+        case FlightEventType_Stall:
+            printf("stall    %s loop\n", name);
+            break;
+        default:
+            printf("type=%u name=%s arg=%u value=%lu\n", (unsigned int)e->type, name, (unsigned int)e->arg, (unsigned long)e->value);
+            break;
+    }
+}
+
+int main(int argc, char** argv) {
+    FlightDumpHeader h;
+    char (*names)[FLIGHT_NAME_SIZE] = NULL;
+    FlightEvent* events = NULL;
+    uint32_t crc;
+    uint32_t i;
+    FILE* f;
+    int status = 1;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s flight.bin\n", argv[0]);
+        return 2;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        fprintf(stderr, "flightdump: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != FLIGHT_DUMP_MAGIC) {
+        fprintf(stderr, "flightdump: %s is not a flight recorder dump\n", argv[1]);
+        goto out;
+    }
+    if (h.version != FLIGHT_DUMP_VERSION || h.size != sizeof(h) || h.tick_freq == 0) {
+        fprintf(stderr, "flightdump: unsupported dump version %u\n", (unsigned int)h.version);
+        goto out;
+    }
+
+    names = calloc(h.name_count ? h.name_count : 1, FLIGHT_NAME_SIZE);
+    events = calloc(h.event_count ? h.event_count : 1, sizeof(FlightEvent));
+    if (!names || !events ||
+        fread(names, FLIGHT_NAME_SIZE, h.name_count, f) != h.name_count ||
+        fread(events, sizeof(FlightEvent), h.event_count, f) != h.event_count) {
+        fprintf(stderr, "flightdump: %s is truncated\n", argv[1]);
+        goto out;
+    }
+    for (i = 0; i < h.name_count; i++) {
+        names[i][FLIGHT_NAME_SIZE - 1] = '\0';
+    }
+    crc = status_record_crc32_update(0, names, (size_t)h.name_count * FLIGHT_NAME_SIZE);
+    crc = status_record_crc32_update(crc, events, (size_t)h.event_count * sizeof(FlightEvent));
+
+    printf(
+        "session_id=%llu reason=%s sequence=%lu dumped_at=%.3fs events=%lu recorded=%llu overwritten=%llu crc=%s\n",
+        (unsigned long long)h.session_id,
+        reason_name(h.reason),
+        (unsigned long)h.sequence,
+        (double)h.dump_tick / (double)h.tick_freq,
+        (unsigned long)h.event_count,
+        (unsigned long long)h.recorded,
+        (unsigned long long)(h.recorded - h.event_count),
+        crc == h.crc32 ? "ok" : "BAD"
+    );
+    printf("%12s %10s  event\n", "uptime_s", "before_s");
+    for (i = 0; i < h.event_count; i++) {
+        print_event(&events[i], &h, (const char (*)[FLIGHT_NAME_SIZE])names);
+    }
+    status = crc == h.crc32 ? 0 : 3;
+
+out:
+    free(names);
+    free(events);
+    fclose(f);
+    return status;
+}
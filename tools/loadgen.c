@@ -0,0 +1,524 @@
+// Host-side load generator for the sysmodule's HTTP server. Runs N client
+// threads against one or more paths (default /state and /debug, alternated)
+// and prints one JSON object with throughput, latency percentiles, error
+// counts and the server's request_count/accepted_count deltas, e.g.
+//
+//   loadgen -c 8 -d 10                     closed loop, connect per request
+//   loadgen -c 8 -d 10 -r 200 -k           200 req/s total, keep-alive
+//   loadgen -P /state -P /debug/timings    custom paths
+//
+// In fixed-rate mode each client sends on a fixed schedule and latency is
+// measured from the scheduled send time, so a stalled server shows up as
+// latency rather than as fewer samples. Keep-alive mode reuses a connection
+// until the server answers "Connection: close"; "reused" counts how often
+// that actually happened.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PATH_MAX_COUNT 8
+#define RESPONSE_MAX (256 * 1024)
+#define REQUEST_MAX 512
+
+typedef enum {
+    LoadError_Connect = 0,
+    LoadError_Send,
+    LoadError_Recv,
+    LoadError_Timeout,
+    LoadError_Status,
+    LoadError_Count,
+} LoadError;
+
+static const char* const g_error_names[LoadError_Count] = {
+    "connect", "send", "recv", "timeout", "status",
+};
+
+typedef struct {
+    uint32_t* us;
+    size_t count;
+    size_t cap;
+} Samples;
+
+typedef struct {
+    const char* path;
+    Samples latency;
+    uint64_t requests;
+    uint64_t ok;
+    uint64_t errors[LoadError_Count];
+} PathStats;
+
+typedef struct {
+    int index;
+    pthread_t thread;
+    PathStats paths[PATH_MAX_COUNT];
+    uint64_t connects;
+    uint64_t reused;
+    char* response;
+} Client;
+
+typedef struct {
+    struct sockaddr_in addr;
+    const char* host;
+    int port;
+    int clients;
+    double rate; // total requests/s; 0 = closed loop
+    double duration_sec;
+    bool keep_alive;
+    int timeout_ms;
+    const char* paths[PATH_MAX_COUNT];
+    int path_count;
+} Options;
+
+static Options g_opt;
+static uint64_t g_start_ns;
+static uint64_t g_end_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t deadline) {
+    const uint64_t now = now_ns();
+    struct timespec ts;
+
+    if (deadline <= now) return;
+    ts.tv_sec = (time_t)((deadline - now) / 1000000000ULL);
+    ts.tv_nsec = (long)((deadline - now) % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void samples_add(Samples* s, uint32_t us) {
+    if (s->count == s->cap) {
+        const size_t cap = s->cap ? s->cap * 2 : 1024;
+        uint32_t* grown = (uint32_t*)realloc(s->us, cap * sizeof(*grown));
+        if (!grown) return;
+        s->us = grown;
+        s->cap = cap;
+    }
+    s->us[s->count++] = us;
+}
+
+static void samples_merge(Samples* dst, const Samples* src) {
+    size_t i;
+    for (i = 0; i < src->count; i++) samples_add(dst, src->us[i]);
+}
+
+static int compare_u32(const void* a, const void* b) {
+    const uint32_t x = *(const uint32_t*)a;
+    const uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile over sorted samples.
+static uint32_t samples_percentile(const Samples* s, double pct) {
+    size_t rank;
+
+    if (s->count == 0) return 0;
+    rank = (size_t)((pct / 100.0) * (double)s->count + 0.999999);
+    if (rank == 0) rank = 1;
+    if (rank > s->count) rank = s->count;
+    return s->us[rank - 1];
+}
+
+// connection ---------------------------------------------------------------------
+
+static int open_connection(void) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct timeval tv;
+    int one = 1;
+
+    if (fd < 0) return -1;
+    tv.tv_sec = g_opt.timeout_ms / 1000;
+    tv.tv_usec = (g_opt.timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (const struct sockaddr*)&g_opt.addr, sizeof(g_opt.addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static const char* find_header(const char* headers, const char* name) {
+    const size_t name_len = strlen(name);
+    const char* line = strstr(headers, "\r\n");
+
+    while (line && line[2] != '\r') {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            line += name_len + 1;
+            while (*line == ' ') line++;
+            return line;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return NULL;
+}
+
+// Reads one response into buf; returns the error class, or -1 on success.
+// Sets *server_closes when the server will not reuse the connection.
+static int read_response(int fd, char* buf, size_t cap, int* status, bool* server_closes) {
+    size_t len = 0;
+    size_t header_len = 0;
+    long content_length = -1;
+
+    *status = 0;
+    *server_closes = true;
+    for (;;) {
+        ssize_t n;
+
+        if (header_len > 0 && content_length >= 0 && len >= header_len + (size_t)content_length) break;
+        if (len + 1 >= cap) return LoadError_Recv;
+        n = recv(fd, buf + len, cap - 1 - len, 0);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? LoadError_Timeout : LoadError_Recv;
+        if (n == 0) {
+            if (header_len > 0 && content_length < 0) break; // body delimited by close
+            return LoadError_Recv;
+        }
+        len += (size_t)n;
+        buf[len] = '\0';
+
+        if (header_len == 0) {
+            const char* end = strstr(buf, "\r\n\r\n");
+            const char* value;
+            if (!end) continue;
+            header_len = (size_t)(end - buf) + 4;
+            if (sscanf(buf, "HTTP/1.%*d %d", status) != 1) return LoadError_Recv;
+            value = find_header(buf, "Content-Length");
+            if (value) content_length = strtol(value, NULL, 10);
+            value = find_header(buf, "Connection");
+            *server_closes = !value || strncasecmp(value, "keep-alive", 10) != 0;
+        }
+    }
+    return (*status == 200) ? -1 : LoadError_Status;
+}
+
+// Performs one request on *fd (opening it if needed); returns -1 or a LoadError.
+static int do_request(Client* c, int* fd, const char* path) {
+    char request[REQUEST_MAX];
+    int status;
+    bool server_closes;
+    bool reused = (*fd >= 0);
+    int err;
+    const int len = snprintf(
+        request,
+        sizeof(request),
+        "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+        path,
+        g_opt.host,
+        g_opt.keep_alive ? "keep-alive" : "close"
+    );
+
+    if (*fd < 0) {
+        *fd = open_connection();
+        if (*fd < 0) return LoadError_Connect;
+        c->connects++;
+    }
+    if (!send_all(*fd, request, (size_t)len)) {
+        err = LoadError_Send;
+    } else {
+        err = read_response(*fd, c->response, RESPONSE_MAX, &status, &server_closes);
+    }
+    if (err < 0 && reused) c->reused++;
+    if (err >= 0 || !g_opt.keep_alive || server_closes) {
+        close(*fd);
+        *fd = -1;
+    }
+    return err;
+}
+
+static void* client_main(void* arg) {
+    Client* c = (Client*)arg;
+    const double per_client_rate = g_opt.rate / g_opt.clients;
+    const uint64_t interval_ns = per_client_rate > 0 ? (uint64_t)(1e9 / per_client_rate) : 0;
+    // Stagger fixed-rate clients so they do not all fire on the same tick.
+    uint64_t scheduled = g_start_ns + (interval_ns * (uint64_t)c->index) / (uint64_t)g_opt.clients;
+    uint64_t seq = (uint64_t)c->index;
+    int fd = -1;
+
+    for (;;) {
+        PathStats* p = &c->paths[seq % (uint64_t)g_opt.path_count];
+        uint64_t begin;
+        int err;
+
+        if (interval_ns > 0) {
+            if (scheduled >= g_end_ns) break;
+            sleep_until_ns(scheduled);
+            begin = scheduled;
+            scheduled += interval_ns;
+        } else {
+            begin = now_ns();
+            if (begin >= g_end_ns) break;
+        }
+
+        err = do_request(c, &fd, p->path);
+        p->requests++;
+        if (err < 0) {
+            const uint64_t us = (now_ns() - begin) / 1000ULL;
+            p->ok++;
+            samples_add(&p->latency, us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+        } else {
+            p->errors[err]++;
+            if (err == LoadError_Connect && interval_ns == 0) sleep_until_ns(now_ns() + 1000000ULL);
+        }
+        seq++;
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+// server counters ----------------------------------------------------------------
+
+static bool json_u64_field(const char* json, const char* key, uint64_t* out) {
+    char pattern[64];
+    const char* p;
+
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    p = strstr(json, pattern);
+    if (!p) return false;
+    *out = strtoull(p + strlen(pattern), NULL, 10);
+    return true;
+}
+
+static bool fetch_server_counters(uint64_t* request_count, uint64_t* accepted_count) {
+    static char buf[RESPONSE_MAX];
+    static const char request[] = "GET /debug HTTP/1.1\r\nConnection: close\r\n\r\n";
+    const int fd = open_connection();
+    int status;
+    bool server_closes;
+    bool ok;
+
+    if (fd < 0) return false;
+    ok = send_all(fd, request, sizeof(request) - 1) &&
+         read_response(fd, buf, sizeof(buf), &status, &server_closes) < 0 &&
+         json_u64_field(buf, "request_count", request_count) &&
+         json_u64_field(buf, "accepted_count", accepted_count);
+    close(fd);
+    return ok;
+}
+
+// report -------------------------------------------------------------------------
+
+static void print_latency(FILE* out, Samples* s) {
+    uint64_t total = 0;
+    size_t i;
+
+    qsort(s->us, s->count, sizeof(*s->us), compare_u32);
+    for (i = 0; i < s->count; i++) total += s->us[i];
+    fprintf(
+        out,
+        "{\"p50\":%u,\"p90\":%u,\"p99\":%u,\"max\":%u,\"mean\":%llu}",
+        samples_percentile(s, 50),
+        samples_percentile(s, 90),
+        samples_percentile(s, 99),
+        s->count ? s->us[s->count - 1] : 0,
+        (unsigned long long)(s->count ? total / s->count : 0)
+    );
+}
+
+static void print_errors(FILE* out, const uint64_t* errors) {
+    int i;
+    fputc('{', out);
+    for (i = 0; i < LoadError_Count; i++) {
+        fprintf(out, "%s\"%s\":%llu", i ? "," : "", g_error_names[i], (unsigned long long)errors[i]);
+    }
+    fputc('}', out);
+}
+
+static void usage(const char* argv0) {
+    fprintf(
+        stderr,
+        "usage: %s [-H host] [-p port] [-c clients] [-d seconds] [-r total_rps] [-k] [-t timeout_ms] [-P path]...\n"
+        "  -r 0 (default) runs a closed loop; -k reuses connections; -P may be repeated\n",
+        argv0
+    );
+}
+
+static bool parse_options(int argc, char** argv) {
+    int opt;
+    struct hostent* he;
+
+    g_opt.host = "127.0.0.1";
+    g_opt.port = 6029;
+    g_opt.clients = 4;
+    g_opt.duration_sec = 10;
+    g_opt.timeout_ms = 2000;
+
+    while ((opt = getopt(argc, argv, "H:p:c:d:r:kt:P:")) != -1) {
+        switch (opt) {
+            case 'H': g_opt.host = optarg; break;
+            case 'p': g_opt.port = atoi(optarg); break;
+            case 'c': g_opt.clients = atoi(optarg); break;
+            case 'd': g_opt.duration_sec = atof(optarg); break;
+            case 'r': g_opt.rate = atof(optarg); break;
+            case 'k': g_opt.keep_alive = true; break;
+            case 't': g_opt.timeout_ms = atoi(optarg); break;
+            case 'P':
+                if (g_opt.path_count == PATH_MAX_COUNT || optarg[0] != '/') return false;
+                g_opt.paths[g_opt.path_count++] = optarg;
+                break;
+            default: return false;
+        }
+    }
+    if (g_opt.clients < 1 || g_opt.duration_sec <= 0 || g_opt.rate < 0 || g_opt.timeout_ms < 1 ||
+        g_opt.port < 1 || g_opt.port > 65535) {
+        return false;
+    }
+    if (g_opt.path_count == 0) {
+        g_opt.paths[g_opt.path_count++] = "/state";
+        g_opt.paths[g_opt.path_count++] = "/debug";
+    }
+
+    he = gethostbyname(g_opt.host);
+    if (!he || he->h_addrtype != AF_INET) {
+        fprintf(stderr, "loadgen: cannot resolve %s\n", g_opt.host);
+        return false;
+    }
+    memset(&g_opt.addr, 0, sizeof(g_opt.addr));
+    g_opt.addr.sin_family = AF_INET;
+    g_opt.addr.sin_port = htons((uint16_t)g_opt.port);
+    memcpy(&g_opt.addr.sin_addr, he->h_addr_list[0], sizeof(g_opt.addr.sin_addr));
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Client* clients;
+    PathStats totals[PATH_MAX_COUNT];
+    Samples all = { NULL, 0, 0 };
+    uint64_t errors[LoadError_Count] = { 0 };
+    uint64_t requests = 0, ok = 0, connects = 0, reused = 0;
+    uint64_t rc_before = 0, ac_before = 0, rc_after = 0, ac_after = 0;
+    bool have_before, have_after;
+    double elapsed_sec;
+    int i, j, k;
+
+    if (!parse_options(argc, argv)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    clients = (Client*)calloc((size_t)g_opt.clients, sizeof(*clients));
+    if (!clients) return 1;
+    have_before = fetch_server_counters(&rc_before, &ac_before);
+    if (!have_before) {
+        fprintf(stderr, "loadgen: warning: could not read /debug counters before the run\n");
+    }
+
+    g_start_ns = now_ns() + 10000000ULL; // let every thread reach its loop first
+    g_end_ns = g_start_ns + (uint64_t)(g_opt.duration_sec * 1e9);
+    for (i = 0; i < g_opt.clients; i++) {
+        clients[i].index = i;
+        clients[i].response = (char*)malloc(RESPONSE_MAX);
+        for (j = 0; j < g_opt.path_count; j++) clients[i].paths[j].path = g_opt.paths[j];
+        if (!clients[i].response || pthread_create(&clients[i].thread, NULL, client_main, &clients[i]) != 0) {
+            fprintf(stderr, "loadgen: cannot start client %d\n", i);
+            return 1;
+        }
+    }
+    sleep_until_ns(g_start_ns);
+    for (i = 0; i < g_opt.clients; i++) pthread_join(clients[i].thread, NULL);
+    elapsed_sec = (double)(now_ns() - g_start_ns) / 1e9;
+    have_after = fetch_server_counters(&rc_after, &ac_after);
+
+    memset(totals, 0, sizeof(totals));
+    for (j = 0; j < g_opt.path_count; j++) totals[j].path = g_opt.paths[j];
+    for (i = 0; i < g_opt.clients; i++) {
+        connects += clients[i].connects;
+        reused += clients[i].reused;
+        for (j = 0; j < g_opt.path_count; j++) {
+            const PathStats* p = &clients[i].paths[j];
+            totals[j].requests += p->requests;
+            totals[j].ok += p->ok;
+            for (k = 0; k < LoadError_Count; k++) totals[j].errors[k] += p->errors[k];
+            samples_merge(&totals[j].latency, &p->latency);
+        }
+    }
+    for (j = 0; j < g_opt.path_count; j++) {
+        requests += totals[j].requests;
+        ok += totals[j].ok;
+        for (k = 0; k < LoadError_Count; k++) errors[k] += totals[j].errors[k];
+        samples_merge(&all, &totals[j].latency);
+    }
+
+    printf(
+        "{\"target\":\"%s:%d\",\"connection\":\"%s\",\"load\":\"%s\",\"clients\":%d,\"rate\":%.1f,"
+        "\"duration_sec\":%.3f,\"requests\":%llu,\"ok\":%llu,\"throughput_rps\":%.1f,\"errors\":",
+        g_opt.host,
+        g_opt.port,
+        g_opt.keep_alive ? "keep-alive" : "close",
+        g_opt.rate > 0 ? "fixed" : "closed",
+        g_opt.clients,
+        g_opt.rate,
+        elapsed_sec,
+        (unsigned long long)requests,
+        (unsigned long long)ok,
+        elapsed_sec > 0 ? (double)ok / elapsed_sec : 0.0
+    );
+    print_errors(stdout, errors);
+    printf(",\"connects\":%llu,\"reused\":%llu,\"latency_us\":", (unsigned long long)connects, (unsigned long long)reused);
+    print_latency(stdout, &all);
+    printf(",\"paths\":[");
+    for (j = 0; j < g_opt.path_count; j++) {
+        printf(
+            "%s{\"path\":\"%s\",\"requests\":%llu,\"ok\":%llu,\"errors\":",
+            j ? "," : "",
+            totals[j].path,
+            (unsigned long long)totals[j].requests,
+            (unsigned long long)totals[j].ok
+        );
+        print_errors(stdout, totals[j].errors);
+        printf(",\"latency_us\":");
+        print_latency(stdout, &totals[j].latency);
+        putchar('}');
+    }
+    printf("],\"server\":");
+    if (have_before && have_after) {
+        // The closing /debug fetch is counted by the server too.
+        const uint64_t rc_delta = rc_after - rc_before - 1;
+        printf(
+            "{\"request_count_delta\":%llu,\"accepted_count_delta\":%llu,\"unaccounted\":%lld}",
+            (unsigned long long)rc_delta,
+            (unsigned long long)(ac_after - ac_before - 1),
+            (long long)rc_delta - (long long)requests
+        );
+    } else {
+        printf("null");
+    }
+    printf("}\n");
+
+    for (i = 0; i < g_opt.clients; i++) {
+        for (j = 0; j < g_opt.path_count; j++) free(clients[i].paths[j].latency.us);
+        free(clients[i].response);
+    }
+    for (j = 0; j < g_opt.path_count; j++) free(totals[j].latency.us);
+    free(all.us);
+    free(clients);
+    return errors[LoadError_Connect] == requests && requests > 0 ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+// Host-side decoder for the sysmodule's binary log (log.bin, log.N.bin).
+// Prints each record in the same "[<sec> s] [line=<n>] message" form as the
+// text log. Pass rotated files oldest first: logdecode log.2.bin log.1.bin log.bin
+
+#include "log_format.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORMAT_MAX 128
+#define RECORD_MAX 0xFFFF
+
+static char* g_formats[FORMAT_MAX];
+
+static void reset_formats(void) {
+    int i;
+    for (i = 0; i < FORMAT_MAX; i++) {
+        free(g_formats[i]);
+        g_formats[i] = NULL;
+    }
+}
+
+static void print_prefix(uint64_t ms, uint64_t line, FILE* out) {
+    fprintf(out, "[%llu s] [line=%llu] ", (unsigned long long)(ms / 1000ULL), (unsigned long long)line);
+}
+
+static int decode_file(const char* path, FILE* out) {
+    FILE* f = fopen(path, "rb");
+    uint8_t header[LOG_BIN_HEADER_SIZE];
+    uint8_t* payload;
+    unsigned long records = 0;
+
+    if (!f) {
+        fprintf(stderr, "logdecode: cannot open %s\n", path);
+        return 1;
+    }
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) ||
+        memcmp(header, LOG_BIN_MAGIC, LOG_BIN_MAGIC_SIZE) != 0) {
+        fprintf(stderr, "logdecode: %s is not a binary log\n", path);
+        fclose(f);
+        return 1;
+    }
+    if (header[LOG_BIN_MAGIC_SIZE] != LOG_BIN_VERSION) {
+        fprintf(stderr, "logdecode: %s has unsupported version %u\n", path, (unsigned)header[LOG_BIN_MAGIC_SIZE]);
+        fclose(f);
+        return 1;
+    }
+
+    payload = (uint8_t*)malloc(RECORD_MAX);
+    if (!payload) {
+        fclose(f);
+        return 1;
+    }
+    reset_formats();
+
+    for (;;) {
+        uint8_t rh[LOG_BIN_RECORD_HEADER_SIZE];
+        size_t len;
+        LogReader r;
+
+        if (fread(rh, 1, sizeof(rh), f) != sizeof(rh)) break;
+        len = (size_t)rh[1] | ((size_t)rh[2] << 8);
+        if (fread(payload, 1, len, f) != len) {
+            fprintf(stderr, "logdecode: %s: truncated record after %lu records\n", path, records);
+            break;
+        }
+        records++;
+
+        r.p = payload;
+        r.end = payload + len;
+        r.ok = 1;
+
+        switch (rh[0]) {
+            case LogRecord_Format: {
+                const uint64_t id = log_read_varint(&r);
+                const size_t text_len = (size_t)(r.end - r.p);
+                if (!r.ok || id >= FORMAT_MAX) break;
+                free(g_formats[id]);
+                g_formats[id] = (char*)malloc(text_len + 1);
+                if (!g_formats[id]) break;
+                memcpy(g_formats[id], r.p, text_len);
+                g_formats[id][text_len] = '\0';
+                break;
+            }
+            case LogRecord_Event: {
+                const uint64_t id = log_read_varint(&r);
+                const uint64_t ms = log_read_varint(&r);
+                const uint64_t line = log_read_varint(&r);
+                print_prefix(ms, line, out);
+                if (!r.ok || id >= FORMAT_MAX || !g_formats[id]) {
+                    fprintf(out, "<unknown format %llu>", (unsigned long long)id);
+                } else {
+                    char text[4096];
+                    log_format_render(g_formats[id], &r, text, sizeof(text));
+                    fputs(text, out);
+                }
+                fputc('\n', out);
+                break;
+            }
+            case LogRecord_Text: {
+                const uint64_t ms = log_read_varint(&r);
+                const uint64_t line = log_read_varint(&r);
+                print_prefix(ms, line, out);
+                fwrite(r.p, 1, (size_t)(r.end - r.p), out);
+                fputc('\n', out);
+                break;
+            }
+            case LogRecord_Dropped:
+                fprintf(out, "[logger] dropped %llu lines (ring full)\n", (unsigned long long)log_read_varint(&r));
+                break;
+            default:
+                fprintf(stderr, "logdecode: %s: skipping unknown record type %u\n", path, (unsigned)rh[0]);
+                break;
+        }
+    }
+
+    free(payload);
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    int rc = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s log.bin [more.bin ...]\n", argv[0]);
+        return 2;
+    }
+
+    for (i = 1; i < argc; i++) {
+        rc |= decode_file(argv[i], stdout);
+    }
+    reset_formats();
+    return rc;
+}
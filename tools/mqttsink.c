@@ -0,0 +1,284 @@
+// Minimal MQTT 3.1.1 broker stand-in for exercising the sysmodule's publisher
+// (mqtt_enabled) without a real broker. Accepts one client at a time, answers
+// CONNECT, PUBLISH (QoS 1) and PINGREQ, and prints one JSON line per packet.
+// Retained values are remembered across connections so a reconnect that
+// republishes an unchanged value shows up as "same":true.
+//
+//   mqttsink                          listen on 1883
+//   mqttsink -p 11883 -r 2            refuse the first 2 CONNECTs (rc 3)
+//   mqttsink -a 3 -d 20               drop every 3rd PUBACK, hang up after 20 PUBLISHes
+//   mqttsink -P                       never answer PINGREQ (ping timeout)
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PACKET_MAX 4096
+#define RETAINED_MAX 64
+
+typedef struct {
+    char topic[128];
+    char value[128];
+} Retained;
+
+static int g_port = 1883;
+static int g_refuse = 0;
+static int g_drop_ack_every = 0;
+static int g_disconnect_after = 0;
+static bool g_no_pingresp = false;
+static Retained g_retained[RETAINED_MAX];
+static int g_retained_count;
+static double g_start;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9 - g_start;
+}
+
+static bool read_exact(int fd, uint8_t* buf, size_t len) {
+    size_t off = 0;
+
+    while (off < len) {
+        const ssize_t n = recv(fd, buf + off, len - off, 0);
+        if (n <= 0) return false;
+        off += (size_t)n;
+    }
+    return true;
+}
+
+// Reads one packet; returns its remaining length or -1.
+static int read_packet(int fd, uint8_t* type, uint8_t* body) {
+    uint32_t len = 0;
+    int shift = 0;
+    uint8_t b;
+
+    if (!read_exact(fd, type, 1)) return -1;
+    do {
+        if (!read_exact(fd, &b, 1) || shift > 21) return -1;
+        len |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    if (len > PACKET_MAX || !read_exact(fd, body, len)) return -1;
+    return (int)len;
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+// Prints a length-prefixed string field as a JSON value; returns bytes consumed.
+static size_t print_string(const char* key, const uint8_t* p, size_t avail) {
+    size_t len;
+    size_t i;
+
+    if (avail < 2) return avail;
+    len = get_u16(p);
+    if (2 + len > avail) len = avail - 2;
+    printf(",\"%s\":\"", key);
+    for (i = 0; i < len; i++) {
+        const uint8_t c = p[2 + i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    printf("\"");
+    return 2 + len;
+}
+
+static bool remember(const char* topic, const char* value) {
+    int i;
+
+    for (i = 0; i < g_retained_count; i++) {
+        if (strcmp(g_retained[i].topic, topic) == 0) {
+            const bool same = strcmp(g_retained[i].value, value) == 0;
+            snprintf(g_retained[i].value, sizeof(g_retained[i].value), "%s", value);
+            return same;
+        }
+    }
+    if (g_retained_count < RETAINED_MAX) {
+        snprintf(g_retained[g_retained_count].topic, sizeof(g_retained[0].topic), "%s", topic);
+        snprintf(g_retained[g_retained_count].value, sizeof(g_retained[0].value), "%s", value);
+        g_retained_count++;
+    }
+    return false;
+}
+
+static void handle_connect(int fd, const uint8_t* body, int len, int* connects) {
+    const uint8_t rc = (*connects)++ < g_refuse ? 3 : 0; // 3 = server unavailable
+    const uint8_t ack[4] = { 0x20, 0x02, 0x00, rc };
+    size_t off = 10;
+    uint8_t flags;
+
+    printf("{\"t\":%.3f,\"type\":\"CONNECT\"", now_sec());
+    if (len >= 10) {
+        flags = body[7];
+        printf(",\"level\":%u,\"flags\":\"0x%02X\",\"keepalive\":%u", body[6], flags, get_u16(body + 8));
+        off += print_string("client_id", body + off, (size_t)len - off);
+        if (flags & 0x04) {
+            off += print_string("will_topic", body + off, (size_t)len - off);
+            off += print_string("will_message", body + off, (size_t)len - off);
+        }
+        if (flags & 0x80) off += print_string("user", body + off, (size_t)len - off);
+        if (flags & 0x40) printf(",\"password\":true");
+    }
+    printf(",\"connack\":%u}\n", rc);
+    send(fd, ack, sizeof(ack), MSG_NOSIGNAL);
+}
+
+static void handle_publish(int fd, uint8_t type, const uint8_t* body, int len, int* publishes) {
+    const int qos = (type >> 1) & 3;
+    char topic[128];
+    char value[128];
+    size_t topic_len;
+    size_t off;
+    size_t value_len;
+    uint16_t id = 0;
+    bool same;
+
+    if (len < 2) return;
+    topic_len = get_u16(body);
+    if (2 + topic_len > (size_t)len) return;
+    snprintf(topic, sizeof(topic), "%.*s", (int)topic_len, (const char*)body + 2);
+    off = 2 + topic_len;
+    if (qos > 0 && off + 2 <= (size_t)len) {
+        id = get_u16(body + off);
+        off += 2;
+    }
+    value_len = (size_t)len - off;
+    snprintf(value, sizeof(value), "%.*s", (int)value_len, (const char*)body + off);
+    same = remember(topic, value);
+
+    (*publishes)++;
+    printf(
+        "{\"t\":%.3f,\"type\":\"PUBLISH\",\"topic\":\"%s\",\"value\":\"%s\",\"qos\":%d,\"retain\":%s,\"dup\":%s,\"id\":%u,\"same\":%s",
+        now_sec(),
+        topic,
+        value,
+        qos,
+        (type & 0x01) ? "true" : "false",
+        (type & 0x08) ? "true" : "false",
+        id,
+        same ? "true" : "false"
+    );
+    if (qos > 0) {
+        const bool drop = g_drop_ack_every > 0 && (*publishes % g_drop_ack_every) == 0;
+        if (!drop) {
+            const uint8_t ack[4] = { 0x40, 0x02, (uint8_t)(id >> 8), (uint8_t)id };
+            send(fd, ack, sizeof(ack), MSG_NOSIGNAL);
+        }
+        printf(",\"puback\":%s", drop ? "false" : "true");
+    }
+    printf("}\n");
+}
+
+static void serve(int fd, int* connects) {
+    static uint8_t body[PACKET_MAX];
+    int publishes = 0;
+    uint8_t type;
+    int len;
+
+    while ((len = read_packet(fd, &type, body)) >= 0) {
+        switch (type & 0xF0) {
+            case 0x10:
+                handle_connect(fd, body, len, connects);
+                if (*connects <= g_refuse) return;
+                break;
+            case 0x30:
+                handle_publish(fd, type, body, len, &publishes);
+                if (g_disconnect_after > 0 && publishes >= g_disconnect_after) {
+                    printf("{\"t\":%.3f,\"type\":\"HANGUP\",\"after\":%d}\n", now_sec(), publishes);
+                    fflush(stdout);
+                    return;
+                }
+                break;
+            case 0xC0:
+                printf("{\"t\":%.3f,\"type\":\"PINGREQ\",\"answered\":%s}\n", now_sec(), g_no_pingresp ? "false" : "true");
+                if (!g_no_pingresp) {
+                    const uint8_t resp[2] = { 0xD0, 0x00 };
+                    send(fd, resp, sizeof(resp), MSG_NOSIGNAL);
+                }
+                break;
+            case 0xE0:
+                printf("{\"t\":%.3f,\"type\":\"DISCONNECT\"}\n", now_sec());
+                fflush(stdout);
+                return;
+            default:
+                printf("{\"t\":%.3f,\"type\":\"0x%02X\",\"bytes\":%d}\n", now_sec(), type, len);
+                break;
+        }
+        fflush(stdout);
+    }
+    printf("{\"t\":%.3f,\"type\":\"CLOSED\"}\n", now_sec());
+    fflush(stdout);
+}
+
+static void usage(const char* argv0) {
+    fprintf(
+        stderr,
+        "usage: %s [-p port] [-r refuse_connects] [-a drop_every_nth_puback] [-d disconnect_after_publishes] [-P]\n",
+        argv0
+    );
+}
+
+int main(int argc, char** argv) {
+    struct sockaddr_in addr;
+    struct timespec ts;
+    int connects = 0;
+    int listen_fd;
+    int one = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:r:a:d:P")) != -1) {
+        switch (opt) {
+            case 'p': g_port = atoi(optarg); break;
+            case 'r': g_refuse = atoi(optarg); break;
+            case 'a': g_drop_ack_every = atoi(optarg); break;
+            case 'd': g_disconnect_after = atoi(optarg); break;
+            case 'P': g_no_pingresp = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (g_port < 1 || g_port > 65535) {
+        usage(argv[0]);
+        return 2;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    g_start = (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)g_port);
+    if (listen_fd < 0 || bind(listen_fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 1) != 0) {
+        fprintf(stderr, "mqttsink: cannot listen on port %d: %s\n", g_port, strerror(errno));
+        return 1;
+    }
+    for (;;) {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        const int fd = accept(listen_fd, (struct sockaddr*)&peer, &peer_len);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        printf("{\"t\":%.3f,\"type\":\"ACCEPT\",\"peer\":\"%s:%u\"}\n", now_sec(), inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+        fflush(stdout);
+        serve(fd, &connects);
+        close(fd);
+    }
+}
@@ -0,0 +1,240 @@
+// Subscribes to the sysmodule's UDP push (POST /subscribe) and prints every
+// datagram as one JSON line, renewing the lease at half its length and
+// unsubscribing on Ctrl-C. The datagram layout is documented in include/push.h.
+//
+//   pushwatch -H 192.168.1.20                      all probes, port 6030
+//   pushwatch -H 192.168.1.20 -f battery,dock -l 60
+//   pushwatch -H 127.0.0.1 -p 6029 -u 7000         against the host build
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Mirrors include/push.h, which needs libnx types.
+#define PUSH_MAGIC "RNXP"
+#define PUSH_VERSION 1
+#define PUSH_HEADER_SIZE 16
+#define PUSH_FLAG_REFRESH 0x01
+#define PUSH_LEASE_MIN_SEC 10
+#define RESPONSE_MAX 2048
+
+static const char* g_host = "127.0.0.1";
+static int g_port = 6029;
+static int g_udp_port = 6030;
+static const char* g_fields = "all";
+static int g_lease_sec = 60;
+static struct sockaddr_in g_server;
+static volatile sig_atomic_t g_stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t* p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+// Sends one POST /subscribe; prints the server's answer to stderr on failure.
+static bool subscribe(int lease_sec) {
+    char body[128];
+    char request[384];
+    char response[RESPONSE_MAX];
+    size_t len = 0;
+    int body_len;
+    int request_len;
+    int status = 0;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd < 0) return false;
+    if (connect(fd, (const struct sockaddr*)&g_server, sizeof(g_server)) != 0) {
+        fprintf(stderr, "pushwatch: connect to %s:%d failed: %s\n", g_host, g_port, strerror(errno));
+        close(fd);
+        return false;
+    }
+    body_len = snprintf(body, sizeof(body), "port=%d&fields=%s&lease=%d", g_udp_port, g_fields, lease_sec);
+    request_len = snprintf(
+        request,
+        sizeof(request),
+        "POST /subscribe HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Length: %d\r\n\r\n%s",
+        g_host,
+        body_len,
+        body
+    );
+    if (send(fd, request, (size_t)request_len, MSG_NOSIGNAL) != request_len) {
+        close(fd);
+        return false;
+    }
+    while (len + 1 < sizeof(response)) {
+        const ssize_t n = recv(fd, response + len, sizeof(response) - 1 - len, 0);
+        if (n <= 0) break;
+        len += (size_t)n;
+    }
+    response[len] = '\0';
+    close(fd);
+    if (sscanf(response, "HTTP/1.%*d %d", &status) != 1 || status != 200) {
+        const char* msg = strstr(response, "\r\n\r\n");
+        fprintf(stderr, "pushwatch: subscribe failed (%d): %s", status, msg ? msg + 4 : "no response\n");
+        return false;
+    }
+    return true;
+}
+
+static void print_record(int id, const uint8_t* p, size_t len) {
+    switch (id) {
+        case 0:
+            if (len < 9) break;
+            printf("\"battery\":{\"valid\":%d,\"percent\":%u,\"rc\":\"0x%08X\"}", p[0], get_u32(p + 1), get_u32(p + 5));
+            return;
+        case 1:
+            if (len < 10) break;
+            printf(
+                "\"charger\":{\"valid\":%d,\"charging\":%d,\"type\":%u,\"rc\":\"0x%08X\"}",
+                p[0], p[1], get_u32(p + 2), get_u32(p + 6)
+            );
+            return;
+        case 2:
+            if (len < 7) break;
+            printf("\"dock\":{\"valid\":%d,\"docked\":%d,\"source\":%d,\"rc\":\"0x%08X\"}", p[0], p[1], p[2], get_u32(p + 3));
+            return;
+        case 3:
+            if (len < 33) break;
+            printf(
+                "\"title\":{\"program_id\":\"0x%016llX\",\"process_id\":%llu,\"source\":%d,\"fail_streak\":%u}",
+                (unsigned long long)get_u64(p),
+                (unsigned long long)get_u64(p + 8),
+                p[16],
+                get_u32(p + 17)
+            );
+            return;
+        default:
+            break;
+    }
+    printf("\"probe%d\":{\"bytes\":%u}", id, (unsigned int)len);
+}
+
+static void print_datagram(const uint8_t* buf, size_t len, double at_sec) {
+    size_t off = PUSH_HEADER_SIZE;
+
+    if (len < PUSH_HEADER_SIZE || memcmp(buf, PUSH_MAGIC, 4) != 0 || buf[4] != PUSH_VERSION) {
+        fprintf(stderr, "pushwatch: ignoring %u-byte datagram with a bad header\n", (unsigned int)len);
+        return;
+    }
+    printf(
+        "{\"t\":%.3f,\"seq\":%u,\"refresh\":%s,\"fields\":\"0x%02X\",\"changed\":\"0x%02X\",\"lease_left_sec\":%u,\"bytes\":%u",
+        at_sec,
+        get_u32(buf + 8),
+        (buf[5] & PUSH_FLAG_REFRESH) ? "true" : "false",
+        buf[6],
+        buf[7],
+        get_u32(buf + 12),
+        (unsigned int)len
+    );
+    while (off + 2 <= len && off + 2 + buf[off + 1] <= len) {
+        const int id = buf[off];
+        const size_t rec_len = buf[off + 1];
+        printf(",");
+        print_record(id, buf + off + 2, rec_len);
+        off += 2 + rec_len;
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void usage(const char* argv0) {
+    fprintf(
+        stderr,
+        "usage: %s [-H host] [-p http_port] [-u udp_port] [-f fields] [-l lease_sec]\n"
+        "  fields: comma separated probe names or \"all\"\n",
+        argv0
+    );
+}
+
+int main(int argc, char** argv) {
+    struct sockaddr_in local;
+    struct hostent* he;
+    struct sigaction sa;
+    struct timeval tv;
+    uint8_t buf[2048];
+    double start;
+    double renew_at;
+    int fd;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:u:f:l:")) != -1) {
+        switch (opt) {
+            case 'H': g_host = optarg; break;
+            case 'p': g_port = atoi(optarg); break;
+            case 'u': g_udp_port = atoi(optarg); break;
+            case 'f': g_fields = optarg; break;
+            case 'l': g_lease_sec = atoi(optarg); break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    if (g_port < 1 || g_port > 65535 || g_udp_port < 1 || g_udp_port > 65535 || g_lease_sec < PUSH_LEASE_MIN_SEC) {
+        usage(argv[0]);
+        return 2;
+    }
+    he = gethostbyname(g_host);
+    if (!he || he->h_addrtype != AF_INET) {
+        fprintf(stderr, "pushwatch: cannot resolve %s\n", g_host);
+        return 2;
+    }
+    memset(&g_server, 0, sizeof(g_server));
+    g_server.sin_family = AF_INET;
+    g_server.sin_port = htons((uint16_t)g_port);
+    memcpy(&g_server.sin_addr, he->h_addr_list[0], sizeof(g_server.sin_addr));
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)g_udp_port);
+    if (fd < 0 || bind(fd, (const struct sockaddr*)&local, sizeof(local)) != 0) {
+        fprintf(stderr, "pushwatch: cannot bind udp port %d: %s\n", g_udp_port, strerror(errno));
+        return 1;
+    }
+    tv.tv_sec = 0;
+    tv.tv_usec = 250000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (!subscribe(g_lease_sec)) return 1;
+    start = now_sec();
+    renew_at = start + g_lease_sec / 2.0;
+    while (!g_stop) {
+        const ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) print_datagram(buf, (size_t)n, now_sec() - start);
+        if (now_sec() >= renew_at) {
+            if (!subscribe(g_lease_sec)) fprintf(stderr, "pushwatch: lease renewal failed, retrying\n");
+            renew_at = now_sec() + (g_lease_sec / 2.0);
+        }
+    }
+    subscribe(0);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,92 @@
+// Host-side dump of the sysmodule's status.bin. Prints both slots in the
+// key=value form the old status.txt used and marks the current one.
+// Exit status is 0 for a clean previous shutdown, 3 if the current record is
+// still RUNNING (unclean), 1 if no valid record exists.
+
+#include "status_record.h"
+
+#include <stdio.h>
+
+static const char* const g_service_names[StatusService_Count] = {
+    "sm", "fs", "setsys", "applet", "psm", "pmshell", "pminfo", "nifm", "socket", "ns",
+};
+
+static const char* const g_flag_names[StatusFlag_Count] = {
+    "http_started", "detector_started", "detector_running", "detector_alive", "kill_switch", "unclean_prev",
+};
+
+static const char* state_name(uint32_t state) {
+    switch (state) {
+        case StatusState_Running: return "RUNNING";
+        case StatusState_Stopped: return "STOPPED";
+        default: return "UNKNOWN";
+    }
+}
+
+static void dump_record(const StatusRecord* rec, FILE* out) {
+    int i;
+
+    fprintf(out, "state=%s\n", state_name(rec->state));
+    fprintf(out, "sequence=%llu\n", (unsigned long long)rec->sequence);
+    fprintf(out, "session_id=%llu\n", (unsigned long long)rec->session_id);
+    fprintf(out, "uptime_sec=%llu\n", (unsigned long long)rec->uptime_sec);
+    fprintf(out, "stage=%.*s\n", (int)sizeof(rec->stage), rec->stage);
+    fprintf(out, "last_rc=0x%08lX\n", (unsigned long)rec->last_rc);
+    fprintf(out, "heartbeats=%llu\n", (unsigned long long)rec->heartbeats);
+    for (i = 0; i < StatusService_Count; i++) {
+        fprintf(out, "%s%s=%d", i ? " " : "", g_service_names[i], (rec->services >> i) & 1 ? 1 : 0);
+    }
+    fputc('\n', out);
+    for (i = 0; i < StatusFlag_Count; i++) {
+        fprintf(out, "%s%s=%d", i ? " " : "", g_flag_names[i], (rec->flags >> i) & 1 ? 1 : 0);
+    }
+    fputc('\n', out);
+    fprintf(
+        out,
+        "detector_last_hb=%llu detector_attempts=%llu detector_ok=%llu detector_fail=%llu detector_streak=%u\n",
+        (unsigned long long)rec->detector_last_heartbeat_sec,
+        (unsigned long long)rec->detector_attempts,
+        (unsigned long long)rec->detector_successes,
+        (unsigned long long)rec->detector_failures,
+        (unsigned int)rec->detector_fail_streak
+    );
+    fprintf(
+        out,
+        "detector_cooldown_until=%llu detector_last_rc=0x%08lX\n",
+        (unsigned long long)rec->detector_cooldown_until_sec,
+        (unsigned long)rec->detector_last_rc
+    );
+}
+
+int main(int argc, char** argv) {
+    StatusRecord slots[STATUS_RECORD_SLOTS];
+    FILE* f;
+    int newest;
+    int i;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s status.bin\n", argv[0]);
+        return 2;
+    }
+
+    f = fopen(argv[1], "rb");
+    if (!f) {
+        fprintf(stderr, "statusdump: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    newest = status_record_read_slots(f, slots);
+    fclose(f);
+
+    for (i = 0; i < STATUS_RECORD_SLOTS; i++) {
+        if (!status_record_valid(&slots[i])) {
+            printf("[slot %d] invalid\n\n", i);
+            continue;
+        }
+        printf("[slot %d]%s\n", i, i == newest ? " current" : "");
+        dump_record(&slots[i], stdout);
+        putchar('\n');
+    }
+
+    if (newest < 0) return 1;
+    return slots[newest].state == StatusState_Running ? 3 : 0;
+}